@@ -0,0 +1,70 @@
+#include "AST/Builder.h"
+#include "AST/TreeOps/BatchEval.h"
+#include "AST/TreeOps/EvalExpression.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace kiwi;
+
+// FullEval row by row against BatchEval on the same columns
+//  usage: batch_bench [rows]
+
+template <typename Fun> double measure(Fun fun) {
+    auto start = std::chrono::high_resolution_clock::now();
+    fun();
+    auto end = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+int main(int argc, char const *argv[]) {
+    std::size_t n = argc > 1 ? std::size_t(std::atol(argv[1])) : 1000000;
+
+    BuilderContext ctx;
+    Builder builder(&ctx);
+    for(char const *name : {"+", "-", "*", "/", "sqrt", "x", "y"})
+        builder.make_placeholder(name);
+
+    auto x = [&]() { return builder.get_ctx_ref("x"); };
+    auto y = [&]() { return builder.get_ctx_ref("y"); };
+
+    // sqrt(x * x + y * y) / (x + 1) - y * 0.5
+    Expression *expr = builder.make_binary_call(
+        "-",
+        builder.make_binary_call(
+            "/",
+            builder.make_unary_call(
+                "sqrt", builder.make_binary_call("+", builder.make_binary_call("*", x(), x()),
+                                                 builder.make_binary_call("*", y(), y()))),
+            builder.make_binary_call("+", x(), builder.make_value(1.0))),
+        builder.make_binary_call("*", y(), builder.make_value(0.5)));
+
+    Array<double> xs(n), ys(n), tree(n), batch(n);
+    for(std::size_t i = 0; i < n; ++i) {
+        xs[i] = double(i % 100) * 0.25;
+        ys[i] = double(i % 37) - 10;
+    }
+
+    double tree_ms = measure([&]() {
+        PrimitiveValue vx(0.0), vy(0.0);
+        Context row;
+        row[Symbol("x")] = &vx;
+        row[Symbol("y")] = &vy;
+
+        for(std::size_t i = 0; i < n; ++i) {
+            vx.set_value(xs[i]);
+            vy.set_value(ys[i]);
+            tree[i] = full_eval(row, expr);
+        }
+    });
+
+    double batch_ms = measure([&]() {
+        Columns columns = {{Symbol("x"), xs.data()}, {Symbol("y"), ys.data()}};
+        BatchEval(Context(), columns).run(expr, n, batch.data());
+    });
+
+    std::printf("%zu rows  tree %9.2f ms  batch %9.2f ms  speedup %6.1fx  (%s)\n", n, tree_ms,
+                batch_ms, tree_ms / batch_ms, tree == batch ? "same" : "DIFFERENT");
+    return 0;
+}
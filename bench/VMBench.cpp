@@ -0,0 +1,102 @@
+#include "AST/Builder.h"
+#include "AST/FlatAST.h"
+#include "AST/TreeOps/EvalExpression.h"
+#include "VM/Compiler.h"
+#include "VM/VirtualMachine.h"
+
+#ifdef KIWI_USE_LLVM_IR
+#include "JIT/NativeJIT.h"
+#endif
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace kiwi;
+
+// FullEval against the bytecode VM on the same expressions
+// and against a linear walk of the flat tree when there is no call
+//  usage: vm_bench [repeat]
+
+template <typename Fun> double measure(int repeat, Fun fun, double &result) {
+    auto start = std::chrono::high_resolution_clock::now();
+    for(int i = 0; i < repeat; ++i)
+        result = fun();
+    auto end = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count() / repeat;
+}
+
+void report(char const *name, int repeat, Context const &env, Expression *expr) {
+    Program program = compile_bytecode(env, expr);
+    VirtualMachine vm;
+
+    double tree     = 0;
+    double bytecode = 0;
+    double tree_ms = measure(repeat, [&]() { return full_eval(env, expr); }, tree);
+    double vm_ms   = measure(repeat, [&]() { return vm.run(program); }, bytecode);
+
+    std::printf("%-12s tree %10.4f ms  vm %10.4f ms  speedup %6.1fx  (%g, %g)\n", name, tree_ms,
+                vm_ms, tree_ms / vm_ms, tree, bytecode);
+}
+
+int main(int argc, char const *argv[]) {
+    int repeat = argc > 1 ? std::atoi(argv[1]) : 10;
+
+    BuilderContext ctx;
+    Builder builder(&ctx);
+    builder.make_placeholder("+");
+    builder.make_placeholder("-");
+    builder.make_placeholder("*");
+    builder.make_placeholder("x");
+
+    // def fib(n) = n match | 0 => 0 | 1 => 1 | _ => fib(n - 1) + fib(n - 2)
+    FunctionBuilder fb = builder.make_function("fib");
+    fb.add_arg("n", get_primitive_type<f64>());
+
+    auto fib_call = [&](Expression *arg) {
+        return builder.make<FunctionCall>(builder.get_ctx_ref("fib"), Array<Expression *>{arg});
+    };
+    auto fib_sub = [&](double offset) {
+        return fib_call(
+            builder.make_binary_call("-", builder.get_ctx_ref("n"), builder.make_value(offset)));
+    };
+
+    Match *match  = builder.make<Match>();
+    match->target = builder.get_ctx_ref("n");
+    match->branches.emplace_back(builder.make_value(0.0), builder.make_value(0.0));
+    match->branches.emplace_back(builder.make_value(1.0), builder.make_value(1.0));
+    match->default_branch = builder.make_binary_call("+", fib_sub(1), fib_sub(2));
+    fb.add_body(match);
+    Function *fib = fb.build();
+
+    // x * (x * (x * (... + 1) + 1) + 1), evaluated in place
+    Expression *poly = builder.make_value(1.0);
+    for(int i = 0; i < 64; ++i)
+        poly = builder.make_binary_call(
+            "+", builder.make_binary_call("*", builder.get_ctx_ref("x"), poly),
+            builder.make_value(1.0));
+
+    Context env;
+    env[Symbol("fib")] = fib;
+    env[Symbol("x")]   = builder.make_value(0.5);
+
+    report("fib(18)", repeat, env, fib_call(builder.make_value(18.0)));
+    report("horner(64)", repeat * 1000, env, poly);
+
+    FlatTree flat = flatten(poly);
+    FlatEval walker(env);
+    double flat_result = 0;
+    double flat_ms = measure(repeat * 1000, [&]() { return walker.run(flat); }, flat_result);
+    std::printf("%-12s flat %10.4f ms  (%g)\n", "horner(64)", flat_ms, flat_result);
+
+#ifdef KIWI_USE_LLVM_IR
+    NativeJIT jit(env);
+    auto native_fib = jit.compile_as<f64, f64>(fib);
+    if(native_fib != nullptr) {
+        double result    = 0;
+        double native_ms = measure(repeat, [&]() { return native_fib(18); }, result);
+        std::printf("%-12s native %8.4f ms  (%g)\n", "fib(18)", native_ms, result);
+    }
+#endif
+    return 0;
+}
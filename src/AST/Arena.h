@@ -0,0 +1,250 @@
+#ifndef KIWI_AST_ARENA_HEADER
+#define KIWI_AST_ARENA_HEADER
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "../Types.h"
+
+namespace kiwi {
+
+struct ArenaStats {
+    u64 allocations = 0; // number of allocations served
+    u64 bytes       = 0; // bytes currently handed out
+    u64 peak_bytes  = 0; // highest `bytes` ever reached
+    u64 reserved    = 0; // bytes currently reserved from the system
+    u64 blocks      = 0; // number of blocks currently reserved
+};
+
+/* Bump allocator owning the nodes of a module.
+ *
+ * Nodes are never freed one by one, the whole arena is released at once
+ * when it is destroyed or reset. Nodes with a non trivial destructor
+ * (i.e holding an Array or a String) register a finalizer so the memory
+ * they own is given back too; trivial nodes cost nothing to release.
+ */
+class Arena {
+  public:
+    Arena(std::size_t block_size = 64 * 1024) : _block_size(block_size) {}
+
+    Arena(Arena const &) = delete;
+    Arena &operator=(Arena const &) = delete;
+
+    ~Arena() {
+        finalize();
+        free_blocks(nullptr);
+        trim();
+    }
+
+    void *allocate(std::size_t size, std::size_t align = alignof(std::max_align_t)) {
+        _stats.allocations += 1;
+        return bump(size, align);
+    }
+
+    template <typename T, typename... Args> T *make(Args &&... args) {
+        void *mem = allocate(sizeof(T), alignof(T));
+        T *obj    = new(mem) T(std::forward<Args>(args)...);
+
+        if(!std::is_trivially_destructible<T>::value) {
+            void *fmem  = bump(sizeof(Finalizer), alignof(Finalizer));
+            _finalizers = new(fmem) Finalizer{&destroy<T>, obj, _finalizers};
+        }
+        return obj;
+    }
+
+    // Position in the arena, see rewind
+    struct Mark;
+
+    Mark mark() const;
+
+    // Release every object allocated after `m`, their blocks are kept for reuse
+    void rewind(Mark const &m);
+
+    // Was `ptr` allocated from this arena
+    // binary search in the live blocks, sorted by address
+    bool owns(void const *ptr) const {
+        char const *p = static_cast<char const *>(ptr);
+        auto after    = std::upper_bound(_blocks.begin(), _blocks.end(), p,
+                                      [](char const *p, Block *b) { return p < data(b); });
+        if(after == _blocks.begin())
+            return false;
+
+        Block *block = *(after - 1);
+        return p < data(block) + block->size;
+    }
+
+    // Release every object but keep the first block around for reuse
+    void reset() {
+        finalize();
+        trim();
+
+        Block *first = _head;
+        while(first != nullptr && first->prev != nullptr)
+            first = first->prev;
+
+        free_blocks(first);
+
+        _head   = first;
+        _offset = 0;
+
+        _stats.bytes    = 0;
+        _stats.blocks   = first ? 1 : 0;
+        _stats.reserved = first ? first->size : 0;
+    }
+
+    ArenaStats const &stats() const { return _stats; }
+
+    // Give the blocks kept by rewind back to the system
+    void trim() {
+        while(_spare != nullptr) {
+            Block *prev = _spare->prev;
+            _stats.blocks -= 1;
+            _stats.reserved -= _spare->size;
+            std::free(_spare);
+            _spare = prev;
+        }
+    }
+
+  private:
+    struct Block {
+        Block *prev;
+        std::size_t size;
+    };
+
+    struct Finalizer {
+        void (*destroy)(void *);
+        void *object;
+        Finalizer *prev;
+    };
+
+    void *bump(std::size_t size, std::size_t align) {
+        std::size_t offset = aligned_offset(align);
+
+        if(_head == nullptr || offset + size > _head->size) {
+            new_block(size + align);
+            offset = aligned_offset(align);
+        }
+
+        _offset = offset + size;
+        _stats.bytes += size;
+        if(_stats.bytes > _stats.peak_bytes)
+            _stats.peak_bytes = _stats.bytes;
+
+        return data(_head) + offset;
+    }
+
+    std::size_t aligned_offset(std::size_t align) const {
+        if(_head == nullptr)
+            return 0;
+
+        std::uintptr_t base = reinterpret_cast<std::uintptr_t>(data(_head));
+        std::uintptr_t ptr  = (base + _offset + align - 1) & ~std::uintptr_t(align - 1);
+        return std::size_t(ptr - base);
+    }
+
+    template <typename T> static void destroy(void *obj) { static_cast<T *>(obj)->~T(); }
+
+    static char *data(Block *block) { return reinterpret_cast<char *>(block + 1); }
+
+    void new_block(std::size_t min_size) {
+        // reuse a block released by rewind
+        if(_spare != nullptr && _spare->size >= min_size) {
+            Block *block = _spare;
+            _spare       = block->prev;
+            block->prev  = _head;
+            _head        = block;
+            _offset      = 0;
+            index(block);
+            return;
+        }
+
+        std::size_t size = min_size > _block_size ? min_size : _block_size;
+        Block *block     = static_cast<Block *>(std::malloc(sizeof(Block) + size));
+
+        if(block == nullptr)
+            throw std::bad_alloc();
+
+        block->prev = _head;
+        block->size = size;
+        _head       = block;
+        _offset     = 0;
+        index(block);
+
+        _stats.blocks += 1;
+        _stats.reserved += size;
+    }
+
+    // Run finalizers in reverse allocation order
+    void finalize() {
+        for(Finalizer *f = _finalizers; f != nullptr; f = f->prev)
+            f->destroy(f->object);
+        _finalizers = nullptr;
+    }
+
+    // Free every block allocated after `keep`
+    void free_blocks(Block *keep) {
+        while(_head != nullptr && _head != keep) {
+            Block *prev = _head->prev;
+            unindex(_head);
+            std::free(_head);
+            _head = prev;
+        }
+    }
+
+    static bool by_address(Block *a, Block *b) { return data(a) < data(b); }
+
+    // Track a block that became live
+    void index(Block *block) {
+        _blocks.insert(std::upper_bound(_blocks.begin(), _blocks.end(), block, by_address),
+                       block);
+    }
+
+    // Stop tracking a block that was freed or moved to the spares
+    void unindex(Block *block) {
+        auto it = std::lower_bound(_blocks.begin(), _blocks.end(), block, by_address);
+        if(it != _blocks.end() && *it == block)
+            _blocks.erase(it);
+    }
+
+    std::size_t _block_size;
+    std::size_t _offset{0};
+    Block *_head{nullptr};
+    Finalizer *_finalizers{nullptr};
+    Block *_spare{nullptr}; // blocks released by rewind
+    Array<Block *> _blocks; // live blocks sorted by address
+    ArenaStats _stats;
+};
+
+struct Arena::Mark {
+    Block *block;
+    std::size_t offset;
+    Finalizer *finalizers;
+    u64 bytes;
+};
+
+inline Arena::Mark Arena::mark() const { return Mark{_head, _offset, _finalizers, _stats.bytes}; }
+
+inline void Arena::rewind(Mark const &m) {
+    for(; _finalizers != m.finalizers; _finalizers = _finalizers->prev)
+        _finalizers->destroy(_finalizers->object);
+
+    while(_head != m.block) {
+        Block *prev = _head->prev;
+        unindex(_head);
+        _head->prev = _spare;
+        _spare      = _head;
+        _head       = prev;
+    }
+
+    _offset      = m.offset;
+    _stats.bytes = m.bytes;
+}
+
+} // namespace kiwi
+
+#endif
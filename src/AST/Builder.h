@@ -3,8 +3,10 @@
 
 #define PARENT(x)
 
+#include "Arena.h"
 #include "Definition.h"
 #include "Expression.h"
+#include "HashCons.h"
 #include "Stack.h"
 #include "Type.h"
 #include "Value.h"
@@ -12,119 +14,124 @@
 
 namespace kiwi {
 
+/* Lexical environment used while building an AST.
+ *
+ * Bindings are kept in a single array in declaration order, each one links
+ * to the binding of the same name it shadows. `_latest` maps a symbol id to
+ * the innermost live binding so a lookup is two array reads, exiting a
+ * scope pops its bindings and restores the shadowed ones.
+ *
+ * A name resolves to a (depth, slot) pair: depth is the number of scopes
+ * between the reference and its binding, slot the index of the binding
+ * inside the scope that declared it (unnamed statements take no slot).
+ */
 class BuilderContext {
   public:
-    BuilderContext() {
-        owned = true;
-        ctx_stack.push(new SubContext(0));
-    }
+    struct Binding {
+        Symbol name;
+        Statement *stmt;
+        u32 depth;       // depth of the scope that declared it
+        u32 slot;        // index inside that scope
+        int32 shadowed;  // binding of the same name it hides, -1 if none
+    };
 
-    ~BuilderContext() {
-        if(owned) {
-            SubContext *ctx = ctx_stack.pop();
-            delete ctx;
-        }
-    }
+    BuilderContext() { enter_scope(); }
 
-    Array<Statement *> get_statements() { return ctx_stack.last()->statements; }
+    Array<Statement *> get_statements() const {
+        Scope const &scope = _scopes.back();
+        return Array<Statement *>(_statements.begin() + std::ptrdiff_t(scope.first_statement),
+                                  _statements.end());
+    }
 
     // Some statements are not addressabable
     void insert(Statement *stmt) {
-        ctx_stack.last()->insert(stmt);
+        _statements.push_back(stmt);
         size += 1;
     }
 
     // Addressable statement
-    void insert(String const &str, Statement *stmt) {
-        ctx_stack.last()->insert(str, stmt);
-        SubContext *ctx = ctx_mappings[str];
-
-        // Variable Shadowing
-        if(ctx) {
-            // Print Warning
-            previous_ctx[ctx_stack.last()] = ctx;
-            shadowed_variables[ctx_stack.last()].push_back(str);
-        }
+    void insert(Symbol str, Statement *stmt) {
+        Scope const &scope = _scopes.back();
 
-        ctx_mappings[str] = ctx_stack.last();
-        size += 1;
+        if(str.id() >= _latest.size())
+            _latest.resize(std::size_t(str.id()) + 1, -1);
+
+        // only addressable statements take a slot
+        int32 &latest = _latest[str.id()];
+        u32 slot      = u32(_bindings.size() - scope.first_binding);
+
+        _bindings.push_back(Binding{str, stmt, depth(), slot, latest});
+        latest = int32(_bindings.size() - 1);
+
+        insert(stmt);
     }
 
-    void enter_scope() { ctx_stack.push(new SubContext(ctx_stack.last()->depth + 1)); }
+    void enter_scope() { _scopes.push_back(Scope{_bindings.size(), _statements.size()}); }
 
+    // The root scope is never exited
     void exit_scope() {
-        SubContext *ctx  = ctx_stack.pop();
-        SubContext *pctx = previous_ctx[ctx];
-        // Shadowed Variables detected need to restore previous context
-        if(pctx) {
-            Array<String> &vars = shadowed_variables.at(ctx);
-            for(String &str : vars) {
-                ctx_mappings[str] = pctx;
-            }
-            shadowed_variables.erase(ctx);
-            previous_ctx.erase(ctx);
+        if(_scopes.size() <= 1)
+            return;
+
+        Scope scope = _scopes.back();
+        _scopes.pop_back();
+
+        // restore shadowed bindings
+        while(_bindings.size() > scope.first_binding) {
+            Binding const &b    = _bindings.back();
+            _latest[b.name.id()] = b.shadowed;
+            _bindings.pop_back();
         }
-        delete ctx;
+        _statements.resize(scope.first_statement);
     }
 
-    Statement *get_statement(String const &str) const {
-        SubContext *ctx = ctx_mappings.at(str);
-        if(ctx)
-            return ctx->get_statement(str);
-        return nullptr;
+    // Innermost binding of a name, nullptr if the name is not bound
+    Binding const *lookup(Symbol str) const {
+        if(str.id() >= _latest.size() || _latest[str.id()] < 0)
+            return nullptr;
+        return &_bindings[std::size_t(_latest[str.id()])];
     }
 
-    int32 get_ref_index(String const &str) const {
-        SubContext *ctx = ctx_mappings.at(str);
-        if(ctx)
-            return ctx->get_ref_index(str);
-        return -1;
+    Statement *get_statement(Symbol str) const {
+        Binding const *b = lookup(str);
+        return b ? b->stmt : nullptr;
     }
 
-    u64 depth() { return ctx_stack.last()->depth; }
+    int32 get_ref_index(Symbol str) const {
+        Binding const *b = lookup(str);
+        return b ? int32(b->slot) : -1;
+    }
 
-  private:
-    struct SubContext {
-        Array<Statement *> statements;
-        Dict<String, u64> mappings;
-        u64 depth;
+    // Number of scopes between the current scope and the binding, -1 if not bound
+    int32 get_ref_depth(Symbol str) const {
+        Binding const *b = lookup(str);
+        return b ? int32(depth() - b->depth) : -1;
+    }
 
-        SubContext(u64 depth) : depth(depth) {}
+    u32 depth() const { return u32(_scopes.size() - 1); }
 
-        // Some statement are not addressabable
-        void insert(Statement *stmt) { statements.push_back(stmt); }
+    // Every node built inside this context is allocated here
+    // dropping the context releases the whole module at once
+    Arena &arena() { return _arena; }
 
-        // Addressable statement
-        void insert(String const &str, Statement *stmt) {
-            mappings[str] = statements.size();
-            insert(stmt);
-        }
+    ArenaStats const &stats() const { return _arena.stats(); }
 
-        int32 get_ref_index(String const &str) const {
-            if(mappings.count(str) > 0)
-                return int32(mappings.at(str));
-            else
-                return -1;
-        }
-
-        Statement *get_statement(String const &str) const {
-            int32 index = get_ref_index(str);
-            return get_statement(index);
-        }
+    // Unique nodes shared by the builders running in hash-consing mode
+    HashConsTable &hash_cons() { return _hash_cons; }
 
-        Statement *get_statement(int32 index) const {
-            if(index >= 0)
-                return statements.at(std::size_t(index));
-            return nullptr;
-        }
+  private:
+    struct Scope {
+        std::size_t first_binding;
+        std::size_t first_statement;
     };
 
-    Stack<SubContext *> ctx_stack;
-    Dict<String, SubContext *> ctx_mappings;
-    Dict<SubContext *, SubContext *> previous_ctx;
-    Dict<SubContext *, Array<String>> shadowed_variables;
-    bool owned = true;
-    u64 size;
+    Array<Scope> _scopes;
+    Array<Binding> _bindings;
+    Array<Statement *> _statements;
+    Array<int32> _latest; // SymbolId -> index in _bindings
+    u64 size = 0;
+    Arena _arena;
+    HashConsTable _hash_cons;
 };
 
 /*
@@ -238,19 +245,22 @@ class Builder {
 
 class UnionBuilder {
   public:
-    UnionBuilder(BuilderContext *ctx) : ctx(ctx) {}
+    UnionBuilder(BuilderContext *ctx) : ctx(ctx) { ctx->enter_scope(); }
 
     // Union with Bind
-    UnionBuilder(BuilderContext *ctx, String const &name) : ctx(ctx) { ctx->insert(name, un); }
+    UnionBuilder(BuilderContext *ctx, Symbol name) : ctx(ctx) {
+        ctx->insert(name, un);
+        ctx->enter_scope();
+    }
 
   public:
-    UnionBuilder *add_meta_type(String const &name, Statement *stmt) {
+    UnionBuilder *add_meta_type(Symbol name, Statement *stmt) {
         ctx->insert(name, stmt);
         un->add_meta_type(name, stmt);
         return this;
     }
 
-    UnionBuilder *add_attribute(String const &name, Statement *stmt) {
+    UnionBuilder *add_attribute(Symbol name, Statement *stmt) {
         ctx->insert(name, stmt);
         un->add_attribute(name, stmt);
         return this;
@@ -258,29 +268,32 @@ class UnionBuilder {
 
     Union *build() {
         ctx->exit_scope();
-        return un;
+        return un->seal();
     }
 
   private:
     BuilderContext *ctx;
-    Union *un = new Union();
+    Union *un = ctx->arena().make<Union>();
 };
 
 class StructBuilder {
   public:
-    StructBuilder(BuilderContext *ctx) : ctx(ctx) {}
+    StructBuilder(BuilderContext *ctx) : ctx(ctx) { ctx->enter_scope(); }
 
     // Struct with Bind
-    StructBuilder(BuilderContext *ctx, String const &name) : ctx(ctx) { ctx->insert(name, stru); }
+    StructBuilder(BuilderContext *ctx, Symbol name) : ctx(ctx) {
+        ctx->insert(name, stru);
+        ctx->enter_scope();
+    }
 
   public:
-    StructBuilder *add_meta_type(String const &name, Statement *stmt) {
+    StructBuilder *add_meta_type(Symbol name, Statement *stmt) {
         ctx->insert(name, stmt);
         stru->add_meta_type(name, stmt);
         return this;
     }
 
-    StructBuilder *add_attribute(String const &name, Statement *stmt) {
+    StructBuilder *add_attribute(Symbol name, Statement *stmt) {
         ctx->insert(name, stmt);
         stru->add_attribute(name, stmt);
         return this;
@@ -288,23 +301,26 @@ class StructBuilder {
 
     Struct *build() {
         ctx->exit_scope();
-        return stru;
+        return stru->seal();
     }
 
   private:
     BuilderContext *ctx;
-    Struct *stru = new Struct();
+    Struct *stru = ctx->arena().make<Struct>();
 };
 
 class FunctionBuilder {
   public:
-    FunctionBuilder(BuilderContext *ctx) : ctx(ctx) {}
+    FunctionBuilder(BuilderContext *ctx) : ctx(ctx) { ctx->enter_scope(); }
 
     // Function with Bind
-    FunctionBuilder(BuilderContext *ctx, String const &name) : ctx(ctx) { ctx->insert(name, fun); }
+    FunctionBuilder(BuilderContext *ctx, Symbol name) : ctx(ctx) {
+        ctx->insert(name, fun);
+        ctx->enter_scope();
+    }
 
   public:
-    FunctionBuilder *add_arg(String const &name, Statement *stmt) {
+    FunctionBuilder *add_arg(Symbol name, Statement *stmt) {
         ctx->insert(name, stmt);
         fun->add_arg(name, stmt);
         return this;
@@ -327,59 +343,86 @@ class FunctionBuilder {
 
   private:
     BuilderContext *ctx;
-    Function *fun = new Function();
+    Function *fun = ctx->arena().make<Function>();
 };
 
 class UnionValueBuilder {
   public:
-    UnionValueBuilder(Union *type) { un_val->set_type(type); }
+    UnionValueBuilder(BuilderContext *ctx, Union *type) : ctx(ctx) { un_val->set_type(type); }
 
     // Union Value with Bind
-    UnionValueBuilder(BuilderContext *ctx, String const &name, Union *type) {
+    UnionValueBuilder(BuilderContext *ctx, Symbol name, Union *type) : ctx(ctx) {
         ctx->insert(name, un_val);
         un_val->set_type(type);
     }
 
   public:
-    UnionValueBuilder *set_value(String const &name, Value *stmt) {
-        un_val->index = un_val->definition()->get_attribute_index(name);
-        un_val->value = stmt;
+    UnionValueBuilder *set_value(Symbol name, Value *stmt) {
+        un_val->set_value(un_val->definition()->get_attribute_index(name), stmt);
+        return this;
+    }
+
+    template <typename T> UnionValueBuilder *set(Symbol name, T v) {
+        un_val->set(un_val->definition()->get_attribute_index(name), v);
         return this;
     }
 
     UnionValue *build() { return un_val; }
 
   private:
-    UnionValue *un_val = new UnionValue();
+    BuilderContext *ctx;
+    UnionValue *un_val = ctx->arena().make<UnionValue>();
 };
 
 class StructValueBuilder {
   public:
-    StructValueBuilder(Struct *type) { struct_val->set_type(type); }
+    StructValueBuilder(BuilderContext *ctx, Struct *type) : ctx(ctx) {
+        struct_val->set_type(type);
+    }
 
     // Struct Value with Bind
-    StructValueBuilder(BuilderContext *ctx, String const &name, Struct *type) {
+    StructValueBuilder(BuilderContext *ctx, Symbol name, Struct *type) : ctx(ctx) {
         ctx->insert(name, struct_val);
         struct_val->set_type(type);
     }
 
   public:
-    StructValueBuilder *set_value(String const &name, Value *stmt) {
+    StructValueBuilder *set_value(Symbol name, Value *stmt) {
+        auto index = struct_val->definition()->get_attribute_index(name);
+        if(index >= 0)
+            struct_val->set_value(std::size_t(index), stmt);
+        return this;
+    }
+
+    template <typename T> StructValueBuilder *set(Symbol name, T v) {
         auto index = struct_val->definition()->get_attribute_index(name);
         if(index >= 0)
-            struct_val->values[std::size_t(index)] = stmt;
+            struct_val->set(std::size_t(index), v);
         return this;
     }
 
     StructValue *build() { return struct_val; }
 
   private:
-    StructValue *struct_val = new StructValue();
+    BuilderContext *ctx;
+    StructValue *struct_val = ctx->arena().make<StructValue>();
 };
 
-// Need to spawn a builder and ctx per thread
+// A Builder and its context are not thread safe,
+// use ParallelModuleBuilder to build a module from many threads
+//
+// In hash-consing mode structurally identical references, values and calls
+// are built once and shared: the AST becomes a DAG and its nodes must be
+// considered immutable.
 struct Builder {
-    Builder(BuilderContext *ctx) : ctx(ctx) { assert(ctx != nullptr); }
+    Builder(BuilderContext *ctx, bool hash_consing = false) :
+        ctx(ctx), hash_consing(hash_consing) {
+        assert(ctx != nullptr);
+    }
+
+    void set_hash_consing(bool enabled) { hash_consing = enabled; }
+
+    bool is_hash_consing() const { return hash_consing; }
 
     FunctionBuilder make_function() { return FunctionBuilder(ctx); }
 
@@ -387,74 +430,120 @@ struct Builder {
 
     StructBuilder make_struct() { return StructBuilder(ctx); }
 
-    FunctionBuilder make_function(String const &name) { return FunctionBuilder(ctx, name); }
+    FunctionBuilder make_function(Symbol name) { return FunctionBuilder(ctx, name); }
 
-    UnionBuilder make_union(String const &name) { return UnionBuilder(ctx, name); }
+    UnionBuilder make_union(Symbol name) { return UnionBuilder(ctx, name); }
 
-    StructBuilder make_struct(String const &name) { return StructBuilder(ctx, name); }
+    StructBuilder make_struct(Symbol name) { return StructBuilder(ctx, name); }
 
-    Union *make_union(String const &name, Array<Tuple<String, Statement *>> const &meta,
-                      Array<Tuple<String, Statement *>> const &attr) {
-        auto s = new Union(meta, attr);
+    Union *make_union(Symbol name, Array<Tuple<Symbol, Statement *>> const &meta,
+                      Array<Tuple<Symbol, Statement *>> const &attr) {
+        auto s = make<Union>(meta, attr)->seal();
         ctx->insert(name, s);
         return s;
     }
-    Struct *make_struct(String const &name, Array<Tuple<String, Statement *>> const &meta,
-                        Array<Tuple<String, Statement *>> const &attr) {
-        auto s = new Struct(meta, attr);
+    Struct *make_struct(Symbol name, Array<Tuple<Symbol, Statement *>> const &meta,
+                        Array<Tuple<Symbol, Statement *>> const &attr) {
+        auto s = make<Struct>(meta, attr)->seal();
         ctx->insert(name, s);
         return s;
     }
 
     // Leaves
-    PlaceholderReference *get_ctx_ref(String const &name) {
-        return new PlaceholderReference(name, ctx->get_ref_index(name));
+    // Reference resolved to the innermost binding of `name`
+    PlaceholderReference *get_ctx_ref(Symbol name) {
+        int32 index = ctx->get_ref_index(name);
+        int32 depth = ctx->get_ref_depth(name);
+        if(!hash_consing)
+            return make<PlaceholderReference>(name, index, depth);
+
+        // references are unique per binding, not per name
+        Statement *binding = ctx->get_statement(name);
+        NodeKey key{NodeTag::placeholder_ref, name.id(), u64(u32(index)) | (u64(u32(depth)) << 32),
+                    NodeKey::id(binding), 0};
+        return static_cast<PlaceholderReference *>(ctx->hash_cons().get(
+            key, [&]() { return make<PlaceholderReference>(name, index, depth); }));
     }
 
-    template <typename T> Value *make_value(T val) { return new PrimitiveValue(val); }
+    template <typename T> Value *make_value(T val) {
+        PrimitiveTag tag = get_primitive_tag<T>();
+        if(!hash_consing || tag == PrimitiveTag::none)
+            return make<PrimitiveValue>(val);
+
+        NodeKey key{NodeTag::value, u32(tag), NodeKey::bits(val), 0, 0};
+        return static_cast<Value *>(
+            ctx->hash_cons().get(key, [&]() { return make<PrimitiveValue>(val); }));
+    }
 
-    template <typename T> Value *make_value(String const &name, T val) {
-        auto v = new PrimitiveValue(val);
+    template <typename T> Value *make_value(Symbol name, T val) {
+        auto v = make<PrimitiveValue>(val);
         ctx->insert(name, v);
         return v;
     }
 
-    BuiltinType *make_builtin(String const &name) { return new BuiltinType(name); }
+    BuiltinType *make_builtin(Symbol name) { return make<BuiltinType>(name); }
+
+    Block *make_block() { return make<Block>(); }
 
-    UnionValueBuilder *make_union_value(String const &type_name) {
+    UnionValueBuilder *make_union_value(Symbol type_name) {
         Statement *type = ctx->get_statement(type_name);
-        if(type->tag == NodeTag::struct_def) {
-            return new UnionValueBuilder(static_cast<Union *>(type));
+        if(type != nullptr && type->tag == NodeTag::union_def) {
+            return make<UnionValueBuilder>(ctx, static_cast<Union *>(type));
         }
-        printf("Could not find the union type %s\n", type_name.c_str());
+        log_error("Could not find the union type ", type_name);
         return nullptr;
     }
 
-    StructValueBuilder *make_struct_value(String const &type_name) {
+    StructValueBuilder *make_struct_value(Symbol type_name) {
         Statement *type = ctx->get_statement(type_name);
-        if(type->tag == NodeTag::struct_def) {
-            return new StructValueBuilder(static_cast<Struct *>(type));
+        if(type != nullptr && type->tag == NodeTag::struct_def) {
+            return make<StructValueBuilder>(ctx, static_cast<Struct *>(type));
         }
-        printf("Could not find the struct type %s\n", type_name.c_str());
+        log_error("Could not find the struct type ", type_name);
         return nullptr;
     }
 
-    Expression *make_unary_call(String const &op_name, Expression *expr) {
-        return new UnaryCall(get_ctx_ref(op_name), expr);
+    Expression *make_unary_call(Symbol op_name, Expression *expr) {
+        return make_unary_call(get_ctx_ref(op_name), expr);
+    }
+
+    // `fun` is the reference to the operator, i.e of an existing call
+    Expression *make_unary_call(Expression *fun, Expression *expr) {
+        if(!hash_consing)
+            return make<UnaryCall>(fun, expr);
+
+        NodeKey key{NodeTag::unary_call, 0, NodeKey::id(fun), NodeKey::id(expr), 0};
+        return ctx->hash_cons().get(key, [&]() { return make<UnaryCall>(fun, expr); });
     }
 
-    Expression *make_binary_call(String const &op_name, Expression *lhs, Expression *rhs) {
-        return new BinaryCall(get_ctx_ref(op_name), lhs, rhs);
+    Expression *make_binary_call(Symbol op_name, Expression *lhs, Expression *rhs) {
+        return make_binary_call(get_ctx_ref(op_name), lhs, rhs);
     }
 
-    Expression *make_placeholder(String const name) {
-        auto place = new Placeholder(name);
+    Expression *make_binary_call(Expression *fun, Expression *lhs, Expression *rhs) {
+        if(!hash_consing)
+            return make<BinaryCall>(fun, lhs, rhs);
+
+        NodeKey key{NodeTag::binary_call, 0, NodeKey::id(fun), NodeKey::id(lhs), NodeKey::id(rhs)};
+        return ctx->hash_cons().get(key, [&]() { return make<BinaryCall>(fun, lhs, rhs); });
+    }
+
+    Expression *make_placeholder(Symbol name) {
+        auto place = make<Placeholder>(name);
         ctx->insert(name, place);
         return place;
     }
 
+    // Allocate a node inside the context's arena
+    template <typename T, typename... Args> T *make(Args &&... args) {
+        return ctx->arena().make<T>(std::forward<Args>(args)...);
+    }
+
+    ArenaStats const &stats() const { return ctx->stats(); }
+
   private:
     BuilderContext *ctx;
+    bool hash_consing;
 };
 
 } // namespace kiwi
@@ -10,10 +10,10 @@ namespace kiwi {
 
 class Definition : public Statement {
   public:
-    Definition(NodeTag tag, String name, Expression *type = nullptr) :
+    Definition(NodeTag tag, Symbol name, Expression *type = nullptr) :
         Statement(tag), name(name), type(type) {}
 
-    const String name;
+    const Symbol name;
     Expression *type;
 };
 
@@ -21,21 +21,18 @@ class Definition : public Statement {
 //      body
 class FunctionDefinition : public Definition {
   public:
-    FunctionDefinition(String const &name, Expression *body) :
-        Definition(NodeTag::function_def, name), body(body) {}
-
-    FunctionDefinition(String const &name, Expression *body = nullptr,
+    FunctionDefinition(Symbol name, Expression *body = nullptr,
                        Expression *ftype = nullptr) :
         Definition(NodeTag::function_def, name, ftype),
         body(body) {}
 
     u64 args_size() const { return args.size(); }
 
-    const String &arg(u64 index) const { return args[index]; }
+    Symbol arg(u64 index) const { return args[index]; }
 
-    void add_arg(String const &str) { args.push_back(str); }
+    void add_arg(Symbol str) { args.push_back(str); }
 
-    Array<String> args;
+    Array<Symbol> args;
 
     Expression *body{nullptr};
 };
@@ -51,19 +48,19 @@ class FunctionDefinition : public Definition {
 //
 class MacroDefinition : public Definition {
   public:
-    MacroDefinition(String const &name, Expression *body) :
+    MacroDefinition(Symbol name, Expression *body) :
         Definition(NodeTag::macro_def, name), body(body) {}
 
-    MacroDefinition(String const &name, Expression *body, Expression *ftype) :
+    MacroDefinition(Symbol name, Expression *body, Expression *ftype) :
         Definition(NodeTag::macro_def, name, ftype), body(body) {}
 
     u64 args_size() const { return args.size(); }
 
-    const String &arg(u64 index) const { return args[index]; }
+    Symbol arg(u64 index) const { return args[index]; }
 
-    void add_arg(String const &str) { args.push_back(str); }
+    void add_arg(Symbol str) { args.push_back(str); }
 
-    Array<String> args;
+    Array<Symbol> args;
     Expression *body{nullptr};
 };
 
@@ -98,24 +95,24 @@ class MacroDefinition : public Definition {
 class StructDefinition : public Definition {
   public:
     StructDefinition(
-        String const &name,
-        Array<Tuple<String, Statement *>> const &meta = Array<Tuple<String, Statement *>>(),
-        Array<Tuple<String, Statement *>> const &attr = Array<Tuple<String, Statement *>>()) :
+        Symbol name,
+        Array<Tuple<Symbol, Statement *>> const &meta = Array<Tuple<Symbol, Statement *>>(),
+        Array<Tuple<Symbol, Statement *>> const &attr = Array<Tuple<Symbol, Statement *>>()) :
         Definition(NodeTag::struct_def, name),
         meta_types(meta), attributes(attr) {}
 
-    StructDefinition *add_meta_type(String const &name, Statement *stmt) {
+    StructDefinition *add_meta_type(Symbol name, Statement *stmt) {
         meta_types.emplace_back(std::make_tuple(name, stmt));
         return this;
     }
 
-    StructDefinition *add_attribute(String const &name, Statement *stmt) {
+    StructDefinition *add_attribute(Symbol name, Statement *stmt) {
         attributes.emplace_back(std::make_tuple(name, stmt));
         return this;
     }
 
-    Array<Tuple<String, Statement *>> meta_types;
-    Array<Tuple<String, Statement *>> attributes;
+    Array<Tuple<Symbol, Statement *>> meta_types;
+    Array<Tuple<Symbol, Statement *>> attributes;
 };
 
 // union type_name(name: meta_type):
@@ -123,24 +120,24 @@ class StructDefinition : public Definition {
 class UnionDefinition : public Definition {
   public:
     UnionDefinition(
-        String const &name,
-        Array<Tuple<String, Statement *>> const &meta = Array<Tuple<String, Statement *>>(),
-        Array<Tuple<String, Statement *>> const &attr = Array<Tuple<String, Statement *>>()) :
+        Symbol name,
+        Array<Tuple<Symbol, Statement *>> const &meta = Array<Tuple<Symbol, Statement *>>(),
+        Array<Tuple<Symbol, Statement *>> const &attr = Array<Tuple<Symbol, Statement *>>()) :
         Definition(NodeTag::union_def, name),
         meta_types(meta), attributes(attr) {}
 
-    UnionDefinition *add_meta_type(String const &name, Statement *stmt) {
+    UnionDefinition *add_meta_type(Symbol name, Statement *stmt) {
         meta_types.emplace_back(std::make_tuple(name, stmt));
         return this;
     }
 
-    UnionDefinition *add_attribute(String const &name, Statement *stmt) {
+    UnionDefinition *add_attribute(Symbol name, Statement *stmt) {
         attributes.emplace_back(std::make_tuple(name, stmt));
         return this;
     }
 
-    Array<Tuple<String, Statement *>> meta_types;
-    Array<Tuple<String, Statement *>> attributes;
+    Array<Tuple<Symbol, Statement *>> meta_types;
+    Array<Tuple<Symbol, Statement *>> attributes;
 };
 
 } // namespace kiwi
@@ -0,0 +1,81 @@
+#include "EvalRegion.h"
+
+namespace kiwi {
+
+thread_local EvalRegion *EvalRegion::active = nullptr;
+
+namespace {
+
+// Copy the packed fields of a struct, boxed fields are promoted
+void promote_fields(EvalRegion const &region, StructValue *src, StructValue *dst, Arena &arena) {
+    RecordLayout const &layout = src->layout();
+    std::memcpy(dst->data(), src->data(), layout.size);
+
+    for(std::size_t i = 0; i < layout.fields.size(); ++i) {
+        FieldLayout const &field = layout.field(i);
+        if(!field.is_boxed())
+            continue;
+
+        Value *v = nullptr;
+        std::memcpy(&v, src->data() + field.offset, sizeof(Value *));
+        v = region.promote(v, arena);
+        std::memcpy(dst->data() + field.offset, &v, sizeof(Value *));
+    }
+}
+
+} // namespace
+
+Value *EvalRegion::promote(Value *v, Arena &dst) const {
+    if(v == nullptr || !owns(v))
+        return v;
+
+    switch(v->value_tag) {
+    case ValueTag::vprimitive: {
+        PrimitiveValue *src = static_cast<PrimitiveValue *>(v);
+        // clang-format off
+        switch(src->tag()) {
+        #define X(n)                                                                               \
+        case PrimitiveTag::n:                                                                      \
+            return dst.make<PrimitiveValue>(src->as<n>());
+        KIWI_PRIMITIVE(X)
+        #undef X
+        case PrimitiveTag::none:
+            return v;
+        }
+        // clang-format on
+        return v;
+    }
+    case ValueTag::vstruct: {
+        StructValue *src    = static_cast<StructValue *>(v);
+        StructValue *result = dst.make<StructValue>()->set_type(src->definition());
+        promote_fields(*this, src, result, dst);
+        return result;
+    }
+    case ValueTag::vunion: {
+        UnionValue *src    = static_cast<UnionValue *>(v);
+        UnionValue *result = dst.make<UnionValue>()->set_type(src->definition());
+        result->index      = src->index;
+
+        // fields overlap, only the active one is meaningful
+        std::memcpy(result->data(), src->data(), src->layout().size);
+        if(src->index >= 0 && src->layout().field(std::size_t(src->index)).is_boxed())
+            result->set_value(src->index, promote(src->get_boxed(), dst));
+        return result;
+    }
+    case ValueTag::varray: {
+        // elements released with the region are copied, views of other memory stay views
+        ArrayValue *src = static_cast<ArrayValue *>(v);
+        void *data      = src->data();
+        if(src->owns_data() || owns(data)) {
+            data = dst.allocate(src->nbytes(), ArrayValue::alignment);
+            std::memcpy(data, src->data(), src->nbytes());
+        }
+        return dst.make<ArrayValue>(src->tag(), src->shape(), data);
+    }
+    case ValueTag::vfunction:
+        return v;
+    }
+    return v;
+}
+
+} // namespace kiwi
@@ -0,0 +1,92 @@
+#ifndef KIWI_AST_EVAL_REGION_HEADER
+#define KIWI_AST_EVAL_REGION_HEADER
+
+#include "Arena.h"
+#include "Value.h"
+
+/*
+ *  Evaluation memory
+ *
+ *  Values created while serving a request (inputs, arguments, records) are
+ *  bump allocated from a region and released together when the request is
+ *  done. There is no malloc/free per value and, with one region per
+ *  thread, no allocator lock shared between threads; the memory is kept
+ *  for the next request.
+ *
+ *      EvalRegion region;  // one per worker thread
+ *      {
+ *          EvalRegion::Scope scope(region);
+ *          Value *v = region.make<PrimitiveValue>(2.0);
+ *          ...
+ *          result = region.promote(v, module.arena()); // v escapes
+ *      }                                               // the rest is released
+ *
+ *  Scopes nest, an inner scope only releases what was allocated inside it.
+ *  While a scope is active, FullEval (call arguments) and ArrayEval (array
+ *  values) allocate from the region of the innermost scope of the thread
+ *  (EvalRegion::current). The other evaluators do not use it: StackEval,
+ *  TypedEval and BatchEval reuse buffers they own across runs, and the
+ *  tasks of ParallelEval run on threads where the region is not active.
+ */
+namespace kiwi {
+
+class EvalRegion {
+  public:
+    EvalRegion(std::size_t block_size = 64 * 1024) : arena(block_size) {}
+
+    EvalRegion(EvalRegion const &) = delete;
+    EvalRegion &operator=(EvalRegion const &) = delete;
+
+    // Activate the region on this thread, release its new values on exit
+    class Scope {
+      public:
+        Scope(EvalRegion &region) :
+            region(region), start(region.arena.mark()), previous(active) {
+            active = &region;
+        }
+
+        ~Scope() {
+            region.arena.rewind(start);
+            active = previous;
+        }
+
+        Scope(Scope const &) = delete;
+        Scope &operator=(Scope const &) = delete;
+
+      private:
+        EvalRegion &region;
+        Arena::Mark start;
+        EvalRegion *previous;
+    };
+
+    template <typename T, typename... Args> T *make(Args &&... args) {
+        return arena.make<T>(std::forward<Args>(args)...);
+    }
+
+    void *allocate(std::size_t size, std::size_t align = alignof(std::max_align_t)) {
+        return arena.allocate(size, align);
+    }
+
+    bool owns(void const *ptr) const { return arena.owns(ptr); }
+
+    // Copy `v` and the values it references into `dst`
+    // values the region does not own are returned as is
+    Value *promote(Value *v, Arena &dst) const;
+
+    ArenaStats const &stats() const { return arena.stats(); }
+
+    // Give the memory kept between requests back to the system
+    void trim() { arena.trim(); }
+
+    // Region of the innermost scope of this thread, nullptr if none
+    static EvalRegion *current() { return active; }
+
+  private:
+    static thread_local EvalRegion *active;
+
+    Arena arena;
+};
+
+} // namespace kiwi
+
+#endif
@@ -1,10 +1,14 @@
 ﻿#ifndef KIWI_AST_EXPRESSION_HEADER
 #define KIWI_AST_EXPRESSION_HEADER
 
+#include "Operator.h"
+#include "RecordLayout.h"
 #include "Statement.h"
+#include "StringDatabase.h"
 
 #include <cassert>
 #include <iostream>
+#include <memory>
 #include <string>
 #include <unordered_map>
 #include <vector>
@@ -49,14 +53,14 @@ class Function : public Expression {
 
     u64 args_size() const { return args.size(); }
 
-    const Tuple<String, Statement *> &arg(u64 index) const { return args[index]; }
+    const Tuple<Symbol, Statement *> &arg(u64 index) const { return args[index]; }
 
-    Function *add_arg(String const &str, Statement *stmt = nullptr) {
+    Function *add_arg(Symbol str, Statement *stmt = nullptr) {
         args.emplace_back(str, stmt);
         return this;
     }
 
-    Array<Tuple<String, Statement *>> args;
+    Array<Tuple<Symbol, Statement *>> args;
     Statement *return_type{nullptr};
 
     Statement *body{nullptr};
@@ -74,25 +78,39 @@ class Function : public Expression {
 //
 class Struct : public Expression {
   public:
-    Struct(Array<Tuple<String, Statement *>> const &meta = Array<Tuple<String, Statement *>>(),
-           Array<Tuple<String, Statement *>> const &attr = Array<Tuple<String, Statement *>>()) :
+    Struct(Array<Tuple<Symbol, Statement *>> const &meta = Array<Tuple<Symbol, Statement *>>(),
+           Array<Tuple<Symbol, Statement *>> const &attr = Array<Tuple<Symbol, Statement *>>()) :
         Expression(NodeTag::struct_def),
         meta_types(meta), attributes(attr) {}
 
-    Struct *add_meta_type(String const &name, Statement *stmt) {
+    Struct *add_meta_type(Symbol name, Statement *stmt) {
+        assert(!layout.sealed && "Struct is sealed");
         meta_types.emplace_back(std::make_tuple(name, stmt));
         return this;
     }
 
-    Struct *add_attribute(String const &name, Statement *stmt) {
+    Struct *add_attribute(Symbol name, Statement *stmt) {
+        assert(!layout.sealed && "Struct is sealed");
         attributes.emplace_back(std::make_tuple(name, stmt));
         return this;
     }
 
-    Array<Tuple<String, Statement *>> meta_types;
-    Array<Tuple<String, Statement *>> attributes;
+    // Freeze the definition, lookups go through the layout afterwards
+    Struct *seal() {
+        layout = RecordLayout::make_struct(meta_types, attributes);
+        return this;
+    }
+
+    bool is_sealed() const { return layout.sealed; }
+
+    Array<Tuple<Symbol, Statement *>> meta_types;
+    Array<Tuple<Symbol, Statement *>> attributes;
+    RecordLayout layout;
+
+    int32 get_meta_type_index(Symbol name) const {
+        if(layout.sealed)
+            return layout.meta_type_index(name);
 
-    int32 get_meta_type_index(String const &name) {
         for(std::size_t i = 0; i < meta_types.size(); ++i) {
             if(std::get<0>(meta_types[i]) == name)
                 return int32(i);
@@ -100,7 +118,10 @@ class Struct : public Expression {
         return -1;
     }
 
-    int32 get_attribute_index(String const &name) {
+    int32 get_attribute_index(Symbol name) const {
+        if(layout.sealed)
+            return layout.attribute_index(name);
+
         for(std::size_t i = 0; i < attributes.size(); ++i) {
             if(std::get<0>(attributes[i]) == name)
                 return int32(i);
@@ -117,25 +138,39 @@ class Struct : public Expression {
 //
 class Union : public Expression {
   public:
-    Union(Array<Tuple<String, Statement *>> const &meta = Array<Tuple<String, Statement *>>(),
-          Array<Tuple<String, Statement *>> const &attr = Array<Tuple<String, Statement *>>()) :
+    Union(Array<Tuple<Symbol, Statement *>> const &meta = Array<Tuple<Symbol, Statement *>>(),
+          Array<Tuple<Symbol, Statement *>> const &attr = Array<Tuple<Symbol, Statement *>>()) :
         Expression(NodeTag::union_def),
         meta_types(meta), attributes(attr) {}
 
-    Union *add_meta_type(String const &name, Statement *stmt) {
+    Union *add_meta_type(Symbol name, Statement *stmt) {
+        assert(!layout.sealed && "Union is sealed");
         meta_types.emplace_back(std::make_tuple(name, stmt));
         return this;
     }
 
-    Union *add_attribute(String const &name, Statement *stmt) {
+    Union *add_attribute(Symbol name, Statement *stmt) {
+        assert(!layout.sealed && "Union is sealed");
         attributes.emplace_back(std::make_tuple(name, stmt));
         return this;
     }
 
-    Array<Tuple<String, Statement *>> meta_types;
-    Array<Tuple<String, Statement *>> attributes;
+    // Freeze the definition, lookups go through the layout afterwards
+    Union *seal() {
+        layout = RecordLayout::make_union(meta_types, attributes);
+        return this;
+    }
+
+    bool is_sealed() const { return layout.sealed; }
+
+    Array<Tuple<Symbol, Statement *>> meta_types;
+    Array<Tuple<Symbol, Statement *>> attributes;
+    RecordLayout layout;
+
+    int32 get_meta_type_index(Symbol name) const {
+        if(layout.sealed)
+            return layout.meta_type_index(name);
 
-    int32 get_meta_type_index(String const &name) {
         for(std::size_t i = 0; i < meta_types.size(); ++i) {
             if(std::get<0>(meta_types[i]) == name)
                 return int32(i);
@@ -143,7 +178,10 @@ class Union : public Expression {
         return -1;
     }
 
-    int32 get_attribute_index(String const &name) {
+    int32 get_attribute_index(Symbol name) const {
+        if(layout.sealed)
+            return layout.attribute_index(name);
+
         for(std::size_t i = 0; i < attributes.size(); ++i) {
             if(std::get<0>(attributes[i]) == name)
                 return int32(i);
@@ -180,6 +218,8 @@ class Call : public Expression {
  *  Has to be an Expression that evaluate to a Value (then == must be defined for that type)
  *  it is basically a more generic switch we do not provide real pattern matching there yet.
  */
+class MatchPlan;
+
 class Match : public Expression {
   public:
     Match() : Expression(NodeTag::match) {}
@@ -187,11 +227,16 @@ class Match : public Expression {
     Expression *target;
     Array<Tuple<Expression *, Expression *>> branches;
     Expression *default_branch = nullptr;
+
+    // Lookup replacing the chain of tests, set by MatchCompiler
+    std::shared_ptr<MatchPlan const> plan;
 };
 
+// `op` is resolved from the callee's name when the call is built,
+// it is none when the callee is not a builtin operator
 class UnaryCall final : public Call {
   public:
-    UnaryCall(Expression *fun, Expression *expr) : Call(NodeTag::unary_call, fun), expr(expr) {}
+    UnaryCall(Expression *fun, Expression *expr);
 
     u64 args_size() const { return 1; }
 
@@ -205,13 +250,13 @@ class UnaryCall final : public Call {
     }
 
     Expression *expr;
+    UnaryOp op;
     bool right = false; // operator is left/right associative
 };
 
 class BinaryCall final : public Call {
   public:
-    BinaryCall(Expression *fun, Expression *lhs, Expression *rhs) :
-        Call(NodeTag::binary_call, fun), lhs(lhs), rhs(rhs) {}
+    BinaryCall(Expression *fun, Expression *lhs, Expression *rhs);
 
     u64 args_size() const { return 2; }
 
@@ -228,6 +273,7 @@ class BinaryCall final : public Call {
 
     Expression *lhs;
     Expression *rhs;
+    BinaryOp op;
 };
 
 class FunctionCall final : public Call {
@@ -244,19 +290,26 @@ class FunctionCall final : public Call {
 
 class Placeholder final : public Expression {
   public:
-    Placeholder(String const &name) : Expression(NodeTag::placeholder), name(name) {}
+    Placeholder(Symbol name) : Expression(NodeTag::placeholder), name(name) {}
 
-    String name;
+    Symbol name;
     Expression *type{nullptr};
 };
 
+// Reference to a binding resolved at build time
+//  depth: number of scopes between the reference and the binding
+//  index: slot of the binding inside its scope
+// both are -1 when the name could not be resolved
 class PlaceholderReference final : public Expression {
   public:
-    PlaceholderReference(String const &name, int32 index) :
-        Expression(NodeTag::placeholder_ref), name(name), index(index) {}
+    PlaceholderReference(Symbol name, int32 index, int32 depth = -1) :
+        Expression(NodeTag::placeholder_ref), name(name), index(index), depth(depth) {}
 
-    String name;
+    bool is_resolved() const { return index >= 0; }
+
+    Symbol name;
     int32 index;
+    int32 depth;
     Expression *type{nullptr};
 };
 
@@ -296,6 +349,28 @@ class ErrorNode final : public Expression {
     Expression *partial{nullptr};  // partial parsed Node
 };
 
+// Name of the function being called, empty if the callee is computed
+inline Symbol callee_name(Expression const *fun) {
+    if(fun == nullptr)
+        return Symbol();
+
+    switch(fun->tag) {
+    case NodeTag::placeholder:
+        return static_cast<Placeholder const *>(fun)->name;
+    case NodeTag::placeholder_ref:
+        return static_cast<PlaceholderReference const *>(fun)->name;
+    default:
+        return Symbol();
+    }
+}
+
+inline UnaryCall::UnaryCall(Expression *fun, Expression *expr) :
+    Call(NodeTag::unary_call, fun), expr(expr), op(get_unary_op(callee_name(fun).str())) {}
+
+inline BinaryCall::BinaryCall(Expression *fun, Expression *lhs, Expression *rhs) :
+    Call(NodeTag::binary_call, fun), lhs(lhs), rhs(rhs),
+    op(get_binary_op(callee_name(fun).str())) {}
+
 inline Expression *Call::arg(u64 index) const {
     switch(Expression::tag) {
     case NodeTag::unary_call:
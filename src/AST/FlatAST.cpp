@@ -0,0 +1,343 @@
+#include "FlatAST.h"
+
+#include "../Logging/Log.h"
+#include "TreeOps/Operators.h"
+#include "Value.h"
+
+namespace kiwi {
+
+namespace {
+
+class Flattener {
+  public:
+    Flattener(FlatTree &tree) : tree(tree) {}
+
+    NodeIndex flatten(Statement *stmt) {
+        if(stmt == nullptr)
+            return null_node;
+
+        auto seen = nodes.find(stmt);
+        if(seen != nodes.end())
+            return seen->second;
+
+        NodeIndex index = null_node;
+        Array<NodeIndex> kids;
+
+        switch(stmt->tag) {
+        case NodeTag::unary_call: {
+            UnaryCall *call = static_cast<UnaryCall *>(stmt);
+            kids            = {flatten(call->fun), flatten(call->expr)};
+            index = push(stmt->tag, kids,
+                         (opaque_type(call->type) << 9) | (u32(call->op) << 1) | u32(call->right));
+            break;
+        }
+        case NodeTag::binary_call: {
+            BinaryCall *call = static_cast<BinaryCall *>(stmt);
+            kids             = {flatten(call->fun), flatten(call->lhs), flatten(call->rhs)};
+            index = push(stmt->tag, kids, (opaque_type(call->type) << 8) | u32(call->op));
+            break;
+        }
+        case NodeTag::function_call: {
+            FunctionCall *call = static_cast<FunctionCall *>(stmt);
+            kids.push_back(flatten(call->fun));
+            for(Expression *arg : call->args)
+                kids.push_back(flatten(arg));
+            index = push(stmt->tag, kids, opaque_type(call->type));
+            break;
+        }
+        case NodeTag::match: {
+            Match *match = static_cast<Match *>(stmt);
+            kids         = {flatten(match->target), flatten(match->default_branch)};
+            for(auto &branch : match->branches) {
+                kids.push_back(flatten(std::get<0>(branch)));
+                kids.push_back(flatten(std::get<1>(branch)));
+            }
+            index = push(stmt->tag, kids, 0);
+            break;
+        }
+        case NodeTag::block: {
+            Block *block = static_cast<Block *>(stmt);
+            for(Statement *item : block->statements)
+                kids.push_back(flatten(item));
+            index = push(stmt->tag, kids, opaque_type(block->type));
+            break;
+        }
+        case NodeTag::placeholder: {
+            Placeholder *p = static_cast<Placeholder *>(stmt);
+            kids           = {flatten(p->type)};
+            tree.symbols.push_back(p->name);
+            index = push(stmt->tag, kids, u32(tree.symbols.size() - 1));
+            break;
+        }
+        case NodeTag::placeholder_ref: {
+            PlaceholderReference *ref = static_cast<PlaceholderReference *>(stmt);
+            kids                      = {flatten(ref->type)};
+            tree.references.push_back(FlatReference{ref->name, ref->index, ref->depth});
+            index = push(stmt->tag, kids, u32(tree.references.size() - 1));
+            break;
+        }
+        case NodeTag::value: {
+            tree.values.push_back(static_cast<Value *>(stmt));
+            index = push(stmt->tag, kids, u32(tree.values.size() - 1));
+            break;
+        }
+        default: {
+            tree.opaque.push_back(stmt);
+            index = push(stmt->tag, kids, u32(tree.opaque.size() - 1));
+        }
+        }
+
+        nodes[stmt] = index;
+        return index;
+    }
+
+  private:
+    u32 opaque_type(Expression *type) {
+        if(type == nullptr)
+            return 0;
+        tree.opaque.push_back(type);
+        return u32(tree.opaque.size());
+    }
+
+    NodeIndex push(NodeTag tag, Array<NodeIndex> const &kids, u32 payload) {
+        tree.tags.push_back(tag);
+        tree.first_child.push_back(u32(tree.children.size()));
+        tree.child_count.push_back(u32(kids.size()));
+        tree.payload.push_back(payload);
+        tree.children.insert(tree.children.end(), kids.begin(), kids.end());
+        return NodeIndex(tree.tags.size() - 1);
+    }
+
+    FlatTree &tree;
+    Dict<Statement *, NodeIndex> nodes;
+};
+
+Expression *opaque_type(FlatTree const &tree, u32 payload) {
+    if(payload == 0)
+        return nullptr;
+    return static_cast<Expression *>(tree.opaque[payload - 1]);
+}
+
+} // namespace
+
+bool FlatTree::is_opaque(NodeIndex i) const {
+    switch(tags[i]) {
+    case NodeTag::unary_call:
+    case NodeTag::binary_call:
+    case NodeTag::function_call:
+    case NodeTag::match:
+    case NodeTag::block:
+    case NodeTag::placeholder:
+    case NodeTag::placeholder_ref:
+    case NodeTag::value:
+        return false;
+    default:
+        return true;
+    }
+}
+
+std::size_t FlatTree::bytes() const {
+    return tags.size() * sizeof(NodeTag) + first_child.size() * sizeof(u32) +
+           child_count.size() * sizeof(u32) + payload.size() * sizeof(u32) +
+           children.size() * sizeof(NodeIndex) + symbols.size() * sizeof(Symbol) +
+           references.size() * sizeof(FlatReference) + values.size() * sizeof(Value *) +
+           opaque.size() * sizeof(Statement *);
+}
+
+FlatTree flatten(Expression *expr) {
+    FlatTree tree;
+    tree.root = Flattener(tree).flatten(expr);
+    return tree;
+}
+
+Expression *unflatten(FlatTree const &tree, Builder &builder) {
+    Array<Statement *> nodes(tree.size(), nullptr);
+
+    auto expr = [&](NodeIndex i) -> Expression * {
+        if(i == null_node)
+            return nullptr;
+        return static_cast<Expression *>(nodes[i]);
+    };
+
+    // children are always stored before their parent
+    for(NodeIndex i = 0; i < tree.size(); ++i) {
+        u32 n = tree.args_size(i);
+
+        switch(tree.tag(i)) {
+        case NodeTag::unary_call: {
+            UnaryCall *call = builder.make<UnaryCall>(expr(tree.child(i, 0)), expr(tree.child(i, 1)));
+            call->right     = tree.payload[i] & 1;
+            call->type      = opaque_type(tree, tree.payload[i] >> 9);
+            nodes[i]        = call;
+            break;
+        }
+        case NodeTag::binary_call: {
+            BinaryCall *call = builder.make<BinaryCall>(
+                expr(tree.child(i, 0)), expr(tree.child(i, 1)), expr(tree.child(i, 2)));
+            call->type = opaque_type(tree, tree.payload[i] >> 8);
+            nodes[i]   = call;
+            break;
+        }
+        case NodeTag::function_call: {
+            Array<Expression *> args;
+            for(u32 k = 1; k < n; ++k)
+                args.push_back(expr(tree.child(i, k)));
+
+            FunctionCall *call = builder.make<FunctionCall>(expr(tree.child(i, 0)), args);
+            call->type         = opaque_type(tree, tree.payload[i]);
+            nodes[i]           = call;
+            break;
+        }
+        case NodeTag::match: {
+            Match *match          = builder.make<Match>();
+            match->target         = expr(tree.child(i, 0));
+            match->default_branch = expr(tree.child(i, 1));
+            for(u32 k = 2; k + 1 < n; k += 2)
+                match->branches.emplace_back(expr(tree.child(i, k)), expr(tree.child(i, k + 1)));
+            nodes[i] = match;
+            break;
+        }
+        case NodeTag::block: {
+            Block *block = builder.make_block();
+            for(u32 k = 0; k < n; ++k) {
+                NodeIndex c = tree.child(i, k);
+                block->statements.push_back(c == null_node ? nullptr : nodes[c]);
+            }
+            block->type = opaque_type(tree, tree.payload[i]);
+            nodes[i]    = block;
+            break;
+        }
+        case NodeTag::placeholder: {
+            Placeholder *p = builder.make<Placeholder>(tree.symbol(i));
+            p->type        = expr(tree.child(i, 0));
+            nodes[i]       = p;
+            break;
+        }
+        case NodeTag::placeholder_ref: {
+            FlatReference const &r = tree.reference(i);
+            PlaceholderReference *ref =
+                builder.make<PlaceholderReference>(r.name, r.index, r.depth);
+            ref->type = expr(tree.child(i, 0));
+            nodes[i]  = ref;
+            break;
+        }
+        case NodeTag::value: {
+            nodes[i] = tree.value(i);
+            break;
+        }
+        default: { nodes[i] = tree.statement(i); }
+        }
+    }
+
+    if(tree.root == null_node)
+        return nullptr;
+    return static_cast<Expression *>(nodes[tree.root]);
+}
+
+double FlatEval::run(FlatTree const &tree) {
+    failed = false;
+    results.resize(tree.size());
+
+    // children are always computed before their parent
+    for(NodeIndex i = 0; i < tree.size() && !failed; ++i) {
+        u32 n = tree.args_size(i);
+
+        switch(tree.tag(i)) {
+        case NodeTag::unary_call: {
+            UnaryOperator fun = unary_operator(tree.unary_op(i));
+            if(fun == nullptr) {
+                log_error("Unknown unary operator");
+                failed = true;
+                break;
+            }
+            results[i] = fun(operand(tree, tree.child(i, 1)));
+            break;
+        }
+        case NodeTag::binary_call: {
+            BinaryOperator fun = binary_operator(tree.binary_op(i));
+            if(fun == nullptr) {
+                log_error("Unknown binary operator");
+                failed = true;
+                break;
+            }
+            results[i] = fun(operand(tree, tree.child(i, 1)), operand(tree, tree.child(i, 2)));
+            break;
+        }
+        case NodeTag::match: {
+            double target = operand(tree, tree.child(i, 0));
+            double result = operand(tree, tree.child(i, 1));
+            for(u32 k = 2; k + 1 < n; k += 2) {
+                if(operand(tree, tree.child(i, k)) == target) {
+                    result = operand(tree, tree.child(i, k + 1));
+                    break;
+                }
+            }
+            results[i] = result;
+            break;
+        }
+        // value of the last expression
+        case NodeTag::block: {
+            double result = 0;
+            for(u32 k = n; k > 0; --k) {
+                NodeIndex c = tree.child(i, k - 1);
+                if(c != null_node && !tree.is_opaque(c)) {
+                    result = operand(tree, c);
+                    break;
+                }
+            }
+            results[i] = result;
+            break;
+        }
+        case NodeTag::function_call: {
+            log_error("Cannot evaluate ", to_string(tree.tag(i)), " in a flat tree");
+            failed = true;
+            break;
+        }
+        // leaves are read by their parent
+        default:
+            break;
+        }
+    }
+
+    if(failed || tree.root == null_node)
+        return 0;
+
+    double result = operand(tree, tree.root);
+    return failed ? 0 : result;
+}
+
+double FlatEval::operand(FlatTree const &tree, NodeIndex i) {
+    if(i == null_node)
+        return 0;
+
+    switch(tree.tag(i)) {
+    case NodeTag::value:
+        return tree.value(i)->as<f64>();
+    case NodeTag::placeholder:
+        return name(tree.symbol(i));
+    case NodeTag::placeholder_ref:
+        return name(tree.reference(i).name);
+    default:
+        break;
+    }
+
+    if(tree.is_opaque(i)) {
+        log_error("Cannot evaluate ", to_string(tree.tag(i)));
+        failed = true;
+        return 0;
+    }
+    return results[i];
+}
+
+double FlatEval::name(Symbol name) {
+    auto result = ctx.find(name);
+    if(result == ctx.end() || result->second == nullptr ||
+       result->second->tag != NodeTag::value) {
+        log_error("Undefined variable ", name);
+        failed = true;
+        return 0;
+    }
+    return static_cast<Value *>(result->second)->as<f64>();
+}
+
+} // namespace kiwi
@@ -0,0 +1,122 @@
+#ifndef KIWI_AST_FLAT_HEADER
+#define KIWI_AST_FLAT_HEADER
+
+#include "Builder.h"
+#include "Expression.h"
+#include "Module.h"
+
+/*
+ *  Compact copy of an expression tree stored as a struct of arrays.
+ *
+ *  Nodes are laid out in post-order: the children of a node always have a
+ *  smaller index than the node itself, so a single forward loop over the
+ *  arrays visits the tree bottom-up without recursion or pointer chasing.
+ *  Children are referred to by 32 bits indices into the node arrays.
+ *
+ *  Node layout (children in order, `-` means null_node):
+ *      unary_call      fun, expr               payload: type + operator + right flag
+ *      binary_call     fun, lhs, rhs           payload: type + operator
+ *      function_call   fun, args...            payload: type
+ *      match           target, default, (pattern, branch)...
+ *      block           statements...           payload: type
+ *      placeholder     type                    payload: symbols
+ *      placeholder_ref type                    payload: references
+ *      value                                   payload: values
+ *
+ *  Every other node (definitions, types, records...) is kept as an opaque
+ *  pointer to the original node. Types attached to calls and blocks are
+ *  stored in the opaque table too (payload is the index + 1, 0 means none).
+ *
+ *  FlatEval evaluates a tree with a single forward loop over these arrays.
+ */
+namespace kiwi {
+
+using NodeIndex               = u32;
+constexpr NodeIndex null_node = ~NodeIndex(0);
+
+struct FlatReference {
+    Symbol name;
+    int32 index;
+    int32 depth;
+};
+
+struct FlatTree {
+    // one entry per node
+    Array<NodeTag> tags;
+    Array<u32> first_child;
+    Array<u32> child_count;
+    Array<u32> payload;
+
+    // child indices of every node, contiguous per node
+    Array<NodeIndex> children;
+
+    // side tables
+    Array<Symbol> symbols;
+    Array<FlatReference> references;
+    Array<Value *> values;     // shared with the original tree
+    Array<Statement *> opaque; // shared with the original tree
+
+    NodeIndex root = null_node;
+
+    std::size_t size() const { return tags.size(); }
+
+    NodeTag tag(NodeIndex i) const { return tags[i]; }
+
+    u32 args_size(NodeIndex i) const { return child_count[i]; }
+
+    NodeIndex child(NodeIndex i, u32 k) const { return children[first_child[i] + k]; }
+
+    Symbol symbol(NodeIndex i) const { return symbols[payload[i]]; }
+
+    FlatReference const &reference(NodeIndex i) const { return references[payload[i]]; }
+
+    Value *value(NodeIndex i) const { return values[payload[i]]; }
+
+    Statement *statement(NodeIndex i) const { return opaque[payload[i]]; }
+
+    BinaryOp binary_op(NodeIndex i) const { return BinaryOp(payload[i] & 0xff); }
+
+    UnaryOp unary_op(NodeIndex i) const { return UnaryOp((payload[i] >> 1) & 0xff); }
+
+    bool is_opaque(NodeIndex i) const;
+
+    // Memory used by the flat representation
+    std::size_t bytes() const;
+};
+
+// Convert a pointer tree into its flat representation
+// shared subtrees are stored once
+FlatTree flatten(Expression *expr);
+
+// Rebuild a pointer tree, nodes are allocated through the builder
+Expression *unflatten(FlatTree const &tree, Builder &builder);
+
+// Evaluate a flat tree bottom-up, each node is computed once from the results
+// of its children: shared subtrees are evaluated once and every branch of a
+// match is computed. Function calls are not supported.
+// Leaves are read by their parent, names must be bound to values in `ctx`.
+class FlatEval {
+  public:
+    FlatEval(Context const &ctx) : ctx(ctx) {}
+
+    double run(FlatTree const &tree);
+
+    // false if the last run failed
+    bool ok() const { return !failed; }
+
+  private:
+    double operand(FlatTree const &tree, NodeIndex i);
+    double name(Symbol name);
+
+    Context const &ctx;
+    Array<double> results; // one per node, reused between runs
+    bool failed = false;
+};
+
+inline double flat_eval(Context const &ctx, FlatTree const &tree) {
+    return FlatEval(ctx).run(tree);
+}
+
+} // namespace kiwi
+
+#endif
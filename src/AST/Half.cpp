@@ -0,0 +1,178 @@
+#include "Half.h"
+
+#if(defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#    define KIWI_HALF_X86 1
+#    include <immintrin.h>
+#else
+#    define KIWI_HALF_X86 0
+#endif
+
+namespace kiwi {
+namespace {
+
+void f16_to_f32_scalar(f32 *dst, f16 const *src, std::size_t n) {
+    for(std::size_t i = 0; i < n; ++i)
+        dst[i] = f32(src[i]);
+}
+
+void f32_to_f16_scalar(f16 *dst, f32 const *src, std::size_t n) {
+    for(std::size_t i = 0; i < n; ++i)
+        dst[i] = f16(src[i]);
+}
+
+void bf16_to_f32_scalar(f32 *dst, bf16 const *src, std::size_t n) {
+    for(std::size_t i = 0; i < n; ++i)
+        dst[i] = f32(src[i]);
+}
+
+void f32_to_bf16_scalar(bf16 *dst, f32 const *src, std::size_t n) {
+    for(std::size_t i = 0; i < n; ++i)
+        dst[i] = bf16(src[i]);
+}
+
+#if KIWI_HALF_X86
+// The vector loops handle full registers, the tail uses the scalar version
+
+__attribute__((target("avx2,f16c"))) void f16_to_f32_f16c(f32 *dst, f16 const *src,
+                                                          std::size_t n) {
+    std::size_t i = 0;
+    for(; i + 8 <= n; i += 8) {
+        __m128i h = _mm_loadu_si128(reinterpret_cast<__m128i const *>(src + i));
+        _mm256_storeu_ps(dst + i, _mm256_cvtph_ps(h));
+    }
+    f16_to_f32_scalar(dst + i, src + i, n - i);
+}
+
+__attribute__((target("avx2,f16c"))) void f32_to_f16_f16c(f16 *dst, f32 const *src,
+                                                          std::size_t n) {
+    std::size_t i = 0;
+    for(; i + 8 <= n; i += 8) {
+        __m128i h = _mm256_cvtps_ph(_mm256_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), h);
+    }
+    f32_to_f16_scalar(dst + i, src + i, n - i);
+}
+
+__attribute__((target("avx2"))) void bf16_to_f32_avx2(f32 *dst, bf16 const *src, std::size_t n) {
+    std::size_t i = 0;
+    for(; i + 8 <= n; i += 8) {
+        __m128i h = _mm_loadu_si128(reinterpret_cast<__m128i const *>(src + i));
+        __m256i w = _mm256_slli_epi32(_mm256_cvtepu16_epi32(h), 16);
+        _mm256_storeu_ps(dst + i, _mm256_castsi256_ps(w));
+    }
+    bf16_to_f32_scalar(dst + i, src + i, n - i);
+}
+
+// Same rounding as f32_to_bf16_bits, the result is in the low 16 bits of each lane
+__attribute__((target("avx2"))) __m256i round_bf16_avx2(__m256 v) {
+    __m256i bits  = _mm256_castps_si256(v);
+    __m256i lsb   = _mm256_and_si256(_mm256_srli_epi32(bits, 16), _mm256_set1_epi32(1));
+    __m256i bias  = _mm256_add_epi32(lsb, _mm256_set1_epi32(0x7fff));
+    __m256i round = _mm256_srli_epi32(_mm256_add_epi32(bits, bias), 16);
+    __m256i quiet = _mm256_srli_epi32(_mm256_or_si256(bits, _mm256_set1_epi32(0x400000)), 16);
+    __m256i abs   = _mm256_and_si256(bits, _mm256_set1_epi32(0x7fffffff));
+    __m256i nan   = _mm256_cmpgt_epi32(abs, _mm256_set1_epi32(0x7f800000));
+    return _mm256_blendv_epi8(round, quiet, nan);
+}
+
+__attribute__((target("avx2"))) void f32_to_bf16_avx2(bf16 *dst, f32 const *src, std::size_t n) {
+    std::size_t i = 0;
+    for(; i + 16 <= n; i += 16) {
+        __m256i lo = round_bf16_avx2(_mm256_loadu_ps(src + i));
+        __m256i hi = round_bf16_avx2(_mm256_loadu_ps(src + i + 8));
+        // packus works per 128 bit lane, put the quarters back in order
+        __m256i h = _mm256_permute4x64_epi64(_mm256_packus_epi32(lo, hi), 0xd8);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), h);
+    }
+    f32_to_bf16_scalar(dst + i, src + i, n - i);
+}
+
+__attribute__((target("avx512f"))) void f16_to_f32_avx512(f32 *dst, f16 const *src,
+                                                         std::size_t n) {
+    std::size_t i = 0;
+    for(; i + 16 <= n; i += 16) {
+        __m256i h = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(src + i));
+        _mm512_storeu_ps(dst + i, _mm512_cvtph_ps(h));
+    }
+    f16_to_f32_scalar(dst + i, src + i, n - i);
+}
+
+__attribute__((target("avx512f"))) void f32_to_f16_avx512(f16 *dst, f32 const *src,
+                                                         std::size_t n) {
+    std::size_t i = 0;
+    for(; i + 16 <= n; i += 16) {
+        __m256i h = _mm512_cvtps_ph(_mm512_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), h);
+    }
+    f32_to_f16_scalar(dst + i, src + i, n - i);
+}
+
+__attribute__((target("avx512f"))) void bf16_to_f32_avx512(f32 *dst, bf16 const *src,
+                                                          std::size_t n) {
+    std::size_t i = 0;
+    for(; i + 16 <= n; i += 16) {
+        __m256i h = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(src + i));
+        __m512i w = _mm512_slli_epi32(_mm512_cvtepu16_epi32(h), 16);
+        _mm512_storeu_ps(dst + i, _mm512_castsi512_ps(w));
+    }
+    bf16_to_f32_scalar(dst + i, src + i, n - i);
+}
+
+__attribute__((target("avx512f"))) void f32_to_bf16_avx512(bf16 *dst, f32 const *src,
+                                                          std::size_t n) {
+    std::size_t i = 0;
+    for(; i + 16 <= n; i += 16) {
+        __m512i bits  = _mm512_castps_si512(_mm512_loadu_ps(src + i));
+        __m512i lsb   = _mm512_and_si512(_mm512_srli_epi32(bits, 16), _mm512_set1_epi32(1));
+        __m512i bias  = _mm512_add_epi32(lsb, _mm512_set1_epi32(0x7fff));
+        __m512i round = _mm512_srli_epi32(_mm512_add_epi32(bits, bias), 16);
+        __m512i quiet = _mm512_srli_epi32(_mm512_or_si512(bits, _mm512_set1_epi32(0x400000)), 16);
+        __m512i abs   = _mm512_and_si512(bits, _mm512_set1_epi32(0x7fffffff));
+        __mmask16 nan = _mm512_cmpgt_epi32_mask(abs, _mm512_set1_epi32(0x7f800000));
+        __m512i h     = _mm512_mask_blend_epi32(nan, round, quiet);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), _mm512_cvtepi32_epi16(h));
+    }
+    f32_to_bf16_scalar(dst + i, src + i, n - i);
+}
+#endif
+
+struct HalfKernels {
+    void (*f16_to_f32)(f32 *, f16 const *, std::size_t);
+    void (*f32_to_f16)(f16 *, f32 const *, std::size_t);
+    void (*bf16_to_f32)(f32 *, bf16 const *, std::size_t);
+    void (*f32_to_bf16)(bf16 *, f32 const *, std::size_t);
+    char const *isa;
+};
+
+HalfKernels select_kernels() {
+#if KIWI_HALF_X86
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx512f"))
+        return {f16_to_f32_avx512, f32_to_f16_avx512, bf16_to_f32_avx512, f32_to_bf16_avx512,
+                "avx512"};
+
+    if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("f16c"))
+        return {f16_to_f32_f16c, f32_to_f16_f16c, bf16_to_f32_avx2, f32_to_bf16_avx2, "f16c"};
+#endif
+    return {f16_to_f32_scalar, f32_to_f16_scalar, bf16_to_f32_scalar, f32_to_bf16_scalar,
+            "scalar"};
+}
+
+HalfKernels const &kernels() {
+    static HalfKernels k = select_kernels();
+    return k;
+}
+
+} // namespace
+
+void f16_to_f32(f32 *dst, f16 const *src, std::size_t n) { kernels().f16_to_f32(dst, src, n); }
+
+void f32_to_f16(f16 *dst, f32 const *src, std::size_t n) { kernels().f32_to_f16(dst, src, n); }
+
+void bf16_to_f32(f32 *dst, bf16 const *src, std::size_t n) { kernels().bf16_to_f32(dst, src, n); }
+
+void f32_to_bf16(bf16 *dst, f32 const *src, std::size_t n) { kernels().f32_to_bf16(dst, src, n); }
+
+char const *half_conversion_isa() { return kernels().isa; }
+
+} // namespace kiwi
@@ -0,0 +1,156 @@
+#ifndef KIWI_AST_HALF_HEADER
+#define KIWI_AST_HALF_HEADER
+
+#include <cstddef>
+#include <cstring>
+#include <type_traits>
+
+#include "../Types.h"
+
+/*
+ *  16 bit floating point
+ *
+ *      f16 : IEEE 754-2008 binary16, 5 bits of exponent, 10 bits of mantissa
+ *      bf16: bfloat16, the upper half of a f32, 8 bits of exponent, 7 bits of mantissa
+ *
+ *  Both are storage types. They convert implicitly to f32, so arithmetic is
+ *  computed in f32 and the result is rounded once (to nearest even) when it
+ *  is stored back in a f16/bf16.
+ *
+ *  Buffers are converted in bulk with F16C / AVX-512 when the CPU has them,
+ *  the instruction set is selected once at runtime.
+ */
+namespace kiwi {
+
+inline f32 f16_bits_to_f32(u16 h) {
+    u32 sign = u32(h & 0x8000) << 16;
+    u32 exp  = (h >> 10) & 0x1f;
+    u32 mant = h & 0x3ff;
+    u32 bits = sign;
+
+    if(exp == 0x1f) { // inf, nan
+        bits |= 0x7f800000 | (mant << 13);
+    } else if(exp != 0) {
+        bits |= ((exp + 112) << 23) | (mant << 13);
+    } else if(mant != 0) { // subnormal, normalized in f32
+        exp = 113;
+        while((mant & 0x400) == 0) {
+            mant <<= 1;
+            exp -= 1;
+        }
+        bits |= (exp << 23) | ((mant & 0x3ff) << 13);
+    }
+
+    f32 v;
+    std::memcpy(&v, &bits, sizeof(v));
+    return v;
+}
+
+inline u16 f32_to_f16_bits(f32 v) {
+    u32 bits;
+    std::memcpy(&bits, &v, sizeof(bits));
+    u32 sign = (bits >> 16) & 0x8000;
+    u32 abs  = bits & 0x7fffffff;
+
+    // nan stays a quiet nan
+    if(abs > 0x7f800000)
+        return u16(sign | 0x7e00 | ((abs >> 13) & 0x3ff));
+
+    // 65520 and above round to inf
+    if(abs >= 0x477ff000)
+        return u16(sign | 0x7c00);
+
+    // normal, round the 13 dropped bits to nearest even and rebias
+    if(abs >= 0x38800000)
+        return u16(sign | ((abs + 0xfff + ((abs >> 13) & 1) - 0x38000000) >> 13));
+
+    // below half of the smallest subnormal
+    if(abs < 0x33000000)
+        return u16(sign);
+
+    // subnormal
+    u32 mant  = (abs & 0x7fffff) | 0x800000;
+    u32 shift = 126 - (abs >> 23);
+    u32 q     = mant >> shift;
+    u32 rem   = mant & ((u32(1) << shift) - 1);
+    u32 half  = u32(1) << (shift - 1);
+    if(rem > half || (rem == half && (q & 1)))
+        q += 1;
+    return u16(sign | q);
+}
+
+inline f32 bf16_bits_to_f32(u16 h) {
+    u32 bits = u32(h) << 16;
+    f32 v;
+    std::memcpy(&v, &bits, sizeof(v));
+    return v;
+}
+
+inline u16 f32_to_bf16_bits(f32 v) {
+    u32 bits;
+    std::memcpy(&bits, &v, sizeof(bits));
+
+    if((bits & 0x7fffffff) > 0x7f800000)
+        return u16((bits >> 16) | 0x40);
+
+    return u16((bits + 0x7fff + ((bits >> 16) & 1)) >> 16);
+}
+
+struct f16 {
+    u16 bits;
+
+    f16() = default;
+    explicit f16(f32 v) : bits(f32_to_f16_bits(v)) {}
+
+    // other types are converted through f32
+    template <typename T, typename = std::enable_if_t<std::is_arithmetic<T>::value>>
+    explicit f16(T v) : f16(f32(v)) {}
+
+    operator f32() const { return f16_bits_to_f32(bits); }
+
+    static f16 from_bits(u16 bits) {
+        f16 v;
+        v.bits = bits;
+        return v;
+    }
+};
+
+struct bf16 {
+    u16 bits;
+
+    bf16() = default;
+    explicit bf16(f32 v) : bits(f32_to_bf16_bits(v)) {}
+
+    template <typename T, typename = std::enable_if_t<std::is_arithmetic<T>::value>>
+    explicit bf16(T v) : bf16(f32(v)) {}
+
+    operator f32() const { return bf16_bits_to_f32(bits); }
+
+    static bf16 from_bits(u16 bits) {
+        bf16 v;
+        v.bits = bits;
+        return v;
+    }
+};
+
+// std traits cannot be specialized, these include the 16 bit types
+template <typename T> struct is_float_type : std::is_floating_point<T> {};
+template <> struct is_float_type<f16> : std::true_type {};
+template <> struct is_float_type<bf16> : std::true_type {};
+
+template <typename T> struct is_signed_type : std::is_signed<T> {};
+template <> struct is_signed_type<f16> : std::true_type {};
+template <> struct is_signed_type<bf16> : std::true_type {};
+
+// Bulk conversions of `n` values
+void f16_to_f32(f32 *dst, f16 const *src, std::size_t n);
+void f32_to_f16(f16 *dst, f32 const *src, std::size_t n);
+void bf16_to_f32(f32 *dst, bf16 const *src, std::size_t n);
+void f32_to_bf16(bf16 *dst, f32 const *src, std::size_t n);
+
+// Instruction set used by the bulk conversions: avx512, f16c or scalar
+char const *half_conversion_isa();
+
+} // namespace kiwi
+
+#endif
@@ -0,0 +1,83 @@
+#ifndef KIWI_AST_HASH_CONS_HEADER
+#define KIWI_AST_HASH_CONS_HEADER
+
+#include <cstring>
+#include <functional>
+
+#include "Expression.h"
+
+namespace kiwi {
+
+/* Structural identity of a leaf or of a node whose children are already
+ * hash-consed: children are compared by address, values by their bits.
+ */
+struct NodeKey {
+    NodeTag tag;
+    u32 sub; // primitive tag, symbol id...
+    u64 a;
+    u64 b;
+    u64 c;
+
+    bool operator==(NodeKey const &k) const {
+        return tag == k.tag && sub == k.sub && a == k.a && b == k.b && c == k.c;
+    }
+
+    static u64 id(void const *ptr) { return u64(reinterpret_cast<std::uintptr_t>(ptr)); }
+
+    template <typename T> static u64 bits(T val) {
+        static_assert(sizeof(T) <= sizeof(u64), "value does not fit in a key");
+        u64 b = 0;
+        std::memcpy(&b, &val, sizeof(T));
+        return b;
+    }
+};
+
+// Mix `v` into the hash `seed` (boost::hash_combine)
+inline std::size_t hash_combine(std::size_t seed, u64 v) {
+    return seed ^ (std::hash<u64>()(v) + 0x9e3779b9 + (seed << 6) + (seed >> 2));
+}
+
+struct NodeKeyHash {
+    std::size_t operator()(NodeKey const &k) const {
+        std::size_t h = std::size_t(k.tag);
+        for(u64 v : {u64(k.sub), k.a, k.b, k.c})
+            h = hash_combine(h, v);
+        return h;
+    }
+};
+
+struct HashConsStats {
+    u64 hits   = 0; // node reused
+    u64 misses = 0; // node created
+};
+
+/* Maps structural keys to the unique node built for them.
+ * Nodes returned by the table are shared: they must not be mutated.
+ */
+class HashConsTable {
+  public:
+    template <typename Make> Expression *get(NodeKey const &key, Make make) {
+        auto result = _nodes.find(key);
+        if(result != _nodes.end()) {
+            _stats.hits += 1;
+            return result->second;
+        }
+
+        _stats.misses += 1;
+        Expression *expr = make();
+        _nodes.emplace(key, expr);
+        return expr;
+    }
+
+    std::size_t size() const { return _nodes.size(); }
+
+    HashConsStats const &stats() const { return _stats; }
+
+  private:
+    std::unordered_map<NodeKey, Expression *, NodeKeyHash> _nodes;
+    HashConsStats _stats;
+};
+
+} // namespace kiwi
+
+#endif
@@ -1,6 +1,7 @@
 #ifndef KIWI_AST_MODULE_HEADER
 #define KIWI_AST_MODULE_HEADER
 
+#include "../Logging/Log.h"
 #include "Definition.h"
 #include "Expression.h"
 #include "Stack.h"
@@ -9,17 +10,22 @@ namespace kiwi {
 
 using Module = Dict<String, Definition *>;
 
-using Context = Dict<String, Expression *>;
+using Context = Dict<Symbol, Expression *>;
 
 class LocalScope;
 
 // This is the Top Scope that manages the memory
 // Not Thread safe as new var are pushed forward
+//
+// Every scope is a frame of consecutive slots, the global scope is frame 0.
+// A frame links to the frame of its lexically enclosing scope (static link):
+// a reference `depth` scopes up follows `depth` links, which is the right
+// frame even when the function recursed or was called from a nested scope.
 class GlobalScope {
   public:
-    GlobalScope(std::size_t reserve_size) : _scope(reserve_size) {}
+    GlobalScope(std::size_t reserve_size) : _scope(reserve_size) { _frames.push_back(Frame{0, 0}); }
 
-    void push(void()) {}
+    void push() {}
 
     template <typename... Args> void push(Expression *const &v, Args... args) {
         _scope.push(v);
@@ -32,13 +38,57 @@ class GlobalScope {
 
     std::size_t size() { return _scope.size(); }
 
+    // Innermost frame
+    std::size_t frame() const { return _frames.size() - 1; }
+
+    // Open a frame starting at the current size, nested in the frame `parent`
+    void enter(std::size_t parent) { _frames.push_back(Frame{_scope.size(), parent}); }
+
+    // Close the innermost frame and pop its slots
+    void exit() {
+        if(_frames.size() <= 1)
+            return;
+
+        while(_scope.size() > _frames.back().base)
+            _scope.pop_back();
+        _frames.pop_back();
+    }
+
+    // Value bound by a resolved reference, `depth` scopes up from the innermost one
+    // nullptr if the reference does not match a live slot
+    Expression *get(std::size_t depth, std::size_t slot) {
+        std::size_t frame = _frames.size() - 1;
+        for(; depth > 0; --depth) {
+            if(frame == 0) {
+                log_error("Reference to a scope above the global scope");
+                return nullptr;
+            }
+            frame = _frames[frame].parent;
+        }
+
+        // slots of a frame end where the next frame starts
+        std::size_t index = _frames[frame].base + slot;
+        std::size_t end   = frame + 1 < _frames.size() ? _frames[frame + 1].base : _scope.size();
+        if(index >= end) {
+            log_error("Reference to an unbound slot ", slot);
+            return nullptr;
+        }
+        return _scope[index];
+    }
+
+    Expression *get(PlaceholderReference const *ref) {
+        return get(std::size_t(ref->depth), std::size_t(ref->index));
+    }
+
   private:
-    void inc() { _depth += 1; }
-    void dec() { _depth -= 1; }
+    struct Frame {
+        std::size_t base;   // first slot
+        std::size_t parent; // frame of the enclosing scope
+    };
 
     // size can be different from _scope
     Stack<Expression *> _scope;
-    std::size_t _depth = 0;
+    Array<Frame> _frames;
 
     friend LocalScope new_scope(GlobalScope &scope);
     friend LocalScope new_scope(LocalScope &scope);
@@ -64,31 +114,44 @@ class GlobalScope {
 
 class LocalScope {
   public:
+    // Scope nested in `scope`
     LocalScope(LocalScope &scope) : _scope(scope._scope), _starting_size(scope.size()) {
-        _scope.inc();
+        _scope.enter(scope._frame);
+        _frame = _scope.frame();
     }
 
     LocalScope(LocalScope &&scope) : _scope(scope._scope), _starting_size(scope.size()) {
-        _scope.inc();
+        _scope.enter(scope._frame);
+        _frame = _scope.frame();
     }
 
-    LocalScope(GlobalScope &scope) : _scope(scope), _starting_size(scope.size()) { _scope.inc(); }
-
-    ~LocalScope() {
-        for(std::size_t i = _starting_size, n = size(); i < n; ++i)
-            _scope.pop_back();
-        _scope.dec();
+    // Scope nested in the frame `parent`, the global scope by default:
+    // the body of a function is nested where the function was defined
+    LocalScope(GlobalScope &scope, std::size_t parent = 0) :
+        _scope(scope), _starting_size(scope.size()) {
+        _scope.enter(parent);
+        _frame = _scope.frame();
     }
 
+    ~LocalScope() { _scope.exit(); }
+
     template <typename... Args> void push(Args... args) { _scope.push(args...); }
 
     Expression *pop() { return _scope.pop(); }
 
     std::size_t size() { return _scope.size(); }
 
+    // Slot of this scope
+    Expression *operator[](std::size_t slot) { return _scope._scope[_starting_size + slot]; }
+
+    Expression *get(std::size_t depth, std::size_t slot) { return _scope.get(depth, slot); }
+
+    std::size_t frame() const { return _frame; }
+
   private:
     GlobalScope &_scope;
     std::size_t _starting_size;
+    std::size_t _frame;
 
     friend LocalScope new_scope(GlobalScope &scope);
     friend LocalScope new_scope(LocalScope &scope);
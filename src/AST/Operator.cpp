@@ -0,0 +1,71 @@
+#include "Operator.h"
+
+namespace kiwi {
+
+BinaryOp get_binary_op(StringView name) {
+#define OP(id, str)                                                                                \
+    if(name == str)                                                                                \
+        return BinaryOp::id;
+    KIWI_BINARY_OPERATORS(OP)
+#undef OP
+    return BinaryOp::none;
+}
+
+UnaryOp get_unary_op(StringView name) {
+#define OP(id, str)                                                                                \
+    if(name == str)                                                                                \
+        return UnaryOp::id;
+    KIWI_UNARY_OPERATORS(OP)
+#undef OP
+    return UnaryOp::none;
+}
+
+Reduction get_reduction(StringView name) {
+#define OP(id, str)                                                                                \
+    if(name == str)                                                                                \
+        return Reduction::id;
+    KIWI_REDUCTIONS(OP)
+#undef OP
+    return Reduction::none;
+}
+
+char const *to_string(BinaryOp op) {
+    switch(op) {
+#define OP(id, str)                                                                                \
+    case BinaryOp::id:                                                                             \
+        return str;
+        KIWI_BINARY_OPERATORS(OP)
+#undef OP
+    case BinaryOp::none:
+        return "<none>";
+    }
+    return "<none>";
+}
+
+char const *to_string(UnaryOp op) {
+    switch(op) {
+#define OP(id, str)                                                                                \
+    case UnaryOp::id:                                                                              \
+        return str;
+        KIWI_UNARY_OPERATORS(OP)
+#undef OP
+    case UnaryOp::none:
+        return "<none>";
+    }
+    return "<none>";
+}
+
+char const *to_string(Reduction op) {
+    switch(op) {
+#define OP(id, str)                                                                                \
+    case Reduction::id:                                                                            \
+        return str;
+        KIWI_REDUCTIONS(OP)
+#undef OP
+    case Reduction::none:
+        return "<none>";
+    }
+    return "<none>";
+}
+
+} // namespace kiwi
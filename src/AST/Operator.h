@@ -0,0 +1,70 @@
+#ifndef KIWI_AST_OPERATOR_HEADER
+#define KIWI_AST_OPERATOR_HEADER
+
+#include "../Types.h"
+#include "StringDatabase.h"
+
+/*
+ *  Operator registry
+ *
+ *  Operators are resolved to a dense id when the call is built, evaluation
+ *  then indexes a table instead of hashing the operator name.
+ *  The kernels implementing them live in TreeOps/Operators.h.
+ */
+namespace kiwi {
+
+//  OP(id, name)
+#define KIWI_BINARY_OPERATORS(OP)                                                                  \
+    OP(add, "+")                                                                                   \
+    OP(sub, "-")                                                                                   \
+    OP(mul, "*")                                                                                   \
+    OP(div, "/")
+
+#define KIWI_UNARY_OPERATORS(OP)                                                                   \
+    OP(neg, "-")                                                                                   \
+    OP(ln, "ln")                                                                                   \
+    OP(exp, "exp")                                                                                 \
+    OP(sqrt, "sqrt")                                                                               \
+    OP(ret, "return")
+
+//  OP(id, name), builtin functions reducing an array to a scalar
+#define KIWI_REDUCTIONS(OP)                                                                        \
+    OP(sum, "sum")                                                                                 \
+    OP(prod, "prod")                                                                               \
+    OP(min, "min")                                                                                 \
+    OP(max, "max")                                                                                 \
+    OP(mean, "mean")
+
+enum class BinaryOp : u8 {
+    none,
+#define OP(id, name) id,
+    KIWI_BINARY_OPERATORS(OP)
+#undef OP
+};
+
+enum class UnaryOp : u8 {
+    none,
+#define OP(id, name) id,
+    KIWI_UNARY_OPERATORS(OP)
+#undef OP
+};
+
+enum class Reduction : u8 {
+    none,
+#define OP(id, name) id,
+    KIWI_REDUCTIONS(OP)
+#undef OP
+};
+
+// none if `name` is not an operator
+BinaryOp get_binary_op(StringView name);
+UnaryOp get_unary_op(StringView name);
+Reduction get_reduction(StringView name);
+
+char const *to_string(BinaryOp op);
+char const *to_string(UnaryOp op);
+char const *to_string(Reduction op);
+
+} // namespace kiwi
+
+#endif
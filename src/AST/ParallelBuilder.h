@@ -0,0 +1,191 @@
+#ifndef KIWI_AST_PARALLEL_BUILDER_HEADER
+#define KIWI_AST_PARALLEL_BUILDER_HEADER
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "Builder.h"
+#include "Module.h"
+
+/*
+ *  Build one module from many threads.
+ *
+ *  Every worker owns a BuilderContext and a Builder so building never
+ *  synchronizes; only names are shared through the global StringDatabase,
+ *  the same name gets the same symbol id in every worker.
+ *  The value of an id depends on which thread interned the name first, it
+ *  changes from one run to the next: compare and order names by their
+ *  string (as merge does), or intern() them before running to fix their ids.
+ *
+ *  Work is split in items, each item can emit any number of definitions.
+ *  An item builds inside its own scope: the names it binds are dropped
+ *  before the worker starts the next one.
+ *  The merge phase orders the definitions by (item, emission order) so the
+ *  resulting module does not depend on how items were scheduled.
+ *  When a name is emitted twice the first definition wins and the other
+ *  one is reported as a conflict.
+ *
+ *  A job that throws stops the distribution of items, every thread is
+ *  joined and the first exception is rethrown by run().
+ *
+ *  The nodes live in the workers' arenas: the ParallelModuleBuilder must
+ *  outlive the module it produced.
+ */
+namespace kiwi {
+
+struct ModuleConflict {
+    Symbol name;
+    Definition *kept;
+    Definition *dropped;
+};
+
+class ModuleWorker {
+  public:
+    ModuleWorker(std::size_t id) : _id(id), _builder(&_ctx) {}
+
+    std::size_t id() const { return _id; }
+
+    Builder &builder() { return _builder; }
+
+    BuilderContext &context() { return _ctx; }
+
+    // Add a top level definition to the module
+    void emit(Definition *def) {
+        _emitted.push_back(Emitted{_item, _sequence, def});
+        _sequence += 1;
+    }
+
+  private:
+    struct Emitted {
+        std::size_t item;
+        std::size_t sequence;
+        Definition *def;
+    };
+
+    void start(std::size_t item) {
+        _item     = item;
+        _sequence = 0;
+        _ctx.enter_scope();
+    }
+
+    void finish() { _ctx.exit_scope(); }
+
+    std::size_t _id;
+    BuilderContext _ctx;
+    Builder _builder;
+    Array<Emitted> _emitted;
+    std::size_t _item     = 0;
+    std::size_t _sequence = 0;
+
+    friend class ParallelModuleBuilder;
+};
+
+class ParallelModuleBuilder {
+  public:
+    ParallelModuleBuilder(std::size_t workers = std::thread::hardware_concurrency()) {
+        workers = std::max<std::size_t>(workers, 1);
+        for(std::size_t i = 0; i < workers; ++i)
+            _workers.emplace_back(new ModuleWorker(i));
+    }
+
+    std::size_t size() const { return _workers.size(); }
+
+    ModuleWorker &worker(std::size_t i) { return *_workers[i]; }
+
+    // Intern `names` in order, their symbol ids do not depend on the scheduling
+    static void intern(Array<String> const &names) {
+        for(String const &name : names)
+            StringDatabase::instance().intern(name);
+    }
+
+    // Call `job(worker, item)` for every item in [0, n)
+    // items are handed out dynamically to balance the load
+    template <typename Job> void run(std::size_t n, Job job) {
+        std::atomic<std::size_t> next(0);
+        std::mutex error_lock;
+        std::exception_ptr error;
+
+        auto work = [&](ModuleWorker &worker) {
+            for(std::size_t item = next++; item < n; item = next++) {
+                worker.start(_items + item);
+                try {
+                    job(worker, item);
+                } catch(...) {
+                    std::lock_guard<std::mutex> guard(error_lock);
+                    if(!error)
+                        error = std::current_exception();
+                    next = n;
+                }
+                worker.finish();
+            }
+        };
+
+        {
+            // joined even if starting a thread throws
+            Array<std::thread> threads;
+            struct JoinAll {
+                Array<std::thread> &threads;
+                ~JoinAll() {
+                    for(auto &thread : threads)
+                        thread.join();
+                }
+            } join_all{threads};
+
+            for(std::size_t i = 1; i < _workers.size(); ++i)
+                threads.emplace_back(work, std::ref(*_workers[i]));
+
+            work(*_workers[0]);
+        }
+
+        // later runs are merged after this one
+        _items += n;
+
+        if(error)
+            std::rethrow_exception(error);
+    }
+
+    // Combine the definitions of every worker, the result is deterministic
+    Module merge() {
+        using Emitted = ModuleWorker::Emitted;
+
+        Array<Emitted> all;
+        for(auto &worker : _workers)
+            all.insert(all.end(), worker->_emitted.begin(), worker->_emitted.end());
+
+        std::sort(all.begin(), all.end(), [](Emitted const &a, Emitted const &b) {
+            if(a.item != b.item)
+                return a.item < b.item;
+            return a.sequence < b.sequence;
+        });
+
+        Module module;
+        _conflicts.clear();
+
+        for(Emitted const &e : all) {
+            auto result = module.emplace(e.def->name.string(), e.def);
+
+            if(!result.second) {
+                log_warn("Declaration `", e.def->name, "` already exists");
+                _conflicts.push_back(ModuleConflict{e.def->name, result.first->second, e.def});
+            }
+        }
+
+        return module;
+    }
+
+    // Definitions dropped by the last merge
+    Array<ModuleConflict> const &conflicts() const { return _conflicts; }
+
+  private:
+    Array<std::unique_ptr<ModuleWorker>> _workers;
+    Array<ModuleConflict> _conflicts;
+    std::size_t _items = 0;
+};
+
+} // namespace kiwi
+
+#endif
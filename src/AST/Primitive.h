@@ -0,0 +1,153 @@
+#ifndef KIWI_AST_PRIMITIVE_HEADER
+#define KIWI_AST_PRIMITIVE_HEADER
+
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+
+#include "../Types.h"
+#include "Half.h"
+#include "StringDatabase.h"
+
+namespace kiwi {
+
+#define KIWI_PRIMITIVE(X)                                                                          \
+    X(i8)                                                                                          \
+    X(i16)                                                                                         \
+    X(i32)                                                                                         \
+    X(i64)                                                                                         \
+    X(u8)                                                                                          \
+    X(u16)                                                                                         \
+    X(u32)                                                                                         \
+    X(u64)                                                                                         \
+    X(f32)                                                                                         \
+    X(f64)                                                                                         \
+    X(f16)                                                                                         \
+    X(bf16)
+
+// clang-format off
+enum class PrimitiveTag {
+    #define X(n) n,
+        KIWI_PRIMITIVE(X)
+    #undef X
+    none,
+};
+
+template <typename T> PrimitiveTag get_primitive_tag() { return PrimitiveTag::none; }
+
+// Map C++ type to Primitive Tag
+#define X(n)                                                                                       \
+    template <> inline PrimitiveTag get_primitive_tag<n>() { return PrimitiveTag::n; }
+    KIWI_PRIMITIVE(X)
+#undef X
+
+// PrettyPrint a Primitive Tag name
+inline const std::string &get_primitive_name(PrimitiveTag id) {
+    static std::unordered_map<PrimitiveTag, std::string> builtin_types = {
+    #define X(n) {PrimitiveTag::n, #n},
+        KIWI_PRIMITIVE(X)
+    #undef X
+        {PrimitiveTag::none, "NotAPrimitive"}
+    };
+    return builtin_types[id];
+}
+
+// Primitive Tag from a type name, none if the name is not a primitive
+inline PrimitiveTag get_primitive_tag(Symbol name) {
+    static std::unordered_map<Symbol, PrimitiveTag> builtin_tags = {
+    #define X(n) {Symbol(#n), PrimitiveTag::n},
+        KIWI_PRIMITIVE(X)
+    #undef X
+    };
+    auto result = builtin_tags.find(name);
+    if(result != builtin_tags.end())
+        return result->second;
+    return PrimitiveTag::none;
+}
+
+// Size in bytes of a primitive, 0 for none
+inline std::size_t get_primitive_size(PrimitiveTag id) {
+    switch(id) {
+    #define X(n) case PrimitiveTag::n: return sizeof(n);
+        KIWI_PRIMITIVE(X)
+    #undef X
+    case PrimitiveTag::none:
+        return 0;
+    }
+    return 0;
+}
+
+// Is the primitive a floating point type
+inline bool is_floating_primitive(PrimitiveTag id) {
+    switch(id) {
+    #define X(n) case PrimitiveTag::n: return is_float_type<n>::value;
+        KIWI_PRIMITIVE(X)
+    #undef X
+    case PrimitiveTag::none:
+        return false;
+    }
+    return false;
+}
+
+// Common type of a binary operation on `a` and `b`, following C: floating
+// point wins, then the widest type, then unsigned over signed.
+// f16 and bf16 have no common 16 bit type, they promote to f32
+inline PrimitiveTag promote_primitive(PrimitiveTag a, PrimitiveTag b) {
+    if((a == PrimitiveTag::f16 && b == PrimitiveTag::bf16) ||
+       (a == PrimitiveTag::bf16 && b == PrimitiveTag::f16))
+        return PrimitiveTag::f32;
+
+    auto rank = [](PrimitiveTag id) -> int {
+        switch(id) {
+        #define X(n)                                                                               \
+        case PrimitiveTag::n:                                                                      \
+            return int(is_float_type<n>::value) * 64 + int(sizeof(n)) * 2 +                        \
+                   int(std::is_unsigned<n>::value);
+            KIWI_PRIMITIVE(X)
+        #undef X
+        case PrimitiveTag::none:
+            return -1;
+        }
+        return -1;
+    };
+    return rank(a) >= rank(b) ? a : b;
+}
+
+// Read the primitive `id` stored at `src` and convert it to T
+template <typename T> T load_primitive(PrimitiveTag id, void const *src) {
+    switch(id) {
+    #define X(n)                                                                                   \
+    case PrimitiveTag::n: {                                                                        \
+        n v;                                                                                       \
+        std::memcpy(&v, src, sizeof(n));                                                           \
+        return T(v);                                                                               \
+    }
+        KIWI_PRIMITIVE(X)
+    #undef X
+    case PrimitiveTag::none:
+        return T();
+    }
+    return T();
+}
+
+// Convert `value` to the primitive `id` and store it at `dst`
+template <typename T> void store_primitive(PrimitiveTag id, void *dst, T value) {
+    switch(id) {
+    #define X(n)                                                                                   \
+    case PrimitiveTag::n: {                                                                        \
+        n v = n(value);                                                                            \
+        std::memcpy(dst, &v, sizeof(n));                                                           \
+        return;                                                                                    \
+    }
+        KIWI_PRIMITIVE(X)
+    #undef X
+    case PrimitiveTag::none:
+        return;
+    }
+}
+// clang-format on
+
+} // namespace kiwi
+
+#endif
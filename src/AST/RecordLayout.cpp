@@ -0,0 +1,96 @@
+#include "RecordLayout.h"
+#include "Expression.h"
+#include "Type.h"
+
+namespace kiwi {
+
+SymbolIndex::SymbolIndex(Array<Symbol> const &names) {
+    if(names.empty())
+        return;
+
+    std::size_t capacity = 4;
+    while(capacity < names.size() * 2)
+        capacity *= 2;
+
+    _slots.resize(capacity);
+    std::size_t mask = capacity - 1;
+
+    for(std::size_t k = 0; k < names.size(); ++k) {
+        std::size_t i = hash(names[k]) & mask;
+        while(_slots[i].index >= 0 && _slots[i].id != names[k].id())
+            i = (i + 1) & mask;
+
+        if(_slots[i].index < 0)
+            _slots[i] = Slot{names[k].id(), int32(k)};
+    }
+}
+
+PrimitiveTag get_field_primitive(Statement *type) {
+    if(type == nullptr)
+        return PrimitiveTag::none;
+
+    switch(type->tag) {
+    case NodeTag::builtin_type:
+        return get_primitive_tag(static_cast<BuiltinType *>(type)->name);
+    case NodeTag::placeholder_ref:
+        return get_primitive_tag(static_cast<PlaceholderReference *>(type)->name);
+    default:
+        return PrimitiveTag::none;
+    }
+}
+
+RecordLayout RecordLayout::make(Array<Tuple<Symbol, Statement *>> const &meta,
+                                Array<Tuple<Symbol, Statement *>> const &attr, bool overlap) {
+    RecordLayout layout;
+    Array<Symbol> names;
+    names.reserve(attr.size());
+
+    u32 offset = 0;
+    for(auto &item : attr) {
+        FieldLayout field;
+        field.name      = std::get<0>(item);
+        field.primitive = get_field_primitive(std::get<1>(item));
+        field.size      = field.is_boxed() ? u32(sizeof(void *))
+                                           : u32(get_primitive_size(field.primitive));
+
+        // primitives are naturally aligned
+        u32 align = field.size;
+        if(!overlap)
+            offset = (offset + align - 1) & ~(align - 1);
+
+        field.offset = overlap ? 0 : offset;
+        offset       = field.offset + field.size;
+
+        if(align > layout.alignment)
+            layout.alignment = align;
+        if(offset > layout.size)
+            layout.size = offset;
+
+        layout.fields.push_back(field);
+        names.push_back(field.name);
+    }
+
+    layout.size = (layout.size + layout.alignment - 1) & ~(layout.alignment - 1);
+
+    Array<Symbol> meta_names;
+    meta_names.reserve(meta.size());
+    for(auto &item : meta)
+        meta_names.push_back(std::get<0>(item));
+
+    layout._attributes = SymbolIndex(names);
+    layout._meta_types = SymbolIndex(meta_names);
+    layout.sealed      = true;
+    return layout;
+}
+
+RecordLayout RecordLayout::make_struct(Array<Tuple<Symbol, Statement *>> const &meta,
+                                       Array<Tuple<Symbol, Statement *>> const &attr) {
+    return make(meta, attr, false);
+}
+
+RecordLayout RecordLayout::make_union(Array<Tuple<Symbol, Statement *>> const &meta,
+                                      Array<Tuple<Symbol, Statement *>> const &attr) {
+    return make(meta, attr, true);
+}
+
+} // namespace kiwi
@@ -0,0 +1,100 @@
+#ifndef KIWI_AST_RECORD_LAYOUT_HEADER
+#define KIWI_AST_RECORD_LAYOUT_HEADER
+
+#include "../Types.h"
+#include "Primitive.h"
+#include "StringDatabase.h"
+
+namespace kiwi {
+
+class Statement;
+
+/* Read only table mapping interned names to their position.
+ *
+ * Open addressing over the symbol ids with linear probing, the table is
+ * at most half full so a lookup touches one or two slots.
+ * When a name appears twice the first position is kept.
+ */
+class SymbolIndex {
+  public:
+    SymbolIndex() = default;
+
+    SymbolIndex(Array<Symbol> const &names);
+
+    int32 find(Symbol name) const {
+        if(_slots.empty())
+            return -1;
+
+        std::size_t mask = _slots.size() - 1;
+        for(std::size_t i = hash(name) & mask;; i = (i + 1) & mask) {
+            Slot const &slot = _slots[i];
+            if(slot.index < 0)
+                return -1;
+            if(slot.id == name.id())
+                return slot.index;
+        }
+    }
+
+    std::size_t capacity() const { return _slots.size(); }
+
+  private:
+    struct Slot {
+        SymbolId id = 0;
+        int32 index = -1;
+    };
+
+    // Symbol ids are dense, multiplying by an odd constant spreads them
+    static std::size_t hash(Symbol name) { return std::size_t(name.id()) * 0x9E3779B1u; }
+
+    Array<Slot> _slots;
+};
+
+struct FieldLayout {
+    Symbol name;
+    PrimitiveTag primitive; // none if the field is boxed
+    u32 offset;
+    u32 size;
+
+    bool is_boxed() const { return primitive == PrimitiveTag::none; }
+};
+
+/* Immutable layout of a record type, computed once when it is sealed.
+ *
+ *  Struct: fields are packed in declaration order at their natural alignment
+ *  Union : every field starts at offset 0, size is the size of the largest field
+ *
+ *  Primitive fields are stored inline, every other field is a pointer to a Value.
+ */
+class RecordLayout {
+  public:
+    static RecordLayout make_struct(Array<Tuple<Symbol, Statement *>> const &meta,
+                                    Array<Tuple<Symbol, Statement *>> const &attr);
+
+    static RecordLayout make_union(Array<Tuple<Symbol, Statement *>> const &meta,
+                                   Array<Tuple<Symbol, Statement *>> const &attr);
+
+    int32 attribute_index(Symbol name) const { return _attributes.find(name); }
+
+    int32 meta_type_index(Symbol name) const { return _meta_types.find(name); }
+
+    FieldLayout const &field(std::size_t index) const { return fields[index]; }
+
+    bool sealed   = false;
+    u32 size      = 0;
+    u32 alignment = 1;
+    Array<FieldLayout> fields;
+
+  private:
+    static RecordLayout make(Array<Tuple<Symbol, Statement *>> const &meta,
+                             Array<Tuple<Symbol, Statement *>> const &attr, bool overlap);
+
+    SymbolIndex _attributes;
+    SymbolIndex _meta_types;
+};
+
+// Primitive stored by a field of the given type, none if it is not a primitive
+PrimitiveTag get_field_primitive(Statement *type);
+
+} // namespace kiwi
+
+#endif
@@ -23,6 +23,9 @@ template <typename T> class Stack {
 
     T &last() { return _vector[_vector.size() - 1]; }
 
+    T &operator[](std::size_t index) { return _vector[index]; }
+    T const &operator[](std::size_t index) const { return _vector[index]; }
+
   private:
     Array<T> _vector;
 };
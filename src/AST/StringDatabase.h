@@ -1,35 +1,134 @@
 #pragma once
 
-#include "../Logging/Log.h"
-#include <unordered_set>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <ostream>
+#include <stdexcept>
+#include <string_view>
+
+#include "../Types.h"
+#include "Arena.h"
 
 namespace kiwi {
 
-    class StringDatabase {
-    private:
-        using StringDBImpl = std::unordered_set<std::string>;
-
-        StringDatabase() :
-            _string_db(541)
-        {};
-
-    public:
-        using StringStorage = std::string;
-        using StringView = std::string_view;
-
-        const StringView put(const StringStorage& str) {
-            using insert_result = std::pair<StringDBImpl::iterator, bool>;
-            insert_result result = _string_db.emplace(str);
-            return StringView(*result.first);
-        }
-
-        bool contains(const StringStorage& str) const {
-            using const_iterator = StringDBImpl::const_iterator;
-            const_iterator data = _string_db.find(str);
-            return data != _string_db.end();
-        }
-
-    private:
-        std::unordered_set<StringStorage> _string_db;
-    };
-}
\ No newline at end of file
+using SymbolId   = u32;
+using StringView = std::string_view;
+
+/* Global string interner.
+ *
+ * Every name of the AST is stored once and referred to by a 32 bits id.
+ * Characters live in an arena and are never moved so the views returned
+ * stay valid for the lifetime of the program.
+ *
+ * Interning takes a lock, reading a symbol back does not: the id table
+ * is split in fixed pages that are never reallocated and an id can only be
+ * observed after the thread that created it released the lock.
+ */
+class StringDatabase {
+  private:
+    static constexpr std::size_t page_bits = 12;
+    static constexpr std::size_t page_size = std::size_t(1) << page_bits;
+    static constexpr std::size_t max_pages = 4096;
+
+    StringDatabase() : _index(541), _pages(max_pages, nullptr) { intern(""); }
+
+  public:
+    ~StringDatabase() {
+        for(StringView *page : _pages)
+            delete[] page;
+    }
+
+    static StringDatabase &instance() {
+        static StringDatabase db;
+        return db;
+    }
+
+    SymbolId intern(StringView str) {
+        std::lock_guard<std::mutex> guard(_lock);
+
+        auto result = _index.find(str);
+        if(result != _index.end())
+            return result->second;
+
+        SymbolId id = SymbolId(_size);
+        if((id >> page_bits) >= max_pages)
+            throw std::length_error("StringDatabase: too many symbols");
+
+        char *data = static_cast<char *>(_storage.allocate(str.size() + 1, 1));
+        std::memcpy(data, str.data(), str.size());
+        data[str.size()] = '\0';
+
+        StringView *&page = _pages[id >> page_bits];
+        if(page == nullptr)
+            page = new StringView[page_size];
+
+        StringView view(data, str.size());
+        page[id & (page_size - 1)] = view;
+        _index.emplace(view, id);
+        _size += 1;
+        return id;
+    }
+
+    StringView get(SymbolId id) const { return _pages[id >> page_bits][id & (page_size - 1)]; }
+
+    bool contains(StringView str) const {
+        std::lock_guard<std::mutex> guard(_lock);
+        return _index.count(str) > 0;
+    }
+
+    std::size_t size() const {
+        std::lock_guard<std::mutex> guard(_lock);
+        return _size;
+    }
+
+  private:
+    mutable std::mutex _lock;
+    Arena _storage;
+    Dict<StringView, SymbolId> _index;
+    Array<StringView *> _pages;
+    std::size_t _size = 0;
+};
+
+/* Interned name used everywhere in the AST.
+ * Comparing and hashing symbols is an integer operation.
+ * Symbol() is the empty string.
+ */
+class Symbol {
+  public:
+    Symbol() = default;
+
+    Symbol(StringView str) : _id(StringDatabase::instance().intern(str)) {}
+    Symbol(String const &str) : Symbol(StringView(str)) {}
+    Symbol(char const *str) : Symbol(StringView(str)) {}
+
+    static Symbol from_id(SymbolId id) {
+        Symbol s;
+        s._id = id;
+        return s;
+    }
+
+    SymbolId id() const { return _id; }
+
+    StringView str() const { return StringDatabase::instance().get(_id); }
+
+    String string() const { return String(str()); }
+
+    bool empty() const { return _id == 0; }
+
+    bool operator==(Symbol const &other) const { return _id == other._id; }
+    bool operator!=(Symbol const &other) const { return _id != other._id; }
+
+  private:
+    SymbolId _id = 0;
+};
+
+inline std::ostream &operator<<(std::ostream &out, Symbol const &sym) { return out << sym.str(); }
+
+} // namespace kiwi
+
+namespace std {
+template <> struct hash<kiwi::Symbol> {
+    std::size_t operator()(kiwi::Symbol const &sym) const { return sym.id(); }
+};
+} // namespace std
@@ -0,0 +1,157 @@
+#ifndef KIWI_AST_STRUCT_ARRAY_HEADER
+#define KIWI_AST_STRUCT_ARRAY_HEADER
+
+#include <memory>
+#include <new>
+
+#include "Value.h"
+
+namespace kiwi {
+
+/* N instances of one struct type stored as one array per field.
+ *
+ * Every column is contiguous and aligned on a cache line, a scan over a
+ * single field is a plain loop over a typed array. Boxed fields are stored
+ * as an array of Value pointers.
+ */
+class StructArray {
+  public:
+    static constexpr std::size_t alignment = 64;
+
+    StructArray(Struct *def, std::size_t n = 0) : _type(def) {
+        if(!def->is_sealed())
+            def->seal();
+
+        _columns.resize(layout().fields.size());
+        resize(n);
+    }
+
+    Struct *definition() const { return _type; }
+
+    RecordLayout const &layout() const { return _type->layout; }
+
+    std::size_t size() const { return _size; }
+
+    std::size_t capacity() const { return _capacity; }
+
+    // Typed column, nullptr if T is not the primitive stored by the field
+    template <typename T> T *column(std::size_t field) {
+        if(layout().field(field).primitive != get_primitive_tag<T>())
+            return nullptr;
+        return reinterpret_cast<T *>(_columns[field].get());
+    }
+
+    template <typename T> T const *column(std::size_t field) const {
+        return const_cast<StructArray *>(this)->column<T>(field);
+    }
+
+    Value **boxed_column(std::size_t field) {
+        if(!layout().field(field).is_boxed())
+            return nullptr;
+        return reinterpret_cast<Value **>(_columns[field].get());
+    }
+
+    template <typename T> T get(std::size_t row, std::size_t field) const {
+        FieldLayout const &f = layout().field(field);
+        if(f.is_boxed()) {
+            Value *v = reinterpret_cast<Value *const *>(_columns[field].get())[row];
+            return v ? v->as<T>() : T();
+        }
+        return load_primitive<T>(f.primitive, cell(row, field));
+    }
+
+    template <typename T> void set(std::size_t row, std::size_t field, T v) {
+        FieldLayout const &f = layout().field(field);
+        if(f.is_boxed()) {
+            log_error("Cannot store a primitive in the boxed field ", f.name);
+            return;
+        }
+        store_primitive(f.primitive, cell(row, field), v);
+    }
+
+    // Copy a row out of / into a packed struct value of the same type
+    void load(std::size_t row, StructValue &out) const {
+        if(!same_type(out))
+            return;
+
+        for(std::size_t i = 0; i < _columns.size(); ++i) {
+            FieldLayout const &f = layout().field(i);
+            std::memcpy(out.data() + f.offset, cell(row, i), f.size);
+        }
+    }
+
+    void store(std::size_t row, StructValue const &value) {
+        if(!same_type(value))
+            return;
+
+        for(std::size_t i = 0; i < _columns.size(); ++i) {
+            FieldLayout const &f = layout().field(i);
+            std::memcpy(cell(row, i), value.data() + f.offset, f.size);
+        }
+    }
+
+    void push_back(StructValue const &value) {
+        resize(_size + 1);
+        store(_size - 1, value);
+    }
+
+    void reserve(std::size_t n) {
+        if(n <= _capacity)
+            return;
+
+        for(std::size_t i = 0; i < _columns.size(); ++i) {
+            std::size_t width = layout().field(i).size;
+            Buffer column     = allocate(n * width);
+
+            if(_size > 0)
+                std::memcpy(column.get(), _columns[i].get(), _size * width);
+
+            _columns[i] = std::move(column);
+        }
+        _capacity = n;
+    }
+
+    // New rows are zero initialized
+    void resize(std::size_t n) {
+        if(n > _capacity)
+            reserve(n > 2 * _capacity ? n : 2 * _capacity);
+
+        for(std::size_t i = 0; n > _size && i < _columns.size(); ++i) {
+            std::size_t width = layout().field(i).size;
+            std::memset(_columns[i].get() + _size * width, 0, (n - _size) * width);
+        }
+        _size = n;
+    }
+
+  private:
+    bool same_type(StructValue const &value) const {
+        if(value.definition() != _type) {
+            log_error("Struct value does not have the type of the array");
+            return false;
+        }
+        return true;
+    }
+
+    struct AlignedDelete {
+        void operator()(u8 *ptr) const { ::operator delete[](ptr, std::align_val_t(alignment)); }
+    };
+
+    using Buffer = std::unique_ptr<u8[], AlignedDelete>;
+
+    static Buffer allocate(std::size_t bytes) {
+        return Buffer(static_cast<u8 *>(::operator new[](bytes, std::align_val_t(alignment))));
+    }
+
+    u8 *cell(std::size_t row, std::size_t field) const {
+        return _columns[field].get() + row * layout().field(field).size;
+    }
+
+    Struct *_type;
+    Array<Buffer> _columns;
+    std::size_t _size     = 0;
+    std::size_t _capacity = 0;
+};
+
+} // namespace kiwi
+
+#endif
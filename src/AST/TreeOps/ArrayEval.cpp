@@ -0,0 +1,283 @@
+#include "ArrayEval.h"
+
+#include "../../Logging/Log.h"
+
+namespace kiwi {
+
+struct ArrayEval::Operand {
+    PrimitiveTag tag  = PrimitiveTag::none;
+    void const *data  = nullptr;
+    ArrayValue *array = nullptr; // nullptr for a scalar
+    u64 scalar        = 0;
+    u64 converted     = 0;
+};
+
+ArrayValue *ArrayEval::make_array(PrimitiveTag tag, Array<u64> const &shape) {
+    ArrayValue *v = uninitialized(tag, shape);
+    std::memset(v->data(), 0, v->nbytes());
+    return v;
+}
+
+ArrayValue *ArrayEval::uninitialized(PrimitiveTag tag, Array<u64> const &shape) {
+    std::size_t n = 1;
+    for(u64 dim : shape)
+        n *= std::size_t(dim);
+    return make<ArrayValue>(tag, shape, allocate(n * get_primitive_size(tag)));
+}
+
+ArrayValue *ArrayEval::convert(ArrayValue *v, PrimitiveTag tag) {
+    ArrayValue *result = uninitialized(tag, v->shape());
+    array_convert_kernel(v->tag(), tag)(result->data(), v->data(), v->size());
+    return result;
+}
+
+Value *ArrayEval::scalar(PrimitiveTag tag, void const *src) {
+    switch(tag) {
+#define X(n)                                                                                       \
+    case PrimitiveTag::n:                                                                          \
+        return make<PrimitiveValue>(load_primitive<n>(tag, src));
+        KIWI_PRIMITIVE(X)
+#undef X
+    case PrimitiveTag::none:
+        return nullptr;
+    }
+    return nullptr;
+}
+
+bool ArrayEval::load(Value *v, Operand &x) const {
+    if(v == nullptr)
+        return false;
+
+    if(v->value_tag == ValueTag::vprimitive) {
+        PrimitiveValue *p = static_cast<PrimitiveValue *>(v);
+        x.tag             = p->tag();
+        p->store(x.tag, &x.scalar);
+        x.data = &x.scalar;
+        return x.tag != PrimitiveTag::none;
+    }
+
+    if(v->value_tag == ValueTag::varray) {
+        x.array = static_cast<ArrayValue *>(v);
+        x.tag   = x.array->tag();
+        x.data  = x.array->data();
+        return x.tag != PrimitiveTag::none;
+    }
+    return false;
+}
+
+void const *ArrayEval::cast(Operand &x, PrimitiveTag tag) {
+    if(x.tag == tag)
+        return x.data;
+
+    if(x.array != nullptr)
+        return convert(x.array, tag)->data();
+
+    array_convert_kernel(x.tag, tag)(&x.converted, x.data, 1);
+    return &x.converted;
+}
+
+Value *ArrayEval::function_call(FunctionCall *x) {
+    Symbol name = callee_name(x->fun);
+    auto result = ctx.find(name);
+
+    if(result == ctx.end()) {
+        Reduction op = get_reduction(name.str());
+        if(op != Reduction::none)
+            return reduce(op, x);
+    }
+
+    Expression *efun = result != ctx.end() ? result->second : nullptr;
+    if(efun == nullptr || efun->tag != NodeTag::function_def) {
+        log_error("Calling a non-function");
+        return nullptr;
+    }
+
+    Function *fun = static_cast<Function *>(efun);
+    if(fun->args_size() != x->args_size()) {
+        log_error("argument size mismatch:", fun->args_size(), " ", x->args_size());
+        return nullptr;
+    }
+
+    // arrays are passed by reference
+    Context fun_ctx = ctx;
+    for(u64 i = 0; i < fun->args_size(); ++i)
+        fun_ctx[std::get<0>(fun->arg(i))] = visit_expression(x->arg(i));
+
+    ArrayEval eval(fun_ctx, *this);
+    return eval.run(static_cast<Expression *>(fun->body));
+}
+
+Value *ArrayEval::reduce(Reduction op, FunctionCall *x) {
+    if(x->args_size() != 1) {
+        log_error(to_string(op), " expects one argument got ", x->args_size());
+        return nullptr;
+    }
+
+    // a scalar is an array of one element
+    Operand a;
+    if(!load(visit_expression(x->arg(0)), a)) {
+        log_error("Cannot reduce a non primitive value");
+        return nullptr;
+    }
+
+    std::size_t n = a.array != nullptr ? a.array->size() : 1;
+    u64 out       = 0;
+    reduce_kernel(op, a.tag)(&out, a.data, n);
+    return scalar(reduction_type(op, a.tag), &out);
+}
+
+Value *ArrayEval::binary_call(BinaryCall *x) {
+    Operand a, b;
+    if(!load(visit_expression(x->lhs), a) || !load(visit_expression(x->rhs), b)) {
+        log_error("Cannot apply ", to_string(x->op), " to a non primitive value");
+        return nullptr;
+    }
+
+    if(a.array == nullptr && b.array == nullptr) {
+        PrimitiveTag tag    = promote_primitive(a.tag, b.tag);
+        BinaryKernel kernel = binary_kernel(x->op, tag);
+        if(kernel == nullptr) {
+            log_error("Unknown binary operator ", callee_name(x->fun));
+            return nullptr;
+        }
+
+        u64 out = 0;
+        kernel(&out, cast(a, tag), cast(b, tag));
+        return scalar(tag, &out);
+    }
+
+    ArrayValue *array = a.array != nullptr ? a.array : b.array;
+    PrimitiveTag tag  = promote_primitive(a.tag, b.tag);
+    Broadcast repeat  = Broadcast::none;
+
+    if(a.array == nullptr) {
+        repeat = Broadcast::lhs;
+    } else if(b.array == nullptr) {
+        repeat = Broadcast::rhs;
+    } else {
+        if(a.array->shape() != b.array->shape()) {
+            log_error("Shape mismatch in ", to_string(x->op));
+            return nullptr;
+        }
+    }
+
+    ArrayBinaryKernel kernel = array_binary_kernel(x->op, tag);
+    if(kernel == nullptr) {
+        log_error("Unknown binary operator ", callee_name(x->fun));
+        return nullptr;
+    }
+
+    void const *lhs    = cast(a, tag);
+    void const *rhs    = cast(b, tag);
+    ArrayValue *result = uninitialized(tag, array->shape());
+    kernel(result->data(), lhs, rhs, result->size(), repeat);
+    return result;
+}
+
+Value *ArrayEval::unary_call(UnaryCall *x) {
+    Operand a;
+    if(!load(visit_expression(x->expr), a)) {
+        log_error("Cannot apply ", to_string(x->op), " to a non primitive value");
+        return nullptr;
+    }
+
+    // ln, exp and sqrt of integers are computed in f64
+    PrimitiveTag tag = a.tag;
+    if(unary_kernel(x->op, tag) == nullptr)
+        tag = PrimitiveTag::f64;
+
+    if(a.array == nullptr) {
+        UnaryKernel kernel = unary_kernel(x->op, tag);
+        if(kernel == nullptr) {
+            log_error("Unknown unary operator ", callee_name(x->fun));
+            return nullptr;
+        }
+
+        u64 out = 0;
+        kernel(&out, cast(a, tag));
+        return scalar(tag, &out);
+    }
+
+    ArrayUnaryKernel kernel = array_unary_kernel(x->op, tag);
+    if(kernel == nullptr) {
+        log_error("Unknown unary operator ", callee_name(x->fun));
+        return nullptr;
+    }
+
+    void const *src    = cast(a, tag);
+    ArrayValue *result = uninitialized(tag, a.array->shape());
+    kernel(result->data(), src, result->size());
+    return result;
+}
+
+Value *ArrayEval::match(Match *x) {
+    MatchPlan const *plan = x->plan.get();
+    // only a union value matches a variant, any other target takes the default branch
+    if(plan != nullptr && plan->strategy == MatchStrategy::union_tag) {
+        UnionValue *target = union_target(ctx, x->target);
+        if(target == nullptr) {
+            Value *value = visit_expression(x->target);
+            if(value != nullptr && value->value_tag == ValueTag::vunion)
+                target = static_cast<UnionValue *>(value);
+        }
+
+        u32 branch = target ? plan->select_variant(target->index) : MatchPlan::default_branch;
+        return visit_expression(MatchPlan::branch(x, branch));
+    }
+
+    Value *target = visit_expression(x->target);
+    if(target == nullptr || target->value_tag != ValueTag::vprimitive) {
+        log_error("Match target is not a scalar");
+        return nullptr;
+    }
+
+    double v = target->as<f64>();
+    if(plan != nullptr && plan->is_lookup())
+        return visit_expression(MatchPlan::branch(x, plan->select(v)));
+
+    for(auto &branch : x->branches) {
+        Value *pattern = visit_expression(std::get<0>(branch));
+        if(pattern != nullptr && pattern->value_tag == ValueTag::vprimitive &&
+           pattern->as<f64>() == v)
+            return visit_expression(std::get<1>(branch));
+    }
+    return visit_expression(x->default_branch);
+}
+
+// value of the last expression
+Value *ArrayEval::block(Block *x) {
+    Value *result = nullptr;
+    for(Statement *stmt : x->statements) {
+        if(stmt != nullptr && stmt->is_expr())
+            result = visit_expression(static_cast<Expression *>(stmt));
+    }
+    return result;
+}
+
+Value *ArrayEval::unhandled_expression(Expression *x) {
+    log_error("Cannot evaluate ", to_string(x->tag));
+    return nullptr;
+}
+
+Expression *ArrayEval::resolve(Symbol name) {
+    auto result = ctx.find(name);
+    if(result == ctx.end()) {
+        log_error("Undefined variable ", name);
+        return nullptr;
+    }
+    return result->second;
+}
+
+Value *ArrayEval::bound(Symbol name) {
+    if(depth >= max_depth) {
+        log_error("Recursive definition of ", name);
+        return nullptr;
+    }
+
+    depth += 1;
+    Value *result = visit_expression(resolve(name));
+    depth -= 1;
+    return result;
+}
+
+} // namespace kiwi
@@ -0,0 +1,106 @@
+#pragma once
+
+#include "../Arena.h"
+#include "../EvalRegion.h"
+#include "../Expression.h"
+#include "../Module.h"
+#include "../Value.h"
+#include "../Visitor.h"
+
+#include "MatchCompiler.h"
+#include "Operators.h"
+
+/*
+ *  Array evaluation
+ *
+ *  Evaluates to values instead of doubles: operators applied to an
+ *  ArrayValue run over every element in one call of an elementwise kernel
+ *  (array_binary_kernel), a whole buffer is processed by a single
+ *  evaluation of the expression.
+ *
+ *      def normalize(x) = (x - mean(x)) / sqrt(mean(x * x))
+ *
+ *  Rules
+ *      - array op array: same shape, the types are promoted (promote_primitive)
+ *      - array op scalar: the scalar is repeated, the types are promoted
+ *      - scalar op scalar: computed in the promoted type
+ *      - ln, exp and sqrt of integers are computed in f64
+ *      - sum, prod, min, max and mean are builtin functions reducing an array
+ *        to a scalar (see KIWI_REDUCTIONS), unless the name is bound in the context
+ *      - match targets and patterns are scalars
+ *
+ *  Results are allocated from the region of the thread when one is active
+ *  (EvalRegion::current) and from the evaluator otherwise, they are valid
+ *  while it lives. Errors are logged and evaluate to nullptr.
+ */
+namespace kiwi {
+
+class ArrayEval : public StaticExpressionVisitor<ArrayEval, Value *> {
+  public:
+    ArrayEval(Context const &ctx) : ctx(ctx), arena(&storage) {}
+
+    Value *run(Expression *expr) { return visit_expression(expr); }
+
+    // Zero initialized array, allocated like the results
+    ArrayValue *make_array(PrimitiveTag tag, Array<u64> const &shape);
+
+    Value *function_call(FunctionCall *x);
+    Value *binary_call(BinaryCall *x);
+    Value *unary_call(UnaryCall *x);
+    Value *match(Match *x);
+    Value *block(Block *x);
+    Value *value(Value *x) { return x; }
+    Value *placeholder(Placeholder *x) { return bound(x->name); }
+    Value *placeholder_ref(PlaceholderReference *x) { return bound(x->name); }
+    Value *unhandled_expression(Expression *x);
+    Value *nullptr_expression() { return nullptr; }
+
+  private:
+    struct Operand;
+
+    // Evaluator of a function body, sharing the allocations of its caller
+    ArrayEval(Context const &ctx, ArrayEval &caller) : ctx(ctx), arena(caller.arena) {}
+
+    template <typename T, typename... Args> T *make(Args &&... args) {
+        if(EvalRegion *region = EvalRegion::current())
+            return region->make<T>(std::forward<Args>(args)...);
+        return arena->make<T>(std::forward<Args>(args)...);
+    }
+
+    void *allocate(std::size_t size) {
+        if(EvalRegion *region = EvalRegion::current())
+            return region->allocate(size, ArrayValue::alignment);
+        return arena->allocate(size, ArrayValue::alignment);
+    }
+
+    // PrimitiveValue of the primitive `tag` stored at `src`
+    Value *scalar(PrimitiveTag tag, void const *src);
+
+    // Array whose elements are not initialized
+    ArrayValue *uninitialized(PrimitiveTag tag, Array<u64> const &shape);
+
+    // `v` with elements of type `tag`
+    ArrayValue *convert(ArrayValue *v, PrimitiveTag tag);
+
+    // false if `v` is neither a primitive nor an array
+    bool load(Value *v, Operand &x) const;
+
+    // elements of `x` as `tag`
+    void const *cast(Operand &x, PrimitiveTag tag);
+
+    Value *reduce(Reduction op, FunctionCall *x);
+
+    Expression *resolve(Symbol name);
+
+    // value of the expression bound to `name`, followed at most `max_depth` times
+    Value *bound(Symbol name);
+
+    static constexpr int max_depth = 64;
+
+    Context const &ctx;
+    Arena storage;
+    Arena *arena;
+    int depth = 0;
+};
+
+} // namespace kiwi
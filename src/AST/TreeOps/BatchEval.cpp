@@ -0,0 +1,350 @@
+#include "BatchEval.h"
+
+#include "../../Logging/Log.h"
+#include "../Value.h"
+#include "EvalExpression.h"
+
+#include <algorithm>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define KIWI_BATCH_AVX 1
+#else
+#define KIWI_BATCH_AVX 0
+#endif
+
+namespace kiwi {
+namespace {
+
+// Kernels are written once for doubles and AVX vectors,
+// `vector` is false when there is no vector instruction for the operator
+#if KIWI_BATCH_AVX
+#define KIWI_VECTOR_OP(expr)                                                                       \
+    static constexpr bool vector = true;                                                           \
+    __m256d operator()(__m256d a, __m256d b) const { return expr; }
+#define KIWI_VECTOR_UOP(expr)                                                                      \
+    static constexpr bool vector = true;                                                           \
+    __m256d operator()(__m256d a) const { return expr; }
+#else
+#define KIWI_VECTOR_OP(expr) static constexpr bool vector = false;
+#define KIWI_VECTOR_UOP(expr) static constexpr bool vector = false;
+#endif
+
+struct Add {
+    double operator()(double a, double b) const { return a + b; }
+    KIWI_VECTOR_OP(_mm256_add_pd(a, b))
+};
+
+struct Sub {
+    double operator()(double a, double b) const { return a - b; }
+    KIWI_VECTOR_OP(_mm256_sub_pd(a, b))
+};
+
+struct Mul {
+    double operator()(double a, double b) const { return a * b; }
+    KIWI_VECTOR_OP(_mm256_mul_pd(a, b))
+};
+
+struct Div {
+    double operator()(double a, double b) const { return a / b; }
+    KIWI_VECTOR_OP(_mm256_div_pd(a, b))
+};
+
+struct Neg {
+    double operator()(double a) const { return -a; }
+    KIWI_VECTOR_UOP(_mm256_sub_pd(_mm256_setzero_pd(), a))
+};
+
+struct Sqrt {
+    double operator()(double a) const { return std::sqrt(a); }
+    KIWI_VECTOR_UOP(_mm256_sqrt_pd(a))
+};
+
+// no vector instruction, left to the compiler
+template <UnaryOp op> struct Scalar {
+    static constexpr bool vector = false;
+    double operator()(double a) const { return apply_operator(op, a); }
+};
+
+#undef KIWI_VECTOR_OP
+#undef KIWI_VECTOR_UOP
+
+struct ColumnArg {
+    double const *data;
+
+    double operator[](std::size_t i) const { return data[i]; }
+#if KIWI_BATCH_AVX
+    __m256d load(std::size_t i) const { return _mm256_loadu_pd(data + i); }
+#endif
+};
+
+struct ScalarArg {
+    double value;
+
+    double operator[](std::size_t) const { return value; }
+#if KIWI_BATCH_AVX
+    __m256d load(std::size_t) const { return _mm256_set1_pd(value); }
+#endif
+};
+
+template <typename Op, typename A, typename B>
+void map(Op op, double *dst, A a, B b, std::size_t n) {
+    std::size_t i = 0;
+#if KIWI_BATCH_AVX
+    if constexpr(Op::vector) {
+        for(; i + 4 <= n; i += 4)
+            _mm256_storeu_pd(dst + i, op(a.load(i), b.load(i)));
+    }
+#endif
+    for(; i < n; ++i)
+        dst[i] = op(a[i], b[i]);
+}
+
+template <typename Op> void map(Op op, double *dst, double const *src, std::size_t n) {
+    std::size_t i = 0;
+#if KIWI_BATCH_AVX
+    if constexpr(Op::vector) {
+        for(; i + 4 <= n; i += 4)
+            _mm256_storeu_pd(dst + i, op(_mm256_loadu_pd(src + i)));
+    }
+#endif
+    for(; i < n; ++i)
+        dst[i] = op(src[i]);
+}
+
+template <typename A, typename B>
+void dispatch(BinaryOp op, double *dst, A a, B b, std::size_t n) {
+    switch(op) {
+    case BinaryOp::add:
+        return map(Add(), dst, a, b, n);
+    case BinaryOp::sub:
+        return map(Sub(), dst, a, b, n);
+    case BinaryOp::mul:
+        return map(Mul(), dst, a, b, n);
+    case BinaryOp::div:
+        return map(Div(), dst, a, b, n);
+    case BinaryOp::none:
+        std::fill(dst, dst + n, 0.0);
+        return;
+    }
+}
+
+} // namespace
+
+void batch_binary(BinaryOp op, double *dst, double const *lhs, double const *rhs, std::size_t n) {
+    dispatch(op, dst, ColumnArg{lhs}, ColumnArg{rhs}, n);
+}
+
+void batch_binary(BinaryOp op, double *dst, double const *lhs, double rhs, std::size_t n) {
+    dispatch(op, dst, ColumnArg{lhs}, ScalarArg{rhs}, n);
+}
+
+void batch_binary(BinaryOp op, double *dst, double lhs, double const *rhs, std::size_t n) {
+    dispatch(op, dst, ScalarArg{lhs}, ColumnArg{rhs}, n);
+}
+
+void batch_unary(UnaryOp op, double *dst, double const *src, std::size_t n) {
+    switch(op) {
+    case UnaryOp::neg:
+        return map(Neg(), dst, src, n);
+    case UnaryOp::sqrt:
+        return map(Sqrt(), dst, src, n);
+    case UnaryOp::ln:
+        return map(Scalar<UnaryOp::ln>(), dst, src, n);
+    case UnaryOp::exp:
+        return map(Scalar<UnaryOp::exp>(), dst, src, n);
+    case UnaryOp::ret:
+        if(dst != src)
+            std::copy(src, src + n, dst);
+        return;
+    case UnaryOp::none:
+        std::fill(dst, dst + n, 0.0);
+        return;
+    }
+}
+
+void BatchEval::run(Expression *expr, std::size_t n, double *out) {
+    for(start = 0; start < n; start += tile_size) {
+        rows = std::min(tile_size, n - start);
+        top  = 0;
+
+        BatchOperand result = visit_expression(expr);
+        if(result.is_scalar())
+            std::fill(out + start, out + start + rows, result.scalar);
+        else
+            std::copy(result.data, result.data + rows, out + start);
+    }
+}
+
+double *BatchEval::temporary() {
+    if(top == temporaries.size())
+        temporaries.emplace_back(tile_size);
+    return temporaries[top++].data();
+}
+
+BatchOperand BatchEval::binary_call(BinaryCall *x) {
+    if(x->op == BinaryOp::none) {
+        log_error("Unknown binary operator ", callee_name(x->fun));
+        return scalar(0);
+    }
+
+    std::size_t mark = top;
+    BatchOperand lhs = visit_expression(x->lhs);
+    BatchOperand rhs = visit_expression(x->rhs);
+
+    if(lhs.is_scalar() && rhs.is_scalar()) {
+        top = mark;
+        return scalar(binary_operator(x->op)(lhs.scalar, rhs.scalar));
+    }
+
+    // the result overwrites the first temporary of the operands
+    top         = mark;
+    double *dst = temporary();
+
+    if(lhs.is_scalar())
+        batch_binary(x->op, dst, lhs.scalar, rhs.data, rows);
+    else if(rhs.is_scalar())
+        batch_binary(x->op, dst, lhs.data, rhs.scalar, rows);
+    else
+        batch_binary(x->op, dst, lhs.data, rhs.data, rows);
+
+    return BatchOperand{dst};
+}
+
+BatchOperand BatchEval::unary_call(UnaryCall *x) {
+    if(x->op == UnaryOp::none) {
+        log_error("Unknown unary operator ", callee_name(x->fun));
+        return scalar(0);
+    }
+
+    std::size_t mark = top;
+    BatchOperand src = visit_expression(x->expr);
+    top              = mark;
+
+    if(src.is_scalar())
+        return scalar(unary_operator(x->op)(src.scalar));
+
+    double *dst = temporary();
+    batch_unary(x->op, dst, src.data, rows);
+    return BatchOperand{dst};
+}
+
+BatchOperand BatchEval::function_call(FunctionCall *x) {
+    // bind the columns to values once, then evaluate row by row
+    if(row_values.size() != columns.size()) {
+        row_ctx = ctx;
+        row_values.assign(columns.size(), PrimitiveValue(0.0));
+
+        std::size_t k = 0;
+        for(auto &column : columns)
+            row_ctx[column.first] = &row_values[k++];
+    }
+
+    double *dst = temporary();
+    for(std::size_t i = 0; i < rows; ++i) {
+        std::size_t k = 0;
+        for(auto &column : columns)
+            row_values[k++].set_value(column.second[start + i]);
+
+        dst[i] = full_eval(row_ctx, x);
+    }
+    return BatchOperand{dst};
+}
+
+BatchOperand BatchEval::match(Match *x) {
+    std::size_t mark    = top;
+    BatchOperand target = visit_expression(x->target);
+    std::size_t live    = top; // the target stays live until the branches are selected
+
+    // scalar target and patterns, pick the branch once for the whole tile
+    if(target.is_scalar()) {
+        bool scalar_patterns = true;
+
+        for(auto &branch : x->branches) {
+            BatchOperand pattern = visit_expression(std::get<0>(branch));
+            top                  = live;
+
+            if(!pattern.is_scalar()) {
+                scalar_patterns = false;
+                break;
+            }
+            if(pattern.scalar == target.scalar)
+                return visit_expression(std::get<1>(branch));
+        }
+
+        if(scalar_patterns)
+            return visit_expression(x->default_branch);
+    }
+
+    // select row by row, the first matching branch wins
+    top              = live;
+    std::size_t slot = top;
+    double *dst      = temporary();
+    std::size_t work = top;
+
+    BatchOperand def = visit_expression(x->default_branch);
+    for(std::size_t i = 0; i < rows; ++i)
+        dst[i] = def[i];
+
+    for(auto it = x->branches.rbegin(); it != x->branches.rend(); ++it) {
+        top                  = work;
+        BatchOperand pattern = visit_expression(std::get<0>(*it));
+        BatchOperand result  = visit_expression(std::get<1>(*it));
+
+        for(std::size_t i = 0; i < rows; ++i) {
+            if(target[i] == pattern[i])
+                dst[i] = result[i];
+        }
+    }
+
+    // the result takes the place of the first temporary of the target
+    std::swap(temporaries[mark], temporaries[slot]);
+    top = mark + 1;
+    return BatchOperand{temporaries[mark].data()};
+}
+
+// value of the last expression
+BatchOperand BatchEval::block(Block *x) {
+    std::size_t mark    = top;
+    BatchOperand result = scalar(0);
+
+    for(Statement *stmt : x->statements) {
+        if(stmt == nullptr || !stmt->is_expr())
+            continue;
+
+        top    = mark;
+        result = visit_expression(static_cast<Expression *>(stmt));
+    }
+    return result;
+}
+
+BatchOperand BatchEval::value(Value *x) { return scalar(x->template as<f64>()); }
+
+BatchOperand BatchEval::name(Symbol name) {
+    auto column = columns.find(name);
+    if(column != columns.end())
+        return BatchOperand{column->second + start};
+
+    auto result = ctx.find(name);
+    if(result == ctx.end() || result->second == nullptr) {
+        log_error("Undefined variable ", name);
+        return scalar(0);
+    }
+
+    if(depth >= max_depth) {
+        log_error("Recursive definition of ", name);
+        return scalar(0);
+    }
+
+    depth += 1;
+    BatchOperand operand = visit_expression(result->second);
+    depth -= 1;
+    return operand;
+}
+
+BatchOperand BatchEval::unhandled_expression(Expression *x) {
+    log_error("Cannot evaluate ", to_string(x->tag));
+    return scalar(0);
+}
+
+} // namespace kiwi
@@ -0,0 +1,104 @@
+#pragma once
+
+#include "../Expression.h"
+#include "../Module.h"
+#include "../Value.h"
+#include "../Visitor.h"
+
+#include "Operators.h"
+
+/*
+ *  Batch evaluation
+ *
+ *  Evaluate one expression over many rows: free placeholders are bound to
+ *  columns instead of values. The tree is walked once per tile of rows and
+ *  every node runs a tight loop over the tile, so the interpretation cost is
+ *  paid per tile instead of per row.
+ *
+ *  Function calls cannot be vectorized (they might recurse), they fall back
+ *  to FullEval row by row: one full_eval per row and per call, in a copy of
+ *  the context made once per evaluator where the columns are bound to
+ *  values. Expressions dominated by calls gain nothing from batching.
+ */
+namespace kiwi {
+
+using Columns = Dict<Symbol, double const *>;
+
+// Elementwise kernels, `dst` can alias an input
+void batch_binary(BinaryOp op, double *dst, double const *lhs, double const *rhs, std::size_t n);
+void batch_binary(BinaryOp op, double *dst, double const *lhs, double rhs, std::size_t n);
+void batch_binary(BinaryOp op, double *dst, double lhs, double const *rhs, std::size_t n);
+void batch_unary(UnaryOp op, double *dst, double const *src, std::size_t n);
+
+// Operand of a batched node: a column or a scalar shared by every row
+struct BatchOperand {
+    double const *data = nullptr;
+    double scalar      = 0;
+
+    bool is_scalar() const { return data == nullptr; }
+
+    double operator[](std::size_t i) const { return data == nullptr ? scalar : data[i]; }
+};
+
+class BatchEval : public StaticExpressionVisitor<BatchEval, BatchOperand> {
+  public:
+    static constexpr std::size_t tile_size = 1024;
+
+    BatchEval(Context const &ctx, Columns const &columns) : ctx(ctx), columns(columns) {}
+
+    // Evaluate `expr` for the rows [0, n) of the columns, write the result in `out`
+    void run(Expression *expr, std::size_t n, double *out);
+
+    Array<double> run(Expression *expr, std::size_t n) {
+        Array<double> out(n);
+        run(expr, n, out.data());
+        return out;
+    }
+
+    BatchOperand binary_call(BinaryCall *x);
+    BatchOperand unary_call(UnaryCall *x);
+    BatchOperand function_call(FunctionCall *x);
+    BatchOperand match(Match *x);
+    BatchOperand block(Block *x);
+    BatchOperand value(Value *x);
+    BatchOperand placeholder(Placeholder *x) { return name(x->name); }
+    BatchOperand placeholder_ref(PlaceholderReference *x) { return name(x->name); }
+    BatchOperand unhandled_expression(Expression *x);
+    BatchOperand nullptr_expression() { return scalar(0); }
+
+  private:
+    static BatchOperand scalar(double v) {
+        BatchOperand op;
+        op.scalar = v;
+        return op;
+    }
+
+    // bound expressions are evaluated in place, at most `max_depth` names deep
+    BatchOperand name(Symbol name);
+
+    // Scratch column for the current tile, released in stack order
+    double *temporary();
+
+    Context const &ctx;
+    Columns const &columns;
+
+    std::size_t start = 0; // first row of the tile
+    std::size_t rows  = 0; // rows in the tile
+
+    Array<Array<double>> temporaries;
+    std::size_t top = 0;
+
+    // context of the calls evaluated row by row, bound to `row_values`
+    Context row_ctx;
+    Array<PrimitiveValue> row_values;
+
+    static constexpr int max_depth = 64;
+    int depth = 0;
+};
+
+inline Array<double> batch_eval(Context const &ctx, Columns const &columns, Expression *expr,
+                                std::size_t n) {
+    return BatchEval(ctx, columns).run(expr, n);
+}
+
+} // namespace kiwi
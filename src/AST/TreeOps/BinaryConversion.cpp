@@ -0,0 +1,895 @@
+#include "BinaryConversion.h"
+
+#include <algorithm>
+#include <fstream>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace kiwi {
+
+namespace {
+
+class BinaryWriter {
+  public:
+    BinaryWriter() {
+        _buffer.resize(sizeof(BinaryHeader), 0);
+        // string 0 is the empty string used by nameless nodes
+        string("");
+    }
+
+    Array<u8> finish(Module const &module) {
+        Array<BinaryEntry> entries;
+        for(auto &item : module)
+            entries.push_back(BinaryEntry{string(item.first), definition(item.second)});
+
+        if(failed)
+            return Array<u8>();
+
+        auto by_name = [this](BinaryEntry const &a, BinaryEntry const &b) {
+            return _strings[a.name] < _strings[b.name];
+        };
+        std::sort(entries.begin(), entries.end(), by_name);
+
+        // string table
+        BinaryHeader header;
+        std::memcpy(header.magic, "KIWI", 4);
+        header.version      = binary_version;
+        header.string_count = u32(_strings.size());
+        header.strings      = u32(_buffer.size());
+
+        u32 chars = u32(_buffer.size() + _strings.size() * sizeof(BinaryString));
+        for(String const &str : _strings) {
+            append(BinaryString{chars, u32(str.size())});
+            chars += u32(str.size() + 1);
+        }
+        for(String const &str : _strings)
+            _buffer.insert(_buffer.end(), str.c_str(), str.c_str() + str.size() + 1);
+        align();
+
+        // module table
+        header.entry_count = u32(entries.size());
+        header.entries     = u32(_buffer.size());
+        for(BinaryEntry const &entry : entries)
+            append(entry);
+        align();
+
+        header.size = _buffer.size();
+        std::memcpy(_buffer.data(), &header, sizeof(BinaryHeader));
+        return std::move(_buffer);
+    }
+
+    // Module level nodes
+    u32 definition(Definition *def) {
+        if(def == nullptr)
+            return 0;
+
+        auto seen = _nodes.find(def);
+        if(seen != _nodes.end())
+            return seen->second;
+
+        u32 offset = 0;
+        switch(def->tag) {
+        case NodeTag::function_def: {
+            auto fun = static_cast<FunctionDefinition *>(def);
+            offset   = callable(def, 1, fun->args, fun->body);
+            break;
+        }
+        case NodeTag::macro_def: {
+            auto fun = static_cast<MacroDefinition *>(def);
+            offset   = callable(def, 1, fun->args, fun->body);
+            break;
+        }
+        case NodeTag::struct_def: {
+            auto rec = static_cast<StructDefinition *>(def);
+            offset   = record(def->tag, 1, symbol(def->name), rec->meta_types, rec->attributes);
+            break;
+        }
+        case NodeTag::union_def: {
+            auto rec = static_cast<UnionDefinition *>(def);
+            offset   = record(def->tag, 1, symbol(def->name), rec->meta_types, rec->attributes);
+            break;
+        }
+        default:
+            return error("Cannot serialize definition ", to_string(def->tag));
+        }
+
+        _nodes[def] = offset;
+        return offset;
+    }
+
+    u32 write(Statement *stmt) {
+        if(stmt == nullptr)
+            return 0;
+
+        auto seen = _nodes.find(stmt);
+        if(seen != _nodes.end())
+            return seen->second;
+
+        u32 offset = 0;
+        switch(stmt->tag) {
+        case NodeTag::unary_call: {
+            auto call = static_cast<UnaryCall *>(stmt);
+            offset    = node(stmt->tag, call->right, 0, 0,
+                          {write(call->fun), write(call->expr), write(call->type)});
+            break;
+        }
+        case NodeTag::binary_call: {
+            auto call = static_cast<BinaryCall *>(stmt);
+            offset    = node(stmt->tag, 0, 0, 0,
+                          {write(call->fun), write(call->lhs), write(call->rhs),
+                           write(call->type)});
+            break;
+        }
+        case NodeTag::function_call: {
+            auto call         = static_cast<FunctionCall *>(stmt);
+            Array<u32> childs = {write(call->fun), write(call->type)};
+            for(Expression *arg : call->args)
+                childs.push_back(write(arg));
+            offset = node(stmt->tag, 0, 0, 0, childs);
+            break;
+        }
+        case NodeTag::match: {
+            auto match        = static_cast<Match *>(stmt);
+            Array<u32> childs = {write(match->target), write(match->default_branch)};
+            for(auto &branch : match->branches) {
+                childs.push_back(write(std::get<0>(branch)));
+                childs.push_back(write(std::get<1>(branch)));
+            }
+            offset = node(stmt->tag, 0, 0, 0, childs);
+            break;
+        }
+        case NodeTag::block: {
+            auto block        = static_cast<Block *>(stmt);
+            Array<u32> childs = {write(block->type)};
+            for(Statement *item : block->statements)
+                childs.push_back(write(item));
+            offset = node(stmt->tag, 0, 0, 0, childs);
+            break;
+        }
+        case NodeTag::placeholder: {
+            auto p = static_cast<Placeholder *>(stmt);
+            offset = node(stmt->tag, 0, symbol(p->name), 0, {write(p->type)});
+            break;
+        }
+        case NodeTag::placeholder_ref: {
+            auto ref  = static_cast<PlaceholderReference *>(stmt);
+            u64 extra = u64(u32(ref->index)) | (u64(u32(ref->depth)) << 32);
+            offset    = node(stmt->tag, 0, symbol(ref->name), extra, {write(ref->type)});
+            break;
+        }
+        case NodeTag::value: {
+            offset = value(static_cast<Value *>(stmt));
+            break;
+        }
+        case NodeTag::builtin_type: {
+            offset = node(stmt->tag, 0, symbol(static_cast<BuiltinType *>(stmt)->name), 0, {});
+            break;
+        }
+        case NodeTag::unknown_type: {
+            auto type = static_cast<UnknownType *>(stmt);
+            offset    = node(stmt->tag, 0, 0, 0, {write(type->resolved_type)});
+            break;
+        }
+        case NodeTag::function_type: {
+            auto type         = static_cast<FunctionType *>(stmt);
+            Array<u32> childs = {write(type->return_type)};
+            for(Type *arg : type->args)
+                childs.push_back(write(arg));
+            offset = node(stmt->tag, 0, 0, 0, childs);
+            break;
+        }
+        case NodeTag::struct_type: {
+            auto type         = static_cast<StructType *>(stmt);
+            Array<u32> childs = {definition(type->definition)};
+            add_fields(childs, type->meta_types);
+            offset = node(stmt->tag, 0, 0, 0, childs);
+            break;
+        }
+        case NodeTag::union_type: {
+            auto type         = static_cast<UnionType *>(stmt);
+            Array<u32> childs = {definition(type->definition)};
+            add_fields(childs, type->meta_types);
+            offset = node(stmt->tag, 0, 0, 0, childs);
+            break;
+        }
+        // the parser only produces ErrorNode with this tag
+        case NodeTag::error_type: {
+            auto error = static_cast<ErrorNode *>(stmt);
+            offset     = node(stmt->tag, 0, string(error->message), string(error->code),
+                          {write(error->partial)});
+            break;
+        }
+        case NodeTag::function_def: {
+            auto fun          = static_cast<Function *>(stmt);
+            Array<u32> childs = {write(fun->return_type), write(fun->body)};
+            add_fields(childs, fun->args);
+            offset = node(stmt->tag, 0, 0, 0, childs);
+            break;
+        }
+        case NodeTag::struct_def: {
+            auto rec = static_cast<Struct *>(stmt);
+            offset   = record(stmt->tag, 0, 0, rec->meta_types, rec->attributes);
+            break;
+        }
+        case NodeTag::union_def: {
+            auto rec = static_cast<Union *>(stmt);
+            offset   = record(stmt->tag, 0, 0, rec->meta_types, rec->attributes);
+            break;
+        }
+        default:
+            return error("Cannot serialize ", to_string(stmt->tag));
+        }
+
+        _nodes[stmt] = offset;
+        return offset;
+    }
+
+  private:
+    // offset 0 would silently turn the node into a nullptr, the module is dropped instead
+    template <typename... Args> u32 error(Args const &... args) {
+        log_error(args...);
+        failed = true;
+        return 0;
+    }
+
+    u32 callable(Definition *def, u8 aux, Array<Symbol> const &args, Expression *body) {
+        Array<u32> childs = {write(def->type), write(body)};
+        for(Symbol arg : args)
+            childs.push_back(node(binary_field_tag, 0, symbol(arg), 0, {}));
+        return node(def->tag, aux, symbol(def->name), 0, childs);
+    }
+
+    u32 record(NodeTag tag, u8 aux, u32 name, Array<Tuple<Symbol, Statement *>> const &meta,
+               Array<Tuple<Symbol, Statement *>> const &attr) {
+        Array<u32> childs;
+        add_fields(childs, meta);
+        add_fields(childs, attr);
+        return node(tag, aux, name, meta.size(), childs);
+    }
+
+    void add_fields(Array<u32> &childs, Array<Tuple<Symbol, Statement *>> const &fields) {
+        for(auto &field : fields) {
+            u32 stmt = write(std::get<1>(field));
+            childs.push_back(node(binary_field_tag, 0, symbol(std::get<0>(field)), 0, {stmt}));
+        }
+    }
+
+    u32 value(Value *val) {
+        switch(val->value_tag) {
+        case ValueTag::vprimitive: {
+            auto prim = static_cast<PrimitiveValue *>(val);
+            u64 bits  = 0;
+            prim->store(prim->tag(), &bits);
+            return primitive(prim->tag(), bits);
+        }
+        case ValueTag::vstruct: {
+            auto rec          = static_cast<StructValue *>(val);
+            Array<u32> childs = {write(rec->definition())};
+
+            for(std::size_t i = 0; i < rec->size(); ++i) {
+                FieldLayout const &field = rec->layout().field(i);
+                if(field.is_boxed())
+                    childs.push_back(write(rec->get_boxed(i)));
+                else
+                    childs.push_back(primitive(field, rec->data()));
+            }
+            return node(NodeTag::value, u8(val->value_tag), 0, 0, childs);
+        }
+        case ValueTag::vunion: {
+            auto rec          = static_cast<UnionValue *>(val);
+            Array<u32> childs = {write(rec->definition()), 0};
+
+            if(rec->index >= 0) {
+                FieldLayout const &field = rec->layout().field(std::size_t(rec->index));
+                if(field.is_boxed())
+                    childs[1] = write(rec->get_boxed());
+                else
+                    childs[1] = primitive(field, rec->data());
+            }
+            return node(NodeTag::value, u8(val->value_tag), 0, u32(rec->index), childs);
+        }
+        case ValueTag::vfunction:
+            return error("Cannot serialize function values");
+        case ValueTag::varray:
+            return error("Cannot serialize array values");
+        }
+        return error("Cannot serialize value ", int(val->value_tag));
+    }
+
+    u32 primitive(FieldLayout const &field, u8 const *data) {
+        u64 bits = 0;
+        std::memcpy(&bits, data + field.offset, field.size);
+        return primitive(field.primitive, bits);
+    }
+
+    u32 primitive(PrimitiveTag tag, u64 bits) {
+        return node(NodeTag::value, u8(ValueTag::vprimitive), u32(tag), bits, {});
+    }
+
+    u32 node(NodeTag tag, u8 aux, u32 symbol, u64 extra, Array<u32> const &childs) {
+        u32 offset = u32(_buffer.size());
+
+        BinaryNode n;
+        n.tag         = tag;
+        n.aux         = aux;
+        n.reserved    = 0;
+        n.child_count = u32(childs.size());
+        n.symbol      = symbol;
+        n.padding     = 0;
+        n.extra       = extra;
+        append(n);
+
+        for(u32 child : childs) {
+            i32 rel = child == 0 ? 0 : i32(child) - i32(offset);
+            append(rel);
+        }
+        align();
+        return offset;
+    }
+
+    u32 symbol(Symbol sym) { return string(sym.str()); }
+
+    u32 string(StringView str) {
+        String key(str);
+        auto result = _string_index.find(key);
+        if(result != _string_index.end())
+            return result->second;
+
+        u32 index = u32(_strings.size());
+        _strings.push_back(key);
+        _string_index.emplace(key, index);
+        return index;
+    }
+
+    template <typename T> void append(T const &v) {
+        u8 const *bytes = reinterpret_cast<u8 const *>(&v);
+        _buffer.insert(_buffer.end(), bytes, bytes + sizeof(T));
+    }
+
+    void align() { _buffer.resize((_buffer.size() + 7) & ~std::size_t(7), 0); }
+
+    Array<u8> _buffer;
+    Array<String> _strings;
+    Dict<String, u32> _string_index;
+    Dict<Statement *, u32> _nodes;
+    bool failed = false;
+};
+
+} // namespace
+
+Array<u8> write_binary(Module const &module) { return BinaryWriter().finish(module); }
+
+bool write_binary(Module const &module, String const &path) {
+    Array<u8> data = write_binary(module);
+    if(data.empty())
+        return false;
+
+    std::ofstream out(path, std::ios::binary);
+    out.write(reinterpret_cast<char const *>(data.data()), std::streamsize(data.size()));
+    return bool(out);
+}
+
+// ----------------------------------------------------------------------------
+
+#ifndef _WIN32
+MappedFile::MappedFile(String const &path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if(fd < 0) {
+        log_error("Could not open ", path);
+        return;
+    }
+
+    struct stat st;
+    if(::fstat(fd, &st) == 0) {
+        // a mapping cannot be empty, an empty file is open without data
+        if(st.st_size == 0) {
+            _open = true;
+        } else {
+            void *ptr = ::mmap(nullptr, std::size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            if(ptr != MAP_FAILED) {
+                _data = static_cast<u8 const *>(ptr);
+                _size = std::size_t(st.st_size);
+                _open = true;
+            }
+        }
+    }
+    ::close(fd);
+}
+
+MappedFile::~MappedFile() {
+    if(_data != nullptr && _fallback.empty())
+        ::munmap(const_cast<u8 *>(_data), _size);
+}
+
+void MappedFile::advise(Access access) const {
+    if(_data == nullptr || !_fallback.empty())
+        return;
+
+    int advice = MADV_NORMAL;
+    if(access == Access::sequential)
+        advice = MADV_SEQUENTIAL;
+    else if(access == Access::random)
+        advice = MADV_RANDOM;
+    ::madvise(const_cast<u8 *>(_data), _size, advice);
+}
+
+void MappedFile::prefetch(std::size_t offset, std::size_t size) const {
+    if(_data == nullptr || !_fallback.empty() || offset >= _size)
+        return;
+
+    // madvise works on whole pages, round the start down
+    std::size_t page  = std::size_t(::sysconf(_SC_PAGESIZE));
+    std::size_t begin = offset / page * page;
+    std::size_t end   = std::min(offset + size, _size);
+    ::madvise(const_cast<u8 *>(_data) + begin, end - begin, MADV_WILLNEED);
+}
+
+void MappedFile::release(std::size_t offset, std::size_t size) const {
+    if(_data == nullptr || !_fallback.empty() || offset >= _size)
+        return;
+
+    // only the pages fully inside the range, the neighbours might still be used
+    std::size_t page  = std::size_t(::sysconf(_SC_PAGESIZE));
+    std::size_t begin = (offset + page - 1) / page * page;
+    std::size_t end   = std::min(offset + size, _size);
+    if(end != _size)
+        end = end / page * page;
+
+    if(begin < end)
+        ::madvise(const_cast<u8 *>(_data) + begin, end - begin, MADV_DONTNEED);
+}
+#else
+MappedFile::MappedFile(String const &path) {
+    std::ifstream in(path, std::ios::binary);
+    _open = in.is_open();
+    _fallback.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    if(!_fallback.empty()) {
+        _data = _fallback.data();
+        _size = _fallback.size();
+    }
+}
+
+MappedFile::~MappedFile() {}
+
+void MappedFile::advise(Access) const {}
+
+void MappedFile::prefetch(std::size_t, std::size_t) const {}
+
+void MappedFile::release(std::size_t, std::size_t) const {}
+#endif
+
+// ----------------------------------------------------------------------------
+
+BinaryModule::BinaryModule(u8 const *data, std::size_t size) : _data(data), _size(size) {
+    if(data == nullptr || size < sizeof(BinaryHeader)) {
+        log_error("Binary module is too small");
+        return;
+    }
+
+    BinaryHeader const &h = header();
+    if(std::memcmp(h.magic, "KIWI", 4) != 0 || h.version != binary_version) {
+        log_error("Unsupported binary module (version ", h.version, ")");
+        return;
+    }
+
+    if(h.size != size || u64(h.strings) + u64(h.string_count) * sizeof(BinaryString) > size ||
+       u64(h.entries) + u64(h.entry_count) * sizeof(BinaryEntry) > size) {
+        log_error("Binary module is truncated");
+        return;
+    }
+
+    Array<u32> offsets;
+    if(!check_strings() || !check_nodes(offsets) || !check_entries(offsets))
+        return;
+
+    _symbols.resize(h.string_count);
+    _interned.resize(h.string_count, false);
+    _valid = true;
+}
+
+bool BinaryModule::check_strings() const {
+    BinaryHeader const &h = header();
+    auto strings          = reinterpret_cast<BinaryString const *>(_data + h.strings);
+
+    if(h.strings % alignof(BinaryString) != 0) {
+        log_error("Binary module string table is misaligned");
+        return false;
+    }
+
+    for(u32 i = 0; i < h.string_count; ++i) {
+        if(u64(strings[i].offset) + u64(strings[i].size) + 1 > _size) {
+            log_error("Binary module string ", i, " is out of bounds");
+            return false;
+        }
+    }
+    return true;
+}
+
+// nodes are laid out back to back between the header and the string table
+bool BinaryModule::check_nodes(Array<u32> &offsets) const {
+    u64 end    = header().strings;
+    u64 offset = sizeof(BinaryHeader);
+
+    while(offset < end) {
+        if(offset + sizeof(BinaryNode) > end) {
+            log_error("Binary node at ", offset, " is truncated");
+            return false;
+        }
+
+        BinaryNode const &n = *node(u32(offset));
+        u64 next            = offset + sizeof(BinaryNode) + u64(n.child_count) * sizeof(i32);
+        if(next > end) {
+            log_error("Binary node at ", offset, " has too many children");
+            return false;
+        }
+
+        // post-order: a child is a node that was already checked
+        for(u32 i = 0; i < n.child_count; ++i) {
+            i32 rel;
+            std::memcpy(&rel, _data + offset + sizeof(BinaryNode) + i * sizeof(i32), sizeof(i32));
+            if(rel == 0)
+                continue;
+
+            i64 child = i64(offset) + rel;
+            if(rel > 0 || !std::binary_search(offsets.begin(), offsets.end(), u32(child))) {
+                log_error("Binary node at ", offset, " has an invalid child ", i);
+                return false;
+            }
+        }
+
+        if(!check_node(n)) {
+            log_error("Binary node at ", offset, " is malformed");
+            return false;
+        }
+
+        offsets.push_back(u32(offset));
+        offset = (next + 7) & ~u64(7);
+    }
+    return true;
+}
+
+bool BinaryModule::check_node(BinaryNode const &n) const {
+    u32 strings = header().string_count;
+    u32 count   = n.child_count;
+
+    // children from `first` on are fields
+    auto fields = [&](u32 first) {
+        for(u32 i = first; i < count; ++i) {
+            BinaryNode const *field = n.child(i);
+            if(field == nullptr || field->tag != binary_field_tag)
+                return false;
+        }
+        return true;
+    };
+
+    if(n.tag == binary_field_tag)
+        return n.symbol < strings && count <= 1;
+
+    switch(n.tag) {
+    case NodeTag::unary_call:
+        return count == 3;
+    case NodeTag::binary_call:
+        return count == 4;
+    case NodeTag::function_call:
+    case NodeTag::match:
+        return count >= 2;
+    case NodeTag::block:
+        return count >= 1;
+    case NodeTag::placeholder:
+    case NodeTag::placeholder_ref:
+        return n.symbol < strings && count == 1;
+    case NodeTag::builtin_type:
+        return n.symbol < strings && count == 0;
+    case NodeTag::unknown_type:
+        return count == 1;
+    case NodeTag::function_type:
+        return count >= 1;
+    case NodeTag::struct_type:
+    case NodeTag::union_type:
+        return count >= 1 && fields(1);
+    case NodeTag::error_type:
+        return n.symbol < strings && n.extra < strings && count == 1;
+    case NodeTag::function_def:
+    case NodeTag::macro_def:
+        return n.symbol < strings && count >= 2 && fields(2);
+    case NodeTag::struct_def:
+    case NodeTag::union_def:
+        return n.symbol < strings && n.extra <= count && fields(0);
+    case NodeTag::value:
+        switch(ValueTag(n.aux)) {
+        case ValueTag::vprimitive:
+            return count == 0;
+        case ValueTag::vstruct:
+            return count >= 1 && n.child(0) != nullptr;
+        case ValueTag::vunion:
+            return count == 2 && n.child(0) != nullptr;
+        default:
+            return false;
+        }
+    default:
+        return false;
+    }
+}
+
+bool BinaryModule::check_entries(Array<u32> const &offsets) const {
+    BinaryHeader const &h = header();
+    if(h.entries % alignof(BinaryEntry) != 0) {
+        log_error("Binary module table is misaligned");
+        return false;
+    }
+
+    for(u32 i = 0; i < h.entry_count; ++i) {
+        BinaryEntry const &e = entry(i);
+        if(e.name >= h.string_count ||
+           !std::binary_search(offsets.begin(), offsets.end(), e.node)) {
+            log_error("Binary module entry ", i, " is invalid");
+            return false;
+        }
+    }
+    return true;
+}
+
+StringView BinaryModule::string(u32 index) const {
+    auto strings            = reinterpret_cast<BinaryString const *>(_data + header().strings);
+    BinaryString const &str = strings[index];
+    return StringView(reinterpret_cast<char const *>(_data + str.offset), str.size);
+}
+
+Symbol BinaryModule::symbol(u32 index) const {
+    if(!_interned[index]) {
+        _symbols[index]  = Symbol(string(index));
+        _interned[index] = true;
+    }
+    return _symbols[index];
+}
+
+BinaryNode const *BinaryModule::find(StringView name) const {
+    std::size_t lo = 0;
+    std::size_t hi = size();
+
+    while(lo < hi) {
+        std::size_t mid = (lo + hi) / 2;
+        int cmp         = this->name(mid).compare(name);
+
+        if(cmp == 0)
+            return definition(mid);
+        if(cmp < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return nullptr;
+}
+
+// ----------------------------------------------------------------------------
+
+Definition *BinaryLoader::definition(StringView name) {
+    BinaryNode const *node = module.find(name);
+    if(node == nullptr)
+        return nullptr;
+    return static_cast<Definition *>(load(node));
+}
+
+Module BinaryLoader::load_all() {
+    Module result;
+    for(std::size_t i = 0; i < module.size(); ++i)
+        result[String(module.name(i))] = static_cast<Definition *>(load(module.definition(i)));
+    return result;
+}
+
+Array<Tuple<Symbol, Statement *>> BinaryLoader::fields(BinaryNode const *node, u32 start,
+                                                       u32 end) {
+    Array<Tuple<Symbol, Statement *>> result;
+    for(u32 i = start; i < end; ++i) {
+        BinaryNode const *field = node->child(i);
+        Statement *stmt         = field->child_count > 0 ? load(field->child(0)) : nullptr;
+        result.emplace_back(module.symbol(field->symbol), stmt);
+    }
+    return result;
+}
+
+Value *BinaryLoader::load_value(BinaryNode const *node) {
+    switch(ValueTag(node->aux)) {
+    case ValueTag::vprimitive: {
+        PrimitiveTag tag = PrimitiveTag(node->symbol);
+        // clang-format off
+        switch(tag) {
+        #define X(n)                                                                               \
+        case PrimitiveTag::n:                                                                      \
+            return builder.make_value(load_primitive<n>(tag, &node->extra));
+        KIWI_PRIMITIVE(X)
+        #undef X
+        case PrimitiveTag::none:
+            return nullptr;
+        }
+        // clang-format on
+        return nullptr;
+    }
+    case ValueTag::vstruct: {
+        StructValue *val = builder.make<StructValue>();
+        val->set_type(static_cast<Struct *>(load(node->child(0))));
+
+        for(u32 i = 1; i < node->child_count; ++i)
+            val->set_value(i - 1, static_cast<Value *>(load(node->child(i))));
+        return val;
+    }
+    case ValueTag::vunion: {
+        UnionValue *val = builder.make<UnionValue>();
+        val->set_type(static_cast<Union *>(load(node->child(0))));
+        val->set_value(int32(node->extra), static_cast<Value *>(load(node->child(1))));
+        return val;
+    }
+    case ValueTag::vfunction:
+    case ValueTag::varray:
+        return nullptr;
+    }
+    return nullptr;
+}
+
+Statement *BinaryLoader::load(BinaryNode const *node) {
+    if(node == nullptr)
+        return nullptr;
+
+    auto seen = nodes.find(node);
+    if(seen != nodes.end())
+        return seen->second;
+
+    // values store their primitive tag in `symbol`
+    Statement *result = nullptr;
+    Symbol name       = node->tag == NodeTag::value ? Symbol() : module.symbol(node->symbol);
+    u32 n             = node->child_count;
+
+    switch(node->tag) {
+    case NodeTag::unary_call: {
+        UnaryCall *call = builder.make<UnaryCall>(expr(node->child(0)), expr(node->child(1)));
+        call->right     = node->aux != 0;
+        call->type      = expr(node->child(2));
+        result          = call;
+        break;
+    }
+    case NodeTag::binary_call: {
+        BinaryCall *call = builder.make<BinaryCall>(expr(node->child(0)), expr(node->child(1)),
+                                                    expr(node->child(2)));
+        call->type       = expr(node->child(3));
+        result           = call;
+        break;
+    }
+    case NodeTag::function_call: {
+        Array<Expression *> args;
+        for(u32 i = 2; i < n; ++i)
+            args.push_back(expr(node->child(i)));
+
+        FunctionCall *call = builder.make<FunctionCall>(expr(node->child(0)), args);
+        call->type         = expr(node->child(1));
+        result             = call;
+        break;
+    }
+    case NodeTag::match: {
+        Match *match          = builder.make<Match>();
+        match->target         = expr(node->child(0));
+        match->default_branch = expr(node->child(1));
+        for(u32 i = 2; i + 1 < n; i += 2)
+            match->branches.emplace_back(expr(node->child(i)), expr(node->child(i + 1)));
+        result = match;
+        break;
+    }
+    case NodeTag::block: {
+        Block *block = builder.make_block();
+        block->type  = expr(node->child(0));
+        for(u32 i = 1; i < n; ++i)
+            block->statements.push_back(load(node->child(i)));
+        result = block;
+        break;
+    }
+    case NodeTag::placeholder: {
+        Placeholder *p = builder.make<Placeholder>(name);
+        p->type        = expr(node->child(0));
+        result         = p;
+        break;
+    }
+    case NodeTag::placeholder_ref: {
+        int32 index = int32(u32(node->extra));
+        int32 depth = int32(u32(node->extra >> 32));
+
+        PlaceholderReference *ref = builder.make<PlaceholderReference>(name, index, depth);
+        ref->type                 = expr(node->child(0));
+        result                    = ref;
+        break;
+    }
+    case NodeTag::value: {
+        result = load_value(node);
+        break;
+    }
+    case NodeTag::builtin_type: {
+        result = builder.make_builtin(name);
+        break;
+    }
+    case NodeTag::unknown_type: {
+        UnknownType *type   = builder.make<UnknownType>();
+        type->resolved_type = static_cast<Type *>(load(node->child(0)));
+        result              = type;
+        break;
+    }
+    case NodeTag::function_type: {
+        Array<Type *> args;
+        for(u32 i = 1; i < n; ++i)
+            args.push_back(static_cast<Type *>(load(node->child(i))));
+        result = builder.make<FunctionType>(args, static_cast<Type *>(load(node->child(0))));
+        break;
+    }
+    case NodeTag::struct_type: {
+        StructType *type = builder.make<StructType>(
+            static_cast<StructDefinition *>(load(node->child(0))));
+        type->meta_types = fields(node, 1, n);
+        result           = type;
+        break;
+    }
+    case NodeTag::union_type: {
+        UnionType *type  = builder.make<UnionType>(
+            static_cast<UnionDefinition *>(load(node->child(0))));
+        type->meta_types = fields(node, 1, n);
+        result           = type;
+        break;
+    }
+    case NodeTag::error_type: {
+        result = builder.make<ErrorNode>(String(module.string(node->symbol)),
+                                         String(module.string(u32(node->extra))),
+                                         expr(node->child(0)));
+        break;
+    }
+    case NodeTag::function_def: {
+        if(node->aux != 0) {
+            auto fun = builder.make<FunctionDefinition>(name, expr(node->child(1)),
+                                                        expr(node->child(0)));
+            for(u32 i = 2; i < n; ++i)
+                fun->add_arg(module.symbol(node->child(i)->symbol));
+            result = fun;
+        } else {
+            Function *fun    = builder.make<Function>();
+            fun->return_type = load(node->child(0));
+            fun->body        = load(node->child(1));
+            fun->args        = fields(node, 2, n);
+            result           = fun;
+        }
+        break;
+    }
+    case NodeTag::macro_def: {
+        auto fun =
+            builder.make<MacroDefinition>(name, expr(node->child(1)), expr(node->child(0)));
+        for(u32 i = 2; i < n; ++i)
+            fun->add_arg(module.symbol(node->child(i)->symbol));
+        result = fun;
+        break;
+    }
+    case NodeTag::struct_def: {
+        u32 meta  = u32(node->extra);
+        auto attr = fields(node, meta, n);
+        if(node->aux != 0)
+            result = builder.make<StructDefinition>(name, fields(node, 0, meta), attr);
+        else
+            result = builder.make<Struct>(fields(node, 0, meta), attr)->seal();
+        break;
+    }
+    case NodeTag::union_def: {
+        u32 meta  = u32(node->extra);
+        auto attr = fields(node, meta, n);
+        if(node->aux != 0)
+            result = builder.make<UnionDefinition>(name, fields(node, 0, meta), attr);
+        else
+            result = builder.make<Union>(fields(node, 0, meta), attr)->seal();
+        break;
+    }
+    default:
+        log_error("Cannot load ", to_string(node->tag));
+    }
+
+    nodes[node] = result;
+    return result;
+}
+
+} // namespace kiwi
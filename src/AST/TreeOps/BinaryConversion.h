@@ -0,0 +1,216 @@
+#ifndef KIWI_AST_BINARY_HEADER
+#define KIWI_AST_BINARY_HEADER
+
+#include "../Builder.h"
+#include "../Module.h"
+
+/*
+ *  Binary module format
+ *
+ *  The file is made to be mapped in memory and used in place: nodes refer to
+ *  their children through offsets relative to themselves and names are
+ *  indices in a string table, so nothing needs to be patched on load.
+ *  Every record is 8 bytes aligned.
+ *
+ *      BinaryHeader
+ *      nodes...                post-order, children are written first
+ *      BinaryString[]          string table
+ *      chars...                NUL terminated strings
+ *      BinaryEntry[]           module table, sorted by name
+ *
+ *  A node is a BinaryNode followed by `child_count` i32 offsets (0 is nullptr).
+ *  Shared subtrees are written once.
+ *
+ *      tag               aux         symbol     extra          children
+ *      field (0)                     name                      stmt
+ *      unary_call        right                                 fun, expr, type
+ *      binary_call                                             fun, lhs, rhs, type
+ *      function_call                                           fun, type, args...
+ *      match                                                   target, default, branches...
+ *      block                                                   type, statements...
+ *      placeholder                   name                      type
+ *      placeholder_ref               name       index, depth   type
+ *      value             ValueTag    primitive  bits
+ *                                                              definition, fields...   (struct)
+ *                                               index          definition, value       (union)
+ *      builtin_type                  name
+ *      unknown_type                                            resolved type
+ *      function_type                                           return, args...
+ *      struct/union_type                                       definition, meta fields...
+ *      error_type                    message    code           partial
+ *      function_def      definition  name                      type, body, arg fields...
+ *      macro_def         definition  name                      type, body, arg fields...
+ *      struct/union_def  definition  name       meta count     meta fields..., attr fields...
+ *
+ *  `definition` is 1 when the node is a Definition (module level) and 0 for
+ *  the anonymous Function/Struct/Union expressions sharing the same tag.
+ */
+namespace kiwi {
+
+constexpr u32 binary_version       = 1;
+constexpr NodeTag binary_field_tag = NodeTag(0);
+
+struct BinaryHeader {
+    char magic[4]; // KIWI
+    u32 version;
+    u32 string_count;
+    u32 strings; // offset of the string table
+    u32 entry_count;
+    u32 entries; // offset of the module table
+    u64 size;    // size of the file
+};
+
+struct BinaryString {
+    u32 offset;
+    u32 size;
+};
+
+struct BinaryEntry {
+    u32 name; // string index
+    u32 node; // offset of the definition
+};
+
+struct BinaryNode {
+    NodeTag tag;
+    u8 aux;
+    u16 reserved;
+    u32 child_count;
+    u32 symbol;
+    u32 padding;
+    u64 extra;
+
+    BinaryNode const *child(std::size_t i) const {
+        i32 offset;
+        std::memcpy(&offset, reinterpret_cast<u8 const *>(this + 1) + i * sizeof(i32), sizeof(i32));
+        if(offset == 0)
+            return nullptr;
+        return reinterpret_cast<BinaryNode const *>(reinterpret_cast<u8 const *>(this) + offset);
+    }
+};
+
+// Serialize a module, pointers are turned into relative offsets
+// empty if a node cannot be serialized
+Array<u8> write_binary(Module const &module);
+
+// false if a node cannot be serialized or the file cannot be written
+bool write_binary(Module const &module, String const &path);
+
+// Read only view of a file in memory
+class MappedFile {
+  public:
+    MappedFile(String const &path);
+    ~MappedFile();
+
+    MappedFile(MappedFile const &) = delete;
+    MappedFile &operator=(MappedFile const &) = delete;
+
+    // An empty file is open, its data() is nullptr
+    bool is_open() const { return _open; }
+
+    u8 const *data() const { return _data; }
+
+    std::size_t size() const { return _size; }
+
+    enum class Access { normal, sequential, random };
+
+    // Paging hints (madvise), ignored when mmap is not available
+    void advise(Access access) const;
+
+    // Read the bytes [offset, offset + size) ahead of their use
+    void prefetch(std::size_t offset, std::size_t size) const;
+
+    // The bytes [offset, offset + size) are not needed anymore, their pages can be dropped
+    void release(std::size_t offset, std::size_t size) const;
+
+  private:
+    u8 const *_data   = nullptr;
+    std::size_t _size = 0;
+    bool _open        = false;
+    Array<u8> _fallback; // when mmap is not available
+};
+
+/* Binary module used in place.
+ * Every node is checked once when the module is constructed: nodes, child
+ * offsets and string indices lie inside the file and children come before
+ * their parent, so a valid module is walked without further checks.
+ */
+class BinaryModule {
+  public:
+    BinaryModule(u8 const *data, std::size_t size);
+
+    BinaryModule(MappedFile const &file) : BinaryModule(file.data(), file.size()) {}
+
+    bool is_valid() const { return _valid; }
+
+    std::size_t size() const { return _valid ? header().entry_count : 0; }
+
+    StringView name(std::size_t i) const { return string(entry(i).name); }
+
+    BinaryNode const *definition(std::size_t i) const { return node(entry(i).node); }
+
+    // Binary search in the module table, nullptr if not found
+    BinaryNode const *find(StringView name) const;
+
+    StringView string(u32 index) const;
+
+    // Strings are interned the first time they are used as a symbol
+    Symbol symbol(u32 index) const;
+
+    BinaryNode const *node(u32 offset) const {
+        return reinterpret_cast<BinaryNode const *>(_data + offset);
+    }
+
+  private:
+    BinaryHeader const &header() const { return *reinterpret_cast<BinaryHeader const *>(_data); }
+
+    BinaryEntry const &entry(std::size_t i) const {
+        return reinterpret_cast<BinaryEntry const *>(_data + header().entries)[i];
+    }
+
+    bool check_strings() const;
+
+    // `offsets` receives the offset of every node, in increasing order
+    bool check_nodes(Array<u32> &offsets) const;
+
+    bool check_node(BinaryNode const &node) const;
+
+    bool check_entries(Array<u32> const &offsets) const;
+
+    u8 const *_data;
+    std::size_t _size;
+    bool _valid = false;
+    mutable Array<Symbol> _symbols;
+    mutable Array<bool> _interned;
+};
+
+/* Rebuild pointer nodes from a binary module on demand.
+ * Only the definitions requested, and the nodes they reach, are built.
+ */
+class BinaryLoader {
+  public:
+    BinaryLoader(BinaryModule const &module, Builder &builder) :
+        module(module), builder(builder) {}
+
+    // nullptr if the definition does not exist
+    Definition *definition(StringView name);
+
+    // Build every definition
+    Module load_all();
+
+    Statement *load(BinaryNode const *node);
+
+  private:
+    Expression *expr(BinaryNode const *node) { return static_cast<Expression *>(load(node)); }
+
+    Array<Tuple<Symbol, Statement *>> fields(BinaryNode const *node, u32 start, u32 end);
+
+    Value *load_value(BinaryNode const *node);
+
+    BinaryModule const &module;
+    Builder &builder;
+    Dict<BinaryNode const *, Statement *> nodes;
+};
+
+} // namespace kiwi
+
+#endif
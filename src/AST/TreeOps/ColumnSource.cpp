@@ -0,0 +1,119 @@
+#include "ColumnSource.h"
+
+#include <algorithm>
+
+#include "../../Logging/Log.h"
+
+namespace kiwi {
+
+bool ColumnSource::add(Symbol name, String const &path, PrimitiveTag tag) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    log_error("Column files are little endian, they cannot be mapped on this platform");
+    return false;
+#endif
+
+    std::size_t width = get_primitive_size(tag);
+    if(width == 0) {
+        log_error("Column ", name, " is not a primitive");
+        return false;
+    }
+
+    for(Column const &column : entries) {
+        if(column.name == name) {
+            log_error("Column ", name, " is already mapped");
+            return false;
+        }
+    }
+
+    auto file = std::make_unique<MappedFile>(path);
+    if(!file->is_open()) {
+        log_error("Could not map column ", name, " from ", path);
+        return false;
+    }
+
+    if(file->size() % width != 0) {
+        log_error("Column ", name, " is not an array of ", get_primitive_name(tag));
+        return false;
+    }
+
+    std::size_t n = file->size() / width;
+    if(!entries.empty() && n != _rows) {
+        log_error("Column ", name, " has ", n, " rows instead of ", _rows);
+        return false;
+    }
+
+    _rows = n;
+
+    // an empty file has no data, the view of its 0 rows is never read
+    Column column{name, tag, std::move(file), nullptr};
+    column.rows = std::make_unique<ArrayValue>(tag, Array<u64>{n}, column.data(0));
+    entries.push_back(std::move(column));
+    return true;
+}
+
+std::size_t ColumnSource::chunk_rows() const {
+    std::size_t width = 1;
+    for(Column const &column : entries)
+        width = std::max(width, get_primitive_size(column.tag));
+
+    return std::max<std::size_t>(64, chunk_bytes / width / 64 * 64);
+}
+
+void ColumnSource::bind(Context &ctx) const {
+    for(Column const &column : entries)
+        ctx[column.name] = column.rows.get();
+}
+
+Columns ColumnSource::columns() const {
+    Columns result;
+    for(Column const &column : entries) {
+        if(column.tag == PrimitiveTag::f64)
+            result[column.name] = static_cast<double const *>(column.data(0));
+    }
+    return result;
+}
+
+bool ColumnSource::stream(Context const &ctx, Expression *expr, Sink const &sink) const {
+    std::size_t chunk = chunk_rows();
+
+    for(Column const &column : entries) {
+        column.file->advise(MappedFile::Access::sequential);
+        column.file->prefetch(0, chunk * get_primitive_size(column.tag));
+    }
+
+    Context chunk_ctx = ctx;
+    EvalRegion region;
+
+    for(std::size_t first = 0; first < _rows; first += chunk) {
+        std::size_t n = std::min(chunk, _rows - first);
+
+        // read the next chunk while this one is computed
+        for(Column const &column : entries) {
+            std::size_t width = get_primitive_size(column.tag);
+            column.file->prefetch((first + n) * width, chunk * width);
+        }
+
+        {
+            EvalRegion::Scope scope(region);
+            for(Column const &column : entries) {
+                chunk_ctx[column.name] =
+                    region.make<ArrayValue>(column.tag, Array<u64>{n}, column.data(first));
+            }
+
+            ArrayEval eval(chunk_ctx);
+            Value *result = eval.run(expr);
+            if(result == nullptr)
+                return false;
+
+            sink(first, result);
+        }
+
+        for(Column const &column : entries) {
+            std::size_t width = get_primitive_size(column.tag);
+            column.file->release(first * width, n * width);
+        }
+    }
+    return true;
+}
+
+} // namespace kiwi
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <functional>
+
+#include "ArrayEval.h"
+#include "BatchEval.h"
+#include "BinaryConversion.h"
+
+/*
+ *  Column files
+ *
+ *  A column file is a raw array of little endian values of one primitive
+ *  type. The files are mapped, not read: columns are bound in the context
+ *  as ArrayValue views of the mapping, the evaluators read the page cache
+ *  directly and no value is copied nor boxed. The views are read only.
+ *
+ *      ColumnSource source;
+ *      source.add("price", "price.f64", PrimitiveTag::f64);
+ *      source.add("qty", "qty.i32", PrimitiveTag::i32);
+ *
+ *      // price * qty
+ *      source.stream(ctx, expr, [&](std::size_t first_row, Value *chunk) { ... });
+ *
+ *  stream() evaluates the expression over a chunk of rows at a time
+ *  (ArrayEval). Chunks are sized to stay in cache and their temporaries are
+ *  released before the next chunk. The next chunk is prefetched while the
+ *  current one is computed and the pages already used are released, so a
+ *  dataset larger than memory is read once, sequentially.
+ *
+ *  f64 columns can also be given to BatchEval as is (columns()).
+ */
+namespace kiwi {
+
+class ColumnSource {
+  public:
+    // `result` is valid until the sink returns
+    using Sink = std::function<void(std::size_t first_row, Value *result)>;
+
+    // A chunk holds `chunk_bytes` of the widest column
+    ColumnSource(std::size_t chunk_bytes = 256 * 1024) : chunk_bytes(chunk_bytes) {}
+
+    // Map the column file `path` as `name`, false if it cannot be mapped,
+    // is not an array of `tag`, its length differs from the other columns
+    // or `name` is already used. An empty file is a column of 0 rows
+    bool add(Symbol name, String const &path, PrimitiveTag tag);
+
+    std::size_t size() const { return entries.size(); }
+
+    std::size_t rows() const { return _rows; }
+
+    // Rows evaluated at once by stream, a multiple of 64 so every chunk is aligned
+    std::size_t chunk_rows() const;
+
+    // Bind every column as an array of all its rows
+    void bind(Context &ctx) const;
+
+    // f64 columns, for BatchEval
+    Columns columns() const;
+
+    // Evaluate `expr` for every chunk of rows, the columns are bound over
+    // the values of `ctx`. false if an evaluation failed
+    bool stream(Context const &ctx, Expression *expr, Sink const &sink) const;
+
+  private:
+    struct Column {
+        Symbol name;
+        PrimitiveTag tag;
+        UniquePtr<MappedFile> file;
+        UniquePtr<ArrayValue> rows; // view of every row
+
+        void *data(std::size_t row) const {
+            return const_cast<u8 *>(file->data()) + row * get_primitive_size(tag);
+        }
+    };
+
+    Array<Column> entries;
+    std::size_t chunk_bytes;
+    std::size_t _rows = 0;
+};
+
+} // namespace kiwi
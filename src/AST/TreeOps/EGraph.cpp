@@ -0,0 +1,543 @@
+#include "EGraph.h"
+
+#include "../Value.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+
+namespace kiwi {
+namespace {
+
+bool is_arithmetic(UnaryOp op) {
+    return op == UnaryOp::neg || op == UnaryOp::ln || op == UnaryOp::exp || op == UnaryOp::sqrt;
+}
+
+// 2^k, its reciprocal is exact
+bool is_power_of_two(double v) {
+    int exponent;
+    return v != 0 && std::isfinite(v) && std::frexp(std::abs(v), &exponent) == 0.5;
+}
+
+double operation_cost(ENode const &node) {
+    switch(node.kind) {
+    case ENode::Kind::binary:
+        return node.binary_op() == BinaryOp::div ? 4 : 1;
+    case ENode::Kind::unary:
+        return node.unary_op() == UnaryOp::neg ? 1 : (node.unary_op() == UnaryOp::sqrt ? 8 : 20);
+    default:
+        return 0;
+    }
+}
+
+double node_cost(CostModel model, ENode const &node, double a, double b) {
+    switch(model) {
+    case CostModel::flops:
+        return operation_cost(node) + a + b;
+    case CostModel::depth:
+        return node.arity() == 0 ? 0 : 1 + std::max(a, b);
+    case CostModel::memory:
+        return 1 + a + b;
+    }
+    return 0;
+}
+
+} // namespace
+
+char const *to_string(StopReason reason) {
+    switch(reason) {
+    case StopReason::saturated:
+        return "saturated";
+    case StopReason::node_limit:
+        return "node limit";
+    case StopReason::iteration_limit:
+        return "iteration limit";
+    case StopReason::time_limit:
+        return "time limit";
+    }
+    return "<none>";
+}
+
+EClassId EGraph::add(Expression *expr) {
+    if(expr == nullptr)
+        return add(ENode::constant(0));
+
+    switch(expr->tag) {
+    case NodeTag::value: {
+        Value *value = static_cast<Value *>(expr);
+        if(value->value_tag == ValueTag::vprimitive)
+            return add(ENode::constant(value->as<f64>()));
+        break;
+    }
+    case NodeTag::placeholder:
+    case NodeTag::placeholder_ref: {
+        Symbol name = expr->tag == NodeTag::placeholder
+                          ? static_cast<Placeholder *>(expr)->name
+                          : static_cast<PlaceholderReference *>(expr)->name;
+
+        auto leaf = named_leaves.find(name);
+        if(leaf != named_leaves.end())
+            return add(ENode::leaf(leaf->second));
+
+        named_leaves[name] = leaves.size();
+        leaves.push_back(expr);
+        return add(ENode::leaf(leaves.size() - 1));
+    }
+    case NodeTag::binary_call: {
+        BinaryCall *call = static_cast<BinaryCall *>(expr);
+        if(call->op != BinaryOp::none) {
+            EClassId a = add(call->lhs);
+            EClassId b = add(call->rhs);
+            return add(ENode::binary(call->op, a, b));
+        }
+        break;
+    }
+    case NodeTag::unary_call: {
+        UnaryCall *call = static_cast<UnaryCall *>(expr);
+        if(is_arithmetic(call->op))
+            return add(ENode::unary(call->op, add(call->expr)));
+        break;
+    }
+    default:
+        break;
+    }
+
+    // opaque
+    auto leaf = opaque_leaves.find(expr);
+    if(leaf != opaque_leaves.end())
+        return add(ENode::leaf(leaf->second));
+
+    opaque_leaves[expr] = leaves.size();
+    leaves.push_back(expr);
+    return add(ENode::leaf(leaves.size() - 1));
+}
+
+EClassId EGraph::add(ENode node) {
+    node = canonical(node);
+
+    auto result = memo.find(node);
+    if(result != memo.end())
+        return find(result->second);
+
+    EClassId id = EClassId(classes.size());
+    parent.push_back(id);
+    classes.emplace_back();
+    classes[id].nodes.push_back(node);
+
+    if(node.arity() > 0)
+        classes[node.a].parents.emplace_back(node, id);
+    if(node.arity() > 1 && node.b != node.a)
+        classes[node.b].parents.emplace_back(node, id);
+
+    memo[node] = id;
+
+    double value;
+    if(node.kind == ENode::Kind::constant) {
+        classes[id].constant = true;
+        classes[id].value    = node.value();
+    } else if(fold(node, value)) {
+        set_constant(id, value);
+    }
+    return find(id);
+}
+
+EClassId EGraph::find(EClassId id) const {
+    while(parent[id] != id)
+        id = parent[id];
+    return id;
+}
+
+bool EGraph::merge(EClassId a, EClassId b) {
+    a = find(a);
+    b = find(b);
+    if(a == b)
+        return false;
+
+    // keep the class with the most parents, fewer entries to move
+    if(classes[a].parents.size() < classes[b].parents.size())
+        std::swap(a, b);
+
+    parent[b] = a;
+
+    EClass &root  = classes[a];
+    EClass &other = classes[b];
+
+    root.nodes.insert(root.nodes.end(), other.nodes.begin(), other.nodes.end());
+    root.parents.insert(root.parents.end(), other.parents.begin(), other.parents.end());
+    Array<ENode>().swap(other.nodes);
+    Array<Tuple<ENode, EClassId>>().swap(other.parents);
+
+    if(other.constant && !root.constant) {
+        root.constant = true;
+        root.value    = other.value;
+    }
+
+    pending.push_back(a);
+    return true;
+}
+
+void EGraph::rebuild() {
+    while(!pending.empty()) {
+        Array<EClassId> todo;
+        todo.swap(pending);
+
+        for(EClassId &id : todo)
+            id = find(id);
+        std::sort(todo.begin(), todo.end());
+        todo.erase(std::unique(todo.begin(), todo.end()), todo.end());
+
+        for(EClassId id : todo)
+            repair(id);
+    }
+
+    // canonical and unique nodes in every class
+    for(EClassId id = 0; id < classes.size(); ++id) {
+        if(find(id) != id)
+            continue;
+
+        Array<ENode> &nodes = classes[id].nodes;
+        for(ENode &node : nodes)
+            node = canonical(node);
+
+        std::sort(nodes.begin(), nodes.end());
+        nodes.erase(std::unique(nodes.begin(), nodes.end()), nodes.end());
+    }
+}
+
+void EGraph::repair(EClassId id) {
+    Array<Tuple<ENode, EClassId>> parents;
+    parents.swap(classes[find(id)].parents);
+
+    for(auto &entry : parents) {
+        memo.erase(std::get<0>(entry));
+        std::get<0>(entry) = canonical(std::get<0>(entry));
+        memo[std::get<0>(entry)] = find(std::get<1>(entry));
+    }
+
+    // congruence: parents that became identical are equal
+    std::unordered_map<ENode, EClassId, ENodeHash> unique;
+    for(auto &entry : parents) {
+        ENode node = canonical(std::get<0>(entry));
+
+        auto other = unique.find(node);
+        if(other != unique.end())
+            merge(std::get<1>(entry), other->second);
+        unique[node] = find(std::get<1>(entry));
+
+        double value;
+        if(fold(node, value))
+            set_constant(find(std::get<1>(entry)), value);
+    }
+
+    Array<Tuple<ENode, EClassId>> &current = classes[find(id)].parents;
+    for(auto &entry : unique)
+        current.emplace_back(entry.first, entry.second);
+}
+
+ENode EGraph::canonical(ENode node) const {
+    if(node.arity() > 0)
+        node.a = find(node.a);
+    if(node.arity() > 1)
+        node.b = find(node.b);
+    return node;
+}
+
+bool EGraph::fold(ENode const &node, double &value) const {
+    switch(node.kind) {
+    case ENode::Kind::constant:
+        value = node.value();
+        return true;
+    case ENode::Kind::binary:
+        if(!is_constant(node.a) || !is_constant(node.b))
+            return false;
+        value = binary_operator(node.binary_op())(constant(node.a), constant(node.b));
+        return true;
+    case ENode::Kind::unary:
+        if(!is_constant(node.a))
+            return false;
+        value = unary_operator(node.unary_op())(constant(node.a));
+        return true;
+    case ENode::Kind::leaf:
+        return false;
+    }
+    return false;
+}
+
+void EGraph::set_constant(EClassId id, double value) {
+    id = find(id);
+    if(classes[id].constant)
+        return;
+
+    classes[id].constant = true;
+    classes[id].value    = value;
+    merge(id, add(ENode::constant(value)));
+}
+
+std::size_t EGraph::apply_rules(std::size_t max_nodes,
+                                std::chrono::steady_clock::time_point deadline) {
+    Array<Tuple<EClassId, ENode>> matches;
+    for(EClassId id = 0; id < classes.size(); ++id) {
+        if(find(id) != id)
+            continue;
+        for(ENode const &node : classes[id].nodes)
+            matches.emplace_back(id, node);
+    }
+
+    std::size_t merged = 0;
+    auto equal         = [&](EClassId a, EClassId b) { merged += merge(a, b) ? 1 : 0; };
+    auto is            = [&](EClassId a, double v) { return is_constant(a) && constant(a) == v; };
+    auto value         = [&](double v) { return add(ENode::constant(v)); };
+    auto bin           = [&](BinaryOp op, EClassId a, EClassId b) {
+        return add(ENode::binary(op, a, b));
+    };
+
+    // large classes make the nested matches quadratic, check the budget often
+    auto exhausted = [&]() {
+        return node_count() >= max_nodes || std::chrono::steady_clock::now() >= deadline;
+    };
+
+    // visit the nodes a class had before the rules ran on it,
+    // the class can grow (or be merged) while it is visited
+    auto each = [&](EClassId id, auto visit) {
+        std::size_t n = classes[find(id)].nodes.size();
+        for(std::size_t i = 0; i < n && i < classes[find(id)].nodes.size() && !exhausted(); ++i) {
+            ENode node = classes[find(id)].nodes[i];
+            visit(node);
+        }
+    };
+
+    for(auto &match : matches) {
+        if(exhausted())
+            break;
+
+        EClassId id = std::get<0>(match);
+        ENode node  = canonical(std::get<1>(match));
+        EClassId a  = node.a;
+        EClassId b  = node.b;
+
+        if(node.kind == ENode::Kind::unary) {
+            each(a, [&](ENode const &inner) {
+                if(inner.kind != ENode::Kind::unary)
+                    return;
+
+                // -(-x) = x, ln(exp(x)) = x
+                if(node.unary_op() == UnaryOp::neg && inner.unary_op() == UnaryOp::neg)
+                    equal(id, inner.a);
+                if(node.unary_op() == UnaryOp::ln && inner.unary_op() == UnaryOp::exp)
+                    equal(id, inner.a);
+            });
+            continue;
+        }
+
+        if(node.kind != ENode::Kind::binary)
+            continue;
+
+        switch(node.binary_op()) {
+        case BinaryOp::add:
+            equal(id, bin(BinaryOp::add, b, a));
+            if(is(b, 0))
+                equal(id, a);
+            if(find(a) == find(b))
+                equal(id, bin(BinaryOp::mul, value(2), a));
+
+            each(a, [&](ENode const &l) {
+                // (x + y) + b = x + (y + b)
+                if(l.kind == ENode::Kind::binary && l.binary_op() == BinaryOp::add)
+                    equal(id, bin(BinaryOp::add, l.a, bin(BinaryOp::add, l.b, b)));
+
+                // x * y + x * z = x * (y + z)
+                if(l.kind == ENode::Kind::binary && l.binary_op() == BinaryOp::mul) {
+                    each(b, [&](ENode const &r) {
+                        if(r.kind == ENode::Kind::binary && r.binary_op() == BinaryOp::mul &&
+                           find(r.a) == find(l.a))
+                            equal(id, bin(BinaryOp::mul, l.a, bin(BinaryOp::add, l.b, r.b)));
+                    });
+                }
+            });
+
+            // a + -x = a - x
+            each(b, [&](ENode const &r) {
+                if(r.kind == ENode::Kind::unary && r.unary_op() == UnaryOp::neg)
+                    equal(id, bin(BinaryOp::sub, a, r.a));
+            });
+            break;
+
+        case BinaryOp::mul:
+            equal(id, bin(BinaryOp::mul, b, a));
+            if(is(b, 1))
+                equal(id, a);
+            if(is(b, 0))
+                equal(id, value(0));
+
+            each(a, [&](ENode const &l) {
+                // (x * y) * b = x * (y * b)
+                if(l.kind == ENode::Kind::binary && l.binary_op() == BinaryOp::mul)
+                    equal(id, bin(BinaryOp::mul, l.a, bin(BinaryOp::mul, l.b, b)));
+
+                // exp(x) * exp(y) = exp(x + y)
+                if(l.kind == ENode::Kind::unary && l.unary_op() == UnaryOp::exp) {
+                    each(b, [&](ENode const &r) {
+                        if(r.kind == ENode::Kind::unary && r.unary_op() == UnaryOp::exp)
+                            equal(id, add(ENode::unary(UnaryOp::exp,
+                                                       bin(BinaryOp::add, l.a, r.a))));
+                    });
+                }
+            });
+            break;
+
+        case BinaryOp::sub:
+            if(is(b, 0))
+                equal(id, a);
+            if(find(a) == find(b))
+                equal(id, value(0));
+            equal(id, bin(BinaryOp::add, a, add(ENode::unary(UnaryOp::neg, b))));
+            break;
+
+        case BinaryOp::div:
+            if(is(b, 1))
+                equal(id, a);
+            if(is_constant(b) && is_power_of_two(constant(b)) &&
+               std::isfinite(1.0 / constant(b)))
+                equal(id, bin(BinaryOp::mul, a, value(1.0 / constant(b))));
+            break;
+
+        case BinaryOp::none:
+            break;
+        }
+    }
+    return merged;
+}
+
+SaturationReport EGraph::saturate(SaturationLimits const &limits) {
+    using Clock = std::chrono::steady_clock;
+    std::chrono::duration<double, std::milli> budget(limits.time_budget_ms);
+    auto deadline = Clock::now() + std::chrono::duration_cast<Clock::duration>(budget);
+
+    SaturationReport report;
+    rebuild();
+
+    while(true) {
+        if(node_count() >= limits.max_nodes) {
+            report.reason = StopReason::node_limit;
+            break;
+        }
+        if(Clock::now() >= deadline) {
+            report.reason = StopReason::time_limit;
+            break;
+        }
+        if(report.iterations >= limits.max_iterations) {
+            report.reason = StopReason::iteration_limit;
+            break;
+        }
+
+        report.iterations += 1;
+        std::size_t merged = apply_rules(limits.max_nodes, deadline);
+        rebuild();
+
+        // a pass cut short by the budget proves nothing
+        if(merged == 0 && node_count() < limits.max_nodes && Clock::now() < deadline) {
+            report.reason = StopReason::saturated;
+            break;
+        }
+    }
+
+    report.nodes   = node_count();
+    report.classes = class_count();
+    return report;
+}
+
+std::size_t EGraph::class_count() const {
+    std::size_t count = 0;
+    for(EClassId id = 0; id < classes.size(); ++id)
+        count += find(id) == id;
+    return count;
+}
+
+Array<std::size_t> const &EGraph::select(CostModel model) {
+    double const infinity = std::numeric_limits<double>::infinity();
+
+    costs.assign(classes.size(), infinity);
+    best.assign(classes.size(), 0);
+
+    // costs only decrease, stops once every class has its cheapest node
+    bool changed = true;
+    while(changed) {
+        changed = false;
+
+        for(EClassId id = 0; id < classes.size(); ++id) {
+            if(find(id) != id)
+                continue;
+
+            Array<ENode> const &nodes = classes[id].nodes;
+            for(std::size_t i = 0; i < nodes.size(); ++i) {
+                ENode const &node = nodes[i];
+                double a          = node.arity() > 0 ? costs[find(node.a)] : 0;
+                double b          = node.arity() > 1 ? costs[find(node.b)] : 0;
+                if(a == infinity || b == infinity)
+                    continue;
+
+                double cost = node_cost(model, node, a, b);
+                if(cost < costs[id]) {
+                    costs[id] = cost;
+                    best[id]  = i;
+                    changed   = true;
+                }
+            }
+        }
+    }
+    return best;
+}
+
+double EGraph::cost(EClassId id, CostModel model) {
+    select(model);
+    return costs[find(id)];
+}
+
+Expression *EGraph::extract(Builder &builder, EClassId id, CostModel model) {
+    select(model);
+
+    Dict<EClassId, Expression *> built;
+    auto build = [&](EClassId id, auto &self) -> Expression * {
+        id = find(id);
+
+        auto result = built.find(id);
+        if(result != built.end())
+            return result->second;
+
+        ENode const node = classes[id].nodes[best[id]];
+        Expression *expr = nullptr;
+
+        switch(node.kind) {
+        case ENode::Kind::constant:
+            expr = builder.make_value(node.value());
+            break;
+        case ENode::Kind::leaf:
+            expr = leaves[node.data];
+            break;
+        case ENode::Kind::binary: {
+            Expression *lhs = self(node.a, self);
+            Expression *rhs = self(node.b, self);
+            expr            = builder.make_binary_call(to_string(node.binary_op()), lhs, rhs);
+            break;
+        }
+        case ENode::Kind::unary:
+            expr = builder.make_unary_call(to_string(node.unary_op()), self(node.a, self));
+            break;
+        }
+
+        built[id] = expr;
+        return expr;
+    };
+    return build(id, build);
+}
+
+Expression *egraph_simplify(Builder &builder, Expression *expr, CostModel model,
+                            SaturationLimits const &limits) {
+    EGraph graph;
+    EClassId root = graph.add(expr);
+    graph.saturate(limits);
+    return graph.extract(builder, root, model);
+}
+
+} // namespace kiwi
@@ -0,0 +1,189 @@
+#pragma once
+
+#include <chrono>
+#include <tuple>
+
+#include "../Builder.h"
+#include "../Expression.h"
+#include "../HashCons.h"
+
+#include "Operators.h"
+
+/*
+ *  Equality saturation
+ *
+ *  An e-graph stores many equivalent expressions at once: e-classes group
+ *  the e-nodes known to be equal, e-nodes point to e-classes instead of
+ *  nodes. Rewrite rules only ever add equalities, so applying them in any
+ *  order cannot lose a good form. Once the rules stop adding anything (or
+ *  a limit is reached) the cheapest tree of the root class is extracted.
+ *
+ *      EGraph graph;
+ *      EClassId root = graph.add(expr);
+ *      graph.saturate();
+ *      Expression *best = graph.extract(builder, root, CostModel::flops);
+ *
+ *  Only the arithmetic operators are rewritten, other nodes (calls, match,
+ *  ...) are kept as opaque leaves. Every class carries its constant value
+ *  when known, constant subtrees are folded as they are added.
+ *
+ *  The rules are identities on the reals, not on doubles:
+ *    - x - x = 0 and x * 0 = 0 assume finite values (inf and NaN give NaN)
+ *    - ln(exp(x)) = x assumes exp(x) does not overflow
+ *    - reassociation, distribution and exp(x) * exp(y) = exp(x + y) can
+ *      change the rounding of the result
+ *  Rules that do not hold for part of the domain are left out:
+ *  sqrt(x) * sqrt(x) is NaN for x < 0, it is not rewritten to x.
+ *  x / 2^k becomes x * 2^-k only when 2^-k is finite, the product is then exact.
+ */
+namespace kiwi {
+
+using EClassId = u32;
+
+struct ENode {
+    enum class Kind : u8 { constant, leaf, binary, unary };
+
+    Kind kind;
+    u8 op      = 0; // BinaryOp or UnaryOp
+    EClassId a = 0;
+    EClassId b = 0;
+    u64 data   = 0; // constant bits or leaf index
+
+    static ENode constant(double v) { return ENode{Kind::constant, 0, 0, 0, NodeKey::bits(v)}; }
+    static ENode leaf(std::size_t index) { return ENode{Kind::leaf, 0, 0, 0, u64(index)}; }
+
+    static ENode binary(BinaryOp op, EClassId a, EClassId b) {
+        return ENode{Kind::binary, u8(op), a, b, 0};
+    }
+
+    static ENode unary(UnaryOp op, EClassId a) { return ENode{Kind::unary, u8(op), a, 0, 0}; }
+
+    BinaryOp binary_op() const { return BinaryOp(op); }
+    UnaryOp unary_op() const { return UnaryOp(op); }
+
+    double value() const {
+        double v;
+        std::memcpy(&v, &data, sizeof(v));
+        return v;
+    }
+
+    std::size_t arity() const { return kind == Kind::binary ? 2 : (kind == Kind::unary ? 1 : 0); }
+
+    bool operator==(ENode const &n) const {
+        return kind == n.kind && op == n.op && a == n.a && b == n.b && data == n.data;
+    }
+    bool operator!=(ENode const &n) const { return !(*this == n); }
+
+    bool operator<(ENode const &n) const {
+        return std::tie(kind, op, a, b, data) < std::tie(n.kind, n.op, n.a, n.b, n.data);
+    }
+};
+
+struct ENodeHash {
+    std::size_t operator()(ENode const &n) const {
+        std::size_t h = std::size_t(n.kind);
+        for(u64 v : {u64(n.op), u64(n.a), u64(n.b), n.data})
+            h = hash_combine(h, v);
+        return h;
+    }
+};
+
+// What the extracted tree minimizes
+enum class CostModel {
+    flops,  // weighted operation count, transcendental functions are expensive
+    depth,  // longest chain of dependent operations
+    memory, // number of nodes to allocate
+};
+
+struct SaturationLimits {
+    std::size_t max_nodes      = 10000;
+    std::size_t max_iterations = 32;
+    double time_budget_ms      = 50;
+};
+
+enum class StopReason { saturated, node_limit, iteration_limit, time_limit };
+
+char const *to_string(StopReason reason);
+
+struct SaturationReport {
+    StopReason reason      = StopReason::saturated;
+    std::size_t iterations = 0;
+    std::size_t nodes      = 0;
+    std::size_t classes    = 0;
+};
+
+class EGraph {
+  public:
+    // Insert a tree, returns its class
+    EClassId add(Expression *expr);
+
+    // Insert a node whose children are classes of this graph
+    EClassId add(ENode node);
+
+    EClassId find(EClassId id) const;
+
+    // Record that `a` and `b` are equal, returns false if they already were
+    bool merge(EClassId a, EClassId b);
+
+    // Restore the invariants after merges (canonical nodes, congruence)
+    void rebuild();
+
+    // Apply the rules until nothing changes or a limit is hit
+    SaturationReport saturate(SaturationLimits const &limits = SaturationLimits());
+
+    // Cheapest tree of the class `id`, equal subtrees are shared
+    Expression *extract(Builder &builder, EClassId id, CostModel model = CostModel::flops);
+
+    // Cost of the tree `extract` would return
+    double cost(EClassId id, CostModel model = CostModel::flops);
+
+    bool is_constant(EClassId id) const { return classes[find(id)].constant; }
+    double constant(EClassId id) const { return classes[find(id)].value; }
+
+    std::size_t node_count() const { return memo.size(); }
+    std::size_t class_count() const;
+
+  private:
+    struct EClass {
+        Array<ENode> nodes;
+        Array<Tuple<ENode, EClassId>> parents; // nodes using this class
+        bool constant = false;
+        double value  = 0;
+    };
+
+    ENode canonical(ENode node) const;
+
+    // Constant value of a node, false if unknown
+    bool fold(ENode const &node, double &value) const;
+
+    // Mark `id` as constant and add the constant node to it
+    void set_constant(EClassId id, double value);
+
+    void repair(EClassId id);
+
+    // Apply every rule once, returns the number of classes merged
+    // stops early when the graph grows past `max_nodes` or after `deadline`
+    std::size_t apply_rules(std::size_t max_nodes, std::chrono::steady_clock::time_point deadline);
+
+    // Best node of every class under `model`
+    Array<std::size_t> const &select(CostModel model);
+
+    Array<EClassId> parent;
+    Array<EClass> classes;
+    std::unordered_map<ENode, EClassId, ENodeHash> memo;
+    Array<EClassId> pending; // classes to repair
+
+    // leaves are deduplicated by name, opaque nodes by address
+    Array<Expression *> leaves;
+    Dict<Symbol, std::size_t> named_leaves;
+    Dict<Expression *, std::size_t> opaque_leaves;
+
+    Array<double> costs;
+    Array<std::size_t> best;
+};
+
+// Saturate `expr` and extract its cheapest equivalent
+Expression *egraph_simplify(Builder &builder, Expression *expr, CostModel model = CostModel::flops,
+                            SaturationLimits const &limits = SaturationLimits());
+
+} // namespace kiwi
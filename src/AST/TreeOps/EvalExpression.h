@@ -1,15 +1,17 @@
 #pragma once
 
 #include "../../Logging/Log.h"
+#include "../EvalRegion.h"
 #include "../Expression.h"
 #include "../Module.h"
 #include "../Root.h"
 #include "../Visitor.h"
 
+#include "MatchCompiler.h"
 #include "Operators.h"
 
 namespace kiwi {
-/*/ Functions
+// Functions
 // ------------------------------------------------------------------------
 
 // Compute the graph (all placeholder must be defined)
@@ -17,101 +19,208 @@ double full_eval(const Context &ctx, Expression *expr);
 
 // Implementation
 // ------------------------------------------------------------------------
-class FullEval : public StaticVisitor<FullEval, double> {
+class FullEval : public StaticExpressionVisitor<FullEval, double> {
   public:
     FullEval(const Context &ctx) : ctx(ctx) {}
 
     static double run(const Context &ctx, Expression *expr) {
         FullEval eval(ctx);
-        return eval.traverse(expr);
+        return eval.visit_expression(expr);
     }
 
-    // nothing to do...
-    double function(FunctionDeclaration *) { return 0; }
-
     double function_call(FunctionCall *x) {
-        if(x->fun->tag != NodeTag::placeholder) {
-            log_error("Computed Lambda not supported in FullEval Mode");
-            return 0;
-        }
+        Expression *efun = lookup(x->fun);
 
-        Placeholder *pl   = static_cast<Placeholder *>(x->fun);
-        std::size_t count = ctx.count(pl->name);
-
-        if(count == 0) {
-            log_error("Function does not exist");
-            return 0;
-        }
-
-        Expression *efun = ctx.at(pl->name);
-
-        if(efun->tag != NodeTag::function_decl) {
+        if(efun == nullptr || efun->tag != NodeTag::function_def) {
             log_error("Calling a non-function");
             return 0;
         }
 
-        FunctionDeclaration *fun = reinterpret_cast<FunctionDeclaration *>(efun);
+        Function *fun = static_cast<Function *>(efun);
 
         if(fun->args_size() != x->args_size()) {
             log_error("argument size mismatch:", fun->args_size(), " ", x->args_size());
             return 0;
-        } else {
-            // create eval context
-            Context fun_ctx;
+        }
 
-            for(int i = 0; i < fun->args_size(); ++i) {
-                fun_ctx[fun->arg(i)] = x->arg(i);
-                log_trace(fun->arg(i), " ", x->arg(i));
-            }
+        Expression *body = static_cast<Expression *>(fun->body);
+        std::size_t n    = x->args_size();
+
+        // arguments are allocated in the region of the thread, released with the call
+        if(EvalRegion *region = EvalRegion::current()) {
+            EvalRegion::Scope scope(*region);
 
-            log_trace("Context built ", fun->body);
-            return full_eval(fun_ctx, fun->body);
+            Value **args = static_cast<Value **>(region->allocate(n * sizeof(Value *)));
+            for(std::size_t i = 0; i < n; ++i)
+                args[i] = region->make<PrimitiveValue>(visit_expression(x->arg(i)));
+
+            return FullEval(ctx, Frame{fun, args, frame}).visit_expression(body);
+        }
+
+        // arguments are evaluated in the caller's context
+        Array<PrimitiveValue> values;
+        values.reserve(n);
+        Array<Value *> args(n);
+        for(std::size_t i = 0; i < n; ++i) {
+            values.emplace_back(visit_expression(x->arg(i)));
+            args[i] = &values[i];
         }
+
+        return FullEval(ctx, Frame{fun, args.data(), frame}).visit_expression(body);
     }
 
     double binary_call(BinaryCall *x) {
-        if(x->fun->tag != NodeTag::placeholder) {
-            log_error("Computed Lambda not supported in FullEval Mode");
+        BinaryOperator op = binary_operator(x->op);
+        if(op == nullptr) {
+            log_error("Unknown binary operator ", callee_name(x->fun));
             return 0;
         }
 
-        Placeholder *pl = static_cast<Placeholder *>(x->fun);
-
-        double a = traverse(x->arg(0));
-        double b = traverse(x->arg(1));
-        return binary_operator(pl->name)(a, b);
+        double a = visit_expression(x->arg(0));
+        double b = visit_expression(x->arg(1));
+        return op(a, b);
     }
 
     double unary_call(UnaryCall *x) {
-        if(x->fun->tag != NodeTag::placeholder) {
-            log_error("Computed Lambda not supported in FullEval Mode");
+        UnaryOperator op = unary_operator(x->op);
+        if(op == nullptr) {
+            log_error("Unknown unary operator ", callee_name(x->fun));
             return 0;
         }
 
-        Placeholder *pl = static_cast<Placeholder *>(x->fun);
+        double a = visit_expression(x->arg(0));
+        return op(a);
+    }
 
-        double a = traverse(x->arg(0));
-        return unary_operator(pl->name)(a);
+    double match(Match *x) {
+        MatchPlan const *plan = x->plan.get();
+        // only a union value matches a variant, any other target takes the default branch
+        if(plan != nullptr && plan->strategy == MatchStrategy::union_tag) {
+            UnionValue *target = union_value(x->target);
+            u32 branch = target ? plan->select_variant(target->index) : MatchPlan::default_branch;
+            return visit_expression(MatchPlan::branch(x, branch));
+        }
+
+        double target = visit_expression(x->target);
+        if(plan != nullptr && plan->is_lookup())
+            return visit_expression(MatchPlan::branch(x, plan->select(target)));
+
+        for(auto &branch : x->branches) {
+            if(visit_expression(std::get<0>(branch)) == target)
+                return visit_expression(std::get<1>(branch));
+        }
+        return visit_expression(x->default_branch);
     }
 
-    double borrow(Borrow *b) { return traverse(b->expr); }
+    // value of the last expression
+    double block(Block *x) {
+        double result = 0;
+        for(Statement *stmt : x->statements) {
+            if(stmt != nullptr && stmt->is_expr())
+                result = visit_expression(static_cast<Expression *>(stmt));
+        }
+        return result;
+    }
 
     double value(Value *x) { return x->template as<f64>(); }
 
-    double placeholder(Placeholder *x) { return traverse(ctx.at(x->name)); }
+    double placeholder(Placeholder *x) { return bound(x->name); }
 
-    double arrow(FunctionType *) { return 0; }
+    double placeholder_ref(PlaceholderReference *x) { return bound(x->name); }
 
-    double type(Type *) { return 0; }
+    double unhandled_expression(Expression *x) {
+        log_error("Cannot evaluate ", to_string(x->tag));
+        return 0;
+    }
 
-    double builtin(BuiltinType *) { return 0; }
+    double nullptr_expression() { return 0; }
+
+  private:
+    // Arguments of a call; names the call does not bind are looked up in
+    // the frame of its caller, then in the context
+    struct Frame {
+        Function *fun;
+        Value *const *args;
+        Frame const *caller;
+    };
+
+    FullEval(const Context &ctx, Frame const &frame) : ctx(ctx), frame(&frame) {}
+
+    // nullptr if `name` is not bound, `found` tells whether it was
+    Expression *find(Symbol name, bool &found) const {
+        found = true;
+        for(Frame const *f = frame; f != nullptr; f = f->caller) {
+            for(u64 i = 0; i < f->fun->args_size(); ++i) {
+                if(std::get<0>(f->fun->arg(i)) == name)
+                    return f->args[i];
+            }
+        }
 
-    double error(ErrorNode *) { return 0; }
+        auto result = ctx.find(name);
+        found       = result != ctx.end();
+        return found ? result->second : nullptr;
+    }
+
+    // Follow names to the union value `expr` evaluates to, nullptr if it is not one
+    UnionValue *union_value(Expression *expr) const {
+        for(int i = 0; i < max_depth && expr != nullptr; ++i) {
+            if(expr->tag == NodeTag::value) {
+                if(static_cast<Value *>(expr)->value_tag != ValueTag::vunion)
+                    return nullptr;
+                return static_cast<UnionValue *>(expr);
+            }
+
+            Symbol name;
+            if(expr->tag == NodeTag::placeholder)
+                name = static_cast<Placeholder *>(expr)->name;
+            else if(expr->tag == NodeTag::placeholder_ref)
+                name = static_cast<PlaceholderReference *>(expr)->name;
+            else
+                return nullptr;
+
+            bool found       = false;
+            Expression *next = find(name, found);
+            if(next == expr)
+                return nullptr;
+            expr = next;
+        }
+        return nullptr;
+    }
+
+    Expression *lookup(Expression *fun) {
+        bool found = false;
+        return find(callee_name(fun), found);
+    }
+
+    Expression *resolve(Symbol name) {
+        bool found       = false;
+        Expression *expr = find(name, found);
+        if(!found)
+            log_error("Undefined variable ", name);
+        return expr;
+    }
+
+    // value of the expression bound to `name`,
+    // names bound to names are followed at most `max_depth` times
+    double bound(Symbol name) {
+        if(depth >= max_depth) {
+            log_error("Recursive definition of ", name);
+            return 0;
+        }
+
+        depth += 1;
+        double result = visit_expression(resolve(name));
+        depth -= 1;
+        return result;
+    }
+
+    static constexpr int max_depth = 64;
 
     const Context &ctx;
+    Frame const *frame = nullptr;
+    int depth          = 0;
 };
 
-template <typename NodeTrait> double full_eval(const Context &ctx, Expression *expr) {
-    return FullEval::run(ctx, expr);
-}*/
+inline double full_eval(const Context &ctx, Expression *expr) { return FullEval::run(ctx, expr); }
+
 } // namespace kiwi
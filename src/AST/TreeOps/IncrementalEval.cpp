@@ -0,0 +1,198 @@
+#include "IncrementalEval.h"
+
+#include "../../Logging/Log.h"
+#include "../Value.h"
+
+#include <algorithm>
+
+namespace kiwi {
+namespace {
+
+void add_unique(Array<Symbol> &names, Symbol name) {
+    if(std::find(names.begin(), names.end(), name) == names.end())
+        names.push_back(name);
+}
+
+} // namespace
+
+double IncrementalEval::eval(Expression *expr) {
+    if(expr == nullptr)
+        return 0;
+
+    // cheaper to read than to look up
+    if(expr->tag == NodeTag::value)
+        return value(static_cast<Value *>(expr));
+
+    // function bodies depend on their arguments, their nodes are not cached
+    if(!calls.empty())
+        return visit_expression(expr);
+
+    Entry &cached = cache[expr];
+    if(cached.valid) {
+        depends_on(cached.deps);
+        return cached.value;
+    }
+
+    frames.emplace_back();
+    double result = visit_expression(expr);
+    recomputed += 1;
+
+    Array<Symbol> deps = std::move(frames.back());
+    frames.pop_back();
+
+    // the visit may have rehashed the cache
+    Entry &entry = cache[expr];
+    for(Symbol dep : deps) {
+        if(std::find(entry.deps.begin(), entry.deps.end(), dep) == entry.deps.end())
+            dependents[dep].push_back(expr);
+    }
+
+    entry.value = result;
+    entry.valid = true;
+    entry.deps  = std::move(deps);
+
+    depends_on(entry.deps);
+    return result;
+}
+
+void IncrementalEval::set(Symbol name, Expression *value) {
+    // drops the result of the previous binding
+    invalidate(name);
+    bindings[name] = value;
+}
+
+void IncrementalEval::invalidate(Symbol name) {
+    auto bound = bindings.find(name);
+    if(bound != bindings.end())
+        cache.erase(bound->second);
+
+    auto nodes = dependents.find(name);
+    if(nodes == dependents.end())
+        return;
+
+    // dependencies are transitive, the ancestors are in the list as well
+    for(Expression *node : nodes->second)
+        cache[node].valid = false;
+}
+
+void IncrementalEval::clear() {
+    cache.clear();
+    dependents.clear();
+}
+
+void IncrementalEval::depends_on(Symbol name) {
+    if(!frames.empty())
+        add_unique(frames.back(), name);
+}
+
+void IncrementalEval::depends_on(Array<Symbol> const &names) {
+    for(Symbol name : names)
+        depends_on(name);
+}
+
+double IncrementalEval::function_call(FunctionCall *x) {
+    Symbol callee = callee_name(x->fun);
+    depends_on(callee);
+
+    auto efun = bindings.find(callee);
+    if(efun == bindings.end() || efun->second == nullptr ||
+       efun->second->tag != NodeTag::function_def) {
+        log_error("Calling a non-function");
+        return 0;
+    }
+
+    Function *fun = static_cast<Function *>(efun->second);
+
+    if(fun->args_size() != x->args_size()) {
+        log_error("argument size mismatch:", fun->args_size(), " ", x->args_size());
+        return 0;
+    }
+
+    // arguments are cached, the body is not
+    Call call{fun, Array<double>()};
+    call.args.reserve(x->args_size());
+    for(u64 i = 0; i < x->args_size(); ++i)
+        call.args.push_back(eval(x->arg(i)));
+
+    // the names read by the body, and by its callees, are recorded
+    // as dependencies of the node being computed
+    calls.push_back(std::move(call));
+    double result = eval(static_cast<Expression *>(fun->body));
+    calls.pop_back();
+    return result;
+}
+
+double IncrementalEval::binary_call(BinaryCall *x) {
+    BinaryOperator op = binary_operator(x->op);
+    if(op == nullptr) {
+        log_error("Unknown binary operator ", callee_name(x->fun));
+        return 0;
+    }
+
+    double a = eval(x->lhs);
+    double b = eval(x->rhs);
+    return op(a, b);
+}
+
+double IncrementalEval::unary_call(UnaryCall *x) {
+    UnaryOperator op = unary_operator(x->op);
+    if(op == nullptr) {
+        log_error("Unknown unary operator ", callee_name(x->fun));
+        return 0;
+    }
+
+    return op(eval(x->expr));
+}
+
+// only the evaluated patterns and branch are dependencies
+double IncrementalEval::match(Match *x) {
+    double target = eval(x->target);
+
+    for(auto &branch : x->branches) {
+        if(eval(std::get<0>(branch)) == target)
+            return eval(std::get<1>(branch));
+    }
+    return eval(x->default_branch);
+}
+
+// value of the last expression
+double IncrementalEval::block(Block *x) {
+    double result = 0;
+    for(Statement *stmt : x->statements) {
+        if(stmt != nullptr && stmt->is_expr())
+            result = eval(static_cast<Expression *>(stmt));
+    }
+    return result;
+}
+
+double IncrementalEval::name(Symbol name) {
+    if(!calls.empty()) {
+        Call const &call = calls.back();
+        for(u64 i = 0; i < call.fun->args_size(); ++i) {
+            if(std::get<0>(call.fun->arg(i)) == name)
+                return call.args[i];
+        }
+    }
+
+    depends_on(name);
+
+    auto result = bindings.find(name);
+    if(result == bindings.end()) {
+        log_error("Undefined variable ", name);
+        return 0;
+    }
+
+    // bindings do not see the arguments, their result is cached
+    Array<Call> outer = std::move(calls);
+    calls.clear();
+    double value = eval(result->second);
+    calls        = std::move(outer);
+    return value;
+}
+
+double IncrementalEval::unhandled_expression(Expression *x) {
+    log_error("Cannot evaluate ", to_string(x->tag));
+    return 0;
+}
+
+} // namespace kiwi
@@ -0,0 +1,90 @@
+#pragma once
+
+#include "../Expression.h"
+#include "../Module.h"
+#include "../Visitor.h"
+
+#include "Operators.h"
+
+/*
+ *  Incremental evaluation
+ *
+ *  Every node remembers its last value and the names it read to compute it.
+ *  When a binding changes only the nodes that depend on it are invalidated,
+ *  the next evaluation recomputes the dirty path and reuses everything else.
+ *
+ *      IncrementalEval eval(ctx);
+ *      eval.eval(expr);            // computes everything
+ *      eval.set("x", new_value);
+ *      eval.eval(expr);            // recomputes the nodes reading x
+ *
+ *  Nodes are identified by address, the trees must outlive the evaluator.
+ *  Function bodies are not cached, a call depends on its arguments and on
+ *  every name read while its body (and its callees) were evaluated.
+ */
+namespace kiwi {
+
+class IncrementalEval : public StaticExpressionVisitor<IncrementalEval, double> {
+  public:
+    IncrementalEval(Context const &ctx) : bindings(ctx) {}
+
+    // Value of `expr`, computed nodes are cached
+    double eval(Expression *expr);
+
+    // Rebind `name` and invalidate the nodes that read it
+    void set(Symbol name, Expression *value);
+
+    // The value bound to `name` was modified in place
+    void invalidate(Symbol name);
+
+    // Drop every cached result
+    void clear();
+
+    Context const &context() const { return bindings; }
+
+    // Number of nodes computed (cache misses) since the last reset
+    std::size_t recompute_count() const { return recomputed; }
+    void reset_stats() { recomputed = 0; }
+
+    double function_call(FunctionCall *x);
+    double binary_call(BinaryCall *x);
+    double unary_call(UnaryCall *x);
+    double match(Match *x);
+    double block(Block *x);
+    double value(Value *x) { return x->template as<f64>(); }
+    double placeholder(Placeholder *x) { return name(x->name); }
+    double placeholder_ref(PlaceholderReference *x) { return name(x->name); }
+    double unhandled_expression(Expression *x);
+    double nullptr_expression() { return 0; }
+
+  private:
+    struct Entry {
+        double value = 0;
+        bool valid   = false;
+        Array<Symbol> deps; // names read by the node, or by its children
+    };
+
+    double name(Symbol name);
+
+    // Record a dependency of the node being computed
+    void depends_on(Symbol name);
+    void depends_on(Array<Symbol> const &names);
+
+    struct Call {
+        Function *fun;
+        Array<double> args;
+    };
+
+    Context bindings;
+    Dict<Expression *, Entry> cache;
+    Dict<Symbol, Array<Expression *>> dependents;
+
+    // functions being evaluated, innermost last
+    Array<Call> calls;
+
+    // dependencies of the nodes being computed, innermost last
+    Array<Array<Symbol>> frames;
+    std::size_t recomputed = 0;
+};
+
+} // namespace kiwi
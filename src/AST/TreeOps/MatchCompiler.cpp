@@ -0,0 +1,237 @@
+#include "MatchCompiler.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace kiwi {
+
+char const *to_string(MatchStrategy strategy) {
+    switch(strategy) {
+    case MatchStrategy::linear:
+        return "linear";
+    case MatchStrategy::jump_table:
+        return "jump_table";
+    case MatchStrategy::binary_search:
+        return "binary_search";
+    case MatchStrategy::union_tag:
+        return "union_tag";
+    }
+    return "<strategy>";
+}
+
+u32 MatchPlan::select(double target) const {
+    switch(strategy) {
+    case MatchStrategy::jump_table: {
+        // NaN and out of range targets fail the bound checks
+        double offset = target - min;
+        if(!(offset >= 0 && offset < double(table.size())) || offset != std::floor(offset))
+            return default_branch;
+        return table[std::size_t(offset)];
+    }
+    case MatchStrategy::binary_search: {
+        auto result = std::lower_bound(
+            sorted.begin(), sorted.end(), target,
+            [](Tuple<double, u32> const &item, double v) { return std::get<0>(item) < v; });
+
+        if(result == sorted.end() || std::get<0>(*result) != target)
+            return default_branch;
+        return std::get<1>(*result);
+    }
+    default:
+        return default_branch;
+    }
+}
+
+u32 MatchPlan::select_variant(int32 index) const {
+    if(strategy != MatchStrategy::union_tag || index < -1 || index + 1 >= int32(table.size()))
+        return default_branch;
+    return table[std::size_t(index + 1)];
+}
+
+std::shared_ptr<MatchPlan const> MatchCompiler::plan(Match *x) const {
+    auto plan = std::make_shared<MatchPlan>();
+
+    if(!compile_variants(x, *plan) && !compile_constants(x, *plan)) {
+        plan->strategy        = MatchStrategy::linear;
+        plan->info.exhaustive = x->default_branch != nullptr;
+    }
+    return plan;
+}
+
+bool MatchCompiler::compile_constants(Match *x, MatchPlan &plan) const {
+    Array<Tuple<double, u32>> patterns;
+    for(u32 i = 0; i < u32(x->branches.size()); ++i) {
+        Expression *pattern = std::get<0>(x->branches[i]);
+        if(pattern == nullptr || pattern->tag != NodeTag::value ||
+           static_cast<Value *>(pattern)->value_tag != ValueTag::vprimitive)
+            return false;
+
+        double v = static_cast<Value *>(pattern)->as<f64>();
+        if(std::isnan(v))
+            plan.info.unreachable.push_back(i); // never equal to the target
+        else
+            patterns.emplace_back(v, i);
+    }
+
+    if(patterns.empty())
+        return false;
+
+    // first branch wins, the others are shadowed
+    std::sort(patterns.begin(), patterns.end());
+    Array<Tuple<double, u32>> unique;
+    for(auto &pattern : patterns) {
+        if(!unique.empty() && std::get<0>(unique.back()) == std::get<0>(pattern))
+            plan.info.unreachable.push_back(std::get<1>(pattern));
+        else
+            unique.push_back(pattern);
+    }
+    std::sort(plan.info.unreachable.begin(), plan.info.unreachable.end());
+
+    plan.info.exhaustive = x->default_branch != nullptr;
+
+    bool integers = true;
+    for(auto &pattern : unique)
+        integers &= std::get<0>(pattern) == std::floor(std::get<0>(pattern));
+
+    double lo    = std::get<0>(unique.front());
+    double range = std::get<0>(unique.back()) - lo + 1;
+
+    if(integers && range <= density * double(unique.size()) + 8) {
+        plan.strategy = MatchStrategy::jump_table;
+        plan.min      = lo;
+        plan.table.assign(std::size_t(range), MatchPlan::default_branch);
+        for(auto &pattern : unique)
+            plan.table[std::size_t(std::get<0>(pattern) - lo)] = std::get<1>(pattern);
+        return true;
+    }
+
+    plan.strategy = MatchStrategy::binary_search;
+    plan.sorted   = std::move(unique);
+    return true;
+}
+
+bool MatchCompiler::compile_variants(Match *x, MatchPlan &plan) const {
+    Union *definition = nullptr;
+    for(auto &branch : x->branches) {
+        Expression *pattern = std::get<0>(branch);
+        if(pattern == nullptr || pattern->tag != NodeTag::value ||
+           static_cast<Value *>(pattern)->value_tag != ValueTag::vunion)
+            return false;
+
+        UnionValue *v = static_cast<UnionValue *>(pattern);
+        if(definition != nullptr && v->definition() != definition)
+            return false;
+        definition = v->definition();
+    }
+
+    if(definition == nullptr)
+        return false;
+
+    // payloads are not compared, only the variant
+    RecordLayout const &layout = definition->layout;
+    plan.strategy              = MatchStrategy::union_tag;
+    plan.table.assign(layout.fields.size() + 1, MatchPlan::default_branch);
+
+    for(u32 i = 0; i < u32(x->branches.size()); ++i) {
+        int32 index = static_cast<UnionValue *>(std::get<0>(x->branches[i]))->index;
+        if(index < -1 || index + 1 >= int32(plan.table.size())) {
+            plan.info.unreachable.push_back(i);
+            continue;
+        }
+
+        u32 &slot = plan.table[std::size_t(index + 1)];
+        if(slot == MatchPlan::default_branch)
+            slot = i;
+        else
+            plan.info.unreachable.push_back(i);
+    }
+
+    for(std::size_t i = 0; i < layout.fields.size(); ++i) {
+        if(plan.table[i + 1] == MatchPlan::default_branch)
+            plan.info.missing.push_back(layout.fields[i].name);
+    }
+
+    plan.info.missing_none = plan.table[0] == MatchPlan::default_branch;
+
+    bool covered         = plan.info.missing.empty() && !plan.info.missing_none;
+    plan.info.exhaustive = covered || x->default_branch != nullptr;
+    return true;
+}
+
+void MatchCompiler::compile(Context const &ctx) {
+    for(auto &item : ctx) {
+        Expression *expr = item.second;
+        if(expr == nullptr)
+            continue;
+
+        if(expr->tag == NodeTag::function_def) {
+            Function *fun = static_cast<Function *>(expr);
+            if(fun->body != nullptr && fun->body->is_expr())
+                visit_expression(static_cast<Expression *>(fun->body));
+        } else {
+            visit_expression(expr);
+        }
+    }
+}
+
+void MatchCompiler::function_call(FunctionCall *x) {
+    for(u64 i = 0; i < x->args_size(); ++i)
+        visit_expression(x->arg(i));
+}
+
+void MatchCompiler::binary_call(BinaryCall *x) {
+    visit_expression(x->lhs);
+    visit_expression(x->rhs);
+}
+
+void MatchCompiler::unary_call(UnaryCall *x) { visit_expression(x->expr); }
+
+void MatchCompiler::match(Match *x) {
+    visit_expression(x->target);
+    for(auto &branch : x->branches) {
+        visit_expression(std::get<0>(branch));
+        visit_expression(std::get<1>(branch));
+    }
+    visit_expression(x->default_branch);
+
+    x->plan = plan(x);
+    count += 1;
+}
+
+void MatchCompiler::block(Block *x) {
+    for(Statement *stmt : x->statements) {
+        if(stmt != nullptr && stmt->is_expr())
+            visit_expression(static_cast<Expression *>(stmt));
+    }
+}
+
+UnionValue *union_target(Context const &ctx, Expression *expr) {
+    // bounded, in case of a cycle
+    for(int i = 0; i < 64 && expr != nullptr; ++i) {
+        switch(expr->tag) {
+        case NodeTag::value:
+            if(static_cast<Value *>(expr)->value_tag != ValueTag::vunion)
+                return nullptr;
+            return static_cast<UnionValue *>(expr);
+
+        case NodeTag::placeholder:
+        case NodeTag::placeholder_ref: {
+            Symbol name = expr->tag == NodeTag::placeholder
+                              ? static_cast<Placeholder *>(expr)->name
+                              : static_cast<PlaceholderReference *>(expr)->name;
+
+            auto result = ctx.find(name);
+            if(result == ctx.end() || result->second == expr)
+                return nullptr;
+            expr = result->second;
+            break;
+        }
+
+        default:
+            return nullptr;
+        }
+    }
+    return nullptr;
+}
+
+} // namespace kiwi
@@ -0,0 +1,121 @@
+#pragma once
+
+#include "../Expression.h"
+#include "../Module.h"
+#include "../Value.h"
+#include "../Visitor.h"
+
+/*
+ *  Match compilation
+ *
+ *  Evaluated as written, a Match is a chain of equality tests. When every
+ *  pattern is a constant the chain is replaced by a lookup:
+ *
+ *      - jump_table   : integer patterns covering a dense range,
+ *                       the branch is table[target - min]
+ *      - binary_search: other constants, sorted once
+ *      - union_tag    : UnionValue patterns (`| MaybeFloat(x = _)`), the
+ *                       branch is table[target.index + 1], index -1 is None;
+ *                       a target that is not a union takes the default branch
+ *      - linear       : a pattern is not a constant, nothing changes
+ *
+ *  The first matching branch wins: a pattern equal to a previous one is
+ *  unreachable. Exhaustiveness comes with it, a union match is exhaustive
+ *  when every variant has a branch.
+ *
+ *  Plans are stored in Match::plan and used by the evaluators. Compile
+ *  again after changing the branches of a Match.
+ */
+namespace kiwi {
+
+enum class MatchStrategy : u8 { linear, jump_table, binary_search, union_tag };
+
+char const *to_string(MatchStrategy strategy);
+
+struct MatchInfo {
+    bool exhaustive = false;   // every target is handled, by a branch or the default
+    Array<u32> unreachable;    // branches shadowed by a previous one
+    Array<Symbol> missing;     // union variants without a branch
+    bool missing_none = false; // union match without a None branch
+};
+
+class MatchPlan {
+  public:
+    static constexpr u32 default_branch = u32(-1);
+
+    MatchStrategy strategy = MatchStrategy::linear;
+    MatchInfo info;
+
+    // select can replace the chain of tests
+    bool is_lookup() const {
+        return strategy == MatchStrategy::jump_table || strategy == MatchStrategy::binary_search;
+    }
+
+    // Branch taken for `target`, default_branch if none matches
+    u32 select(double target) const;
+
+    // Branch taken for the union variant `index`, -1 is None
+    u32 select_variant(int32 index) const;
+
+    // Expression to evaluate for the branch returned by select
+    static Expression *branch(Match const *x, u32 index) {
+        if(index == default_branch)
+            return x->default_branch;
+        return std::get<1>(x->branches[index]);
+    }
+
+  private:
+    double min = 0; // first value of the jump table
+    Array<u32> table;
+    Array<Tuple<double, u32>> sorted;
+
+    friend class MatchCompiler;
+};
+
+class MatchCompiler : public StaticExpressionVisitor<MatchCompiler, void> {
+  public:
+    // Jump tables are used when the range of the patterns is at most
+    // `density` times their number (small ranges always qualify)
+    MatchCompiler(double density = 4) : density(density) {}
+
+    // Compile every Match of `expr`
+    void compile(Expression *expr) { visit_expression(expr); }
+
+    // Compile every Match of the functions and expressions bound in `ctx`
+    void compile(Context const &ctx);
+
+    // Plan of a single Match
+    std::shared_ptr<MatchPlan const> plan(Match *x) const;
+
+    std::size_t compiled() const { return count; }
+
+    void function_call(FunctionCall *x);
+    void binary_call(BinaryCall *x);
+    void unary_call(UnaryCall *x);
+    void match(Match *x);
+    void block(Block *x);
+    void value(Value *) {}
+    void placeholder(Placeholder *) {}
+    void placeholder_ref(PlaceholderReference *) {}
+    void unhandled_expression(Expression *) {}
+    void nullptr_expression() {}
+
+  private:
+    bool compile_constants(Match *x, MatchPlan &plan) const;
+    bool compile_variants(Match *x, MatchPlan &plan) const;
+
+    double density;
+    std::size_t count = 0;
+};
+
+// Follow names through `ctx` to the union value `expr` evaluates to, nullptr if it is not one
+UnionValue *union_target(Context const &ctx, Expression *expr);
+
+// Compile the matches of `expr` and of everything bound in `ctx`
+inline void compile_matches(Context const &ctx, Expression *expr) {
+    MatchCompiler compiler;
+    compiler.compile(ctx);
+    compiler.compile(expr);
+}
+
+} // namespace kiwi
@@ -1,35 +1,330 @@
 ﻿#include "Operators.h"
 
-#include <cmath>
-
 namespace kiwi {
 
-    BinaryOperatorTable& binary_table() {
-        static BinaryOperatorTable op = {
-            { "+", [](double a, double b) { return a + b; } },
-            { "-", [](double a, double b) { return a - b; } },
-            { "*", [](double a, double b) { return a * b; } },
-            { "/", [](double a, double b) { return a / b; } },
-        };
-        return op;
+namespace {
+
+template <BinaryOp op> double binary_double(double a, double b) {
+    return apply_operator(op, a, b);
+}
+
+template <UnaryOp op> double unary_double(double a) { return apply_operator(op, a); }
+
+template <BinaryOp op, typename T> void binary_typed(void *dst, void const *lhs, void const *rhs) {
+    T a, b;
+    std::memcpy(&a, lhs, sizeof(T));
+    std::memcpy(&b, rhs, sizeof(T));
+    T r = apply_operator(op, a, b);
+    std::memcpy(dst, &r, sizeof(T));
+}
+
+template <UnaryOp op, typename T> void unary_typed(void *dst, void const *src) {
+    T a;
+    std::memcpy(&a, src, sizeof(T));
+    T r = apply_operator(op, a);
+    std::memcpy(dst, &r, sizeof(T));
+}
+
+template <typename T> BinaryKernel typed_binary_kernel(BinaryOp op) {
+    switch(op) {
+#define OP(id, str)                                                                                \
+    case BinaryOp::id:                                                                             \
+        return &binary_typed<BinaryOp::id, T>;
+        KIWI_BINARY_OPERATORS(OP)
+#undef OP
+    case BinaryOp::none:
+        return nullptr;
+    }
+    return nullptr;
+}
+
+template <typename T> UnaryKernel typed_unary_kernel(UnaryOp op) {
+    switch(op) {
+#define OP(id, str)                                                                                \
+    case UnaryOp::id:                                                                              \
+        if constexpr(has_operator<T>(UnaryOp::id))                                                 \
+            return &unary_typed<UnaryOp::id, T>;                                                   \
+        return nullptr;
+        KIWI_UNARY_OPERATORS(OP)
+#undef OP
+    case UnaryOp::none:
+        return nullptr;
+    }
+    return nullptr;
+}
+
+template <BinaryOp op, typename T>
+void binary_array(void *dst, void const *lhs, void const *rhs, std::size_t n, Broadcast scalar) {
+    T *out     = static_cast<T *>(dst);
+    T const *a = static_cast<T const *>(lhs);
+    T const *b = static_cast<T const *>(rhs);
+
+    switch(scalar) {
+    case Broadcast::none:
+        for(std::size_t i = 0; i < n; ++i)
+            out[i] = apply_operator(op, a[i], b[i]);
+        return;
+    case Broadcast::lhs: {
+        T x = a[0];
+        for(std::size_t i = 0; i < n; ++i)
+            out[i] = apply_operator(op, x, b[i]);
+        return;
+    }
+    case Broadcast::rhs: {
+        T y = b[0];
+        for(std::size_t i = 0; i < n; ++i)
+            out[i] = apply_operator(op, a[i], y);
+        return;
+    }
+    }
+}
+
+template <UnaryOp op, typename T> void unary_array(void *dst, void const *src, std::size_t n) {
+    T *out     = static_cast<T *>(dst);
+    T const *a = static_cast<T const *>(src);
+    for(std::size_t i = 0; i < n; ++i)
+        out[i] = apply_operator(op, a[i]);
+}
+
+template <typename From, typename To>
+void convert_array(void *dst, void const *src, std::size_t n) {
+    To *out       = static_cast<To *>(dst);
+    From const *a = static_cast<From const *>(src);
+
+    // 16 bit floats have SIMD conversions to f32
+    if constexpr(std::is_same<From, f16>::value && std::is_same<To, f32>::value)
+        return f16_to_f32(out, a, n);
+    if constexpr(std::is_same<From, f32>::value && std::is_same<To, f16>::value)
+        return f32_to_f16(out, a, n);
+    if constexpr(std::is_same<From, bf16>::value && std::is_same<To, f32>::value)
+        return bf16_to_f32(out, a, n);
+    if constexpr(std::is_same<From, f32>::value && std::is_same<To, bf16>::value)
+        return f32_to_bf16(out, a, n);
+
+    for(std::size_t i = 0; i < n; ++i)
+        out[i] = To(a[i]);
+}
+
+// mean is computed in f64, 16 bit floats in f32
+template <Reduction op, typename T>
+using Accumulator = std::conditional_t<
+    op == Reduction::mean, f64,
+    std::conditional_t<std::is_same<T, f16>::value || std::is_same<T, bf16>::value, f32, T>>;
+
+template <Reduction op, typename T> T combine(T a, T b) {
+    switch(op) {
+    case Reduction::sum:
+    case Reduction::mean:
+        return T(a + b);
+    case Reduction::prod:
+        return T(a * b);
+    case Reduction::min:
+        return b < a ? b : a;
+    case Reduction::max:
+        return a < b ? b : a;
+    case Reduction::none:
+        return a;
+    }
+    return a;
+}
+
+template <Reduction op, typename T> void reduce_array(void *dst, void const *src, std::size_t n) {
+    using Acc    = Accumulator<op, T>;
+    T const *a   = static_cast<T const *>(src);
+    Acc identity = Acc(op == Reduction::prod ? 1 : 0);
+    if((op == Reduction::min || op == Reduction::max) && n > 0)
+        identity = Acc(a[0]);
+
+    // independent partial results, the loop vectorizes without reordering additions
+    constexpr std::size_t lanes = 8;
+    Acc acc[lanes];
+    for(Acc &v : acc)
+        v = identity;
+
+    std::size_t i = 0;
+    for(; i + lanes <= n; i += lanes) {
+        for(std::size_t j = 0; j < lanes; ++j)
+            acc[j] = combine<op>(acc[j], Acc(a[i + j]));
+    }
+    for(; i < n; ++i)
+        acc[0] = combine<op>(acc[0], Acc(a[i]));
+
+    Acc result = acc[0];
+    for(std::size_t j = 1; j < lanes; ++j)
+        result = combine<op>(result, acc[j]);
+
+    if constexpr(op == Reduction::mean) {
+        f64 mean = n > 0 ? result / f64(n) : 0;
+        std::memcpy(dst, &mean, sizeof(f64));
+    } else {
+        T r = T(result);
+        std::memcpy(dst, &r, sizeof(T));
+    }
+}
+
+template <typename T> ArrayBinaryKernel typed_array_binary_kernel(BinaryOp op) {
+    switch(op) {
+#define OP(id, str)                                                                                \
+    case BinaryOp::id:                                                                             \
+        return &binary_array<BinaryOp::id, T>;
+        KIWI_BINARY_OPERATORS(OP)
+#undef OP
+    case BinaryOp::none:
+        return nullptr;
+    }
+    return nullptr;
+}
+
+template <typename T> ArrayUnaryKernel typed_array_unary_kernel(UnaryOp op) {
+    switch(op) {
+#define OP(id, str)                                                                                \
+    case UnaryOp::id:                                                                              \
+        if constexpr(has_operator<T>(UnaryOp::id))                                                 \
+            return &unary_array<UnaryOp::id, T>;                                                   \
+        return nullptr;
+        KIWI_UNARY_OPERATORS(OP)
+#undef OP
+    case UnaryOp::none:
+        return nullptr;
+    }
+    return nullptr;
+}
+
+template <typename From> ArrayConvertKernel typed_array_convert_kernel(PrimitiveTag to) {
+    switch(to) {
+#define X(type)                                                                                    \
+    case PrimitiveTag::type:                                                                       \
+        return &convert_array<From, type>;
+        KIWI_PRIMITIVE(X)
+#undef X
+    case PrimitiveTag::none:
+        return nullptr;
+    }
+    return nullptr;
+}
+
+template <typename T> ReduceKernel typed_reduce_kernel(Reduction op) {
+    switch(op) {
+#define OP(id, str)                                                                                \
+    case Reduction::id:                                                                            \
+        return &reduce_array<Reduction::id, T>;
+        KIWI_REDUCTIONS(OP)
+#undef OP
+    case Reduction::none:
+        return nullptr;
+    }
+    return nullptr;
+}
+
+// clang-format off
+BinaryOperator const binary_operators[] = {
+    nullptr,
+#define OP(id, str) &binary_double<BinaryOp::id>,
+    KIWI_BINARY_OPERATORS(OP)
+#undef OP
+};
+
+UnaryOperator const unary_operators[] = {
+    nullptr,
+#define OP(id, str) &unary_double<UnaryOp::id>,
+    KIWI_UNARY_OPERATORS(OP)
+#undef OP
+};
+// clang-format on
+
+} // namespace
+
+BinaryOperator binary_operator(BinaryOp op) { return binary_operators[u8(op)]; }
+
+UnaryOperator unary_operator(UnaryOp op) { return unary_operators[u8(op)]; }
+
+BinaryKernel binary_kernel(BinaryOp op, PrimitiveTag tag) {
+    switch(tag) {
+#define X(type)                                                                                    \
+    case PrimitiveTag::type:                                                                       \
+        return typed_binary_kernel<type>(op);
+        KIWI_PRIMITIVE(X)
+#undef X
+    case PrimitiveTag::none:
+        return nullptr;
     }
+    return nullptr;
+}
 
-    UnaryOperatorTable& unary_table() {
-        static UnaryOperatorTable op = {
-            { "ln",     [](double a) { return std::log(a); } },
-            { "exp",    [](double a) { return std::exp(a); } },
-            { "sqrt",   [](double a) { return std::sqrt(a); } },
-            { "return", [](double a) { return a; } },
-        };
-        return op;
+UnaryKernel unary_kernel(UnaryOp op, PrimitiveTag tag) {
+    switch(tag) {
+#define X(type)                                                                                    \
+    case PrimitiveTag::type:                                                                       \
+        return typed_unary_kernel<type>(op);
+        KIWI_PRIMITIVE(X)
+#undef X
+    case PrimitiveTag::none:
+        return nullptr;
     }
+    return nullptr;
+}
 
-    BinaryOperator& binary_operator(const std::string& name) {
-        return binary_table()[name];
+ArrayBinaryKernel array_binary_kernel(BinaryOp op, PrimitiveTag tag) {
+    switch(tag) {
+#define X(type)                                                                                    \
+    case PrimitiveTag::type:                                                                       \
+        return typed_array_binary_kernel<type>(op);
+        KIWI_PRIMITIVE(X)
+#undef X
+    case PrimitiveTag::none:
+        return nullptr;
     }
+    return nullptr;
+}
 
-    UnaryOperator& unary_operator(const std::string& name) {
-        return unary_table()[name];
+ArrayUnaryKernel array_unary_kernel(UnaryOp op, PrimitiveTag tag) {
+    switch(tag) {
+#define X(type)                                                                                    \
+    case PrimitiveTag::type:                                                                       \
+        return typed_array_unary_kernel<type>(op);
+        KIWI_PRIMITIVE(X)
+#undef X
+    case PrimitiveTag::none:
+        return nullptr;
     }
+    return nullptr;
+}
 
+ArrayConvertKernel array_convert_kernel(PrimitiveTag from, PrimitiveTag to) {
+    switch(from) {
+#define X(type)                                                                                    \
+    case PrimitiveTag::type:                                                                       \
+        return typed_array_convert_kernel<type>(to);
+        KIWI_PRIMITIVE(X)
+#undef X
+    case PrimitiveTag::none:
+        return nullptr;
+    }
+    return nullptr;
+}
+
+ReduceKernel reduce_kernel(Reduction op, PrimitiveTag tag) {
+    switch(tag) {
+#define X(type)                                                                                    \
+    case PrimitiveTag::type:                                                                       \
+        return typed_reduce_kernel<type>(op);
+        KIWI_PRIMITIVE(X)
+#undef X
+    case PrimitiveTag::none:
+        return nullptr;
+    }
+    return nullptr;
 }
+
+PrimitiveTag reduction_type(Reduction op, PrimitiveTag tag) {
+    switch(op) {
+    case Reduction::mean:
+        return PrimitiveTag::f64;
+    case Reduction::none:
+        return PrimitiveTag::none;
+    default:
+        return tag;
+    }
+}
+
+} // namespace kiwi
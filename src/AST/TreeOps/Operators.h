@@ -1,21 +1,116 @@
 ﻿#pragma once
 
-#include <iterator>
-#include <algorithm>
-#include <functional>
+#include <cmath>
+#include <limits>
+#include <type_traits>
 
 #include "../../Types.h"
+#include "../Operator.h"
+#include "../Primitive.h"
 
+/*
+ *  Operator kernels
+ *
+ *  Every operator (see Operator.h) has one kernel per primitive type,
+ *  kernels are nullptr when the operator is not defined for that type
+ *  (ln on integers).
+ */
 namespace kiwi {
-    using BinaryOperator = std::function<double(double, double)>;
-    using BinaryOperatorTable = Dict<String, BinaryOperator>;
 
-    using UnaryOperator = std::function<double(double)> ;
-    using UnaryOperatorTable = Dict<String, UnaryOperator>;
+// Apply an operator on a C++ type
+template <typename T> T apply_operator(BinaryOp op, T a, T b) {
+    switch(op) {
+    case BinaryOp::add:
+        return T(a + b);
+    case BinaryOp::sub:
+        return T(a - b);
+    case BinaryOp::mul:
+        return T(a * b);
+    case BinaryOp::div:
+        // integer division by zero is 0 and min / -1 wraps to min instead of undefined
+        if(std::is_integral<T>::value && b == T(0))
+            return T(0);
+        if(std::is_integral<T>::value && std::is_signed<T>::value && b == T(-1) &&
+           a == std::numeric_limits<T>::min())
+            return a;
+        return T(a / b);
+    case BinaryOp::none:
+        return T();
+    }
+    return T();
+}
 
-    BinaryOperatorTable& binary_table();
-    UnaryOperatorTable& unary_table();
+template <typename T> T apply_operator(UnaryOp op, T a) {
+    switch(op) {
+    case UnaryOp::neg:
+        return T(-a);
+    case UnaryOp::ln:
+        return T(std::log(a));
+    case UnaryOp::exp:
+        return T(std::exp(a));
+    case UnaryOp::sqrt:
+        return T(std::sqrt(a));
+    case UnaryOp::ret:
+        return a;
+    case UnaryOp::none:
+        return T();
+    }
+    return T();
+}
 
-    BinaryOperator& binary_operator(const String& name);
-    UnaryOperator& unary_operator(const String& name);
+// Is the operator defined for T
+template <typename T> constexpr bool has_operator(UnaryOp op) {
+    switch(op) {
+    case UnaryOp::neg:
+        return is_signed_type<T>::value;
+    case UnaryOp::ln:
+    case UnaryOp::exp:
+    case UnaryOp::sqrt:
+        return is_float_type<T>::value;
+    case UnaryOp::ret:
+        return true;
+    case UnaryOp::none:
+        return false;
+    }
+    return false;
 }
+
+// Operators on doubles, used by the evaluators
+using BinaryOperator = double (*)(double, double);
+using UnaryOperator  = double (*)(double);
+
+// nullptr for none
+BinaryOperator binary_operator(BinaryOp op);
+UnaryOperator unary_operator(UnaryOp op);
+
+// Typed kernels working on primitive storage, see load_primitive/store_primitive
+using BinaryKernel = void (*)(void *dst, void const *lhs, void const *rhs);
+using UnaryKernel  = void (*)(void *dst, void const *src);
+
+// nullptr if the operator is not defined for `tag`
+BinaryKernel binary_kernel(BinaryOp op, PrimitiveTag tag);
+UnaryKernel unary_kernel(UnaryOp op, PrimitiveTag tag);
+
+// Elementwise kernels on `n` contiguous values, the operator is fixed at
+// compile time so the loops vectorize
+// A scalar operand (Broadcast::lhs, Broadcast::rhs) is repeated for every element
+enum class Broadcast : u8 { none, lhs, rhs };
+
+using ArrayBinaryKernel  = void (*)(void *dst, void const *lhs, void const *rhs, std::size_t n,
+                                    Broadcast scalar);
+using ArrayUnaryKernel   = void (*)(void *dst, void const *src, std::size_t n);
+using ArrayConvertKernel = void (*)(void *dst, void const *src, std::size_t n);
+using ReduceKernel       = void (*)(void *dst, void const *src, std::size_t n);
+
+ArrayBinaryKernel array_binary_kernel(BinaryOp op, PrimitiveTag tag);
+ArrayUnaryKernel array_unary_kernel(UnaryOp op, PrimitiveTag tag);
+
+// Convert `n` values of `from` to `to`
+ArrayConvertKernel array_convert_kernel(PrimitiveTag from, PrimitiveTag to);
+
+// Reductions keep the type of the elements (16 bit floats are accumulated
+// in f32), mean is a f64. Empty arrays reduce to 0 (1 for prod)
+PrimitiveTag reduction_type(Reduction op, PrimitiveTag tag);
+ReduceKernel reduce_kernel(Reduction op, PrimitiveTag tag);
+
+} // namespace kiwi
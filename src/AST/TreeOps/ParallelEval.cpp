@@ -0,0 +1,278 @@
+#include "ParallelEval.h"
+
+#include "../../Logging/Log.h"
+#include "../Value.h"
+#include "MatchCompiler.h"
+
+#include <algorithm>
+#include <chrono>
+
+namespace kiwi {
+
+double EvalCost::estimate(Expression *expr) {
+    if(expr == nullptr)
+        return 0;
+
+    auto cached = estimates.find(expr);
+    if(cached != estimates.end())
+        return cached->second;
+
+    // provisional, a name bound to an expression that refers to it stops here
+    estimates[expr] = node_ns;
+
+    double result = node_ns;
+    switch(expr->tag) {
+    case NodeTag::function_call:
+        result = estimate_call(static_cast<FunctionCall *>(expr));
+        break;
+    case NodeTag::binary_call: {
+        BinaryCall *x = static_cast<BinaryCall *>(expr);
+        result += estimate(x->lhs) + estimate(x->rhs);
+        break;
+    }
+    case NodeTag::unary_call:
+        result += estimate(static_cast<UnaryCall *>(expr)->expr);
+        break;
+    case NodeTag::match: {
+        // pessimistic: every pattern and branch
+        Match *x = static_cast<Match *>(expr);
+        result += estimate(x->target) + estimate(x->default_branch);
+        for(auto &branch : x->branches)
+            result += estimate(std::get<0>(branch)) + estimate(std::get<1>(branch));
+        break;
+    }
+    case NodeTag::block:
+        for(Statement *stmt : static_cast<Block *>(expr)->statements) {
+            if(stmt != nullptr && stmt->is_expr())
+                result += estimate(static_cast<Expression *>(stmt));
+        }
+        break;
+    case NodeTag::placeholder:
+        result += estimate_name(static_cast<Placeholder *>(expr)->name);
+        break;
+    case NodeTag::placeholder_ref:
+        result += estimate_name(static_cast<PlaceholderReference *>(expr)->name);
+        break;
+    default:
+        break;
+    }
+
+    estimates[expr] = result;
+    return result;
+}
+
+double EvalCost::estimate_call(FunctionCall *x) {
+    double result = node_ns;
+    for(u64 i = 0; i < x->args_size(); ++i)
+        result += estimate(x->arg(i));
+
+    Symbol callee = callee_name(x->fun);
+    double known  = profile(callee);
+    if(known >= 0)
+        return result + known;
+
+    auto efun = ctx.find(callee);
+    if(efun == ctx.end() || efun->second == nullptr || efun->second->tag != NodeTag::function_def)
+        return result;
+
+    if(std::find(in_progress.begin(), in_progress.end(), callee) != in_progress.end())
+        return result + recursive_call_ns;
+
+    // the body is estimated once, whatever the call site
+    in_progress.push_back(callee);
+    Function *fun = static_cast<Function *>(efun->second);
+    if(fun->body != nullptr && fun->body->is_expr())
+        result += estimate(static_cast<Expression *>(fun->body));
+    in_progress.pop_back();
+
+    return result;
+}
+
+double EvalCost::estimate_name(Symbol name) {
+    auto result = ctx.find(name);
+    if(result == ctx.end() || result->second == nullptr ||
+       result->second->tag == NodeTag::placeholder || result->second->tag == NodeTag::function_def)
+        return 0;
+    return estimate(result->second);
+}
+
+double EvalCost::cached(Expression *expr) const {
+    auto result = estimates.find(expr);
+    return result == estimates.end() ? 0 : result->second;
+}
+
+void EvalCost::record(Symbol fun, double ns) {
+    std::lock_guard<std::mutex> guard(profile_lock);
+    Measure &measure = measures[fun];
+    measure.total += ns;
+    measure.count += 1;
+}
+
+double EvalCost::profile(Symbol fun) const {
+    std::lock_guard<std::mutex> guard(profile_lock);
+    auto result = measures.find(fun);
+    if(result == measures.end() || result->second.count == 0)
+        return -1;
+    return result->second.total / double(result->second.count);
+}
+
+void ParallelEval::evaluate(Expression *const *exprs, std::size_t n, double *out) {
+    std::size_t heavy_count = 0;
+    for(std::size_t i = 0; i < n; ++i)
+        heavy_count += heavy(exprs[i]);
+
+    if(heavy_count < 2 || forks >= max_forks || pool.pending() >= pool.size()) {
+        for(std::size_t i = 0; i < n; ++i)
+            out[i] = visit_expression(exprs[i]);
+        return;
+    }
+
+    // spawn the heavy ones but the last, it runs on this thread
+    WorkStealingPool::Group group;
+    forks += 1;
+
+    std::size_t inline_heavy = n;
+    for(std::size_t i = n; i > 0; --i) {
+        if(heavy(exprs[i - 1])) {
+            inline_heavy = i - 1;
+            break;
+        }
+    }
+
+    for(std::size_t i = 0; i < n; ++i) {
+        if(i == inline_heavy || !heavy(exprs[i]))
+            continue;
+
+        Expression *expr  = exprs[i];
+        double *result    = out + i;
+        ParallelEval eval = nested(ctx);
+        pool.spawn(group,
+                   [eval, expr, result]() mutable { *result = eval.visit_expression(expr); });
+    }
+
+    for(std::size_t i = 0; i < n; ++i) {
+        if(i == inline_heavy || !heavy(exprs[i]))
+            out[i] = visit_expression(exprs[i]);
+    }
+
+    pool.wait(group);
+    forks -= 1;
+}
+
+double ParallelEval::function_call(FunctionCall *x) {
+    Symbol callee = callee_name(x->fun);
+    auto efun     = ctx.find(callee);
+
+    if(efun == ctx.end() || efun->second == nullptr ||
+       efun->second->tag != NodeTag::function_def) {
+        log_error("Calling a non-function");
+        return 0;
+    }
+
+    Function *fun = static_cast<Function *>(efun->second);
+
+    if(fun->args_size() != x->args_size()) {
+        log_error("argument size mismatch:", fun->args_size(), " ", x->args_size());
+        return 0;
+    }
+
+    using Clock = std::chrono::steady_clock;
+    auto start  = profiling ? Clock::now() : Clock::time_point();
+
+    // arguments are evaluated in the caller's context
+    Array<double> values(x->args_size());
+    evaluate(x->args.data(), x->args_size(), values.data());
+
+    Array<PrimitiveValue> args;
+    args.reserve(values.size());
+    for(double value : values)
+        args.emplace_back(value);
+
+    Context fun_ctx = ctx;
+    for(u64 i = 0; i < fun->args_size(); ++i)
+        fun_ctx[std::get<0>(fun->arg(i))] = &args[i];
+
+    double result = nested(fun_ctx).visit_expression(static_cast<Expression *>(fun->body));
+
+    if(profiling)
+        cost.record(callee, std::chrono::duration<double, std::nano>(Clock::now() - start).count());
+    return result;
+}
+
+double ParallelEval::binary_call(BinaryCall *x) {
+    BinaryOperator op = binary_operator(x->op);
+    if(op == nullptr) {
+        log_error("Unknown binary operator ", callee_name(x->fun));
+        return 0;
+    }
+
+    Expression *operands[] = {x->lhs, x->rhs};
+    double values[2];
+    evaluate(operands, 2, values);
+    return op(values[0], values[1]);
+}
+
+double ParallelEval::unary_call(UnaryCall *x) {
+    UnaryOperator op = unary_operator(x->op);
+    if(op == nullptr) {
+        log_error("Unknown unary operator ", callee_name(x->fun));
+        return 0;
+    }
+    return op(visit_expression(x->expr));
+}
+
+// branches are evaluated lazily, in order
+double ParallelEval::match(Match *x) {
+    MatchPlan const *plan = x->plan.get();
+    // only a union value matches a variant, any other target takes the default branch
+    if(plan != nullptr && plan->strategy == MatchStrategy::union_tag) {
+        UnionValue *target = union_target(ctx, x->target);
+        u32 branch = target ? plan->select_variant(target->index) : MatchPlan::default_branch;
+        return visit_expression(MatchPlan::branch(x, branch));
+    }
+
+    double target = visit_expression(x->target);
+    if(plan != nullptr && plan->is_lookup())
+        return visit_expression(MatchPlan::branch(x, plan->select(target)));
+
+    for(auto &branch : x->branches) {
+        if(visit_expression(std::get<0>(branch)) == target)
+            return visit_expression(std::get<1>(branch));
+    }
+    return visit_expression(x->default_branch);
+}
+
+// value of the last expression
+double ParallelEval::block(Block *x) {
+    double result = 0;
+    for(Statement *stmt : x->statements) {
+        if(stmt != nullptr && stmt->is_expr())
+            result = visit_expression(static_cast<Expression *>(stmt));
+    }
+    return result;
+}
+
+double ParallelEval::name(Symbol name) {
+    auto result = ctx.find(name);
+    if(result == ctx.end()) {
+        log_error("Undefined variable ", name);
+        return 0;
+    }
+
+    if(depth >= max_depth) {
+        log_error("Recursive definition of ", name);
+        return 0;
+    }
+
+    depth += 1;
+    double value = visit_expression(result->second);
+    depth -= 1;
+    return value;
+}
+
+double ParallelEval::unhandled_expression(Expression *x) {
+    log_error("Cannot evaluate ", to_string(x->tag));
+    return 0;
+}
+
+} // namespace kiwi
@@ -0,0 +1,144 @@
+#pragma once
+
+#include <mutex>
+
+#include "../Expression.h"
+#include "../Module.h"
+#include "../Visitor.h"
+#include "../WorkStealingPool.h"
+
+#include "Operators.h"
+
+/*
+ *  Parallel evaluation
+ *
+ *  The operands of a call are independent: when at least two of them are
+ *  expensive, all but one are spawned on the pool and the last one is
+ *  evaluated inline. Cheap operands are always evaluated inline, a task
+ *  costs a few microseconds.
+ *
+ *  Every operator is applied once its operands are known, in the same
+ *  order as FullEval: results are bit for bit identical to the serial
+ *  evaluation whatever the scheduling.
+ *
+ *  EvalCost estimates subtrees from their size; function calls can be
+ *  estimated from measured durations instead (profile). The cost of a
+ *  recursive call is a guess, so every level of a recursion looks heavy:
+ *  forks nest at most `log2(threads) + 2` deep, and none are made while the
+ *  pool already has a task queued per thread. Below that everything runs
+ *  serially on the task that reached it.
+ */
+namespace kiwi {
+
+class EvalCost {
+  public:
+    static constexpr double node_ns = 4; // time to evaluate one node
+
+    // Guess for a recursive call whose depth is unknown,
+    // the fork depth of ParallelEval bounds the tasks it causes
+    double recursive_call_ns = 1e6;
+
+    EvalCost(Context const &ctx) : ctx(ctx) {}
+
+    // Estimated evaluation time in nanoseconds, estimates are cached
+    double estimate(Expression *expr);
+
+    // Cached estimate, 0 if `expr` was not estimated yet (thread safe)
+    double cached(Expression *expr) const;
+
+    // Record a measured call, the average replaces the size estimate
+    void record(Symbol fun, double ns);
+
+    // Average measured time of `fun`, negative if it was never measured
+    double profile(Symbol fun) const;
+
+    // Drop the cached estimates (after recording a profile)
+    void clear() { estimates.clear(); }
+
+  private:
+    double estimate_call(FunctionCall *x);
+    double estimate_name(Symbol name);
+
+    struct Measure {
+        double total = 0;
+        std::size_t count = 0;
+    };
+
+    Context const &ctx;
+    Dict<Expression *, double> estimates;
+    Array<Symbol> in_progress; // functions being estimated
+
+    mutable std::mutex profile_lock;
+    Dict<Symbol, Measure> measures;
+};
+
+class ParallelEval : public StaticExpressionVisitor<ParallelEval, double> {
+  public:
+    // Subtrees estimated under `threshold_ns` are never spawned
+    ParallelEval(Context const &ctx, WorkStealingPool &pool, EvalCost &cost,
+                 double threshold_ns = 20000) :
+        ctx(ctx),
+        pool(pool), cost(cost), threshold(threshold_ns), max_forks(fork_limit(pool.size())) {}
+
+    static double run(Context const &ctx, WorkStealingPool &pool, EvalCost &cost,
+                      Expression *expr, double threshold_ns = 20000) {
+        cost.estimate(expr);
+        return ParallelEval(ctx, pool, cost, threshold_ns).visit_expression(expr);
+    }
+
+    // Measure every function call and record it in `cost`
+    bool profiling = false;
+
+    double function_call(FunctionCall *x);
+    double binary_call(BinaryCall *x);
+    double unary_call(UnaryCall *x);
+    double match(Match *x);
+    double block(Block *x);
+    double value(Value *x) { return x->template as<f64>(); }
+    double placeholder(Placeholder *x) { return name(x->name); }
+    double placeholder_ref(PlaceholderReference *x) { return name(x->name); }
+    double unhandled_expression(Expression *x);
+    double nullptr_expression() { return 0; }
+
+  private:
+    bool heavy(Expression *expr) const { return cost.cached(expr) >= threshold; }
+
+    // enough nested forks to give every thread a few tasks
+    static std::size_t fork_limit(std::size_t threads) {
+        std::size_t levels = 0;
+        while((std::size_t(1) << levels) < threads)
+            levels += 1;
+        return levels + 2;
+    }
+
+    // Evaluate `exprs` into `out`, in parallel when more than one is heavy
+    void evaluate(Expression *const *exprs, std::size_t n, double *out);
+
+    // bound expressions are evaluated in place, at most `max_depth` names deep
+    double name(Symbol name);
+
+    ParallelEval nested(Context const &scope) const {
+        ParallelEval eval(scope, pool, cost, threshold);
+        eval.profiling = profiling;
+        eval.forks     = forks;
+        return eval;
+    }
+
+    Context const &ctx;
+    WorkStealingPool &pool;
+    EvalCost &cost;
+    double threshold;
+    std::size_t max_forks;
+    std::size_t forks = 0; // forks enclosing this evaluation
+
+    static constexpr int max_depth = 64;
+    int depth = 0;
+};
+
+inline double parallel_eval(Context const &ctx, WorkStealingPool &pool, Expression *expr,
+                            double threshold_ns = 20000) {
+    EvalCost cost(ctx);
+    return ParallelEval::run(ctx, pool, cost, expr, threshold_ns);
+}
+
+} // namespace kiwi
@@ -0,0 +1,344 @@
+#include "PartialEvalExpression.h"
+
+#include <cmath>
+
+namespace kiwi {
+namespace {
+
+bool is_leaf(Expression const *x) {
+    return x == nullptr || x->tag == NodeTag::value || x->tag == NodeTag::placeholder ||
+           x->tag == NodeTag::placeholder_ref;
+}
+
+// Size of a function body, the number of times each name is read and
+// whether it calls a function
+class BodyInfo : public StaticExpressionVisitor<BodyInfo, void> {
+  public:
+    std::size_t size = 0;
+    bool has_call    = false;
+    Dict<Symbol, std::size_t> uses;
+
+    void function_call(FunctionCall *x) {
+        size += 1;
+        has_call = true;
+        for(u64 i = 0; i < x->args_size(); ++i)
+            visit_expression(x->arg(i));
+    }
+
+    void binary_call(BinaryCall *x) {
+        size += 1;
+        visit_expression(x->lhs);
+        visit_expression(x->rhs);
+    }
+
+    void unary_call(UnaryCall *x) {
+        size += 1;
+        visit_expression(x->expr);
+    }
+
+    void match(Match *x) {
+        size += 1;
+        visit_expression(x->target);
+        for(auto &branch : x->branches) {
+            visit_expression(std::get<0>(branch));
+            visit_expression(std::get<1>(branch));
+        }
+        visit_expression(x->default_branch);
+    }
+
+    void block(Block *x) {
+        size += 1;
+        for(Statement *stmt : x->statements) {
+            if(stmt != nullptr && stmt->is_expr())
+                visit_expression(static_cast<Expression *>(stmt));
+        }
+    }
+
+    void value(Value *) { size += 1; }
+    void placeholder(Placeholder *x) { name(x->name); }
+    void placeholder_ref(PlaceholderReference *x) { name(x->name); }
+    void unhandled_expression(Expression *) { size += 1; }
+    void nullptr_expression() {}
+
+  private:
+    void name(Symbol name) {
+        size += 1;
+        uses[name] += 1;
+    }
+};
+
+// Replace the references to the parameters by the arguments
+class Substitute : public RewritePass<Substitute> {
+  public:
+    Substitute(Builder &builder, Context const &ctx, Dict<Symbol, Expression *> const &args) :
+        RewritePass(builder, ctx), args(args) {}
+
+    Expression *rewrite_name(Expression *x, Symbol name) {
+        auto arg = args.find(name);
+        return arg == args.end() ? x : arg->second;
+    }
+
+  private:
+    Dict<Symbol, Expression *> const &args;
+};
+
+// 2^k
+bool is_power_of_two(double v) {
+    int exponent;
+    return v != 0 && std::isfinite(v) && std::frexp(std::abs(v), &exponent) == 0.5;
+}
+
+PrimitiveValue const *primitive(Expression const *x) {
+    return static_cast<PrimitiveValue const *>(x);
+}
+
+// Constant of type `tag` stored at `src`
+Value *make_primitive(Builder &builder, PrimitiveTag tag, void const *src) {
+    // clang-format off
+    switch(tag) {
+    #define X(n)                                                                                   \
+    case PrimitiveTag::n:                                                                          \
+        return builder.make_value(load_primitive<n>(tag, src));
+    KIWI_PRIMITIVE(X)
+    #undef X
+    case PrimitiveTag::none:
+        break;
+    }
+    // clang-format on
+    return nullptr;
+}
+
+} // namespace
+
+// Operands are promoted to their common type, the kernel of that type folds them
+Expression *PartialEval::rewrite_binary(BinaryCall *x) {
+    if(x->op == BinaryOp::none || !is_constant(x->lhs) || !is_constant(x->rhs))
+        return x;
+
+    PrimitiveTag tag    = promote_primitive(primitive(x->lhs)->tag(), primitive(x->rhs)->tag());
+    BinaryKernel kernel = binary_kernel(x->op, tag);
+    if(kernel == nullptr)
+        return x;
+
+    u64 lhs = 0, rhs = 0, result = 0;
+    primitive(x->lhs)->store(tag, &lhs);
+    primitive(x->rhs)->store(tag, &rhs);
+    kernel(&result, &lhs, &rhs);
+    return rewritten(make_primitive(builder, tag, &result));
+}
+
+// ln, exp and sqrt of integers are computed in f64
+Expression *PartialEval::rewrite_unary(UnaryCall *x) {
+    if(x->op == UnaryOp::none || !is_constant(x->expr))
+        return x;
+
+    PrimitiveTag tag   = primitive(x->expr)->tag();
+    UnaryKernel kernel = unary_kernel(x->op, tag);
+    if(kernel == nullptr) {
+        tag    = PrimitiveTag::f64;
+        kernel = unary_kernel(x->op, tag);
+    }
+    if(kernel == nullptr)
+        return x;
+
+    u64 value = 0, result = 0;
+    primitive(x->expr)->store(tag, &value);
+    kernel(&result, &value);
+    return rewritten(make_primitive(builder, tag, &result));
+}
+
+Expression *PartialEval::rewrite_name(Expression *x, Symbol name) {
+    auto result = ctx.find(name);
+    if(result == ctx.end() || result->second == x || !is_constant(result->second))
+        return x;
+
+    return rewritten(result->second);
+}
+
+Expression *IdentityElimination::rewrite_binary(BinaryCall *x) {
+    switch(x->op) {
+    case BinaryOp::add:
+        if(is_constant(x->rhs, 0))
+            return rewritten(x->lhs);
+        if(is_constant(x->lhs, 0))
+            return rewritten(x->rhs);
+        break;
+    case BinaryOp::sub:
+        if(is_constant(x->rhs, 0))
+            return rewritten(x->lhs);
+        break;
+    case BinaryOp::mul:
+        if(is_constant(x->rhs, 1))
+            return rewritten(x->lhs);
+        if(is_constant(x->lhs, 1))
+            return rewritten(x->rhs);
+        if(is_constant(x->lhs, 0) || is_constant(x->rhs, 0))
+            return make_value(0);
+        break;
+    case BinaryOp::div:
+        if(is_constant(x->rhs, 1))
+            return rewritten(x->lhs);
+        break;
+    case BinaryOp::none:
+        break;
+    }
+    return x;
+}
+
+Expression *IdentityElimination::rewrite_unary(UnaryCall *x) {
+    if(x->op != UnaryOp::neg || x->expr == nullptr || x->expr->tag != NodeTag::unary_call)
+        return x;
+
+    UnaryCall *inner = static_cast<UnaryCall *>(x->expr);
+    if(inner->op != UnaryOp::neg)
+        return x;
+
+    return rewritten(inner->expr);
+}
+
+Expression *StrengthReduction::rewrite_binary(BinaryCall *x) {
+    switch(x->op) {
+    case BinaryOp::mul: {
+        // reading a leaf twice is cheaper than a multiplication
+        Expression *other = is_constant(x->rhs, 2) ? x->lhs : nullptr;
+        if(other == nullptr && is_constant(x->lhs, 2))
+            other = x->rhs;
+
+        if(other != nullptr && is_leaf(other))
+            return rewritten(builder.make_binary_call("+", other, other));
+        break;
+    }
+    case BinaryOp::div: {
+        // the reciprocal of a power of two is exact, unless it overflows (1 / 2^-1074)
+        if(!is_constant(x->rhs) || !is_power_of_two(constant(x->rhs)))
+            break;
+
+        // an integer divisor truncates
+        PrimitiveTag tag = primitive(x->rhs)->tag();
+        if(!is_floating_primitive(tag))
+            break;
+
+        // and must be exact in the type of the divisor
+        f64 reciprocal = 1.0 / constant(x->rhs);
+        u64 inverse    = 0;
+        store_primitive(tag, &inverse, reciprocal);
+        if(!std::isfinite(reciprocal) || load_primitive<f64>(tag, &inverse) != reciprocal)
+            break;
+
+        return rewritten(
+            builder.make_binary_call("*", x->lhs, make_primitive(builder, tag, &inverse)));
+    }
+    default:
+        break;
+    }
+    return x;
+}
+
+Expression *DeadBranchElimination::rewrite_match(Match *x) {
+    Array<Tuple<Expression *, Expression *>> branches;
+    branches.reserve(x->branches.size());
+
+    bool known_target     = is_constant(x->target);
+    Expression *otherwise = x->default_branch;
+    for(auto &branch : x->branches) {
+        Expression *pattern = std::get<0>(branch);
+
+        if(known_target && is_constant(pattern)) {
+            if(constant(pattern) != constant(x->target))
+                continue;
+
+            // the kept branches are tested first, the match is their default
+            if(branches.empty())
+                return rewritten(std::get<1>(branch));
+            otherwise = std::get<1>(branch);
+            break;
+        }
+
+        // shadowed by a previous branch with the same constant pattern
+        bool shadowed = false;
+        if(is_constant(pattern)) {
+            for(auto &previous : branches)
+                shadowed |= is_constant(std::get<0>(previous), constant(pattern));
+        }
+
+        if(!shadowed)
+            branches.push_back(branch);
+    }
+
+    if(branches.empty())
+        return rewritten(otherwise);
+
+    if(branches.size() == x->branches.size())
+        return x;
+
+    Match *result          = builder.make<Match>();
+    result->target         = x->target;
+    result->branches       = std::move(branches);
+    result->default_branch = otherwise;
+    return rewritten(result);
+}
+
+Expression *Inlining::rewrite_call(FunctionCall *x) {
+    auto efun = ctx.find(callee_name(x->fun));
+    if(efun == ctx.end() || efun->second == nullptr || efun->second->tag != NodeTag::function_def)
+        return x;
+
+    Function *fun = static_cast<Function *>(efun->second);
+    if(fun->args_size() != x->args_size() || fun->body == nullptr || !fun->body->is_expr())
+        return x;
+
+    Expression *body = static_cast<Expression *>(fun->body);
+
+    BodyInfo info;
+    info.visit_expression(body);
+    if(info.has_call || info.size > max_size)
+        return x;
+
+    Dict<Symbol, Expression *> args;
+    for(u64 i = 0; i < fun->args_size(); ++i) {
+        Symbol param = std::get<0>(fun->arg(i));
+
+        auto uses = info.uses.find(param);
+        if(uses != info.uses.end() && uses->second > 1 && !is_leaf(x->arg(i)))
+            return x;
+
+        args[param] = x->arg(i);
+    }
+
+    return rewritten(Substitute(builder, ctx, args).run(body));
+}
+
+Expression *Optimizer::run(Expression *expr) {
+    _iterations = 0;
+
+    while(_iterations < max_iterations) {
+        _iterations += 1;
+
+        std::size_t before = 0;
+        for(PassStats const &stat : _stats)
+            before += stat.rewrites;
+
+        expr = apply<PartialEval>(0, expr);
+        expr = apply<IdentityElimination>(1, expr);
+        expr = apply<StrengthReduction>(2, expr);
+        expr = apply<DeadBranchElimination>(3, expr);
+        if(inline_size > 0)
+            expr = apply<Inlining>(4, expr, inline_size);
+
+        std::size_t after = 0;
+        for(PassStats const &stat : _stats)
+            after += stat.rewrites;
+
+        if(after == before)
+            break;
+    }
+    return expr;
+}
+
+std::ostream &operator<<(std::ostream &out, Array<PassStats> const &stats) {
+    for(PassStats const &stat : stats)
+        out << stat.name << ": " << stat.rewrites << " rewrites in " << stat.runs << " runs\n";
+    return out;
+}
+
+} // namespace kiwi
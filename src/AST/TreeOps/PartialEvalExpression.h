@@ -5,108 +5,273 @@
 #include "../Builder.h"
 #include "../Expression.h"
 #include "../Module.h"
+#include "../Value.h"
 #include "../Visitor.h"
 
 #include "Operators.h"
 
+/*
+ *  Simplification passes
+ *
+ *  Every pass rewrites a tree bottom-up and returns the new root. Subtrees
+ *  that did not change are shared with the input, new nodes are allocated
+ *  through `builder` (hash-consed when it is): the result is a DAG and must
+ *  not be mutated in place.
+ *
+ *  Constants are folded in the type of their operands, promoted as in
+ *  TypedEval: 7 / 2 folds to 3 on integers.
+ *
+ *  Optimizer runs the passes in turn until none of them rewrites anything.
+ */
 namespace kiwi {
-/*/ Functions
+// Functions
 // ------------------------------------------------------------------------
 
+// Simplify `expr` with every pass until a fixpoint is reached
+Expression *optimize(Builder &builder, Context const &ctx, Expression *expr);
+
 // Implementation
 // ------------------------------------------------------------------------
-class PartialEval : public StaticVisitor<PartialEval, Expression *> {
+
+// Rebuild the nodes whose children changed, then give the pass a chance to
+// rewrite them through the `rewrite_*` hooks
+template <typename Impl> class RewritePass : public StaticExpressionVisitor<Impl, Expression *> {
   public:
-    PartialEval(const Context &ctx) : ctx(ctx) {}
+    RewritePass(Builder &builder, Context const &ctx) : builder(builder), ctx(ctx) {}
+
+    Expression *run(Expression *expr) { return this->visit_expression(expr); }
+
+    // Number of nodes rewritten
+    std::size_t rewrites = 0;
 
-    static Expression *run(const Context &ctx, Expression *expr) {
-        PartialEval eval(ctx);
-        return eval.traverse(expr);
+    Expression *binary_call(BinaryCall *x) {
+        Expression *lhs = this->visit_expression(x->lhs);
+        Expression *rhs = this->visit_expression(x->rhs);
+
+        if(lhs != x->lhs || rhs != x->rhs)
+            x = static_cast<BinaryCall *>(builder.make_binary_call(x->fun, lhs, rhs));
+        return impl().rewrite_binary(x);
     }
 
-    Expression *functio_decl(FunctionDeclaration *x) { return x->body; }
+    Expression *unary_call(UnaryCall *x) {
+        Expression *expr = this->visit_expression(x->expr);
 
-    Expression *function_call(FunctionCall *x) {
-        // we need to build a new context with the arguments
+        if(expr != x->expr)
+            x = static_cast<UnaryCall *>(builder.make_unary_call(x->fun, expr));
+        return impl().rewrite_unary(x);
+    }
 
-        // lookup the implementation
+    Expression *function_call(FunctionCall *x) {
+        Array<Expression *> args;
+        args.reserve(x->args_size());
 
-        // eval body with new context
+        bool changed = false;
+        for(u64 i = 0; i < x->args_size(); ++i) {
+            args.push_back(this->visit_expression(x->arg(i)));
+            changed |= args.back() != x->arg(i);
+        }
 
-        // return result
-        return x;
+        if(changed)
+            x = builder.make<FunctionCall>(x->fun, args);
+        return impl().rewrite_call(x);
     }
 
-    Tuple<i64, String> const &resolve_function_calle(Expression *fun) {
-        Expression *callee = traverse(fun);
-        if(callee->tag != NodeTag::placeholder) {
-            return std::make_tuple(1, "");
+    Expression *match(Match *x) {
+        Expression *target = this->visit_expression(x->target);
+        Expression *def    = this->visit_expression(x->default_branch);
+        bool changed       = target != x->target || def != x->default_branch;
+
+        Array<Tuple<Expression *, Expression *>> branches;
+        branches.reserve(x->branches.size());
+        for(auto &branch : x->branches) {
+            branches.emplace_back(this->visit_expression(std::get<0>(branch)),
+                                  this->visit_expression(std::get<1>(branch)));
+            changed |= branches.back() != branch;
+        }
+
+        if(changed) {
+            x                 = builder.make<Match>();
+            x->target         = target;
+            x->branches       = std::move(branches);
+            x->default_branch = def;
         }
-        String name = static_cast<Placeholder *>(callee)->name;
-        return std::make_tuple(0, name);
+        return impl().rewrite_match(x);
     }
 
-    Expression *unary_call(UnaryCall *x) {
-        Expression *expr = traverse(x->expr);
-
-        if(expr->tag == NodeTag::value) {
-            Value *vexpr = static_cast<Value *>(expr);
-            i64 code;
-            String name;
-            std::tie(code, name) = resolve_function_calle(x->fun);
-
-            if(code > 0) {
-                return Builder::error(
-                    "function should resolve to an identifier or a function type");
-            }
-            return Builder::value(unary_operator(name)(vexpr->template as<f64>()));
+    Expression *block(Block *x) {
+        Array<Statement *> statements;
+        statements.reserve(x->statements.size());
+
+        bool changed = false;
+        for(Statement *stmt : x->statements) {
+            if(stmt != nullptr && stmt->is_expr())
+                statements.push_back(this->visit_expression(static_cast<Expression *>(stmt)));
+            else
+                statements.push_back(stmt);
+            changed |= statements.back() != stmt;
         }
 
-        return Builder::unary_call(x->fun, expr);
+        if(!changed)
+            return x;
+
+        Block *result      = builder.make_block();
+        result->statements = std::move(statements);
+        return result;
     }
 
-    Expression *binary_call(BinaryCall *x) {
-        Expression *lhs = traverse(x->lhs);
-        Expression *rhs = traverse(x->rhs);
+    Expression *value(Value *x) { return x; }
+    Expression *placeholder(Placeholder *x) { return impl().rewrite_name(x, x->name); }
+    Expression *placeholder_ref(PlaceholderReference *x) { return impl().rewrite_name(x, x->name); }
+    Expression *unhandled_expression(Expression *x) { return x; }
+    Expression *nullptr_expression() { return nullptr; }
 
-        u64 code;
-        String name;
-        std::tie(code, name) = resolve_function_calle(x->fun);
+    // Hooks, the node's children are already rewritten
+    Expression *rewrite_binary(BinaryCall *x) { return x; }
+    Expression *rewrite_unary(UnaryCall *x) { return x; }
+    Expression *rewrite_call(FunctionCall *x) { return x; }
+    Expression *rewrite_match(Match *x) { return x; }
+    Expression *rewrite_name(Expression *x, Symbol) { return x; }
 
-        if(code > 0) {
-            return Builder::error("function should resolve to an identifier or a function type");
-        }
+  protected:
+    // Count the rewrite
+    Expression *rewritten(Expression *x) {
+        rewrites += 1;
+        return x;
+    }
 
-        if(lhs->tag == NodeTag::value && rhs->tag == NodeTag::value) {
-            Value *vlhs = static_cast<Value *>(lhs);
-            Value *vrhs = static_cast<Value *>(rhs);
+    Expression *make_value(double v) { return rewritten(builder.make_value(v)); }
 
-            return Builder::value(
-                binary_operator(name)(vlhs->template as<f64>(), vrhs->template as<f64>()));
-        }
+    static bool is_constant(Expression const *x) {
+        return x != nullptr && x->tag == NodeTag::value &&
+               static_cast<Value const *>(x)->value_tag == ValueTag::vprimitive;
+    }
 
-        return Builder::binary_call(x->fun, lhs, rhs);
+    static double constant(Expression const *x) {
+        return static_cast<Value const *>(x)->template as<f64>();
     }
 
-    Expression *borrow(Borrow *b) { return traverse(b->expr); }
+    static bool is_constant(Expression const *x, double v) {
+        return is_constant(x) && constant(x) == v;
+    }
 
-    Expression *value(Value *x) { return x; }
+    Builder &builder;
+    Context const &ctx;
 
-    Expression *placeholder(Placeholder *x) {
-        if(ctx.count(x->name) == 0)
-            return x;
+  private:
+    Impl &impl() { return static_cast<Impl &>(*this); }
+};
+
+// Fold operators applied to constants,
+// names bound to a primitive in `ctx` are constants
+class PartialEval : public RewritePass<PartialEval> {
+  public:
+    static constexpr char const *name = "constant-folding";
+
+    using RewritePass::RewritePass;
+
+    Expression *rewrite_binary(BinaryCall *x);
+    Expression *rewrite_unary(UnaryCall *x);
+    Expression *rewrite_name(Expression *x, Symbol name);
+};
+
+// x + 0, x - 0, x * 1, x / 1, x * 0, -(-x)
+// x * 0 assumes x is finite
+class IdentityElimination : public RewritePass<IdentityElimination> {
+  public:
+    static constexpr char const *name = "identities";
+
+    using RewritePass::RewritePass;
+
+    Expression *rewrite_binary(BinaryCall *x);
+    Expression *rewrite_unary(UnaryCall *x);
+};
+
+// x * 2 => x + x when x is a leaf, x / 2^k => x * 2^-k
+// the division is only rewritten for a floating point 2^k whose reciprocal
+// is finite in its type, integer divisions keep truncating
+class StrengthReduction : public RewritePass<StrengthReduction> {
+  public:
+    static constexpr char const *name = "strength-reduction";
+
+    using RewritePass::RewritePass;
+
+    Expression *rewrite_binary(BinaryCall *x);
+};
+
+// Select the branch of a match on a constant, drop unreachable branches
+class DeadBranchElimination : public RewritePass<DeadBranchElimination> {
+  public:
+    static constexpr char const *name = "dead-branches";
+
+    using RewritePass::RewritePass;
+
+    Expression *rewrite_match(Match *x);
+};
+
+// Replace calls to small functions by their body
+//
+// Only leaf functions (no calls in the body) are inlined so recursion cannot
+// unroll forever. An argument used more than once is only substituted if it
+// is a leaf, the others would be computed twice.
+class Inlining : public RewritePass<Inlining> {
+  public:
+    static constexpr char const *name = "inlining";
+
+    Inlining(Builder &builder, Context const &ctx, std::size_t max_size = 16) :
+        RewritePass(builder, ctx), max_size(max_size) {}
+
+    Expression *rewrite_call(FunctionCall *x);
+
+  private:
+    std::size_t max_size;
+};
+
+struct PassStats {
+    char const *name;
+    std::size_t rewrites = 0; // nodes rewritten, summed over the iterations
+    std::size_t runs     = 0;
+};
+
+class Optimizer {
+  public:
+    Optimizer(Builder &builder, Context const &ctx, std::size_t max_iterations = 16) :
+        builder(builder), ctx(ctx), max_iterations(max_iterations) {}
+
+    Expression *run(Expression *expr);
+
+    Array<PassStats> const &stats() const { return _stats; }
+
+    // Iterations of the last run, the last one did not rewrite anything
+    std::size_t iterations() const { return _iterations; }
+
+    // Largest body (in nodes) inlined, 0 disables inlining
+    std::size_t inline_size = 16;
+
+  private:
+    template <typename Pass, typename... Args>
+    Expression *apply(std::size_t index, Expression *expr, Args... args) {
+        Pass pass(builder, ctx, args...);
+        expr = pass.run(expr);
 
-        return traverse(ctx.at(x->name));
+        if(_stats.size() <= index)
+            _stats.resize(index + 1, PassStats{Pass::name});
+        _stats[index].rewrites += pass.rewrites;
+        _stats[index].runs += 1;
+        return expr;
     }
 
-    Expression *arrow(FunctionType *x) { return x; }
+    Builder &builder;
+    Context const &ctx;
+    std::size_t max_iterations;
 
-    Expression *type(Type *x) { return x; }
+    Array<PassStats> _stats;
+    std::size_t _iterations = 0;
+};
 
-    Expression *builtin(BuiltinType *e) { return e; }
+std::ostream &operator<<(std::ostream &out, Array<PassStats> const &stats);
 
-    Expression *error(ErrorNode *e) { return e; }
+inline Expression *optimize(Builder &builder, Context const &ctx, Expression *expr) {
+    return Optimizer(builder, ctx).run(expr);
+}
 
-    const Context &ctx;
-};*/
 } // namespace kiwi
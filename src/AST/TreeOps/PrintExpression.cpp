@@ -24,7 +24,6 @@ std::ostream &PrintType::struct_type(StructType *type, std::ostream &out, u64 de
 }
 
 std::ostream &PrintType::unhandled_type(Type *type, std::ostream &out, u64 depth) {
-    log_info("");
     return out << to_string(type->tag);
 }
 
@@ -81,8 +80,6 @@ std::ostream &PrintExpression::match(Match *m, std::ostream &out, u64 depth) {
 }
 
 std::ostream &PrintExpression::block(Block *b, std::ostream &out, u64 depth) {
-    log_info("");
-
     for(auto &item : b->statements) {
         out << std::string(depth * 4, ' ');
         PrintStatement().visit_statement(item, out, depth);
@@ -99,11 +96,16 @@ std::ostream &PrintExpression::placeholder(Placeholder *p, std::ostream &out, u6
     }
     return out;
 }
-std::ostream &PrintExpression::value(Value *, std::ostream &out, u64 depth) { return out; }
+std::ostream &PrintExpression::placeholder_ref(PlaceholderReference *ref, std::ostream &out,
+                                               u64 depth) {
+    return out << ref->name;
+}
+std::ostream &PrintExpression::value(Value *v, std::ostream &out, u64 depth) {
+    return v->dump(out);
+}
 
 std::ostream &PrintExpression::unhandled_expression(Expression *expr, std::ostream &out,
                                                     u64 depth) {
-    log_info("");
     return out << to_string(expr->tag);
 }
 
@@ -184,7 +186,6 @@ std::ostream &PrintDefinition::union_def(UnionDefinition *def, std::ostream &out
 }
 
 std::ostream &PrintDefinition::unhandled_definition(Definition *def, std::ostream &out, u64 depth) {
-    log_info("");
     return out << to_string(def->tag);
 }
 
@@ -9,60 +9,63 @@
 
 namespace kiwi {
 
-class PrintType : public TypeVisitor<std::ostream &, std::ostream &, u64> {
+class PrintType : public StaticTypeVisitor<PrintType, std::ostream &, std::ostream &, u64> {
   public:
-    std::ostream &builtin_type(BuiltinType *, std::ostream &out, u64 depth) override;
-    std::ostream &function_type(FunctionType *, std::ostream &out, u64 depth) override;
-    std::ostream &union_type(UnionType *, std::ostream &out, u64 depth) override;
-    std::ostream &struct_type(StructType *, std::ostream &out, u64 depth) override;
+    std::ostream &builtin_type(BuiltinType *, std::ostream &out, u64 depth);
+    std::ostream &function_type(FunctionType *, std::ostream &out, u64 depth);
+    std::ostream &union_type(UnionType *, std::ostream &out, u64 depth);
+    std::ostream &struct_type(StructType *, std::ostream &out, u64 depth);
 
-    std::ostream &unhandled_type(Type *, std::ostream &out, u64 depth) override;
-    std::ostream &nullptr_type(std::ostream &out, u64 depth) override;
+    std::ostream &unhandled_type(Type *, std::ostream &out, u64 depth);
+    std::ostream &nullptr_type(std::ostream &out, u64 depth);
 };
 
-class PrintExpression : public ExpressionVisitor<std::ostream &, std::ostream &, u64> {
+class PrintExpression
+    : public StaticExpressionVisitor<PrintExpression, std::ostream &, std::ostream &, u64> {
   public:
-    std::ostream &unary_call(UnaryCall *, std::ostream &out, u64 depth) override;
-    std::ostream &binary_call(BinaryCall *, std::ostream &out, u64 depth) override;
-    std::ostream &function_call(FunctionCall *, std::ostream &out, u64 depth) override;
-    std::ostream &match(Match *, std::ostream &out, u64 depth) override;
-    std::ostream &block(Block *, std::ostream &out, u64 depth) override;
-    std::ostream &placeholder(Placeholder *, std::ostream &out, u64 depth) override;
-    std::ostream &value(Value *, std::ostream &out, u64 depth) override;
-
-    std::ostream &unhandled_expression(Expression *, std::ostream &out, u64 depth) override;
-    std::ostream &nullptr_expression(std::ostream &out, u64 depth) override;
+    std::ostream &unary_call(UnaryCall *, std::ostream &out, u64 depth);
+    std::ostream &binary_call(BinaryCall *, std::ostream &out, u64 depth);
+    std::ostream &function_call(FunctionCall *, std::ostream &out, u64 depth);
+    std::ostream &match(Match *, std::ostream &out, u64 depth);
+    std::ostream &block(Block *, std::ostream &out, u64 depth);
+    std::ostream &placeholder(Placeholder *, std::ostream &out, u64 depth);
+    std::ostream &placeholder_ref(PlaceholderReference *, std::ostream &out, u64 depth);
+    std::ostream &value(Value *, std::ostream &out, u64 depth);
+
+    std::ostream &unhandled_expression(Expression *, std::ostream &out, u64 depth);
+    std::ostream &nullptr_expression(std::ostream &out, u64 depth);
 };
 
-class PrintDefinition : public DefinitionVisitor<std::ostream &, std::ostream &, u64> {
+class PrintDefinition
+    : public StaticDefinitionVisitor<PrintDefinition, std::ostream &, std::ostream &, u64> {
   public:
-    std::ostream &function_def(FunctionDefinition *, std::ostream &out, u64 depth) override;
-    std::ostream &macro_def(MacroDefinition *, std::ostream &out, u64 depth) override;
-    std::ostream &struct_def(StructDefinition *, std::ostream &out, u64 depth) override;
-    std::ostream &union_def(UnionDefinition *, std::ostream &out, u64 depth) override;
+    std::ostream &function_def(FunctionDefinition *, std::ostream &out, u64 depth);
+    std::ostream &macro_def(MacroDefinition *, std::ostream &out, u64 depth);
+    std::ostream &struct_def(StructDefinition *, std::ostream &out, u64 depth);
+    std::ostream &union_def(UnionDefinition *, std::ostream &out, u64 depth);
 
-    std::ostream &unhandled_definition(Definition *, std::ostream &out, u64 depth) override;
-    std::ostream &nullptr_definition(std::ostream &out, u64 depth) override;
+    std::ostream &unhandled_definition(Definition *, std::ostream &out, u64 depth);
+    std::ostream &nullptr_definition(std::ostream &out, u64 depth);
 };
 
-class PrintStatement : public StatementVisitor<std::ostream &, std::ostream &, u64> {
+class PrintStatement
+    : public StaticStatementVisitor<PrintStatement, std::ostream &, std::ostream &, u64> {
   public:
-    std::ostream &visit_type(Type *type, std::ostream &out, u64 depth) override {
+    std::ostream &visit_type(Type *type, std::ostream &out, u64 depth) {
         return PrintType().visit_type(type, out, depth);
     }
-    std::ostream &visit_definition(Definition *def, std::ostream &out, u64 depth) override {
+    std::ostream &visit_definition(Definition *def, std::ostream &out, u64 depth) {
         return PrintDefinition().visit_definition(def, out, depth);
     }
-    std::ostream &visit_expression(Expression *expr, std::ostream &out, u64 depth) override {
+    std::ostream &visit_expression(Expression *expr, std::ostream &out, u64 depth) {
         return PrintExpression().visit_expression(expr, out, depth);
     }
 
-    std::ostream &unhandled_statement(Statement *stmt, std::ostream &out, u64) override {
-        log_info(to_string(stmt->tag));
-        return out;
+    std::ostream &unhandled_statement(Statement *stmt, std::ostream &out, u64) {
+        return out << to_string(stmt->tag);
     }
 
-    std::ostream &nullptr_statement(std::ostream &out, u64) override {
+    std::ostream &nullptr_statement(std::ostream &out, u64) {
         return out << "NoneStatement(nullptr)";
     }
 };
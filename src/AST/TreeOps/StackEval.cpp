@@ -0,0 +1,238 @@
+#include "StackEval.h"
+
+#include "../../Logging/Log.h"
+
+namespace kiwi {
+
+StackEval::StackEval(Context const &ctx, std::size_t slots, std::size_t max_depth) :
+    ctx(ctx), slots(slots), scope(slots), depth_limit(max_depth) {
+    // grown on demand, never reallocated: the scope holds pointers to the boxes
+    boxes.reserve(slots);
+    frames.reserve(max_depth);
+    tasks.reserve(256);
+}
+
+double StackEval::run(Expression *expr) {
+    top      = 0;
+    failed   = false;
+    bindings = 0;
+    while(scope.frame() > 0)
+        scope.exit();
+    frames.clear();
+    tasks.clear();
+
+    schedule(TaskKind::eval, expr);
+    while(!tasks.empty() && !failed) {
+        Task task = tasks.back();
+        tasks.pop_back();
+        step(task);
+    }
+
+    if(failed || top == 0)
+        return 0;
+    return slots[top - 1];
+}
+
+void StackEval::fail(char const *reason) {
+    log_error(reason, " (slots: ", slots.size(), ", frames: ", frames.size(), ")");
+    failed = true;
+}
+
+void StackEval::step(Task const &task) {
+    switch(task.kind) {
+    case TaskKind::eval:
+        return visit_expression(task.expr);
+
+    case TaskKind::binary: {
+        double b = pop();
+        double a = pop();
+        return push(binary_operator(static_cast<BinaryCall *>(task.expr)->op)(a, b));
+    }
+
+    case TaskKind::unary:
+        return push(unary_operator(static_cast<UnaryCall *>(task.expr)->op)(pop()));
+
+    case TaskKind::call:
+        return call(static_cast<FunctionCall *>(task.expr));
+
+    case TaskKind::ret: {
+        double result = pop();
+        top           = frames.back().top;
+        frames.pop_back();
+        scope.exit();
+        return push(result);
+    }
+
+    case TaskKind::match_next: {
+        Match *x = static_cast<Match *>(task.expr);
+        if(task.index < x->branches.size()) {
+            schedule(TaskKind::match_test, x, task.index);
+            return schedule(TaskKind::eval, std::get<0>(x->branches[task.index]));
+        }
+        pop();
+        return schedule(TaskKind::eval, x->default_branch);
+    }
+
+    case TaskKind::match_test: {
+        Match *x       = static_cast<Match *>(task.expr);
+        double pattern = pop();
+
+        if(pattern == slots[top - 1]) {
+            pop();
+            return schedule(TaskKind::eval, std::get<1>(x->branches[task.index]));
+        }
+        return schedule(TaskKind::match_next, x, task.index + 1);
+    }
+
+    // the result of the previous statement is on the stack
+    case TaskKind::block_next: {
+        Block *x = static_cast<Block *>(task.expr);
+        for(u32 i = task.index; i < x->statements.size(); ++i) {
+            Statement *stmt = x->statements[i];
+            if(stmt == nullptr || !stmt->is_expr())
+                continue;
+
+            pop();
+            schedule(TaskKind::block_next, x, i + 1);
+            return schedule(TaskKind::eval, static_cast<Expression *>(stmt));
+        }
+        return;
+    }
+
+    case TaskKind::unbind:
+        bindings -= 1;
+        return;
+    }
+}
+
+// operands are evaluated left to right, tasks run in reverse order
+void StackEval::binary_call(BinaryCall *x) {
+    if(x->op == BinaryOp::none) {
+        log_error("Unknown binary operator ", callee_name(x->fun));
+        return push(0);
+    }
+
+    schedule(TaskKind::binary, x);
+    schedule(TaskKind::eval, x->rhs);
+    schedule(TaskKind::eval, x->lhs);
+}
+
+void StackEval::unary_call(UnaryCall *x) {
+    if(x->op == UnaryOp::none) {
+        log_error("Unknown unary operator ", callee_name(x->fun));
+        return push(0);
+    }
+
+    schedule(TaskKind::unary, x);
+    schedule(TaskKind::eval, x->expr);
+}
+
+void StackEval::function_call(FunctionCall *x) {
+    schedule(TaskKind::call, x);
+    for(u64 i = x->args_size(); i > 0; --i)
+        schedule(TaskKind::eval, x->arg(i - 1));
+}
+
+void StackEval::call(FunctionCall *x) {
+    std::size_t n = x->args_size();
+    auto efun     = ctx.find(callee_name(x->fun));
+
+    if(efun == ctx.end() || efun->second == nullptr ||
+       efun->second->tag != NodeTag::function_def) {
+        log_error("Calling a non-function");
+        top -= n;
+        return push(0);
+    }
+
+    Function *fun = static_cast<Function *>(efun->second);
+
+    if(fun->args_size() != n) {
+        log_error("argument size mismatch:", fun->args_size(), " ", n);
+        top -= n;
+        return push(0);
+    }
+
+    if(frames.size() == depth_limit)
+        return fail("Call depth exceeded");
+
+    if(scope.size() + n > boxes.capacity())
+        return fail("Stack overflow");
+
+    // the body is nested in the global scope, whoever the caller is
+    top -= n;
+    scope.enter(0);
+    for(std::size_t i = 0; i < n; ++i) {
+        std::size_t slot = scope.size();
+        if(slot == boxes.size())
+            boxes.emplace_back(0.0);
+
+        boxes[slot].set_value(slots[top + i]);
+        scope.push(&boxes[slot]);
+    }
+
+    frames.push_back(Frame{fun, top});
+    schedule(TaskKind::ret, x);
+    schedule(TaskKind::eval, static_cast<Expression *>(fun->body));
+}
+
+void StackEval::match(Match *x) {
+    schedule(TaskKind::match_next, x, 0);
+    schedule(TaskKind::eval, x->target);
+}
+
+// value of the last expression
+void StackEval::block(Block *x) {
+    push(0);
+    schedule(TaskKind::block_next, x, 0);
+}
+
+// references to the arguments are resolved to their slot
+void StackEval::placeholder_ref(PlaceholderReference *x) {
+    if(x->is_resolved() && x->depth == 0 && !frames.empty()) {
+        Frame const &frame = frames.back();
+        u64 slot           = u64(x->index);
+
+        if(slot < frame.fun->args_size() && std::get<0>(frame.fun->arg(slot)) == x->name)
+            return push(arg(slot));
+    }
+    name(x->name);
+}
+
+void StackEval::name(Symbol name) {
+    if(!frames.empty()) {
+        Frame const &frame = frames.back();
+        for(u64 i = 0; i < frame.fun->args_size(); ++i) {
+            if(std::get<0>(frame.fun->arg(i)) == name)
+                return push(arg(i));
+        }
+    }
+
+    auto result = ctx.find(name);
+    if(result == ctx.end()) {
+        log_error("Undefined variable ", name);
+        return push(0);
+    }
+
+    Expression *expr = result->second;
+    if(expr == nullptr) {
+        log_error("Undefined variable ", name);
+        return push(0);
+    }
+
+    if(bindings >= max_bindings) {
+        log_error("Recursive definition of ", name);
+        failed = true;
+        return;
+    }
+
+    bindings += 1;
+    schedule(TaskKind::unbind, expr);
+    schedule(TaskKind::eval, expr);
+}
+
+void StackEval::unhandled_expression(Expression *x) {
+    log_error("Cannot evaluate ", to_string(x->tag));
+    push(0);
+}
+
+} // namespace kiwi
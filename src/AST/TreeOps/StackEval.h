@@ -0,0 +1,117 @@
+#pragma once
+
+#include "../Expression.h"
+#include "../Module.h"
+#include "../Value.h"
+#include "../Visitor.h"
+
+#include "Operators.h"
+
+/*
+ *  Evaluation without native recursion
+ *
+ *  Arguments live in a GlobalScope: a call enters a frame nested in the
+ *  global scope (functions are defined at the top level) and pushes its
+ *  arguments, resolved references read them back with `get(depth, slot)`.
+ *  The arguments are boxed in a preallocated pool of PrimitiveValue, one per
+ *  slot of the scope, so no Context is built and nothing is allocated per call.
+ *  Temporaries are kept on a separate operand stack of doubles.
+ *
+ *  Pending work is kept in an explicit task stack instead of the C++ stack,
+ *  the visitor handlers only schedule tasks. Call depth is bounded by the
+ *  configured number of slots and frames, exceeding them stops the
+ *  evaluation with an error instead of crashing.
+ *
+ *  Names are resolved in the arguments of the current frame, then in `ctx`.
+ */
+namespace kiwi {
+
+class StackEval : public StaticExpressionVisitor<StackEval, void> {
+  public:
+    StackEval(Context const &ctx, std::size_t slots = 1 << 16, std::size_t max_depth = 1 << 14);
+
+    double run(Expression *expr);
+
+    // false if the last run ran out of slots or frames
+    bool ok() const { return !failed; }
+
+    void binary_call(BinaryCall *x);
+    void unary_call(UnaryCall *x);
+    void function_call(FunctionCall *x);
+    void match(Match *x);
+    void block(Block *x);
+    void value(Value *x) { push(x->template as<f64>()); }
+    void placeholder(Placeholder *x) { name(x->name); }
+    void placeholder_ref(PlaceholderReference *x);
+    void unhandled_expression(Expression *x);
+    void nullptr_expression() { push(0); }
+
+  private:
+    enum class TaskKind : u8 {
+        eval,       // evaluate `expr`
+        binary,     // pop two operands, push the result
+        unary,      // pop one operand, push the result
+        call,       // arguments are on the stack, enter the function
+        ret,        // keep the result, drop the frame
+        match_next, // target is on the stack, test the pattern `index`
+        match_test, // pattern `index` is on top of the target
+        block_next, // run the statements from `index`
+        unbind,     // the value of a bound name is on the stack
+    };
+
+    struct Task {
+        TaskKind kind;
+        Expression *expr;
+        u32 index;
+    };
+
+    struct Frame {
+        Function *fun;
+        std::size_t top; // operand stack when the call started
+    };
+
+    void step(Task const &task);
+    void call(FunctionCall *x);
+    void name(Symbol name);
+
+    // argument `slot` of the current frame
+    double arg(std::size_t slot) { return static_cast<Value *>(scope.get(0, slot))->as<f64>(); }
+
+    void schedule(TaskKind kind, Expression *expr, u32 index = 0) {
+        tasks.push_back(Task{kind, expr, index});
+    }
+
+    void push(double v) {
+        if(top == slots.size())
+            return fail("Stack overflow");
+        slots[top++] = v;
+    }
+
+    double pop() { return slots[--top]; }
+
+    void fail(char const *reason);
+
+    Context const &ctx;
+
+    // operands
+    Array<double> slots;
+    std::size_t top = 0;
+
+    // arguments, `boxes[i]` is bound to the slot `i` of the scope
+    GlobalScope scope;
+    Array<PrimitiveValue> boxes;
+
+    Array<Frame> frames;
+    std::size_t depth_limit;
+
+    Array<Task> tasks;
+    bool failed = false;
+
+    // names being resolved, bindings are followed at most `max_bindings` deep
+    static constexpr int max_bindings = 64;
+    int bindings = 0;
+};
+
+inline double stack_eval(Context const &ctx, Expression *expr) { return StackEval(ctx).run(expr); }
+
+} // namespace kiwi
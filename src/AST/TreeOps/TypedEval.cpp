@@ -0,0 +1,486 @@
+#include "TypedEval.h"
+
+#include "../../Logging/Log.h"
+
+namespace kiwi {
+namespace {
+
+template <typename From, typename To> void convert_typed(void *dst, void const *src) {
+    From a;
+    std::memcpy(&a, src, sizeof(From));
+    To r = To(a);
+    std::memcpy(dst, &r, sizeof(To));
+}
+
+template <typename T> bool equal_typed(void const *lhs, void const *rhs) {
+    T a, b;
+    std::memcpy(&a, lhs, sizeof(T));
+    std::memcpy(&b, rhs, sizeof(T));
+    return a == b;
+}
+
+template <typename From> ConvertKernel typed_convert_kernel(PrimitiveTag to) {
+    switch(to) {
+#define X(n)                                                                                       \
+    case PrimitiveTag::n:                                                                          \
+        return &convert_typed<From, n>;
+        KIWI_PRIMITIVE(X)
+#undef X
+    case PrimitiveTag::none:
+        return nullptr;
+    }
+    return nullptr;
+}
+
+// nullptr if either type is none
+ConvertKernel convert_kernel(PrimitiveTag from, PrimitiveTag to) {
+    switch(from) {
+#define X(n)                                                                                       \
+    case PrimitiveTag::n:                                                                          \
+        return typed_convert_kernel<n>(to);
+        KIWI_PRIMITIVE(X)
+#undef X
+    case PrimitiveTag::none:
+        return nullptr;
+    }
+    return nullptr;
+}
+
+EqualKernel equal_kernel(PrimitiveTag tag) {
+    switch(tag) {
+#define X(n)                                                                                       \
+    case PrimitiveTag::n:                                                                          \
+        return &equal_typed<n>;
+        KIWI_PRIMITIVE(X)
+#undef X
+    case PrimitiveTag::none:
+        return nullptr;
+    }
+    return nullptr;
+}
+
+// Type of a value made of both, none is unknown (recursive call being compiled)
+PrimitiveTag join(PrimitiveTag a, PrimitiveTag b) {
+    if(a == PrimitiveTag::none)
+        return b;
+    if(b == PrimitiveTag::none)
+        return a;
+    return promote_primitive(a, b);
+}
+
+// Compile an expression into the nodes of a specialization, return the root
+class TypedCompiler : public StaticExpressionVisitor<TypedCompiler, u32> {
+  public:
+    TypedCompiler(TypedEval &eval, Specialization &spec) : eval(eval), spec(spec) {}
+
+    u32 binary_call(BinaryCall *x) {
+        u32 lhs = visit_expression(x->lhs);
+        u32 rhs = visit_expression(x->rhs);
+
+        // literals take the type of the other operand
+        PrimitiveTag tag = join(tag_of(lhs), tag_of(rhs));
+        if(is_literal(lhs) && !is_literal(rhs))
+            tag = tag_of(rhs);
+        else if(is_literal(rhs) && !is_literal(lhs))
+            tag = tag_of(lhs);
+        else if(tag == PrimitiveTag::none && is_literal(lhs))
+            tag = PrimitiveTag::f64;
+
+        TypedNode node = make_node(TypedOp::binary, tag);
+        node.a         = convert(lhs, tag);
+        node.b         = convert(rhs, tag);
+        node.binary    = binary_kernel(x->op, tag);
+
+        if(node.binary == nullptr && tag != PrimitiveTag::none)
+            return error("Operator ", to_string(x->op), " is not defined for ",
+                         get_primitive_name(tag));
+        return add(node);
+    }
+
+    u32 unary_call(UnaryCall *x) {
+        u32 expr         = visit_expression(x->expr);
+        PrimitiveTag tag = tag_of(expr);
+
+        // ln, exp and sqrt of integers
+        if(unary_kernel(x->op, tag) == nullptr && (tag != PrimitiveTag::none || is_literal(expr)))
+            tag = PrimitiveTag::f64;
+
+        TypedNode node = make_node(TypedOp::unary, tag);
+        node.a         = convert(expr, tag);
+        node.unary     = unary_kernel(x->op, tag);
+
+        if(node.unary == nullptr && tag != PrimitiveTag::none)
+            return error("Operator ", to_string(x->op), " is not defined for ",
+                         get_primitive_name(tag));
+        return add(node);
+    }
+
+    u32 function_call(FunctionCall *x) {
+        Symbol callee = callee_name(x->fun);
+        auto efun     = eval.context().find(callee);
+
+        if(efun == eval.context().end() || efun->second == nullptr ||
+           efun->second->tag != NodeTag::function_def)
+            return error("Calling a non-function ", callee);
+
+        Function *fun = static_cast<Function *>(efun->second);
+        if(fun->args_size() != x->args_size())
+            return error("argument size mismatch:", fun->args_size(), " ", x->args_size());
+
+        Array<u32> args;
+        Array<PrimitiveTag> types;
+        for(u64 i = 0; i < x->args_size(); ++i) {
+            args.push_back(visit_expression(x->arg(i)));
+            types.push_back(tag_of(args.back()));
+        }
+
+        Specialization *target = eval.specialize(fun, types);
+        if(target == nullptr)
+            return error("Cannot specialize ", callee);
+
+        // the result type is a guess until the target is compiled
+        if(target->compiling)
+            target->guessed = true;
+
+        TypedNode node = make_node(TypedOp::call, target->result);
+        node.callee    = target;
+        return add_children(node, args);
+    }
+
+    u32 match(Match *x) {
+        u32 target       = visit_expression(x->target);
+        PrimitiveTag tag = tag_of(target);
+        if(tag == PrimitiveTag::none && is_literal(target)) {
+            tag    = PrimitiveTag::f64;
+            target = convert(target, tag);
+        }
+
+        Array<u32> children;
+        PrimitiveTag result = PrimitiveTag::none;
+        for(auto &branch : x->branches) {
+            children.push_back(convert(visit_expression(std::get<0>(branch)), tag));
+            children.push_back(visit_expression(std::get<1>(branch)));
+            result = join(result, tag_of(children.back()));
+        }
+
+        u32 otherwise = visit_expression(x->default_branch);
+        result        = join(result, tag_of(otherwise));
+
+        for(std::size_t i = 1; i < children.size(); i += 2)
+            children[i] = convert(children[i], result);
+
+        TypedNode node = make_node(TypedOp::match, result);
+        node.a         = target;
+        node.b         = convert(otherwise, result);
+        node.equal     = equal_kernel(tag);
+        node.count     = u32(x->branches.size());
+        node.first     = u32(spec.children.size());
+        spec.children.insert(spec.children.end(), children.begin(), children.end());
+        return add(node);
+    }
+
+    u32 block(Block *x) {
+        Array<u32> children;
+        for(Statement *stmt : x->statements) {
+            if(stmt != nullptr && stmt->is_expr())
+                children.push_back(visit_expression(static_cast<Expression *>(stmt)));
+        }
+
+        PrimitiveTag tag = children.empty() ? PrimitiveTag::none : tag_of(children.back());
+        return add_children(make_node(TypedOp::block, tag), children);
+    }
+
+    u32 value(Value *x) {
+        if(x->value_tag != ValueTag::vprimitive)
+            return error("Cannot evaluate a non primitive value");
+
+        PrimitiveValue *v = static_cast<PrimitiveValue *>(x);
+        TypedNode node    = make_node(TypedOp::constant, v->tag());
+        v->store(v->tag(), &node.constant);
+        return add(node);
+    }
+
+    u32 placeholder(Placeholder *x) { return name(x->name); }
+    u32 placeholder_ref(PlaceholderReference *x) { return name(x->name); }
+
+    u32 unhandled_expression(Expression *x) { return error("Cannot evaluate ", to_string(x->tag)); }
+
+    u32 nullptr_expression() { return add(make_node(TypedOp::constant, PrimitiveTag::none)); }
+
+  private:
+    u32 name(Symbol name) {
+        // arguments shadow the context
+        if(spec.fun != nullptr) {
+            for(u64 i = 0; i < spec.fun->args_size(); ++i) {
+                if(std::get<0>(spec.fun->arg(i)) == name) {
+                    TypedNode node = make_node(TypedOp::arg, spec.args[i]);
+                    node.a         = u32(i);
+                    return add(node);
+                }
+            }
+        }
+
+        auto result = eval.context().find(name);
+        if(result == eval.context().end() || result->second == nullptr)
+            return error("Undefined variable ", name);
+
+        Expression *expr = result->second;
+        if(expr->tag == NodeTag::value &&
+           static_cast<Value *>(expr)->value_tag == ValueTag::vprimitive) {
+            PrimitiveValue *v = static_cast<PrimitiveValue *>(expr);
+            TypedNode node    = make_node(TypedOp::global, v->tag());
+            node.global       = name.id();
+            return add(node);
+        }
+
+        if(expr->tag == NodeTag::function_def)
+            return error("Cannot use the function ", name, " as a value");
+
+        // bound expressions are compiled in place
+        if(depth >= max_depth)
+            return error("Recursive definition of ", name);
+
+        depth += 1;
+        u32 node = visit_expression(expr);
+        depth -= 1;
+        return node;
+    }
+
+    // Insert a conversion, literals are converted now
+    u32 convert(u32 index, PrimitiveTag tag) {
+        TypedNode source = spec.nodes[index];
+        if(source.tag == tag || tag == PrimitiveTag::none)
+            return index;
+
+        if(source.op == TypedOp::constant) {
+            TypedNode node = make_node(TypedOp::constant, tag);
+            if(source.tag != PrimitiveTag::none)
+                convert_kernel(source.tag, tag)(&node.constant, &source.constant);
+            return add(node);
+        }
+
+        // unknown type (recursion), the specialization is compiled again
+        if(source.tag == PrimitiveTag::none)
+            return index;
+
+        TypedNode node = make_node(TypedOp::convert, tag);
+        node.a         = index;
+        node.convert   = convert_kernel(source.tag, tag);
+        return add(node);
+    }
+
+    PrimitiveTag tag_of(u32 index) const { return spec.nodes[index].tag; }
+
+    bool is_literal(u32 index) const { return spec.nodes[index].op == TypedOp::constant; }
+
+    static TypedNode make_node(TypedOp op, PrimitiveTag tag) {
+        TypedNode node;
+        node.op  = op;
+        node.tag = tag;
+        return node;
+    }
+
+    u32 add(TypedNode const &node) {
+        spec.nodes.push_back(node);
+        return u32(spec.nodes.size() - 1);
+    }
+
+    u32 add_children(TypedNode node, Array<u32> const &children) {
+        node.first = u32(spec.children.size());
+        node.count = u32(children.size());
+        spec.children.insert(spec.children.end(), children.begin(), children.end());
+        return add(node);
+    }
+
+    template <typename... Args> u32 error(Args &&... args) {
+        log_error(std::forward<Args>(args)...);
+        eval.fail();
+        return add(make_node(TypedOp::constant, PrimitiveTag::none));
+    }
+
+    static constexpr int max_depth = 64;
+
+    TypedEval &eval;
+    Specialization &spec;
+    int depth = 0;
+};
+
+} // namespace
+
+Specialization *TypedEval::specialize(Function *fun, Array<PrimitiveTag> const &args) {
+    Key key{fun, args};
+    auto cached = cache.find(key);
+    if(cached != cache.end())
+        return cached->second.get();
+
+    Specialization *spec = new Specialization();
+    cache[key]           = UniquePtr<Specialization>(spec);
+    order.push_back(key);
+
+    spec->fun       = fun;
+    spec->args      = args;
+    spec->compiling = true;
+
+    // specializations compiled from this one might depend on its result type
+    std::size_t mark = order.size();
+    Expression *body = fun->body != nullptr && fun->body->is_expr()
+                           ? static_cast<Expression *>(fun->body)
+                           : nullptr;
+
+    for(int i = 0; i < 8; ++i) {
+        spec->nodes.clear();
+        spec->children.clear();
+        spec->guessed = false;
+        spec->root    = TypedCompiler(*this, *spec).visit_expression(body);
+
+        PrimitiveTag result = spec->nodes[spec->root].tag;
+        if(!spec->guessed || result == spec->result) {
+            spec->result    = result;
+            spec->compiling = false;
+            break;
+        }
+
+        spec->result = result;
+        for(std::size_t j = mark; j < order.size(); ++j)
+            cache.erase(order[j]);
+        order.resize(mark);
+    }
+
+    if(spec->compiling || spec->result == PrimitiveTag::none) {
+        log_error("Cannot infer the result type of a function");
+        for(std::size_t j = mark - 1; j < order.size(); ++j)
+            cache.erase(order[j]);
+        order.resize(mark - 1);
+        fail();
+        return nullptr;
+    }
+    return spec;
+}
+
+TypedValue TypedEval::run(Expression *expr) {
+    failed = false;
+
+    Specialization entry;
+    entry.root = TypedCompiler(*this, entry).visit_expression(expr);
+    if(failed)
+        return TypedValue();
+
+    entry.result = entry.nodes[entry.root].tag;
+    return execute(entry);
+}
+
+TypedValue TypedEval::call(Symbol name, Array<TypedValue> const &args) {
+    failed    = false;
+    auto efun = ctx.find(name);
+
+    if(efun == ctx.end() || efun->second == nullptr || efun->second->tag != NodeTag::function_def) {
+        log_error("Calling a non-function ", name);
+        fail();
+        return TypedValue();
+    }
+
+    Function *fun = static_cast<Function *>(efun->second);
+    if(fun->args_size() != args.size()) {
+        log_error("argument size mismatch:", fun->args_size(), " ", args.size());
+        fail();
+        return TypedValue();
+    }
+
+    Array<PrimitiveTag> types;
+    for(TypedValue const &arg : args)
+        types.push_back(arg.tag);
+
+    Specialization *spec = specialize(fun, types);
+    if(spec == nullptr || failed)
+        return TypedValue();
+
+    stack.clear();
+    for(TypedValue const &arg : args)
+        stack.push_back(arg.value);
+    return execute(*spec);
+}
+
+TypedValue TypedEval::execute(Specialization const &spec) {
+    TypedValue result;
+    result.tag   = spec.result;
+    result.value = exec(spec, spec.root, 0);
+    stack.clear();
+    return result;
+}
+
+Scalar TypedEval::exec(Specialization const &spec, u32 index, std::size_t base) {
+    TypedNode const &node = spec.nodes[index];
+    Scalar result         = {};
+
+    switch(node.op) {
+    case TypedOp::constant:
+        return node.constant;
+
+    case TypedOp::arg:
+        return stack[base + node.a];
+
+    // the binding can change between runs
+    case TypedOp::global: {
+        auto bound = ctx.find(Symbol::from_id(node.global));
+        if(bound == ctx.end() || bound->second == nullptr ||
+           bound->second->tag != NodeTag::value ||
+           static_cast<Value *>(bound->second)->value_tag != ValueTag::vprimitive) {
+            log_error("Variable ", Symbol::from_id(node.global), " is no longer a value");
+            fail();
+            return result;
+        }
+        static_cast<PrimitiveValue *>(bound->second)->store(node.tag, &result);
+        return result;
+    }
+
+    case TypedOp::convert: {
+        Scalar value = exec(spec, node.a, base);
+        node.convert(&result, &value);
+        return result;
+    }
+
+    case TypedOp::binary: {
+        Scalar lhs = exec(spec, node.a, base);
+        Scalar rhs = exec(spec, node.b, base);
+        node.binary(&result, &lhs, &rhs);
+        return result;
+    }
+
+    case TypedOp::unary: {
+        Scalar value = exec(spec, node.a, base);
+        node.unary(&result, &value);
+        return result;
+    }
+
+    case TypedOp::call: {
+        // arguments are pushed after the ones of the caller
+        std::size_t frame = stack.size();
+        for(u32 i = 0; i < node.count; ++i) {
+            Scalar arg = exec(spec, spec.children[node.first + i], base);
+            stack.push_back(arg);
+        }
+
+        result = exec(*node.callee, node.callee->root, frame);
+        stack.resize(frame);
+        return result;
+    }
+
+    case TypedOp::match: {
+        Scalar target = exec(spec, node.a, base);
+        for(u32 i = 0; i < node.count; ++i) {
+            Scalar pattern = exec(spec, spec.children[node.first + 2 * i], base);
+            if(node.equal(&pattern, &target))
+                return exec(spec, spec.children[node.first + 2 * i + 1], base);
+        }
+        return exec(spec, node.b, base);
+    }
+
+    case TypedOp::block:
+        for(u32 i = 0; i < node.count; ++i)
+            result = exec(spec, spec.children[node.first + i], base);
+        return result;
+    }
+    return result;
+}
+
+} // namespace kiwi
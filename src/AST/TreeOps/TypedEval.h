@@ -0,0 +1,170 @@
+#pragma once
+
+#include "../Expression.h"
+#include "../HashCons.h"
+#include "../Module.h"
+#include "../Value.h"
+#include "../Visitor.h"
+
+#include "Operators.h"
+
+/*
+ *  Typed evaluation
+ *
+ *  FullEval computes everything as a double, TypedEval keeps the primitive
+ *  types. Every function is specialized for the types of its arguments
+ *  (fib(i64) and fib(f64) are two specializations) and specializations are
+ *  cached. A specialization is a flat array of typed nodes whose kernels
+ *  are resolved when it is compiled: evaluation works on raw scalars, it
+ *  never checks a tag nor boxes a value.
+ *
+ *  Typing rules
+ *      - a value has the type of its primitive
+ *      - operands of different types are promoted (promote_primitive)
+ *      - a literal operand takes the type of the other one: n - 1 stays i64
+ *      - match patterns are converted to the type of the target
+ *      - ln, exp and sqrt of an integer are computed in f64
+ *      - a call has the result type of its specialization, recursive
+ *        functions are compiled until their result type is stable
+ *
+ *  Values bound in the context are looked up on every access and converted
+ *  to the type they had when the specialization was compiled; clear() drops
+ *  the specializations after rebinding a name to another type or to an
+ *  expression.
+ */
+namespace kiwi {
+
+// Unboxed primitive, its type is known from the node that produced it
+union Scalar {
+#define X(n) n n##_value;
+    KIWI_PRIMITIVE(X)
+#undef X
+};
+
+struct TypedValue {
+    PrimitiveTag tag = PrimitiveTag::none;
+    Scalar value     = {};
+
+    template <typename T> T as() const { return load_primitive<T>(tag, &value); }
+};
+
+template <typename T> TypedValue make_typed(T v) {
+    TypedValue result;
+    result.tag = get_primitive_tag<T>();
+    store_primitive(result.tag, &result.value, v);
+    return result;
+}
+
+using ConvertKernel = void (*)(void *dst, void const *src);
+using EqualKernel   = bool (*)(void const *lhs, void const *rhs);
+
+struct Specialization;
+
+enum class TypedOp : u8 {
+    constant, // `constant`
+    arg,      // argument `a` of the current call
+    global,   // value bound to `global` in the context
+    convert,  // `a` converted to `tag`
+    binary,   // `a` op `b`
+    unary,    // op `a`
+    call,     // `callee` applied to `count` children
+    match,    // target `a`, `count` (pattern, branch) children, default `b`
+    block,    // `count` children, the last one is the result
+};
+
+struct TypedNode {
+    TypedOp op;
+    PrimitiveTag tag; // type of the result
+    u32 a     = 0;
+    u32 b     = 0;
+    u32 first = 0; // children are stored in Specialization::children
+    u32 count = 0;
+    Scalar constant = {};
+
+    union {
+        BinaryKernel binary = nullptr;
+        UnaryKernel unary;
+        ConvertKernel convert;
+        EqualKernel equal;
+        Specialization *callee;
+        SymbolId global;
+    };
+};
+
+struct Specialization {
+    Function *fun = nullptr; // nullptr for a top level expression
+    Array<PrimitiveTag> args;
+    PrimitiveTag result = PrimitiveTag::none;
+
+    Array<TypedNode> nodes;
+    Array<u32> children;
+    u32 root = 0;
+
+    bool compiling = false;
+    bool guessed   = false; // its result type was used while it was compiling
+};
+
+class TypedEval {
+  public:
+    TypedEval(Context const &ctx) : ctx(ctx) { stack.reserve(1024); }
+
+    // Compile and evaluate `expr`, the functions it calls are cached
+    TypedValue run(Expression *expr);
+
+    // Call the function bound to `name`, specialized for the types of `args`
+    TypedValue call(Symbol name, Array<TypedValue> const &args);
+
+    // Specialization of `fun` for `args`, compiled on first use, nullptr on error
+    Specialization *specialize(Function *fun, Array<PrimitiveTag> const &args);
+
+    std::size_t specializations() const { return cache.size(); }
+
+    // Drop every specialization
+    void clear() {
+        cache.clear();
+        order.clear();
+    }
+
+    // false if the last run or call failed
+    bool ok() const { return !failed; }
+
+    Context const &context() const { return ctx; }
+
+    void fail() { failed = true; }
+
+  private:
+    struct Key {
+        Function *fun;
+        Array<PrimitiveTag> args;
+
+        bool operator==(Key const &other) const {
+            return fun == other.fun && args == other.args;
+        }
+    };
+
+    struct KeyHash {
+        std::size_t operator()(Key const &k) const {
+            std::size_t h = std::hash<void *>()(k.fun);
+            for(PrimitiveTag tag : k.args)
+                h = hash_combine(h, u64(tag));
+            return h;
+        }
+    };
+
+    TypedValue execute(Specialization const &spec);
+
+    Scalar exec(Specialization const &spec, u32 index, std::size_t base);
+
+    Context const &ctx;
+    std::unordered_map<Key, UniquePtr<Specialization>, KeyHash> cache;
+    Array<Key> order; // keys in creation order
+
+    Array<Scalar> stack; // arguments of the active calls
+    bool failed = false;
+};
+
+inline TypedValue typed_eval(Context const &ctx, Expression *expr) {
+    return TypedEval(ctx).run(expr);
+}
+
+} // namespace kiwi
@@ -34,9 +34,9 @@ class FunctionType : public Type {
 //  Mainly used to represent int/float/char/...
 class BuiltinType : public Type {
   public:
-    BuiltinType(String const &name) : Type(NodeTag::builtin_type), name(name) {}
+    BuiltinType(Symbol name) : Type(NodeTag::builtin_type), name(name) {}
 
-    const String name;
+    const Symbol name;
 };
 
 //
@@ -64,7 +64,7 @@ class StructType : public Type {
     StructType(StructDefinition *def) : Type(NodeTag::struct_type), definition(def) {}
 
     StructDefinition *definition;
-    Array<Tuple<String, Statement *>> meta_types;
+    Array<Tuple<Symbol, Statement *>> meta_types;
 };
 
 class UnionType : public Type {
@@ -72,7 +72,7 @@ class UnionType : public Type {
     UnionType(UnionDefinition *def) : Type(NodeTag::union_type), definition(def) {}
 
     UnionDefinition *definition;
-    Array<Tuple<String, Statement *>> meta_types;
+    Array<Tuple<Symbol, Statement *>> meta_types;
 };
 
 } // namespace kiwi
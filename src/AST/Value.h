@@ -3,9 +3,11 @@
 #include <cassert>
 #include <cstdio>
 #include <memory>
+#include <new>
 #include <ostream>
 
 #include "Expression.h"
+#include "Primitive.h"
 
 #include "Definition.h"
 #include "Type.h"
@@ -16,7 +18,7 @@
 namespace kiwi {
 
 // -------------------------------------------------------------------------------------------
-enum class ValueTag { vprimitive, vstruct, vunion, vfunction };
+enum class ValueTag { vprimitive, vstruct, vunion, vfunction, varray };
 
 class Value : public Expression {
   public:
@@ -37,64 +39,29 @@ class Value : public Expression {
 //  Primitive Value
 // -------------------------------------------------------------------------------------------
 
-// TBD: half precision (IEEE 754-2008)
-/*
-struct f16 {
-    f16() = default;
-    template <typename T> f16(T) {}
-    template <typename T> f16 operator=(T) { return f16(); }
-    template <typename T> operator T() { return T(); }
-};
-inline std::ostream &operator<<(std::ostream &out, f16) { return out; }
-*/
-
-//     X(f16)
-
-#define KIWI_PRIMITIVE(X)                                                                          \
-    X(i8)                                                                                          \
-    X(i16)                                                                                         \
-    X(i32)                                                                                         \
-    X(i64)                                                                                         \
-    X(u8)                                                                                          \
-    X(u16)                                                                                         \
-    X(u32)                                                                                         \
-    X(u64)                                                                                         \
-    X(f32)                                                                                         \
-    X(f64)
-
-// clang-format off
-enum class PrimitiveTag {
-    #define X(n) n,
-        KIWI_PRIMITIVE(X)
-    #undef X
-    none,
-};
-
-template <typename T> PrimitiveTag get_primitive_tag() { return PrimitiveTag::none; }
-
-// Map C++ type to Primitive Tag
-#define X(n)                                                                                       \
-    template <> inline PrimitiveTag get_primitive_tag<n>() { return PrimitiveTag::n; }
-    KIWI_PRIMITIVE(X)
-#undef X
-
-// PrettyPrint a Primitive Tag name
-inline const std::string &get_primitive_name(PrimitiveTag id) {
-    static std::unordered_map<PrimitiveTag, std::string> builtin_types = {
-    #define X(n) {PrimitiveTag::n, #n},
-        KIWI_PRIMITIVE(X)
-    #undef X
-        {PrimitiveTag::none, "NotAPrimitive"}
-    };
-    return builtin_types[id];
-}
-
 // Build a Kiwi Builtin Type for primitives
 template <typename T> BuiltinType *get_primitive_type() {
     static BuiltinType t(get_primitive_name(get_primitive_tag<T>()));
     return &t;
 }
-//clang-format on
+
+// PrettyPrint a primitive stored at `src`
+inline std::ostream &dump_primitive(std::ostream &out, PrimitiveTag id, void const *src) {
+    // clang-format off
+    switch(id) {
+    #define X(n)                                                                                   \
+    case PrimitiveTag::n: {                                                                        \
+        out << load_primitive<n>(id, src);                                                         \
+        break;                                                                                     \
+    }
+    KIWI_PRIMITIVE(X)
+    #undef X
+    case PrimitiveTag::none:
+        break;
+    }
+    // clang-format on
+    return out << ": " << get_primitive_name(id);
+}
 
 class PrimitiveValue : public Value {
   public:
@@ -107,6 +74,25 @@ class PrimitiveValue : public Value {
 
     Type* type() const override { return _type;}
 
+    PrimitiveTag tag() const { return primitive_tag; }
+
+    // Convert the value to the primitive `id` and store it at `dst`
+    void store(PrimitiveTag id, void *dst) const {
+        // clang-format off
+        switch(primitive_tag) {
+        #define X(n)                                                                                \
+        case PrimitiveTag::n: {                                                                     \
+            store_primitive(id, dst, value.n##_value);                                              \
+            break;                                                                                  \
+        }
+        KIWI_PRIMITIVE(X)
+        #undef X
+        case PrimitiveTag::none:
+            break;
+        }
+        //clang-format on
+    }
+
     template <typename T> void set_value(T v) {
         // clang-format off
         switch(primitive_tag) {
@@ -125,21 +111,20 @@ class PrimitiveValue : public Value {
         }
     }
 
+    // Value converted to T
     template<typename T> T as() const{
-        if (get_primitive_tag<T>() == primitive_tag){
-            // clang-format off
-            switch(primitive_tag) {
-            #define X(n)                                                                                \
-            case PrimitiveTag::n: {                                                                     \
-                return T(value.n##_value);                                                              \
-            }
-            KIWI_PRIMITIVE(X)
-            #undef X
-            case PrimitiveTag::none:
-                return T();
-            }
-            //clang-format on
+        // clang-format off
+        switch(primitive_tag) {
+        #define X(n)                                                                                \
+        case PrimitiveTag::n: {                                                                     \
+            return T(value.n##_value);                                                              \
         }
+        KIWI_PRIMITIVE(X)
+        #undef X
+        case PrimitiveTag::none:
+            return T();
+        }
+        //clang-format on
         return T();
     }
 
@@ -174,12 +159,77 @@ class PrimitiveValue : public Value {
     Type* _type;
 };
 
+/* Fields of records are stored packed in a single buffer following the
+ * layout of their definition. Primitive fields are stored inline, others
+ * as a pointer to their Value.
+ */
+class RecordBuffer {
+  public:
+    void resize(RecordLayout const &layout) { _buffer.assign((layout.size + 7) / 8, 0); }
+
+    u8 *data() { return reinterpret_cast<u8 *>(_buffer.data()); }
+    u8 const *data() const { return reinterpret_cast<u8 const *>(_buffer.data()); }
+
+    template <typename T> T get(FieldLayout const &field) const;
+
+    template <typename T> void set(FieldLayout const &field, T v) {
+        if(field.is_boxed()) {
+            log_error("Cannot store a primitive in the boxed field ", field.name);
+            return;
+        }
+        store_primitive(field.primitive, data() + field.offset, v);
+    }
+
+    Value *get_boxed(FieldLayout const &field) const {
+        Value *v = nullptr;
+        if(field.is_boxed())
+            std::memcpy(&v, data() + field.offset, sizeof(Value *));
+        return v;
+    }
+
+    void set_boxed(FieldLayout const &field, Value *v) {
+        if(field.is_boxed())
+            std::memcpy(data() + field.offset, &v, sizeof(Value *));
+    }
+
+    // Primitive values are unpacked, other values are boxed
+    void set_value(FieldLayout const &field, Value *v) {
+        if(field.is_boxed())
+            return set_boxed(field, v);
+
+        if(v == nullptr || v->value_tag != ValueTag::vprimitive) {
+            log_error("Cannot store a non primitive value in the packed field ", field.name);
+            return;
+        }
+        static_cast<PrimitiveValue *>(v)->store(field.primitive, data() + field.offset);
+    }
+
+    std::ostream &dump(std::ostream &out, FieldLayout const &field) const {
+        if(!field.is_boxed())
+            return dump_primitive(out, field.primitive, data() + field.offset);
+
+        Value *v = get_boxed(field);
+        if(v == nullptr)
+            return out << "none";
+        return v->dump(out);
+    }
+
+  private:
+    // u64 keeps every field aligned
+    Array<u64> _buffer;
+};
+
 class UnionValue : public Value {
   public:
     UnionValue() : Value(ValueTag::vunion){}
 
     UnionValue* set_type(Union* ptr){
+        if(!ptr->is_sealed())
+            ptr->seal();
+
         _type = ptr;
+        _buffer.resize(ptr->layout);
+        index = -1;
         return this;
     }
 
@@ -188,22 +238,70 @@ class UnionValue : public Value {
 
     Union* definition() { return _type; }
 
+    RecordLayout const &layout() const { return _type->layout; }
+
+    template <typename T> T get() const {
+        if(index < 0)
+            return T();
+        return _buffer.get<T>(layout().field(std::size_t(index)));
+    }
+
+    // -1 selects None, the payload is left untouched
+    template <typename T> UnionValue *set(int32 idx, T v) {
+        if(!check(idx))
+            return this;
+
+        index = idx;
+        if(idx >= 0)
+            _buffer.set(layout().field(std::size_t(idx)), v);
+        return this;
+    }
+
+    Value *get_boxed() const {
+        if(index < 0)
+            return nullptr;
+        return _buffer.get_boxed(layout().field(std::size_t(index)));
+    }
+
+    UnionValue *set_value(int32 idx, Value *v) {
+        if(!check(idx))
+            return this;
+
+        index = idx;
+        if(idx >= 0)
+            _buffer.set_value(layout().field(std::size_t(idx)), v);
+        return this;
+    }
+
+    // Raw packed payload
+    u8 *data() { return _buffer.data(); }
+    u8 const *data() const { return _buffer.data(); }
+
     std::ostream &dump(std::ostream &out) const override {
         out << "(";
-        if (value && index >= 0){
-            out << std::get<0>(_type->attributes[std::size_t(index)]) << " = ";
-            value->dump(out);
+        if (index >= 0){
+            FieldLayout const &field = layout().field(std::size_t(index));
+            out << field.name << " = ";
+            _buffer.dump(out, field);
         } else {
             out << "none";
         }
         return out << ")";
     }
 
-    Value *value;
-    int32 index;
+    int32 index = -1;
 
 private:
-    Union* _type;
+    bool check(int32 idx) const {
+        if(idx < -1 || idx >= int32(layout().fields.size())) {
+            log_error("Union variant ", idx, " out of range");
+            return false;
+        }
+        return true;
+    }
+
+    Union* _type = nullptr;
+    RecordBuffer _buffer;
 };
 
 class StructValue : public Value {
@@ -212,28 +310,173 @@ class StructValue : public Value {
         Value(ValueTag::vstruct) {}
 
     StructValue* set_type(Struct* ptr){
+        if(!ptr->is_sealed())
+            ptr->seal();
+
         _type = ptr;
+        _buffer.resize(ptr->layout);
         return this;
     }
 
     //Type* type() const override { return _type;}
     Type* type() const override { return nullptr;}
 
-    Struct* definition() { return _type; }
+    Struct* definition() const { return _type; }
+
+    RecordLayout const &layout() const { return _type->layout; }
+
+    std::size_t size() const { return layout().fields.size(); }
+
+    template <typename T> T get(std::size_t index) const {
+        if(!check(index))
+            return T();
+        return _buffer.get<T>(layout().field(index));
+    }
+
+    template <typename T> StructValue *set(std::size_t index, T v) {
+        if(check(index))
+            _buffer.set(layout().field(index), v);
+        return this;
+    }
+
+    Value *get_boxed(std::size_t index) const {
+        if(!check(index))
+            return nullptr;
+        return _buffer.get_boxed(layout().field(index));
+    }
+
+    StructValue *set_value(std::size_t index, Value *v) {
+        if(check(index))
+            _buffer.set_value(layout().field(index), v);
+        return this;
+    }
+
+    // Raw packed fields
+    u8 *data() { return _buffer.data(); }
+    u8 const *data() const { return _buffer.data(); }
 
     std::ostream &dump(std::ostream &out) const override {
         out << "(";
-        for(u64 i = 0; i < values.size() - 1; ++i) {
-            auto &item = values[i];
-            item->dump(out) << ", ";
+        for(u64 i = 0; i < size(); ++i) {
+            if(i > 0)
+                out << ", ";
+            _buffer.dump(out, layout().field(i));
         }
-        values[values.size() - 1]->dump(out);
         return out << ")";
     }
 
-    Array<Value *> values;
 private:
-    Struct* _type;
+    bool check(std::size_t index) const {
+        if(index >= size()) {
+            log_error("Struct field ", index, " out of range");
+            return false;
+        }
+        return true;
+    }
+
+    Struct* _type = nullptr;
+    RecordBuffer _buffer;
+};
+
+/* Dense n-dimensional array of primitives, row major. Elements are stored
+ * contiguously and aligned for SIMD loads, either in memory owned by the
+ * value or in a buffer it views (arena, mapped file) that must outlive it.
+ */
+class ArrayValue : public Value {
+  public:
+    static constexpr std::size_t alignment = 64;
+
+    // Zero initialized array owning its elements
+    ArrayValue(PrimitiveTag tag, Array<u64> shape) :
+        Value(ValueTag::varray), _tag(tag), _shape(std::move(shape))
+    {
+        std::size_t bytes = (nbytes() + alignment - 1) / alignment * alignment;
+        _owned.reset(static_cast<u8 *>(::operator new(bytes, std::align_val_t(alignment))));
+        std::memset(_owned.get(), 0, bytes);
+        _data = _owned.get();
+    }
+
+    // View of `data`, which is not copied nor freed
+    ArrayValue(PrimitiveTag tag, Array<u64> shape, void *data) :
+        Value(ValueTag::varray), _tag(tag), _shape(std::move(shape)),
+        _data(static_cast<u8 *>(data))
+    {}
+
+    Type* type() const override { return nullptr;}
+
+    PrimitiveTag tag() const { return _tag; }
+
+    Array<u64> const &shape() const { return _shape; }
+
+    std::size_t rank() const { return _shape.size(); }
+
+    // Number of elements
+    std::size_t size() const {
+        std::size_t n = 1;
+        for(u64 dim : _shape)
+            n *= std::size_t(dim);
+        return n;
+    }
+
+    std::size_t nbytes() const { return size() * get_primitive_size(_tag); }
+
+    bool owns_data() const { return _owned != nullptr; }
+
+    u8 *data() { return _data; }
+    u8 const *data() const { return _data; }
+
+    // Elements as T, T must be the type of the array
+    template <typename T> T *values() {
+        assert(get_primitive_tag<T>() == _tag);
+        return reinterpret_cast<T *>(_data);
+    }
+
+    template <typename T> T get(std::size_t index) const {
+        return load_primitive<T>(_tag, _data + index * get_primitive_size(_tag));
+    }
+
+    template <typename T> ArrayValue *set(std::size_t index, T v) {
+        store_primitive(_tag, _data + index * get_primitive_size(_tag), v);
+        return this;
+    }
+
+    std::ostream &dump(std::ostream &out) const override {
+        out << "[";
+        for(std::size_t i = 0; i < size(); ++i) {
+            if(i > 0)
+                out << ", ";
+            dump_value(out, i);
+        }
+        out << "]: " << get_primitive_name(_tag) << "[";
+        for(std::size_t i = 0; i < rank(); ++i)
+            out << (i > 0 ? ", " : "") << _shape[i];
+        return out << "]";
+    }
+
+  private:
+    std::ostream &dump_value(std::ostream &out, std::size_t index) const {
+        // clang-format off
+        switch(_tag) {
+        #define X(n)                                                                                \
+        case PrimitiveTag::n:                                                                       \
+            return out << get<n>(index);
+        KIWI_PRIMITIVE(X)
+        #undef X
+        case PrimitiveTag::none:
+            break;
+        }
+        //clang-format on
+        return out;
+    }
+
+    struct AlignedDelete {
+        void operator()(u8 *ptr) const { ::operator delete(ptr, std::align_val_t(alignment)); }
+    };
+
+    PrimitiveTag _tag;
+    Array<u64> _shape;
+    std::unique_ptr<u8, AlignedDelete> _owned;
+    u8 *_data = nullptr;
 };
 
 struct ExecutionContext{};
@@ -248,6 +491,16 @@ public:
     ExecutionContext& ctx;
 };
 
+template <typename T> T RecordBuffer::get(FieldLayout const &field) const {
+    if(!field.is_boxed())
+        return load_primitive<T>(field.primitive, data() + field.offset);
+
+    Value *v = get_boxed(field);
+    if(v == nullptr)
+        return T();
+    return v->as<T>();
+}
+
 template<typename T> T Value::as(std::size_t index) const{
     switch(value_tag){
     case ValueTag::vprimitive:{
@@ -255,18 +508,23 @@ template<typename T> T Value::as(std::size_t index) const{
         return val->as<T>();
     }
     case ValueTag::vstruct:{
-        UnionValue const* val = static_cast<UnionValue const*>(this);
-        return val->as<T>();
+        StructValue const* val = static_cast<StructValue const*>(this);
+        return val->get<T>(index);
     }
     case ValueTag::vunion:{
-        StructValue const* val = static_cast<StructValue const*>(this);
-        return val->values[index]->as<T>();
+        UnionValue const* val = static_cast<UnionValue const*>(this);
+        return val->get<T>();
     }
-    case ValueTag::vfunction:{
-        FunctionValue const* val = static_cast<FunctionValue const*>(this);
-        return val->as<T>();
+    case ValueTag::vfunction:
+        return T();
+    case ValueTag::varray:{
+        ArrayValue const* val = static_cast<ArrayValue const*>(this);
+        if (index >= val->size())
+            return T();
+        return val->get<T>(index);
     }
     }
+    return T();
 }
 
 } // namespace kiwi
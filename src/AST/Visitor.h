@@ -18,17 +18,15 @@ template <typename Return, typename... Args> class StatementVisitor {
             return nullptr_statement(args...);
         }
         if(stmt->is_def()) {
-            log_info(to_string(stmt->tag));
             return visit_definition(static_cast<Definition *>(stmt), args...);
         }
         if(stmt->is_type()) {
-            log_info(to_string(stmt->tag));
             return visit_type(static_cast<Type *>(stmt), args...);
         }
         if(stmt->is_expr()) {
-            log_info(to_string(stmt->tag));
             return visit_expression(static_cast<Expression *>(stmt), args...);
         }
+        return unhandled_statement(stmt, args...);
     }
 
     virtual Return visit_type(Type *type, Args... args)             = 0;
@@ -158,4 +156,145 @@ template <typename Return, typename... Args> class DefinitionVisitor {
     virtual ~DefinitionVisitor() = default;
 };
 
+// -------------------------------------------------------------------------------------------
+//  Static Visitors
+// -------------------------------------------------------------------------------------------
+/*
+ *  Same interface as the visitors above but dispatched at compile time (CRTP).
+ *  Handlers are looked up on `Impl`, they can be inlined and no vtable is involved.
+ *  Node handlers that are not implemented fall back to `unhandled_*`,
+ *  `unhandled_*` and `nullptr_*` must be provided by the implementation.
+ *
+ *  class Eval : public StaticExpressionVisitor<Eval, f64> {
+ *      f64 value(Value *v) { return v->as<f64>(); }
+ *      f64 unhandled_expression(Expression *) { return 0; }
+ *      f64 nullptr_expression() { return 0; }
+ *  };
+ */
+
+// clang-format off
+#define KIWI_EXPRESSION_NODES(X)                                                                   \
+    X(unary_call, UnaryCall)                                                                       \
+    X(binary_call, BinaryCall)                                                                     \
+    X(function_call, FunctionCall)                                                                 \
+    X(match, Match)                                                                                \
+    X(block, Block)                                                                                \
+    X(placeholder, Placeholder)                                                                    \
+    X(placeholder_ref, PlaceholderReference)                                                       \
+    X(value, Value)
+
+#define KIWI_TYPE_NODES(X)                                                                         \
+    X(builtin_type, BuiltinType)                                                                   \
+    X(function_type, FunctionType)                                                                 \
+    X(union_type, UnionType)                                                                       \
+    X(struct_type, StructType)
+
+#define KIWI_DEFINITION_NODES(X)                                                                   \
+    X(function_def, FunctionDefinition)                                                            \
+    X(macro_def, MacroDefinition)                                                                  \
+    X(struct_def, StructDefinition)                                                                \
+    X(union_def, UnionDefinition)
+// clang-format on
+
+template <typename Impl, typename Return, typename... Args> class StaticExpressionVisitor {
+  public:
+    Return visit_expression(Expression *expr, Args... args) {
+        if(expr == nullptr) {
+            return impl().nullptr_expression(args...);
+        }
+
+        switch(expr->tag) {
+#define X(name, object)                                                                            \
+    case NodeTag::name:                                                                            \
+        return impl().name(static_cast<object *>(expr), args...);
+            KIWI_EXPRESSION_NODES(X)
+#undef X
+        default: { return impl().unhandled_expression(expr, args...); }
+        }
+    }
+
+#define X(name, object)                                                                            \
+    Return name(object *expr, Args... args) { return impl().unhandled_expression(expr, args...); }
+    KIWI_EXPRESSION_NODES(X)
+#undef X
+
+  private:
+    Impl &impl() { return static_cast<Impl &>(*this); }
+};
+
+template <typename Impl, typename Return, typename... Args> class StaticTypeVisitor {
+  public:
+    Return visit_type(Type *type, Args... args) {
+        if(type == nullptr) {
+            return impl().nullptr_type(args...);
+        }
+
+        switch(type->tag) {
+#define X(name, object)                                                                            \
+    case NodeTag::name:                                                                            \
+        return impl().name(static_cast<object *>(type), args...);
+            KIWI_TYPE_NODES(X)
+#undef X
+        default: { return impl().unhandled_type(type, args...); }
+        }
+    }
+
+#define X(name, object)                                                                            \
+    Return name(object *type, Args... args) { return impl().unhandled_type(type, args...); }
+    KIWI_TYPE_NODES(X)
+#undef X
+
+  private:
+    Impl &impl() { return static_cast<Impl &>(*this); }
+};
+
+template <typename Impl, typename Return, typename... Args> class StaticDefinitionVisitor {
+  public:
+    Return visit_definition(Definition *def, Args... args) {
+        if(def == nullptr) {
+            return impl().nullptr_definition(args...);
+        }
+
+        switch(def->tag) {
+#define X(name, object)                                                                            \
+    case NodeTag::name:                                                                            \
+        return impl().name(static_cast<object *>(def), args...);
+            KIWI_DEFINITION_NODES(X)
+#undef X
+        default: { return impl().unhandled_definition(def, args...); }
+        }
+    }
+
+#define X(name, object)                                                                            \
+    Return name(object *def, Args... args) { return impl().unhandled_definition(def, args...); }
+    KIWI_DEFINITION_NODES(X)
+#undef X
+
+  private:
+    Impl &impl() { return static_cast<Impl &>(*this); }
+};
+
+// Impl provides visit_type, visit_definition and visit_expression
+template <typename Impl, typename Return, typename... Args> class StaticStatementVisitor {
+  public:
+    Return visit_statement(Statement *stmt, Args... args) {
+        if(stmt == nullptr) {
+            return impl().nullptr_statement(args...);
+        }
+        if(stmt->is_def()) {
+            return impl().visit_definition(static_cast<Definition *>(stmt), args...);
+        }
+        if(stmt->is_type()) {
+            return impl().visit_type(static_cast<Type *>(stmt), args...);
+        }
+        if(stmt->is_expr()) {
+            return impl().visit_expression(static_cast<Expression *>(stmt), args...);
+        }
+        return impl().unhandled_statement(stmt, args...);
+    }
+
+  private:
+    Impl &impl() { return static_cast<Impl &>(*this); }
+};
+
 } // namespace kiwi
@@ -0,0 +1,151 @@
+#include "WorkStealingPool.h"
+
+#include <algorithm>
+
+namespace kiwi {
+namespace {
+
+// worker index of the current thread in `current_pool`
+thread_local WorkStealingPool const *current_pool = nullptr;
+thread_local std::size_t current_index            = 0;
+
+} // namespace
+
+WorkStealingPool::WorkStealingPool(std::size_t threads) {
+    threads = std::max<std::size_t>(threads, 1);
+
+    for(std::size_t i = 0; i < threads + 1; ++i)
+        queues.emplace_back(new Queue());
+
+    for(std::size_t i = 0; i < threads; ++i)
+        workers.emplace_back([this, i]() { work(i); });
+}
+
+WorkStealingPool::~WorkStealingPool() {
+    {
+        std::lock_guard<std::mutex> guard(sleep_lock);
+        stopping = true;
+    }
+    wake.notify_all();
+
+    for(std::thread &worker : workers)
+        worker.join();
+}
+
+std::size_t WorkStealingPool::local_queue() const {
+    return current_pool == this ? current_index : workers.size();
+}
+
+void WorkStealingPool::spawn(Group &group, Task task) {
+    std::size_t self = local_queue();
+    group.pending.fetch_add(1, std::memory_order_relaxed);
+
+    {
+        Queue &queue = *queues[self];
+        std::lock_guard<std::mutex> guard(queue.lock);
+        queued.fetch_add(1, std::memory_order_release);
+        queue.items.push_back(Item{std::move(task), &group, self});
+    }
+
+    spawned += 1;
+
+    // a worker between its check and its wait would miss the notification
+    {
+        std::lock_guard<std::mutex> guard(sleep_lock);
+    }
+    wake.notify_one();
+}
+
+void WorkStealingPool::wait(Group &group) {
+    std::size_t self = local_queue();
+    Item item;
+
+    while(!group.done()) {
+        if(pop(self, item)) {
+            execute(item, self);
+            continue;
+        }
+
+        // woken by a spawn or by the last task of a group
+        std::unique_lock<std::mutex> guard(sleep_lock);
+        wake.wait(guard, [&]() { return group.done() || queued.load() > 0; });
+    }
+
+    if(group.error) {
+        std::exception_ptr error = group.error;
+        group.error              = nullptr;
+        std::rethrow_exception(error);
+    }
+}
+
+bool WorkStealingPool::pop(std::size_t self, Item &item) {
+    if(queued.load(std::memory_order_acquire) == 0)
+        return false;
+
+    {
+        Queue &queue = *queues[self];
+        std::lock_guard<std::mutex> guard(queue.lock);
+        if(!queue.items.empty()) {
+            item = std::move(queue.items.back());
+            queue.items.pop_back();
+            queued -= 1;
+            return true;
+        }
+    }
+
+    for(std::size_t i = 1; i < queues.size(); ++i) {
+        Queue &queue = *queues[(self + i) % queues.size()];
+        std::lock_guard<std::mutex> guard(queue.lock);
+        if(!queue.items.empty()) {
+            item = std::move(queue.items.front());
+            queue.items.pop_front();
+            queued -= 1;
+            return true;
+        }
+    }
+    return false;
+}
+
+void WorkStealingPool::execute(Item &item, std::size_t self) {
+    if(item.owner != self)
+        stolen += 1;
+
+    Group &group = *item.group;
+    try {
+        item.task();
+    } catch(...) {
+        std::lock_guard<std::mutex> guard(group.lock);
+        if(!group.error)
+            group.error = std::current_exception();
+    }
+    item.task = nullptr;
+
+    if(group.pending.fetch_sub(1, std::memory_order_acq_rel) != 1)
+        return;
+
+    // the group is done, its waiter may be asleep
+    {
+        std::lock_guard<std::mutex> guard(sleep_lock);
+    }
+    wake.notify_all();
+}
+
+void WorkStealingPool::work(std::size_t self) {
+    current_pool  = this;
+    current_index = self;
+
+    Item item;
+    while(true) {
+        if(pop(self, item)) {
+            execute(item, self);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> guard(sleep_lock);
+        wake.wait(guard, [this]() { return stopping || queued.load() > 0; });
+        if(stopping)
+            return;
+    }
+}
+
+} // namespace kiwi
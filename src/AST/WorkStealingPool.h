@@ -0,0 +1,114 @@
+#ifndef KIWI_AST_WORK_STEALING_POOL_HEADER
+#define KIWI_AST_WORK_STEALING_POOL_HEADER
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#include "../Types.h"
+
+/*
+ *  Fork-join thread pool
+ *
+ *  Every worker owns a deque: it pushes and pops its own tasks at the back
+ *  (depth first, cache friendly) and steals from the front of the others
+ *  when it runs out (the oldest, usually biggest, tasks).
+ *
+ *  The waiting thread runs queued tasks until its group is done, so nested
+ *  fork-join cannot deadlock; it sleeps only when nothing is queued and is
+ *  woken by the next spawn or when its group completes. Threads outside
+ *  the pool can spawn and wait as well.
+ *
+ *  A task that throws does not take its worker down: the first exception
+ *  of a group is rethrown by wait() once every task of the group is done.
+ *
+ *      WorkStealingPool::Group group;
+ *      pool.spawn(group, [&]() { a = work(lhs); });
+ *      b = work(rhs);
+ *      pool.wait(group);
+ */
+namespace kiwi {
+
+struct PoolStats {
+    u64 spawned = 0;
+    u64 stolen  = 0; // tasks run by another thread than the one that spawned them
+};
+
+class WorkStealingPool {
+  public:
+    using Task = std::function<void()>;
+
+    // Tasks waited on together
+    class Group {
+      public:
+        bool done() const { return pending.load(std::memory_order_acquire) == 0; }
+
+      private:
+        std::atomic<std::size_t> pending{0};
+        std::mutex lock;
+        std::exception_ptr error; // first exception thrown by a task
+        friend class WorkStealingPool;
+    };
+
+    WorkStealingPool(std::size_t threads = std::thread::hardware_concurrency());
+    ~WorkStealingPool();
+
+    WorkStealingPool(WorkStealingPool const &) = delete;
+    WorkStealingPool &operator=(WorkStealingPool const &) = delete;
+
+    std::size_t size() const { return workers.size(); }
+
+    // Queue `task`, it can run on any thread
+    void spawn(Group &group, Task task);
+
+    // Run queued tasks until every task of `group` is done,
+    // rethrow the first exception thrown by one of them
+    void wait(Group &group);
+
+    // Tasks queued and not started yet (approximate)
+    std::size_t pending() const { return queued.load(std::memory_order_relaxed); }
+
+    PoolStats stats() const { return PoolStats{spawned.load(), stolen.load()}; }
+
+  private:
+    struct Item {
+        Task task;
+        Group *group;
+        std::size_t owner;
+    };
+
+    struct Queue {
+        std::mutex lock;
+        std::deque<Item> items;
+    };
+
+    // Own queue first (back), then steal from the others (front)
+    bool pop(std::size_t self, Item &item);
+
+    void execute(Item &item, std::size_t self);
+
+    void work(std::size_t self);
+
+    // Queue of the calling thread, a shared one for threads outside the pool
+    std::size_t local_queue() const;
+
+    Array<UniquePtr<Queue>> queues; // one per worker + one for outside threads
+    Array<std::thread> workers;
+
+    // incremented before an item is visible, decremented after it is removed
+    std::atomic<std::size_t> queued{0};
+    std::atomic<bool> stopping{false};
+    std::mutex sleep_lock;
+    std::condition_variable wake;
+
+    std::atomic<u64> spawned{0};
+    std::atomic<u64> stolen{0};
+};
+
+} // namespace kiwi
+
+#endif
@@ -0,0 +1,585 @@
+#include "NativeJIT.h"
+
+#include <sstream>
+
+#include <llvm/ExecutionEngine/Orc/LLJIT.h>
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/Intrinsics.h>
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/Module.h>
+#include <llvm/IR/Verifier.h>
+#include <llvm/Passes/PassBuilder.h>
+#include <llvm/Support/TargetSelect.h>
+
+#include "../AST/RecordLayout.h"
+#include "../AST/Value.h"
+#include "../AST/Visitor.h"
+#include "../Logging/Log.h"
+
+namespace kiwi {
+
+String NativeSignature::to_string() const {
+    std::stringstream ss;
+    ss << get_primitive_name(result) << "(";
+    for(std::size_t i = 0; i < args.size(); ++i) {
+        if(i > 0)
+            ss << ",";
+        ss << get_primitive_name(args[i]);
+    }
+    ss << ")";
+    return ss.str();
+}
+
+namespace {
+
+bool is_float(PrimitiveTag tag) { return is_floating_primitive(tag); }
+
+bool is_signed(PrimitiveTag tag) {
+    switch(tag) {
+    case PrimitiveTag::i8:
+    case PrimitiveTag::i16:
+    case PrimitiveTag::i32:
+    case PrimitiveTag::i64:
+    case PrimitiveTag::f32:
+    case PrimitiveTag::f64:
+    case PrimitiveTag::f16:
+    case PrimitiveTag::bf16:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// Type both operands are converted to, 16 bit floats are computed in f32
+PrimitiveTag promote(PrimitiveTag a, PrimitiveTag b) {
+    if(is_float(a) || is_float(b)) {
+        if(a == PrimitiveTag::f64 || b == PrimitiveTag::f64)
+            return PrimitiveTag::f64;
+        return PrimitiveTag::f32;
+    }
+    return get_primitive_size(b) > get_primitive_size(a) ? b : a;
+}
+
+bool is_half(PrimitiveTag tag) { return tag == PrimitiveTag::f16 || tag == PrimitiveTag::bf16; }
+
+// 16 bit floats are stored as i16, like kiwi::f16/bf16, and computed in f32
+llvm::Type *native_type(llvm::LLVMContext &context, PrimitiveTag tag) {
+    switch(tag) {
+    case PrimitiveTag::f32:
+        return llvm::Type::getFloatTy(context);
+    case PrimitiveTag::f64:
+        return llvm::Type::getDoubleTy(context);
+    case PrimitiveTag::none:
+        return nullptr;
+    default:
+        return llvm::Type::getIntNTy(context, unsigned(get_primitive_size(tag) * 8));
+    }
+}
+
+String cache_key(Function *fun, NativeSignature const &signature) {
+    std::stringstream ss;
+    ss << static_cast<void *>(fun) << signature.to_string();
+    return ss.str();
+}
+
+struct TypedValue {
+    llvm::Value *value;
+    PrimitiveTag tag;
+};
+
+struct Lowered {
+    Function *fun;
+    NativeSignature signature;
+    llvm::Function *native;
+};
+
+// One LLVM module, every function reached from the entry point is lowered in it
+class ModuleLowering {
+  public:
+    ModuleLowering(Context const &ctx, String const &name, llvm::DataLayout const &layout) :
+        ctx(ctx), context(std::make_unique<llvm::LLVMContext>()),
+        module(std::make_unique<llvm::Module>(name, *context)) {
+        module->setDataLayout(layout);
+    }
+
+    llvm::Function *declare(Function *fun, Symbol name, NativeSignature const &signature);
+
+    // Lower the bodies of the declared functions, false on error
+    bool lower();
+
+    Context const &ctx;
+    std::unique_ptr<llvm::LLVMContext> context;
+    std::unique_ptr<llvm::Module> module;
+    Dict<String, llvm::Function *> declared;
+    Array<Lowered> functions;
+    bool ok = true;
+};
+
+class FunctionLowering : public StaticExpressionVisitor<FunctionLowering, TypedValue> {
+  public:
+    FunctionLowering(ModuleLowering &module, Lowered const &target) :
+        module(module), target(target), ir(*module.context) {}
+
+    void lower() {
+        llvm::BasicBlock *entry = llvm::BasicBlock::Create(context(), "entry", target.native);
+        ir.SetInsertPoint(entry);
+
+        TypedValue result = visit_expression(static_cast<Expression *>(target.fun->body));
+        ir.CreateRet(convert(result, target.signature.result));
+    }
+
+    TypedValue value(Value *x) {
+        if(x->value_tag != ValueTag::vprimitive)
+            return error("Only primitive values can be compiled");
+
+        PrimitiveTag tag = static_cast<PrimitiveValue *>(x)->tag();
+        if(is_half(tag))
+            tag = PrimitiveTag::f32;
+
+        llvm::Type *type = native_type(context(), tag);
+
+        if(is_float(tag))
+            return {llvm::ConstantFP::get(type, x->template as<f64>()), tag};
+        if(is_signed(tag))
+            return {llvm::ConstantInt::get(type, u64(x->template as<i64>()), true), tag};
+        return {llvm::ConstantInt::get(type, x->template as<u64>()), tag};
+    }
+
+    TypedValue placeholder(Placeholder *x) { return name(x->name); }
+
+    TypedValue placeholder_ref(PlaceholderReference *x) { return name(x->name); }
+
+    TypedValue binary_call(BinaryCall *x) {
+        TypedValue lhs   = visit_expression(x->lhs);
+        TypedValue rhs   = visit_expression(x->rhs);
+        PrimitiveTag tag = promote(lhs.tag, rhs.tag);
+
+        llvm::Value *a = convert(lhs, tag);
+        llvm::Value *b = convert(rhs, tag);
+        bool fp        = is_float(tag);
+
+        switch(x->op) {
+        case BinaryOp::add:
+            return {fp ? ir.CreateFAdd(a, b) : ir.CreateAdd(a, b), tag};
+        case BinaryOp::sub:
+            return {fp ? ir.CreateFSub(a, b) : ir.CreateSub(a, b), tag};
+        case BinaryOp::mul:
+            return {fp ? ir.CreateFMul(a, b) : ir.CreateMul(a, b), tag};
+        case BinaryOp::div: {
+            if(fp)
+                return {ir.CreateFDiv(a, b), tag};
+
+            // integer division by zero is 0, like the interpreter
+            llvm::Value *zero    = llvm::ConstantInt::get(a->getType(), 0);
+            llvm::Value *is_zero = ir.CreateICmpEQ(b, zero);
+            llvm::Value *one     = llvm::ConstantInt::get(a->getType(), 1);
+            llvm::Value *safe    = ir.CreateSelect(is_zero, one, b);
+            if(!is_signed(tag))
+                return {ir.CreateSelect(is_zero, zero, ir.CreateUDiv(a, safe)), tag};
+
+            // min / -1 overflows, x / -1 is computed as a wrapping -x
+            llvm::Value *minus_one = llvm::ConstantInt::get(a->getType(), u64(-1), true);
+            llvm::Value *is_neg    = ir.CreateICmpEQ(b, minus_one);
+            llvm::Value *div       = ir.CreateSDiv(a, ir.CreateSelect(is_neg, one, safe));
+            div                    = ir.CreateSelect(is_neg, ir.CreateSub(zero, a), div);
+            return {ir.CreateSelect(is_zero, zero, div), tag};
+        }
+        case BinaryOp::none:
+            break;
+        }
+        return error("Unknown binary operator ", callee_name(x->fun));
+    }
+
+    TypedValue unary_call(UnaryCall *x) {
+        TypedValue src = visit_expression(x->expr);
+
+        switch(x->op) {
+        case UnaryOp::neg:
+            if(is_float(src.tag))
+                return {ir.CreateFNeg(src.value), src.tag};
+            if(is_signed(src.tag))
+                return {ir.CreateNeg(src.value), src.tag};
+            return error("Cannot negate an unsigned value");
+        case UnaryOp::ln:
+            return intrinsic(llvm::Intrinsic::log, src);
+        case UnaryOp::exp:
+            return intrinsic(llvm::Intrinsic::exp, src);
+        case UnaryOp::sqrt:
+            return intrinsic(llvm::Intrinsic::sqrt, src);
+        case UnaryOp::ret:
+            return src;
+        case UnaryOp::none:
+            break;
+        }
+        return error("Unknown unary operator ", callee_name(x->fun));
+    }
+
+    TypedValue function_call(FunctionCall *x) {
+        Symbol name = callee_name(x->fun);
+        auto result = module.ctx.find(name);
+
+        if(result == module.ctx.end() || result->second == nullptr ||
+           result->second->tag != NodeTag::function_def)
+            return error("Calling a non-function ", name);
+
+        Function *callee = static_cast<Function *>(result->second);
+        if(callee->args_size() != x->args_size())
+            return error("argument size mismatch:", callee->args_size(), " ", x->args_size());
+
+        // specialize the callee on the types of the arguments
+        Array<TypedValue> args;
+        NativeSignature signature;
+        signature.result = return_type(callee);
+
+        for(u64 i = 0; i < x->args_size(); ++i) {
+            args.push_back(visit_expression(x->arg(i)));
+
+            PrimitiveTag declared = get_field_primitive(std::get<1>(callee->arg(i)));
+            signature.args.push_back(declared != PrimitiveTag::none ? declared : args[i].tag);
+        }
+
+        llvm::Function *native = module.declare(callee, name, signature);
+
+        Array<llvm::Value *> values;
+        for(u64 i = 0; i < args.size(); ++i)
+            values.push_back(convert(args[i], signature.args[i]));
+
+        return widen({ir.CreateCall(native, values), signature.result});
+    }
+
+    TypedValue match(Match *x) {
+        struct Branch {
+            TypedValue value;
+            llvm::BasicBlock *end;
+        };
+
+        TypedValue subject  = visit_expression(x->target);
+        llvm::Function *fun = target.native;
+        Array<Branch> results;
+
+        for(auto &branch : x->branches) {
+            TypedValue pattern = visit_expression(std::get<0>(branch));
+            PrimitiveTag tag   = promote(subject.tag, pattern.tag);
+
+            llvm::Value *a  = convert(subject, tag);
+            llvm::Value *b  = convert(pattern, tag);
+            llvm::Value *eq = is_float(tag) ? ir.CreateFCmpOEQ(a, b) : ir.CreateICmpEQ(a, b);
+
+            llvm::BasicBlock *then = llvm::BasicBlock::Create(context(), "case", fun);
+            llvm::BasicBlock *next = llvm::BasicBlock::Create(context(), "next", fun);
+            ir.CreateCondBr(eq, then, next);
+
+            ir.SetInsertPoint(then);
+            TypedValue value = visit_expression(std::get<1>(branch));
+            results.push_back(Branch{value, ir.GetInsertBlock()});
+
+            ir.SetInsertPoint(next);
+        }
+
+        TypedValue value = visit_expression(x->default_branch);
+        results.push_back(Branch{value, ir.GetInsertBlock()});
+
+        // branches can have different types
+        PrimitiveTag tag = results[0].value.tag;
+        for(Branch &branch : results)
+            tag = promote(tag, branch.value.tag);
+
+        llvm::BasicBlock *merge = llvm::BasicBlock::Create(context(), "merge", fun);
+        llvm::PHINode *phi      = llvm::PHINode::Create(native_type(context(), tag),
+                                                   unsigned(results.size()), "match", merge);
+
+        for(Branch &branch : results) {
+            ir.SetInsertPoint(branch.end);
+            phi->addIncoming(convert(branch.value, tag), branch.end);
+            ir.CreateBr(merge);
+        }
+
+        ir.SetInsertPoint(merge);
+        return {phi, tag};
+    }
+
+    // value of the last expression
+    TypedValue block(Block *x) {
+        TypedValue result = constant(0);
+        for(Statement *stmt : x->statements) {
+            if(stmt != nullptr && stmt->is_expr())
+                result = visit_expression(static_cast<Expression *>(stmt));
+        }
+        return result;
+    }
+
+    TypedValue unhandled_expression(Expression *x) {
+        return error("Cannot compile ", to_string(x->tag));
+    }
+
+    TypedValue nullptr_expression() { return constant(0); }
+
+  private:
+    llvm::LLVMContext &context() { return *module.context; }
+
+    TypedValue constant(f64 v) {
+        return {llvm::ConstantFP::get(llvm::Type::getDoubleTy(context()), v), PrimitiveTag::f64};
+    }
+
+    template <typename... Args> TypedValue error(Args const &... args) {
+        log_error(args...);
+        module.ok = false;
+        return constant(0);
+    }
+
+    TypedValue name(Symbol name) {
+        // arguments
+        for(u64 i = 0; i < target.fun->args_size(); ++i) {
+            if(std::get<0>(target.fun->arg(i)) == name)
+                return widen({target.native->getArg(unsigned(i)), target.signature.args[i]});
+        }
+
+        auto result = module.ctx.find(name);
+        if(result == module.ctx.end() || result->second == nullptr)
+            return error("Undefined variable ", name);
+
+        // bound expressions are lowered in place
+        if(depth >= max_depth)
+            return error("Recursive definition of ", name);
+
+        depth += 1;
+        TypedValue v = visit_expression(result->second);
+        depth -= 1;
+        return v;
+    }
+
+    TypedValue intrinsic(llvm::Intrinsic::ID id, TypedValue src) {
+        PrimitiveTag tag = is_float(src.tag) ? src.tag : PrimitiveTag::f64;
+        llvm::Type *type = native_type(context(), tag);
+
+        llvm::Function *fun = llvm::Intrinsic::getDeclaration(module.module.get(), id, {type});
+        return {ir.CreateCall(fun, {convert(src, tag)}), tag};
+    }
+
+    // 16 bit float bits to f32
+    TypedValue widen(TypedValue v) {
+        llvm::Type *f32 = native_type(context(), PrimitiveTag::f32);
+
+        if(v.tag == PrimitiveTag::f16) {
+            llvm::Value *half = ir.CreateBitCast(v.value, llvm::Type::getHalfTy(context()));
+            return {ir.CreateFPExt(half, f32), PrimitiveTag::f32};
+        }
+        if(v.tag == PrimitiveTag::bf16) {
+            llvm::Value *bits = ir.CreateZExt(v.value, ir.getInt32Ty());
+            return {ir.CreateBitCast(ir.CreateShl(bits, 16), f32), PrimitiveTag::f32};
+        }
+        return v;
+    }
+
+    // f32 to 16 bit float bits, rounded to nearest even
+    llvm::Value *narrow(llvm::Value *v, PrimitiveTag to) {
+        if(to == PrimitiveTag::f16) {
+            llvm::Value *half = ir.CreateFPTrunc(v, llvm::Type::getHalfTy(context()));
+            return ir.CreateBitCast(half, ir.getInt16Ty());
+        }
+
+        // same rounding as f32_to_bf16_bits, nan stays a quiet nan
+        llvm::Value *bits  = ir.CreateBitCast(v, ir.getInt32Ty());
+        llvm::Value *upper = ir.CreateLShr(bits, 16);
+        llvm::Value *bias  = ir.CreateAdd(ir.CreateAnd(upper, 1), ir.getInt32(0x7fff));
+        llvm::Value *round = ir.CreateLShr(ir.CreateAdd(bits, bias), 16);
+        llvm::Value *quiet = ir.CreateOr(upper, 0x40);
+        llvm::Value *nan   = ir.CreateFCmpUNO(v, v);
+        return ir.CreateTrunc(ir.CreateSelect(nan, quiet, round), ir.getInt16Ty());
+    }
+
+    llvm::Value *convert(TypedValue v, PrimitiveTag to) {
+        if(v.tag == to)
+            return v.value;
+
+        if(is_half(to))
+            return narrow(convert(v, PrimitiveTag::f32), to);
+
+        llvm::Type *type = native_type(context(), to);
+        bool from_float  = is_float(v.tag);
+        bool to_float    = is_float(to);
+
+        if(from_float && to_float)
+            return ir.CreateFPCast(v.value, type);
+        if(from_float)
+            return is_signed(to) ? ir.CreateFPToSI(v.value, type) : ir.CreateFPToUI(v.value, type);
+        if(to_float)
+            return is_signed(v.tag) ? ir.CreateSIToFP(v.value, type)
+                                    : ir.CreateUIToFP(v.value, type);
+        return ir.CreateIntCast(v.value, type, is_signed(v.tag));
+    }
+
+    static PrimitiveTag return_type(Function *fun) {
+        PrimitiveTag tag = get_field_primitive(fun->return_type);
+        return tag != PrimitiveTag::none ? tag : PrimitiveTag::f64;
+    }
+
+    static constexpr int max_depth = 64;
+
+    ModuleLowering &module;
+    Lowered const &target;
+    llvm::IRBuilder<> ir;
+    int depth = 0;
+};
+
+llvm::Function *ModuleLowering::declare(Function *fun, Symbol name,
+                                        NativeSignature const &signature) {
+    String key  = cache_key(fun, signature);
+    auto result = declared.find(key);
+    if(result != declared.end())
+        return result->second;
+
+    Array<llvm::Type *> args;
+    for(PrimitiveTag tag : signature.args)
+        args.push_back(native_type(*context, tag));
+
+    llvm::FunctionType *type =
+        llvm::FunctionType::get(native_type(*context, signature.result), args, false);
+
+    std::stringstream symbol;
+    symbol << module->getName().str() << "_" << (name.str().empty() ? "fun" : name.str()) << "_"
+           << functions.size();
+
+    llvm::Function *native = llvm::Function::Create(type, llvm::Function::ExternalLinkage,
+                                                    symbol.str(), module.get());
+    declared[key] = native;
+    functions.push_back(Lowered{fun, signature, native});
+    return native;
+}
+
+bool ModuleLowering::lower() {
+    // lowering a body can declare new functions
+    for(std::size_t i = 0; i < functions.size(); ++i) {
+        Lowered target = functions[i];
+        FunctionLowering(*this, target).lower();
+    }
+
+    if(!ok)
+        return false;
+
+    std::string message;
+    llvm::raw_string_ostream out(message);
+    if(llvm::verifyModule(*module, &out)) {
+        log_error("Invalid module: ", out.str());
+        return false;
+    }
+    return true;
+}
+
+void optimize(llvm::Module &module) {
+    llvm::LoopAnalysisManager lam;
+    llvm::FunctionAnalysisManager fam;
+    llvm::CGSCCAnalysisManager cgam;
+    llvm::ModuleAnalysisManager mam;
+
+    llvm::PassBuilder builder;
+    builder.registerModuleAnalyses(mam);
+    builder.registerCGSCCAnalyses(cgam);
+    builder.registerFunctionAnalyses(fam);
+    builder.registerLoopAnalyses(lam);
+    builder.crossRegisterProxies(lam, fam, cgam, mam);
+
+#if LLVM_VERSION_MAJOR >= 14
+    auto level = llvm::OptimizationLevel::O2;
+#else
+    auto level = llvm::PassBuilder::OptimizationLevel::O2;
+#endif
+    builder.buildPerModuleDefaultPipeline(level).run(module, mam);
+}
+
+} // namespace
+
+NativeJIT::NativeJIT(Context const &ctx) : ctx(ctx) {
+    static bool initialized = []() {
+        llvm::InitializeNativeTarget();
+        llvm::InitializeNativeTargetAsmPrinter();
+        return true;
+    }();
+    (void)initialized;
+
+    auto result = llvm::orc::LLJITBuilder().create();
+    if(!result) {
+        log_error("Could not create the JIT: ", llvm::toString(result.takeError()));
+        return;
+    }
+    jit = std::move(*result);
+}
+
+NativeJIT::~NativeJIT() {}
+
+void *NativeJIT::compile(Function *fun) {
+    NativeSignature signature;
+
+    PrimitiveTag result = get_field_primitive(fun->return_type);
+    if(result != PrimitiveTag::none)
+        signature.result = result;
+
+    for(u64 i = 0; i < fun->args_size(); ++i) {
+        PrimitiveTag tag = get_field_primitive(std::get<1>(fun->arg(i)));
+        signature.args.push_back(tag != PrimitiveTag::none ? tag : PrimitiveTag::f64);
+    }
+    return compile(fun, signature);
+}
+
+void *NativeJIT::compile(Function *fun, NativeSignature const &signature) {
+    if(jit == nullptr || fun == nullptr)
+        return nullptr;
+
+    if(signature.result == PrimitiveTag::none || signature.args.size() != fun->args_size()) {
+        log_error("Invalid signature ", signature.to_string());
+        return nullptr;
+    }
+    for(PrimitiveTag tag : signature.args) {
+        if(tag == PrimitiveTag::none) {
+            log_error("Invalid signature ", signature.to_string());
+            return nullptr;
+        }
+    }
+
+    String key  = cache_key(fun, signature);
+    auto cached = cache.find(key);
+    if(cached != cache.end())
+        return cached->second;
+
+    std::stringstream name;
+    name << "kiwi" << modules++;
+
+    ModuleLowering lowering(ctx, name.str(), jit->getDataLayout());
+    lowering.declare(fun, Symbol(), signature);
+
+    if(!lowering.lower())
+        return nullptr;
+
+    optimize(*lowering.module);
+
+    // names are lost once the module is handed to the JIT
+    Array<Tuple<String, String>> symbols;
+    for(Lowered &lowered : lowering.functions)
+        symbols.emplace_back(cache_key(lowered.fun, lowered.signature),
+                             lowered.native->getName().str());
+
+    llvm::orc::ThreadSafeModule module(std::move(lowering.module), std::move(lowering.context));
+    if(auto err = jit->addIRModule(std::move(module))) {
+        log_error("Could not compile: ", llvm::toString(std::move(err)));
+        return nullptr;
+    }
+
+    // the callees are cached too
+    for(auto &symbol : symbols) {
+        auto address = jit->lookup(std::get<1>(symbol));
+        if(!address) {
+            log_error("Could not find ", std::get<1>(symbol), ": ",
+                      llvm::toString(address.takeError()));
+            return nullptr;
+        }
+#if LLVM_VERSION_MAJOR >= 15
+        cache.emplace(std::get<0>(symbol), address->toPtr<void *>());
+#else
+        cache.emplace(std::get<0>(symbol), reinterpret_cast<void *>(address->getAddress()));
+#endif
+    }
+
+    return cache[key];
+}
+
+} // namespace kiwi
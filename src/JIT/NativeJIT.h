@@ -0,0 +1,73 @@
+#ifndef KIWI_JIT_NATIVE_JIT_HEADER
+#define KIWI_JIT_NATIVE_JIT_HEADER
+
+#include <memory>
+
+#include "../AST/Expression.h"
+#include "../AST/Module.h"
+#include "../AST/Primitive.h"
+
+/*
+ *  Native code generation (USE_LLVM_IR)
+ *
+ *  Functions whose arguments are primitives are lowered to LLVM IR,
+ *  optimized and compiled by ORC. The result is a plain function pointer.
+ *
+ *  A function is compiled once per signature: untyped arguments take the
+ *  type requested by the caller, functions called from the body are
+ *  specialized on the types of their arguments at the call site.
+ *
+ *  f16 and bf16 cross the function boundary as their 16 bits (kiwi::f16,
+ *  kiwi::bf16), they are computed in f32 inside the function.
+ */
+namespace llvm {
+namespace orc {
+class LLJIT;
+}
+} // namespace llvm
+
+namespace kiwi {
+
+struct NativeSignature {
+    PrimitiveTag result = PrimitiveTag::f64;
+    Array<PrimitiveTag> args;
+
+    // f64(i32,f64)
+    String to_string() const;
+};
+
+class NativeJIT {
+  public:
+    // Free names in the compiled functions are resolved in `ctx`
+    NativeJIT(Context const &ctx);
+    ~NativeJIT();
+
+    NativeJIT(NativeJIT const &) = delete;
+    NativeJIT &operator=(NativeJIT const &) = delete;
+
+    bool is_valid() const { return jit != nullptr; }
+
+    // Address of the compiled function, nullptr on failure
+    void *compile(Function *fun, NativeSignature const &signature);
+
+    // Signature from the declared argument types, untyped arguments are f64
+    void *compile(Function *fun);
+
+    template <typename Ret, typename... Args> Ret (*compile_as(Function *fun))(Args...) {
+        NativeSignature signature{get_primitive_tag<Ret>(), {get_primitive_tag<Args>()...}};
+        return reinterpret_cast<Ret (*)(Args...)>(compile(fun, signature));
+    }
+
+    // Number of (function, signature) compiled
+    std::size_t size() const { return cache.size(); }
+
+  private:
+    Context const &ctx;
+    std::unique_ptr<llvm::orc::LLJIT> jit;
+    Dict<String, void *> cache;
+    std::size_t modules = 0;
+};
+
+} // namespace kiwi
+
+#endif
@@ -240,6 +240,8 @@ public:
   Token make_token(int8 t, const std::string &identifier) {
     _token = Token(t, line(), col());
     _token.identifier() = identifier;
+    if (t == tok_identifier)
+      _token.symbol() = Symbol(identifier);
     _token.debug_print(std::cout) << std::endl;
     return _token;
   }
@@ -45,7 +45,7 @@ class Parser {
     void consume_token() { _lexer.consume(); }
     Token peek_token() { return _lexer.peek(); }
 
-    Dict<String, Option<Tuple<bool, uint8>>> operators = {
+    Dict<Symbol, Option<Tuple<bool, uint8>>> operators = {
         {"+", Option<Tuple<bool, uint8>>(std::make_tuple(true, 0))},
         {"-", Option<Tuple<bool, uint8>>(std::make_tuple(true, 0))},
         {"*", Option<Tuple<bool, uint8>>(std::make_tuple(true, 0))},
@@ -100,15 +100,15 @@ class Parser {
     Type *parse_type(int i) {
         Token tok = peek_token();
         if(tok.type() == tok_identifier)
-            return builder.make_builtin(tok.identifier());
+            return builder.make_builtin(tok.symbol());
 
         return nullptr;
     }
 
     // <name>:<expr> <end_sep> <name>:<expr> <term_sep>
-    Array<Tuple<String, Statement *>> parse_attribute_list(char end_sep, char term_sep, int i) {
-        Array<Tuple<String, Statement *>> attributes;
-        String name       = "";
+    Array<Tuple<Symbol, Statement *>> parse_attribute_list(char end_sep, char term_sep, int i) {
+        Array<Tuple<Symbol, Statement *>> attributes;
+        Symbol name;
         Statement *type   = nullptr;
         bool parsing_type = false;
         bool push_ready   = false;
@@ -119,7 +119,7 @@ class Parser {
 
             if(!parsing_type && tok.type() == tok_identifier) {
                 log_info("parsing: ", tok.identifier());
-                name = tok.identifier();
+                name = tok.symbol();
             } else if(parsing_type) {
                 type         = parse_type(i + 1);
                 parsing_type = false;
@@ -166,7 +166,7 @@ class Parser {
         consume_token();
 
         // Parse Meta Types
-        Array<Tuple<String, Statement *>> meta_types;
+        Array<Tuple<Symbol, Statement *>> meta_types;
 
         tok = peek_token();
         if(tok.type() == '(') {
@@ -184,7 +184,7 @@ class Parser {
         // --------------------------------------------------------------------
 
         // Parse Attributes
-        Array<Tuple<String, Statement *>> attributes =
+        Array<Tuple<Symbol, Statement *>> attributes =
             parse_attribute_list(tok_newline, tok_desindent, i + 1);
 
         // --------------------------------------------------------------------
@@ -196,7 +196,7 @@ class Parser {
         return std::make_tuple(name, builder.make_union(name, meta_types, attributes));
     }
 
-    Tuple<Array<String>, Array<Statement *>> parse_args(int i) {
+    Tuple<Array<Symbol>, Array<Statement *>> parse_args(int i) {
         // ---------------------- Sanity Check --------------------------------
         log_cdebug(i, "");
         Token tok = peek_token();
@@ -204,14 +204,14 @@ class Parser {
         // --------------------------------------------------------------------
 
         Array<Statement *> arg_types;
-        Array<String> arg_names;
+        Array<Symbol> arg_names;
 
         // FIXME missing )
         tok = nexttok();
         while(tok.type() != ')') {
             // handle the case where no values are present after a ','
             if(tok.type() == tok_identifier) {
-                arg_names.push_back(tok.identifier());
+                arg_names.push_back(tok.symbol());
                 tok = nexttok();
 
                 // Type annotation is optional
@@ -220,7 +220,7 @@ class Parser {
 
                     EXPECT(tok_identifier, "expected type name");
                     log_info("Type is `", tok.identifier(), "`");
-                    arg_types.push_back(builder.make_builtin(tok.identifier()));
+                    arg_types.push_back(builder.make_builtin(tok.symbol()));
 
                     tok = nexttok();
                 }
@@ -254,7 +254,7 @@ class Parser {
         String name = tok.identifier();
         consume_token();
         Array<Statement *> arg_types;
-        Array<String> arg_names;
+        Array<Symbol> arg_names;
 
         // >>>>>>>> Arguments
         // args = (identifier: identifier,*)
@@ -297,7 +297,7 @@ class Parser {
             }
         }
 
-        Block *b = new Block();
+        Block *b = builder.make_block();
         b->statements.push_back(parse(i + 1));
 
         fbuilder.add_body(b);
@@ -309,7 +309,7 @@ class Parser {
         return std::make_tuple(name, fun);
     }
 
-    Expression *parse_operator(int i, String const &op, Tuple<bool, uint8> const &info) {
+    Expression *parse_operator(int i, Symbol op, Tuple<bool, uint8> const &info) {
         Token tok = peek_token();
         // log_error(tok.type(), tok.identifier());
 
@@ -347,14 +347,14 @@ class Parser {
             lhs = parse_value(i + 1, tok.as_integer());
 
         else if(tok.type() == tok_identifier) {
-            Option<Tuple<bool, uint8>> data = operators[tok.identifier()];
+            Option<Tuple<bool, uint8>> data = operators[tok.symbol()];
 
             if(data.is_defined()) {
-                return parse_operator(i + 1, tok.identifier(), data.get());
+                return parse_operator(i + 1, tok.symbol(), data.get());
             }
 
             // log_error("'", tok.type(), "' '", tok.identifier(), "'");
-            lhs = parse_identifier(i + 1, tok.identifier());
+            lhs = parse_identifier(i + 1, tok.symbol());
         }
 
         consume_token(); // Eat ')'/tok_int...
@@ -405,11 +405,17 @@ class Parser {
         // Builder::value(val);
     }
 
-    Expression *parse_identifier(int i, std::string name) {
+    Expression *parse_identifier(int i, Symbol name) {
         log_cdebug(i, "");
+        // bound names are resolved right away
+        if(ctx.lookup(name) != nullptr)
+            return builder.get_ctx_ref(name);
         return builder.make_placeholder(name);
     }
 
+    // memory used by the parsed module
+    ArenaStats const &stats() const { return ctx.stats(); }
+
   private:
     Lexer _lexer;
     BuilderContext ctx;
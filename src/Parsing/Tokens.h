@@ -6,6 +6,7 @@
 #include <unordered_map>
 #include <vector>
 
+#include "../AST/StringDatabase.h"
 #include "../Types.h"
 
 /*
@@ -76,6 +77,7 @@ class Token {
     int32 begin_line() { return int32(col() - identifier().size()); }
 
     std::string &identifier() { return _identifier; }
+    Symbol &symbol() { return _symbol; }
     float64 as_float() { return std::stod(_identifier); }
     int32 as_integer() { return std::stoi(_identifier); }
 
@@ -88,6 +90,7 @@ class Token {
 
     // Data
     std::string _identifier;
+    Symbol _symbol;
 
   public:
     // print all tokens and their info
@@ -0,0 +1,82 @@
+#include "Bytecode.h"
+
+#include <iomanip>
+
+namespace kiwi {
+
+char const *to_string(OpCode op) {
+    switch(op) {
+#define OP(name)                                                                                   \
+    case OpCode::name:                                                                             \
+        return #name;
+        KIWI_OPCODES(OP)
+#undef OP
+    }
+    return "<op>";
+}
+
+std::ostream &disassemble(std::ostream &out, Chunk const &chunk) {
+    out << chunk.name << " (args: " << chunk.arg_count << ", registers: " << chunk.register_count
+        << ")\n";
+
+    for(std::size_t i = 0; i < chunk.code.size(); ++i) {
+        Instruction const &inst = chunk.code[i];
+        out << std::setw(4) << i << "  " << std::left << std::setw(14) << to_string(inst.op)
+            << std::right;
+
+        switch(inst.op) {
+        case OpCode::load_const:
+            out << "r" << inst.a << ", " << chunk.constants[inst.b];
+            break;
+        case OpCode::move:
+        case OpCode::neg:
+            out << "r" << inst.a << ", r" << inst.b;
+            break;
+        case OpCode::add:
+        case OpCode::sub:
+        case OpCode::mul:
+        case OpCode::div:
+            out << "r" << inst.a << ", r" << inst.b << ", r" << inst.c;
+            break;
+        case OpCode::binary_native:
+            out << "r" << inst.a << ", r" << inst.b << ", r" << inst.c << "  "
+                << to_string(BinaryOp(inst.extra));
+            break;
+        case OpCode::unary_native:
+            out << "r" << inst.a << ", r" << inst.b << "  " << to_string(UnaryOp(inst.extra));
+            break;
+        case OpCode::jump:
+            out << "@" << inst.b;
+            break;
+        case OpCode::jump_ne:
+            out << "r" << inst.a << ", r" << inst.c << ", @" << inst.b;
+            break;
+        case OpCode::jump_table: {
+            JumpTable const &table = chunk.tables[inst.b];
+            out << "r" << inst.a << ", [";
+            for(std::size_t j = 0; j < table.branches.size(); ++j)
+                out << (j > 0 ? ", @" : "@") << table.branches[j];
+            out << "], @" << table.otherwise;
+            break;
+        }
+        case OpCode::call:
+            out << "r" << inst.a << ", fn" << inst.b << ", r" << inst.c;
+            break;
+        case OpCode::ret:
+            out << "r" << inst.a;
+            break;
+        }
+        out << "\n";
+    }
+    return out;
+}
+
+std::ostream &disassemble(std::ostream &out, Program const &program) {
+    for(std::size_t i = 0; i < program.chunks.size(); ++i) {
+        out << "fn" << i << " ";
+        disassemble(out, program.chunks[i]);
+    }
+    return out;
+}
+
+} // namespace kiwi
@@ -0,0 +1,100 @@
+#ifndef KIWI_VM_BYTECODE_HEADER
+#define KIWI_VM_BYTECODE_HEADER
+
+#include <memory>
+#include <ostream>
+
+#include "../AST/StringDatabase.h"
+#include "../AST/TreeOps/Operators.h"
+#include "../Types.h"
+
+/*
+ *  Register bytecode
+ *
+ *  Every function is compiled to a Chunk. A chunk runs inside a frame of
+ *  `register_count` registers; the arguments are passed in the first
+ *  `arg_count` registers.
+ *
+ *      opcode            a         b           c
+ *      load_const        dst       constant
+ *      move              dst       src
+ *      add/sub/mul/div   dst       lhs         rhs
+ *      neg               dst       src
+ *      binary_native     dst       lhs         rhs         BinaryOp in `extra`
+ *      unary_native      dst       src                     UnaryOp in `extra`
+ *      jump                        target
+ *      jump_ne           lhs       target      rhs         jump if lhs != rhs
+ *      jump_table        src       table                   jump to the branch matching src
+ *      call              dst       chunk       first arg
+ *      ret               src
+ */
+namespace kiwi {
+
+#define KIWI_OPCODES(OP)                                                                           \
+    OP(load_const)                                                                                 \
+    OP(move)                                                                                       \
+    OP(add)                                                                                        \
+    OP(sub)                                                                                        \
+    OP(mul)                                                                                        \
+    OP(div)                                                                                        \
+    OP(neg)                                                                                        \
+    OP(binary_native)                                                                              \
+    OP(unary_native)                                                                               \
+    OP(jump)                                                                                       \
+    OP(jump_ne)                                                                                    \
+    OP(jump_table)                                                                                 \
+    OP(call)                                                                                       \
+    OP(ret)
+
+enum class OpCode : u8 {
+#define OP(name) name,
+    KIWI_OPCODES(OP)
+#undef OP
+};
+
+char const *to_string(OpCode op);
+
+using Register = u16;
+
+struct Instruction {
+    OpCode op;
+    u8 extra;
+    u16 a;
+    u16 b;
+    u16 c;
+};
+
+static_assert(sizeof(Instruction) == 8, "Instruction should fit in 8 bytes");
+
+class MatchPlan;
+
+// Compiled Match, the plan selects the branch
+struct JumpTable {
+    std::shared_ptr<MatchPlan const> plan;
+    Array<u16> branches; // first instruction of every branch
+    u16 otherwise = 0;   // first instruction of the default branch
+};
+
+struct Chunk {
+    Symbol name;
+    u16 arg_count      = 0;
+    u16 register_count = 0;
+    Array<Instruction> code;
+    Array<double> constants;
+    Array<JumpTable> tables;
+};
+
+// Compiled functions, the entry point is chunk 0
+struct Program {
+    Array<Chunk> chunks;
+
+    bool empty() const { return chunks.empty(); }
+};
+
+std::ostream &disassemble(std::ostream &out, Chunk const &chunk);
+
+std::ostream &disassemble(std::ostream &out, Program const &program);
+
+} // namespace kiwi
+
+#endif
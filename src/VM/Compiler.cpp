@@ -0,0 +1,390 @@
+#include "Compiler.h"
+
+#include <algorithm>
+#include <limits>
+
+#include "../AST/TreeOps/MatchCompiler.h"
+#include "../AST/Value.h"
+#include "../Logging/Log.h"
+
+namespace kiwi {
+
+// Compile one function body to a chunk
+// every handler returns the register holding the result of the expression
+class ChunkCompiler : public StaticExpressionVisitor<ChunkCompiler, Register> {
+  public:
+    ChunkCompiler(BytecodeCompiler &compiler, Chunk &chunk, Function *fun) :
+        compiler(compiler), chunk(chunk), fun(fun) {
+        top = chunk.arg_count;
+        chunk.register_count = top;
+    }
+
+    void compile(Expression *body) {
+        Register result = visit_expression(body);
+        emit(OpCode::ret, result);
+    }
+
+    Register value(Value *x) { return constant(x->template as<f64>()); }
+
+    Register placeholder(Placeholder *x) { return name(x->name); }
+
+    Register placeholder_ref(PlaceholderReference *x) { return name(x->name); }
+
+    Register binary_call(BinaryCall *x) {
+        if(x->op == BinaryOp::none) {
+            log_error("Unknown binary operator ", callee_name(x->fun));
+            return constant(0);
+        }
+
+        Register mark = top;
+        Register lhs  = visit_expression(x->lhs);
+        Register rhs  = visit_expression(x->rhs);
+        top           = mark;
+        Register dst  = alloc();
+
+        switch(x->op) {
+        case BinaryOp::add:
+            emit(OpCode::add, dst, lhs, rhs);
+            break;
+        case BinaryOp::sub:
+            emit(OpCode::sub, dst, lhs, rhs);
+            break;
+        case BinaryOp::mul:
+            emit(OpCode::mul, dst, lhs, rhs);
+            break;
+        case BinaryOp::div:
+            emit(OpCode::div, dst, lhs, rhs);
+            break;
+        default:
+            emit(OpCode::binary_native, dst, lhs, rhs, u8(x->op));
+        }
+
+        return dst;
+    }
+
+    Register unary_call(UnaryCall *x) {
+        if(x->op == UnaryOp::none) {
+            log_error("Unknown unary operator ", callee_name(x->fun));
+            return constant(0);
+        }
+
+        Register mark = top;
+        Register src  = visit_expression(x->expr);
+        top           = mark;
+        Register dst  = alloc();
+
+        if(x->op == UnaryOp::neg)
+            emit(OpCode::neg, dst, src);
+        else
+            emit(OpCode::unary_native, dst, src, 0, u8(x->op));
+
+        return dst;
+    }
+
+    Register function_call(FunctionCall *x) {
+        Symbol name = callee_name(x->fun);
+        auto result = compiler.ctx.find(name);
+
+        if(result == compiler.ctx.end() || result->second == nullptr ||
+           result->second->tag != NodeTag::function_def) {
+            log_error("Calling a non-function ", name);
+            return constant(0);
+        }
+
+        Function *callee = static_cast<Function *>(result->second);
+        if(callee->args_size() != x->args_size()) {
+            log_error("argument size mismatch:", callee->args_size(), " ", x->args_size());
+            return constant(0);
+        }
+
+        u16 index = compiler.function_index(callee, name);
+
+        // arguments are passed in consecutive registers
+        Register base = top;
+        for(u64 i = 0; i < x->args_size(); ++i) {
+            Register arg = visit_expression(x->arg(i));
+            top          = Register(base + i);
+            Register dst = alloc();
+
+            if(arg != dst)
+                emit(OpCode::move, dst, arg);
+        }
+
+        top = base;
+        Register dst = alloc();
+        emit(OpCode::call, dst, index, base);
+        return dst;
+    }
+
+    Register match(Match *x) {
+        // constant patterns are selected in one instruction
+        std::shared_ptr<MatchPlan const> plan = x->plan ? x->plan : MatchCompiler().plan(x);
+        if(plan->is_lookup())
+            return jump_table(x, plan);
+        if(plan->strategy == MatchStrategy::union_tag)
+            return variant(x, *plan);
+
+        Register dst    = alloc();
+        Register target = visit_expression(x->target);
+
+        Array<std::size_t> exits;
+        for(auto &branch : x->branches) {
+            Register mark    = top;
+            Register pattern = visit_expression(std::get<0>(branch));
+            top              = mark;
+
+            std::size_t next = emit(OpCode::jump_ne, target, 0, pattern);
+            set(dst, visit_expression(std::get<1>(branch)));
+            top = mark;
+
+            exits.push_back(emit(OpCode::jump));
+            patch(next);
+        }
+
+        if(x->default_branch != nullptr)
+            set(dst, visit_expression(x->default_branch));
+        else
+            set(dst, constant(0));
+
+        for(std::size_t exit : exits)
+            patch(exit);
+
+        top = Register(dst + 1);
+        return dst;
+    }
+
+    // Registers never hold a union, the branch is selected when compiling:
+    // only a union constant matches a variant, any other target takes the default branch
+    Register variant(Match *x, MatchPlan const &plan) {
+        UnionValue *target = nullptr;
+        if(!is_argument(x->target))
+            target = union_target(compiler.ctx, x->target);
+
+        u32 branch = target ? plan.select_variant(target->index) : MatchPlan::default_branch;
+
+        Expression *expr = MatchPlan::branch(x, branch);
+        if(expr == nullptr)
+            return constant(0);
+        return visit_expression(expr);
+    }
+
+    Register jump_table(Match *x, std::shared_ptr<MatchPlan const> const &plan) {
+        Register dst    = alloc();
+        Register target = visit_expression(x->target);
+
+        u16 index = operand(chunk.tables.size());
+        emit(OpCode::jump_table, target, index);
+
+        JumpTable table;
+        table.plan = plan;
+        table.branches.assign(x->branches.size(), 0);
+
+        // unreachable branches are not compiled, they are never selected
+        Array<std::size_t> exits;
+        for(std::size_t i = 0; i < x->branches.size(); ++i) {
+            auto const &dead = plan->info.unreachable;
+            if(std::binary_search(dead.begin(), dead.end(), u32(i)))
+                continue;
+
+            Register mark     = top;
+            table.branches[i] = address();
+            set(dst, visit_expression(std::get<1>(x->branches[i])));
+            top = mark;
+            exits.push_back(emit(OpCode::jump));
+        }
+
+        table.otherwise = address();
+        if(x->default_branch != nullptr)
+            set(dst, visit_expression(x->default_branch));
+        else
+            set(dst, constant(0));
+
+        for(std::size_t exit : exits)
+            patch(exit);
+
+        chunk.tables.push_back(std::move(table));
+        top = Register(dst + 1);
+        return dst;
+    }
+
+    // value of the last expression
+    Register block(Block *x) {
+        Register mark   = top;
+        Register result = Register(-1);
+
+        for(Statement *stmt : x->statements) {
+            if(stmt == nullptr || !stmt->is_expr())
+                continue;
+
+            top    = mark;
+            result = visit_expression(static_cast<Expression *>(stmt));
+        }
+
+        if(result == Register(-1))
+            return constant(0);
+
+        top = std::max<Register>(mark, Register(result + 1));
+        return result;
+    }
+
+    Register unhandled_expression(Expression *x) {
+        log_error("Cannot compile ", to_string(x->tag));
+        return constant(0);
+    }
+
+    Register nullptr_expression() { return constant(0); }
+
+  private:
+    // the last register is reused once they run out, the program is dropped anyway
+    Register alloc() {
+        Register r = top;
+        if(operand(std::size_t(top) + 1) != 0)
+            top += 1;
+
+        chunk.register_count = std::max<u16>(chunk.register_count, top);
+        return r;
+    }
+
+    std::size_t emit(OpCode op, u16 a = 0, u16 b = 0, u16 c = 0, u8 extra = 0) {
+        chunk.code.push_back(Instruction{op, extra, a, b, c});
+        return chunk.code.size() - 1;
+    }
+
+    u16 operand(std::size_t value) { return compiler.operand(value, chunk.name); }
+
+    // jump to the next instruction
+    void patch(std::size_t jump) { chunk.code[jump].b = operand(chunk.code.size()); }
+
+    // index of the next instruction
+    u16 address() { return operand(chunk.code.size()); }
+
+    void set(Register dst, Register src) {
+        if(dst != src)
+            emit(OpCode::move, dst, src);
+    }
+
+    Register constant(double v) {
+        Register dst = alloc();
+        emit(OpCode::load_const, dst, operand(chunk.constants.size()));
+        chunk.constants.push_back(v);
+        return dst;
+    }
+
+    // Index of the argument `name`, -1 if it is not one
+    int argument(Symbol name) const {
+        if(fun != nullptr) {
+            for(u64 i = 0; i < fun->args_size(); ++i) {
+                if(std::get<0>(fun->arg(i)) == name)
+                    return int(i);
+            }
+        }
+        return -1;
+    }
+
+    bool is_argument(Expression *expr) const {
+        if(expr == nullptr)
+            return false;
+        if(expr->tag == NodeTag::placeholder)
+            return argument(static_cast<Placeholder *>(expr)->name) >= 0;
+        if(expr->tag == NodeTag::placeholder_ref)
+            return argument(static_cast<PlaceholderReference *>(expr)->name) >= 0;
+        return false;
+    }
+
+    Register name(Symbol name) {
+        // arguments live in the first registers
+        int arg = argument(name);
+        if(arg >= 0)
+            return Register(arg);
+
+        auto result = compiler.ctx.find(name);
+        if(result == compiler.ctx.end() || result->second == nullptr) {
+            log_error("Undefined variable ", name);
+            return constant(0);
+        }
+
+        // bound expressions are compiled in place
+        if(depth >= max_depth) {
+            log_error("Recursive definition of ", name);
+            compiler.failed = true;
+            return constant(0);
+        }
+
+        depth += 1;
+        Register reg = visit_expression(result->second);
+        depth -= 1;
+        return reg;
+    }
+
+    static constexpr int max_depth = 64;
+
+    BytecodeCompiler &compiler;
+    Chunk &chunk;
+    Function *fun;
+    Register top = 0;
+    int depth    = 0;
+};
+
+Program BytecodeCompiler::compile(Function *fun, Symbol name) {
+    program = Program();
+    functions.clear();
+    pending.clear();
+    failed = false;
+
+    function_index(fun, name);
+    compile_pending();
+
+    if(failed)
+        return Program();
+    return std::move(program);
+}
+
+Program BytecodeCompiler::compile(Expression *expr) {
+    if(expr != nullptr && expr->tag == NodeTag::function_def)
+        return compile(static_cast<Function *>(expr));
+
+    Function entry(expr);
+    return compile(&entry);
+}
+
+u16 BytecodeCompiler::function_index(Function *fun, Symbol name) {
+    auto result = functions.find(fun);
+    if(result != functions.end())
+        return result->second;
+
+    std::size_t count = program.chunks.size();
+    u16 index         = operand(count, name);
+    if(index != count)
+        return 0;
+
+    functions[fun] = index;
+    pending.push_back(fun);
+
+    program.chunks.emplace_back();
+    program.chunks.back().name      = name;
+    program.chunks.back().arg_count = operand(fun->args_size(), name);
+    return index;
+}
+
+u16 BytecodeCompiler::operand(std::size_t value, Symbol fun) {
+    if(value <= std::numeric_limits<u16>::max())
+        return u16(value);
+
+    if(!failed)
+        log_error("Function ", fun, " is too big");
+    failed = true;
+    return 0;
+}
+
+void BytecodeCompiler::compile_pending() {
+    // compiling a chunk can discover new functions
+    for(std::size_t i = 0; i < pending.size() && !failed; ++i) {
+        Function *fun = pending[i];
+        Chunk chunk   = std::move(program.chunks[functions[fun]]);
+
+        ChunkCompiler(*this, chunk, fun).compile(static_cast<Expression *>(fun->body));
+        program.chunks[functions[fun]] = std::move(chunk);
+    }
+}
+
+} // namespace kiwi
@@ -0,0 +1,53 @@
+#ifndef KIWI_VM_COMPILER_HEADER
+#define KIWI_VM_COMPILER_HEADER
+
+#include "../AST/Expression.h"
+#include "../AST/Module.h"
+#include "../AST/Visitor.h"
+#include "Bytecode.h"
+
+namespace kiwi {
+
+/* Compile expressions to register bytecode.
+ *
+ * Names are resolved once at compile time: arguments become registers,
+ * operators become opcodes (or an index in the operator registry) and the
+ * functions reachable from the entry point through `ctx` get their own
+ * chunk. Other names bound in `ctx` are compiled inline.
+ */
+class BytecodeCompiler {
+  public:
+    BytecodeCompiler(Context const &ctx) : ctx(ctx) {}
+
+    // The arguments of `fun` are the arguments of the program
+    // the program is empty if a function is too big to be encoded
+    Program compile(Function *fun, Symbol name = Symbol());
+
+    // Program without arguments
+    Program compile(Expression *expr);
+
+  private:
+    // Chunk index of a function, compiled later if it is new
+    u16 function_index(Function *fun, Symbol name);
+
+    // Operands are 16 bits, the program is dropped if one does not fit
+    u16 operand(std::size_t value, Symbol fun);
+
+    void compile_pending();
+
+    Context const &ctx;
+    Program program;
+    Dict<Function *, u16> functions;
+    Array<Function *> pending;
+    bool failed = false;
+
+    friend class ChunkCompiler;
+};
+
+inline Program compile_bytecode(Context const &ctx, Expression *expr) {
+    return BytecodeCompiler(ctx).compile(expr);
+}
+
+} // namespace kiwi
+
+#endif
@@ -0,0 +1,161 @@
+#include "VirtualMachine.h"
+
+#include "../AST/TreeOps/MatchCompiler.h"
+#include "../Logging/Log.h"
+
+namespace kiwi {
+
+double *VirtualMachine::reserve(std::size_t base, std::size_t n) {
+    if(registers.size() < base + n)
+        registers.resize(std::max(base + n, registers.size() * 2));
+    return registers.data() + base;
+}
+
+double VirtualMachine::run(Program const &program, u16 index, double const *args,
+                           std::size_t n) {
+    if(index >= program.chunks.size()) {
+        log_error("Program has no function ", index);
+        return 0;
+    }
+
+    Chunk const *chunk = &program.chunks[index];
+    if(n != chunk->arg_count) {
+        log_error("argument size mismatch:", chunk->arg_count, " ", n);
+        return 0;
+    }
+
+    frames.clear();
+    std::size_t base = 0;
+    double *r        = reserve(base, chunk->register_count);
+    for(std::size_t i = 0; i < n; ++i)
+        r[i] = args[i];
+
+    double const *k       = chunk->constants.data();
+    Instruction const *pc = chunk->code.data();
+    Instruction inst;
+
+#if KIWI_THREADED_DISPATCH
+    static void *const labels[] = {
+#define OP(name) &&op_##name,
+        KIWI_OPCODES(OP)
+#undef OP
+    };
+
+#define VM_CASE(name) op_##name
+#define VM_DISPATCH()                                                                              \
+    do {                                                                                           \
+        inst = *pc++;                                                                              \
+        goto *labels[u8(inst.op)];                                                                 \
+    } while(0)
+
+    VM_DISPATCH();
+#else
+#define VM_CASE(name) case OpCode::name
+#define VM_DISPATCH() goto dispatch
+
+dispatch:
+    inst = *pc++;
+    switch(inst.op) {
+#endif
+
+    VM_CASE(load_const):
+        r[inst.a] = k[inst.b];
+        VM_DISPATCH();
+
+    VM_CASE(move):
+        r[inst.a] = r[inst.b];
+        VM_DISPATCH();
+
+    VM_CASE(add):
+        r[inst.a] = r[inst.b] + r[inst.c];
+        VM_DISPATCH();
+
+    VM_CASE(sub):
+        r[inst.a] = r[inst.b] - r[inst.c];
+        VM_DISPATCH();
+
+    VM_CASE(mul):
+        r[inst.a] = r[inst.b] * r[inst.c];
+        VM_DISPATCH();
+
+    VM_CASE(div):
+        r[inst.a] = r[inst.b] / r[inst.c];
+        VM_DISPATCH();
+
+    VM_CASE(neg):
+        r[inst.a] = -r[inst.b];
+        VM_DISPATCH();
+
+    VM_CASE(binary_native):
+        r[inst.a] = binary_operator(BinaryOp(inst.extra))(r[inst.b], r[inst.c]);
+        VM_DISPATCH();
+
+    VM_CASE(unary_native):
+        r[inst.a] = unary_operator(UnaryOp(inst.extra))(r[inst.b]);
+        VM_DISPATCH();
+
+    VM_CASE(jump):
+        pc = chunk->code.data() + inst.b;
+        VM_DISPATCH();
+
+    VM_CASE(jump_ne):
+        if(r[inst.a] != r[inst.c])
+            pc = chunk->code.data() + inst.b;
+        VM_DISPATCH();
+
+    VM_CASE(jump_table): {
+        JumpTable const &table = chunk->tables[inst.b];
+        u32 branch             = table.plan->select(r[inst.a]);
+
+        u16 target = branch == MatchPlan::default_branch ? table.otherwise : table.branches[branch];
+        pc         = chunk->code.data() + target;
+        VM_DISPATCH();
+    }
+
+    VM_CASE(call): {
+        Chunk const *callee = &program.chunks[inst.b];
+        frames.push_back(Frame{chunk, pc, base, inst.a});
+
+        std::size_t args_base = base + inst.c;
+        base                  = base + chunk->register_count;
+        r                     = reserve(base, callee->register_count);
+
+        // registers might have moved
+        double const *args = registers.data() + args_base;
+        for(u16 i = 0; i < callee->arg_count; ++i)
+            r[i] = args[i];
+
+        chunk = callee;
+        k     = chunk->constants.data();
+        pc    = chunk->code.data();
+        VM_DISPATCH();
+    }
+
+    VM_CASE(ret): {
+        double result = r[inst.a];
+        if(frames.empty())
+            return result;
+
+        Frame frame = frames.back();
+        frames.pop_back();
+
+        chunk = frame.chunk;
+        k     = chunk->constants.data();
+        pc    = frame.pc;
+        base  = frame.base;
+        r     = registers.data() + base;
+
+        r[frame.dst] = result;
+        VM_DISPATCH();
+    }
+
+#if !KIWI_THREADED_DISPATCH
+    }
+    return 0;
+#endif
+
+#undef VM_CASE
+#undef VM_DISPATCH
+}
+
+} // namespace kiwi
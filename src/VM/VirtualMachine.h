@@ -0,0 +1,46 @@
+#ifndef KIWI_VM_VIRTUAL_MACHINE_HEADER
+#define KIWI_VM_VIRTUAL_MACHINE_HEADER
+
+#include "Bytecode.h"
+
+// Dispatch with computed gotos when the compiler supports it
+#if defined(__GNUC__) || defined(__clang__)
+#define KIWI_THREADED_DISPATCH 1
+#else
+#define KIWI_THREADED_DISPATCH 0
+#endif
+
+namespace kiwi {
+
+/* Register machine running a Program.
+ *
+ * Calls do not recurse on the C++ stack: frames are pushed on an explicit
+ * stack and the registers of every frame live in one contiguous array.
+ * Both are kept between runs to avoid reallocating.
+ */
+class VirtualMachine {
+  public:
+    double run(Program const &program, Array<double> const &args = Array<double>()) {
+        return run(program, 0, args.data(), args.size());
+    }
+
+    double run(Program const &program, u16 chunk, double const *args, std::size_t n);
+
+  private:
+    struct Frame {
+        Chunk const *chunk;
+        Instruction const *pc;
+        std::size_t base;
+        Register dst;
+    };
+
+    // make sure registers [base, base + n) exist
+    double *reserve(std::size_t base, std::size_t n);
+
+    Array<double> registers;
+    Array<Frame> frames;
+};
+
+} // namespace kiwi
+
+#endif
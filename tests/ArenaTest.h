@@ -0,0 +1,95 @@
+#pragma once
+#include "AST/Builder.h"
+#include <gtest/gtest.h>
+
+using namespace kiwi;
+
+TEST(Arena, Alignment) {
+    Arena arena(128);
+
+    for(int i = 0; i < 64; ++i) {
+        arena.allocate(3, 1);
+        void *ptr = arena.allocate(8, 64);
+        EXPECT_EQ(reinterpret_cast<std::uintptr_t>(ptr) % 64, 0u);
+    }
+
+    EXPECT_EQ(arena.stats().allocations, 128u);
+    EXPECT_GT(arena.stats().blocks, 1u);
+}
+
+TEST(Arena, Reset) {
+    Arena arena(256);
+
+    for(int i = 0; i < 100; ++i)
+        arena.make<Placeholder>("x");
+
+    u64 peak = arena.stats().peak_bytes;
+    arena.reset();
+
+    EXPECT_EQ(arena.stats().bytes, 0u);
+    EXPECT_EQ(arena.stats().blocks, 1u);
+    EXPECT_EQ(arena.stats().peak_bytes, peak);
+}
+
+TEST(Arena, BuilderStats) {
+    BuilderContext ctx;
+    Builder builder(&ctx);
+
+    builder.make_placeholder("+");
+    Expression *x = builder.make_placeholder("x");
+    Expression *v = builder.make_value(2.0);
+    builder.make_binary_call("+", x, v);
+
+    // 2 placeholders + value + reference + call
+    EXPECT_EQ(builder.stats().allocations, 5u);
+    EXPECT_GT(builder.stats().peak_bytes, 0u);
+}
+
+TEST(Arena, Rewind) {
+    Arena arena(256);
+    arena.make<Placeholder>("x");
+
+    Arena::Mark mark = arena.mark();
+    u64 bytes        = arena.stats().bytes;
+
+    for(int i = 0; i < 100; ++i)
+        arena.make<Placeholder>("y");
+
+    u64 blocks = arena.stats().blocks;
+    arena.rewind(mark);
+
+    // blocks are kept for the next allocations
+    EXPECT_EQ(arena.stats().bytes, bytes);
+    EXPECT_EQ(arena.stats().blocks, blocks);
+
+    for(int i = 0; i < 100; ++i)
+        arena.make<Placeholder>("z");
+    EXPECT_EQ(arena.stats().blocks, blocks);
+
+    arena.rewind(mark);
+    arena.trim();
+    EXPECT_EQ(arena.stats().blocks, 1u);
+}
+
+TEST(Arena, Owns) {
+    Arena arena(256);
+    Placeholder *first = arena.make<Placeholder>("x");
+    Arena::Mark mark   = arena.mark();
+
+    Array<Placeholder *> nodes;
+    for(int i = 0; i < 100; ++i)
+        nodes.push_back(arena.make<Placeholder>("y"));
+
+    Placeholder outside("z");
+    EXPECT_FALSE(arena.owns(&outside));
+    for(Placeholder *node : nodes)
+        EXPECT_TRUE(arena.owns(node));
+
+    // blocks kept for reuse are not owned until they are handed out again
+    arena.rewind(mark);
+    EXPECT_TRUE(arena.owns(first));
+    EXPECT_FALSE(arena.owns(nodes.back()));
+
+    for(int i = 0; i < 100; ++i)
+        EXPECT_TRUE(arena.owns(arena.make<Placeholder>("z")));
+}
@@ -0,0 +1,194 @@
+#pragma once
+#include "AST/Builder.h"
+#include "AST/TreeOps/ArrayEval.h"
+#include <cmath>
+#include <gtest/gtest.h>
+#include <sstream>
+
+using namespace kiwi;
+
+TEST(ArrayValue, Storage) {
+    ArrayValue a(PrimitiveTag::f32, {2, 3});
+
+    EXPECT_EQ(a.rank(), 2u);
+    EXPECT_EQ(a.size(), 6u);
+    EXPECT_EQ(a.nbytes(), 24u);
+    EXPECT_TRUE(a.owns_data());
+    EXPECT_EQ(reinterpret_cast<std::uintptr_t>(a.data()) % ArrayValue::alignment, 0u);
+
+    for(std::size_t i = 0; i < a.size(); ++i)
+        a.set(i, f64(i) * 0.5);
+
+    EXPECT_EQ(a.values<f32>()[3], 1.5f);
+    EXPECT_EQ(a.as<i32>(4), 2);
+    EXPECT_EQ(a.as<i32>(6), 0); // out of range
+
+    std::stringstream ss;
+    a.dump(ss);
+    EXPECT_EQ(ss.str(), "[0, 0.5, 1, 1.5, 2, 2.5]: f32[2, 3]");
+
+    // views do not own their elements
+    i64 buffer[4] = {1, 2, 3, 4};
+    ArrayValue view(PrimitiveTag::i64, {4}, buffer);
+    EXPECT_FALSE(view.owns_data());
+    EXPECT_EQ(view.get<i64>(2), 3);
+}
+
+TEST(ArrayEval, Elementwise) {
+    BuilderContext ctx;
+    Builder builder(&ctx);
+
+    builder.make_placeholder("+");
+    builder.make_placeholder("*");
+    builder.make_placeholder("sqrt");
+    builder.make_placeholder("x");
+    builder.make_placeholder("y");
+
+    // not a multiple of the vector width
+    std::size_t n = 1003;
+    ArrayValue x(PrimitiveTag::f32, {n}), y(PrimitiveTag::f32, {n});
+    for(std::size_t i = 0; i < n; ++i) {
+        x.set(i, f32(i) * 0.25f);
+        y.set(i, 3.0f - f32(i));
+    }
+
+    Context env;
+    env[Symbol("x")] = &x;
+    env[Symbol("y")] = &y;
+
+    // x * 2 + y
+    Expression *expr = builder.make_binary_call(
+        "+", builder.make_binary_call("*", builder.get_ctx_ref("x"), builder.make_value(2.0f)),
+        builder.get_ctx_ref("y"));
+
+    ArrayEval eval(env);
+    Value *r = eval.run(expr);
+    ASSERT_NE(r, nullptr);
+    ASSERT_EQ(r->value_tag, ValueTag::varray);
+
+    ArrayValue *result = static_cast<ArrayValue *>(r);
+    EXPECT_EQ(result->tag(), PrimitiveTag::f32);
+    EXPECT_EQ(result->shape(), Array<u64>{n});
+    for(std::size_t i = 0; i < n; ++i)
+        ASSERT_EQ(result->values<f32>()[i], x.values<f32>()[i] * 2.0f + y.values<f32>()[i]);
+
+    // integers are promoted, sqrt of an integer is a f64
+    ArrayValue k(PrimitiveTag::i32, {n});
+    for(std::size_t i = 0; i < n; ++i)
+        k.set(i, i32(i));
+    env[Symbol("y")] = &k;
+
+    result = static_cast<ArrayValue *>(eval.run(expr));
+    EXPECT_EQ(result->tag(), PrimitiveTag::f32);
+    EXPECT_EQ(result->get<f32>(10), 15.0f);
+
+    // the scalar is promoted too: k * 0.5 is a f64
+    result = static_cast<ArrayValue *>(eval.run(
+        builder.make_binary_call("*", builder.get_ctx_ref("y"), builder.make_value(0.5))));
+    EXPECT_EQ(result->tag(), PrimitiveTag::f64);
+    EXPECT_EQ(result->get<f64>(9), 4.5);
+
+    result = static_cast<ArrayValue *>(
+        eval.run(builder.make_unary_call("sqrt", builder.get_ctx_ref("y"))));
+    EXPECT_EQ(result->tag(), PrimitiveTag::f64);
+    EXPECT_EQ(result->get<f64>(49), 7.0);
+
+    // shapes must match
+    ArrayValue z(PrimitiveTag::f32, {n - 1});
+    env[Symbol("y")] = &z;
+    EXPECT_EQ(eval.run(expr), nullptr);
+}
+
+TEST(ArrayEval, Reductions) {
+    BuilderContext ctx;
+    Builder builder(&ctx);
+
+    builder.make_placeholder("-");
+    builder.make_placeholder("*");
+    builder.make_placeholder("/");
+    builder.make_placeholder("sum");
+    builder.make_placeholder("max");
+    builder.make_placeholder("mean");
+    builder.make_placeholder("x");
+
+    auto call = [&](char const *name, Expression *arg) -> Expression * {
+        return builder.make<FunctionCall>(builder.get_ctx_ref(name), Array<Expression *>{arg});
+    };
+
+    ArrayValue x(PrimitiveTag::i64, {3, 4});
+    for(std::size_t i = 0; i < x.size(); ++i)
+        x.set(i, i64(i) - 4);
+
+    Context env;
+    env[Symbol("x")] = &x;
+
+    ArrayEval eval(env);
+    Value *r = eval.run(call("sum", builder.get_ctx_ref("x")));
+    ASSERT_NE(r, nullptr);
+    EXPECT_EQ(static_cast<PrimitiveValue *>(r)->tag(), PrimitiveTag::i64);
+    EXPECT_EQ(r->as<i64>(), 18);
+    EXPECT_EQ(eval.run(call("max", builder.get_ctx_ref("x")))->as<i64>(), 7);
+    EXPECT_EQ(eval.run(call("mean", builder.get_ctx_ref("x")))->as<f64>(), 1.5);
+
+    // 16 bit floats are accumulated in f32: 2048 + 1 is 2048 in f16
+    ArrayValue h(PrimitiveTag::f16, {32768});
+    for(std::size_t i = 0; i < h.size(); ++i)
+        h.set(i, 1.0f);
+    env[Symbol("x")] = &h;
+
+    r = eval.run(call("sum", builder.get_ctx_ref("x")));
+    EXPECT_EQ(static_cast<PrimitiveValue *>(r)->tag(), PrimitiveTag::f16);
+    EXPECT_EQ(r->as<f32>(), 32768.0f);
+
+    // def center(v) = v - mean(v), functions take arrays
+    FunctionBuilder fb = builder.make_function("center");
+    fb.add_arg("v", get_primitive_type<f64>());
+    fb.add_body(builder.make_binary_call("-", builder.get_ctx_ref("v"),
+                                         call("mean", builder.get_ctx_ref("v"))));
+    env[Symbol("center")] = fb.build();
+    env[Symbol("x")]      = &x;
+
+    Expression *centered = call("center", builder.get_ctx_ref("x"));
+    ArrayValue *result = static_cast<ArrayValue *>(eval.run(centered));
+    ASSERT_NE(result, nullptr);
+    EXPECT_EQ(result->tag(), PrimitiveTag::f64); // mean is a f64
+    EXPECT_EQ(result->get<f64>(0), -5.5);
+
+    // a name bound in the context is not a builtin
+    env[Symbol("sum")] = env[Symbol("center")];
+    EXPECT_EQ(eval.run(call("sum", builder.get_ctx_ref("x")))->value_tag, ValueTag::varray);
+}
+
+TEST(ArrayEval, Region) {
+    BuilderContext ctx;
+    Builder builder(&ctx);
+
+    builder.make_placeholder("*");
+    builder.make_placeholder("x");
+
+    ArrayValue x(PrimitiveTag::f64, {16});
+    for(std::size_t i = 0; i < x.size(); ++i)
+        x.set(i, f64(i));
+
+    Context env;
+    env[Symbol("x")] = &x;
+
+    Expression *expr =
+        builder.make_binary_call("*", builder.get_ctx_ref("x"), builder.get_ctx_ref("x"));
+
+    EvalRegion region;
+    Arena module;
+    Value *kept = nullptr;
+    {
+        EvalRegion::Scope scope(region);
+        ArrayEval eval(env);
+        Value *r = eval.run(expr);
+        EXPECT_TRUE(region.owns(r));
+        EXPECT_TRUE(region.owns(static_cast<ArrayValue *>(r)->data()));
+        kept = region.promote(r, module);
+    }
+
+    ArrayValue *result = static_cast<ArrayValue *>(kept);
+    EXPECT_TRUE(module.owns(result->data()));
+    EXPECT_EQ(result->get<f64>(15), 225.0);
+}
@@ -0,0 +1,100 @@
+#pragma once
+#include "AST/TreeOps/BatchEval.h"
+#include "AST/TreeOps/EvalExpression.h"
+#include <gtest/gtest.h>
+
+using namespace kiwi;
+
+TEST(BatchEval, MatchesFullEval) {
+    BuilderContext ctx;
+    Builder builder(&ctx);
+
+    builder.make_placeholder("+");
+    builder.make_placeholder("-");
+    builder.make_placeholder("*");
+    builder.make_placeholder("/");
+    builder.make_placeholder("sqrt");
+    builder.make_placeholder("x");
+    builder.make_placeholder("y");
+
+    auto x = [&]() { return builder.get_ctx_ref("x"); };
+    auto y = [&]() { return builder.get_ctx_ref("y"); };
+
+    // sqrt(x * x + y) / (2 - -y)
+    Expression *arith = builder.make_binary_call(
+        "/",
+        builder.make_unary_call("sqrt", builder.make_binary_call(
+                                            "+", builder.make_binary_call("*", x(), x()), y())),
+        builder.make_binary_call("-", builder.make_value(2.0), builder.make_unary_call("-", y())));
+
+    // x match | 1 => y | 2 => 10 * y | _ => x
+    Match *match  = builder.make<Match>();
+    match->target = x();
+    match->branches.emplace_back(builder.make_value(1.0), y());
+    match->branches.emplace_back(builder.make_value(2.0),
+                                 builder.make_binary_call("*", builder.make_value(10.0), y()));
+    match->default_branch = x();
+
+    // def sq(v) = v * v; sq(x + y)
+    FunctionBuilder fb = builder.make_function("sq");
+    fb.add_arg("v", get_primitive_type<f64>());
+    fb.add_body(builder.make_binary_call("*", builder.get_ctx_ref("v"), builder.get_ctx_ref("v")));
+    Function *sq = fb.build();
+
+    Expression *call = builder.make<FunctionCall>(
+        builder.get_ctx_ref("sq"), Array<Expression *>{builder.make_binary_call("+", x(), y())});
+
+    // 1 + (x * 2 match | 2 => y | 4 => sq(x + y) | _ => x), the target is a temporary
+    Match *computed  = builder.make<Match>();
+    computed->target = builder.make_binary_call("*", x(), builder.make_value(2.0));
+    computed->branches.emplace_back(builder.make_value(2.0), y());
+    computed->branches.emplace_back(builder.make_value(4.0), call);
+    computed->default_branch = x();
+    Expression *nested = builder.make_binary_call("+", builder.make_value(1.0), computed);
+
+    // more than one tile, not a multiple of the vector width
+    std::size_t n = BatchEval::tile_size * 2 + 3;
+    Array<double> xs(n), ys(n);
+    for(std::size_t i = 0; i < n; ++i) {
+        xs[i] = double(i % 4);
+        ys[i] = double(i) * 0.5;
+    }
+
+    Context env;
+    env[Symbol("sq")] = sq;
+
+    Columns columns = {{Symbol("x"), xs.data()}, {Symbol("y"), ys.data()}};
+    BatchEval batch(env, columns);
+
+    for(Expression *expr : {arith, static_cast<Expression *>(match), call, nested}) {
+        Array<double> result = batch.run(expr, n);
+        ASSERT_EQ(result.size(), n);
+
+        for(std::size_t i = 0; i < n; i += 97) {
+            PrimitiveValue vx(xs[i]), vy(ys[i]);
+            Context row = env;
+            row[Symbol("x")] = &vx;
+            row[Symbol("y")] = &vy;
+
+            EXPECT_DOUBLE_EQ(result[i], full_eval(row, expr)) << "row " << i;
+        }
+    }
+}
+
+TEST(BatchEval, ScalarOperands) {
+    BuilderContext ctx;
+    Builder builder(&ctx);
+
+    builder.make_placeholder("+");
+    builder.make_placeholder("k");
+
+    Context env;
+    env[Symbol("k")] = builder.make_value(3.0);
+
+    // no column: computed once and broadcast
+    Expression *expr =
+        builder.make_binary_call("+", builder.get_ctx_ref("k"), builder.make_value(1.0));
+
+    Array<double> result = batch_eval(env, Columns(), expr, 5);
+    EXPECT_EQ(result, Array<double>(5, 4.0));
+}
@@ -0,0 +1,132 @@
+#pragma once
+#include "AST/TreeOps/BinaryConversion.h"
+#include <cstddef>
+#include <gtest/gtest.h>
+
+using namespace kiwi;
+
+TEST(BinaryConversion, RoundTrip) {
+    BuilderContext ctx;
+    Builder builder(&ctx);
+
+    builder.make_placeholder("+");
+    builder.make_placeholder("x");
+    Expression *body =
+        builder.make_binary_call("+", builder.get_ctx_ref("x"), builder.make_value(2.0));
+
+    FunctionDefinition *fun = builder.make<FunctionDefinition>("add2", body);
+    fun->add_arg("x");
+
+    StructDefinition *def =
+        builder.make<StructDefinition>(Symbol("Point"), Array<Tuple<Symbol, Statement *>>(),
+                                       Array<Tuple<Symbol, Statement *>>{
+                                           {"x", get_primitive_type<f64>()},
+                                           {"y", get_primitive_type<i32>()},
+                                       });
+
+    Module module = {{"add2", fun}, {"Point", def}};
+    String path   = "kiwi_binary_test.kwb";
+    ASSERT_TRUE(write_binary(module, path));
+
+    MappedFile file(path);
+    ASSERT_TRUE(file.is_open());
+
+    BinaryModule binary(file);
+    ASSERT_TRUE(binary.is_valid());
+    EXPECT_EQ(binary.size(), 2u);
+    EXPECT_EQ(binary.find("missing"), nullptr);
+
+    // used in place
+    BinaryNode const *node = binary.find("add2");
+    ASSERT_NE(node, nullptr);
+    EXPECT_EQ(node->tag, NodeTag::function_def);
+    EXPECT_EQ(binary.symbol(node->child(2)->symbol), Symbol("x"));
+
+    BinaryNode const *call = node->child(1);
+    EXPECT_EQ(call->tag, NodeTag::binary_call);
+    EXPECT_EQ(load_primitive<f64>(PrimitiveTag(call->child(2)->symbol), &call->child(2)->extra),
+              2.0);
+
+    // rebuilt on demand
+    BuilderContext lctx;
+    Builder lbuilder(&lctx);
+    BinaryLoader loader(binary, lbuilder);
+
+    auto loaded = static_cast<FunctionDefinition *>(loader.definition("add2"));
+    ASSERT_NE(loaded, nullptr);
+    EXPECT_EQ(loaded->name, Symbol("add2"));
+    EXPECT_EQ(loaded->args, Array<Symbol>{Symbol("x")});
+
+    auto lbody = static_cast<BinaryCall *>(loaded->body);
+    auto ref   = static_cast<PlaceholderReference *>(lbody->lhs);
+    EXPECT_EQ(ref->name, Symbol("x"));
+    EXPECT_EQ(ref->index, 1);
+    EXPECT_EQ(static_cast<Value *>(lbody->rhs)->as<f64>(), 2.0);
+
+    auto ldef = static_cast<StructDefinition *>(loader.definition("Point"));
+    ASSERT_EQ(ldef->attributes.size(), 2u);
+    EXPECT_EQ(std::get<0>(ldef->attributes[1]), Symbol("y"));
+    EXPECT_EQ(static_cast<BuiltinType *>(std::get<1>(ldef->attributes[1]))->name, Symbol("i32"));
+
+    std::remove(path.c_str());
+}
+
+TEST(BinaryConversion, RejectsOtherVersions) {
+    Array<u8> data = write_binary(Module());
+    data[4] += 1;
+
+    BinaryModule binary(data.data(), data.size());
+    EXPECT_FALSE(binary.is_valid());
+    EXPECT_EQ(binary.size(), 0u);
+}
+
+TEST(BinaryConversion, RejectsCorruptedNodes) {
+    BuilderContext ctx;
+    Builder builder(&ctx);
+
+    builder.make_placeholder("+");
+    builder.make_placeholder("x");
+    Expression *body =
+        builder.make_binary_call("+", builder.get_ctx_ref("x"), builder.make_value(2.0));
+
+    FunctionDefinition *fun = builder.make<FunctionDefinition>("add2", body);
+    fun->add_arg("x");
+
+    Array<u8> data = write_binary(Module{{"add2", fun}});
+    BinaryModule binary(data.data(), data.size());
+    ASSERT_TRUE(binary.is_valid());
+
+    auto valid_with = [&](std::size_t offset, auto value) {
+        Array<u8> copy = data;
+        std::memcpy(copy.data() + offset, &value, sizeof(value));
+        return BinaryModule(copy.data(), copy.size()).is_valid();
+    };
+
+    BinaryHeader header;
+    std::memcpy(&header, data.data(), sizeof(BinaryHeader));
+
+    auto node_offset = [&](BinaryNode const *node) {
+        return std::size_t(reinterpret_cast<u8 const *>(node) - data.data());
+    };
+    std::size_t def      = node_offset(binary.find("add2"));
+    std::size_t children = def + sizeof(BinaryNode);
+
+    EXPECT_FALSE(valid_with(def + offsetof(BinaryNode, child_count), u32(1) << 30));
+    EXPECT_FALSE(valid_with(def + offsetof(BinaryNode, symbol), header.string_count));
+    EXPECT_FALSE(valid_with(children + sizeof(i32), i32(8)));  // after its parent
+    EXPECT_FALSE(valid_with(children + sizeof(i32), i32(-4))); // inside a node
+    EXPECT_FALSE(valid_with(header.strings, u32(data.size())));
+    EXPECT_FALSE(valid_with(header.entries + offsetof(BinaryEntry, node), u32(def + 8)));
+}
+
+TEST(BinaryConversion, UnsupportedNodes) {
+    BuilderContext ctx;
+    Builder builder(&ctx);
+
+    ArrayValue array(PrimitiveTag::f64, Array<u64>{4});
+    FunctionDefinition *fun = builder.make<FunctionDefinition>("table", &array);
+
+    // an offset of 0 would load as nullptr, the module is not written at all
+    EXPECT_TRUE(write_binary(Module{{"table", fun}}).empty());
+    EXPECT_FALSE(write_binary(Module{{"table", fun}}, "kiwi_unsupported.kwb"));
+}
@@ -1,5 +1,8 @@
 #pragma once
 #include "AST/Builder.h"
+#include "AST/Module.h"
+#include "AST/ParallelBuilder.h"
+#include <functional>
 #include <gtest/gtest.h>
 
 using namespace kiwi;
@@ -45,3 +48,184 @@ TEST(BuilderContext, NestedScope) {
     ctx.exit_scope();
     // clang-format on
 }
+
+TEST(BuilderContext, HashConsing) {
+    BuilderContext ctx;
+    Builder builder(&ctx, true);
+
+    builder.make_placeholder("+");
+    Expression *x = builder.make_placeholder("x");
+
+    Expression *a = builder.make_binary_call("+", x, builder.make_value(2.0));
+    Expression *b = builder.make_binary_call("+", x, builder.make_value(2.0));
+
+    EXPECT_EQ(a, b);
+    EXPECT_NE(builder.make_value(2.0), builder.make_value(2));
+    EXPECT_NE(a, builder.make_binary_call("+", builder.make_value(2.0), x));
+
+    builder.set_hash_consing(false);
+    EXPECT_NE(a, builder.make_binary_call("+", x, builder.make_value(2.0)));
+
+    EXPECT_GT(ctx.hash_cons().stats().hits, 0u);
+}
+
+TEST(BuilderContext, ResolvedReferences) {
+    BuilderContext ctx;
+    Builder builder(&ctx);
+
+    builder.make_placeholder("x");
+    builder.make_placeholder("y");
+
+    ctx.enter_scope();
+    builder.make_placeholder("z");
+    builder.make_placeholder("x");
+
+    PlaceholderReference *x = builder.get_ctx_ref("x");
+    EXPECT_EQ(x->depth, 0);
+    EXPECT_EQ(x->index, 1);
+
+    ctx.enter_scope();
+    PlaceholderReference *y = builder.get_ctx_ref("y");
+    EXPECT_EQ(y->depth, 2);
+    EXPECT_EQ(y->index, 1);
+    ctx.exit_scope();
+
+    ctx.exit_scope();
+
+    // shadowing is undone with the scope
+    x = builder.get_ctx_ref("x");
+    EXPECT_EQ(x->depth, 0);
+    EXPECT_EQ(x->index, 0);
+    EXPECT_FALSE(builder.get_ctx_ref("z")->is_resolved());
+
+    GlobalScope scope(16);
+    scope.push(builder.make_value(1.0), builder.make_value(2.0));
+    {
+        LocalScope local(scope);
+        local.push(builder.make_value(3.0));
+        EXPECT_EQ(static_cast<Value *>(local.get(0, 0))->as<f64>(), 3.0);
+        EXPECT_EQ(static_cast<Value *>(local.get(1, 1))->as<f64>(), 2.0);
+    }
+    EXPECT_EQ(scope.size(), 2u);
+}
+
+TEST(BuilderContext, StaticLinks) {
+    BuilderContext ctx;
+    Builder builder(&ctx);
+
+    // unnamed statements do not take a slot
+    ctx.insert(builder.make_value(0.0));
+    builder.make_placeholder("k");
+    EXPECT_EQ(builder.get_ctx_ref("k")->index, 0);
+
+    auto value = [](Expression *v) { return v ? static_cast<Value *>(v)->as<f64>() : -1.0; };
+
+    GlobalScope scope(64);
+    scope.push(builder.make_value(10.0)); // k
+
+    // def f(n) = { m = n - 1; f(m) }, f is called from the inner block
+    Array<double> globals;
+    std::function<void(double)> f = [&](double n) {
+        LocalScope body(scope); // nested where f is defined
+        body.push(builder.make_value(n));
+        globals.push_back(value(body.get(1, 0)));
+
+        LocalScope block(body);
+        block.push(builder.make_value(n - 1));
+        EXPECT_EQ(value(block.get(1, 0)), n);
+        EXPECT_EQ(value(block.get(2, 0)), 10.0);
+
+        if(n > 0)
+            f(n - 1);
+    };
+    f(3);
+
+    EXPECT_EQ(globals, Array<double>(4, 10.0));
+    EXPECT_EQ(scope.size(), 1u);
+
+    // above the global scope, past the slots of a frame
+    EXPECT_EQ(scope.get(1, 0), nullptr);
+    EXPECT_EQ(scope.get(0, 1), nullptr);
+}
+
+TEST(BuilderContext, ParallelModule) {
+    ParallelModuleBuilder pbuilder(4);
+
+    pbuilder.run(1000, [](ModuleWorker &worker, std::size_t i) {
+        Builder &builder = worker.builder();
+        Symbol name("def_" + std::to_string(i % 900));
+
+        builder.make_placeholder("x");
+        Expression *body = builder.make_binary_call("+", builder.get_ctx_ref("x"),
+                                                    builder.make_value(f64(i)));
+
+        FunctionDefinition *def = builder.make<FunctionDefinition>(name, body);
+        def->add_arg("x");
+        worker.emit(def);
+    });
+
+    Module module = pbuilder.merge();
+    EXPECT_EQ(module.size(), 900u);
+    EXPECT_EQ(pbuilder.conflicts().size(), 100u);
+
+    // the first emission wins whatever the scheduling
+    for(ModuleConflict const &conflict : pbuilder.conflicts()) {
+        auto kept = static_cast<FunctionDefinition *>(conflict.kept);
+        auto body = static_cast<BinaryCall *>(kept->body);
+        EXPECT_LT(static_cast<Value *>(body->rhs)->as<f64>(), 100.0);
+    }
+}
+
+TEST(BuilderContext, ParallelModuleErrors) {
+    ParallelModuleBuilder pbuilder(4);
+
+    bool thrown = false;
+    try {
+        pbuilder.run(100, [](ModuleWorker &worker, std::size_t i) {
+            if(i == 10)
+                throw i;
+            worker.emit(worker.builder().make<FunctionDefinition>("def_" + std::to_string(i),
+                                                                  nullptr));
+        });
+    } catch(std::size_t i) {
+        thrown = i == 10;
+    }
+    EXPECT_TRUE(thrown);
+
+    // every thread was joined, the builder is still usable
+    pbuilder.run(4, [](ModuleWorker &worker, std::size_t i) {
+        worker.emit(worker.builder().make<FunctionDefinition>("after_" + std::to_string(i),
+                                                              nullptr));
+    });
+    EXPECT_EQ(pbuilder.merge().count("after_3"), 1u);
+
+    // ids of names interned up front follow their order
+    ParallelModuleBuilder::intern({"interned_b", "interned_a"});
+    EXPECT_LT(Symbol("interned_b").id(), Symbol("interned_a").id());
+}
+
+TEST(BuilderContext, ParallelModuleScopes) {
+    std::size_t const n = 64;
+
+    for(std::size_t workers : {1, 2, 4}) {
+        ParallelModuleBuilder pbuilder(workers);
+        Array<int> leaked(n, 0);
+
+        // every item binds the same name
+        pbuilder.run(n, [&](ModuleWorker &worker, std::size_t i) {
+            Builder &builder = worker.builder();
+            leaked[i]        = worker.context().get_statement("k") != nullptr;
+
+            builder.make_value("k", f64(i));
+            PlaceholderReference *k = builder.get_ctx_ref("k");
+            leaked[i] |= k->depth != 0 || k->index != 0;
+
+            worker.emit(builder.make<FunctionDefinition>("def_" + std::to_string(i), k));
+        });
+
+        for(std::size_t i = 0; i < n; ++i)
+            EXPECT_EQ(leaked[i], 0) << workers << " workers, item " << i;
+
+        EXPECT_EQ(pbuilder.merge().size(), n);
+    }
+}
@@ -0,0 +1,157 @@
+#pragma once
+#include "AST/Builder.h"
+#include "AST/TreeOps/ColumnSource.h"
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <gtest/gtest.h>
+
+using namespace kiwi;
+
+// Column files written in a temporary directory, removed with it
+class ColumnFiles {
+  public:
+    ColumnFiles() {
+        auto now = std::chrono::steady_clock::now().time_since_epoch().count();
+        dir      = std::filesystem::temp_directory_path() / ("kiwi_columns_" + std::to_string(now));
+        std::filesystem::create_directories(dir);
+    }
+
+    ~ColumnFiles() {
+        std::error_code error;
+        std::filesystem::remove_all(dir, error);
+    }
+
+    String path(String const &name) const { return (dir / name).string(); }
+
+    template <typename T> String write(String const &name, Array<T> const &values) const {
+        std::ofstream out(path(name), std::ios::binary);
+        out.write(reinterpret_cast<char const *>(values.data()),
+                  std::streamsize(values.size() * sizeof(T)));
+        return path(name);
+    }
+
+  private:
+    std::filesystem::path dir;
+};
+
+TEST(ColumnSource, Stream) {
+    BuilderContext ctx;
+    Builder builder(&ctx);
+
+    builder.make_placeholder("*");
+    builder.make_placeholder("+");
+    builder.make_placeholder("price");
+    builder.make_placeholder("qty");
+
+    std::size_t n = 10000;
+    Array<f64> price(n);
+    Array<i32> qty(n);
+    for(std::size_t i = 0; i < n; ++i) {
+        price[i] = f64(i) * 0.5;
+        qty[i]   = i32(i % 7);
+    }
+    ColumnFiles files;
+
+    // 4 KiB of f64 per chunk
+    ColumnSource source(4096);
+    ASSERT_TRUE(source.add("price", files.write("price.f64", price), PrimitiveTag::f64));
+    ASSERT_TRUE(source.add("qty", files.write("qty.i32", qty), PrimitiveTag::i32));
+    EXPECT_EQ(source.rows(), n);
+    EXPECT_EQ(source.chunk_rows(), 512u);
+
+    // price * qty + 1
+    Expression *cost =
+        builder.make_binary_call("*", builder.get_ctx_ref("price"), builder.get_ctx_ref("qty"));
+    Expression *expr = builder.make_binary_call("+", cost, builder.make_value(1.0));
+
+    Array<f64> out(n);
+    std::size_t chunks = 0;
+    bool ok = source.stream(Context(), expr, [&](std::size_t first, Value *result) {
+        ASSERT_EQ(result->value_tag, ValueTag::varray);
+        ArrayValue *chunk = static_cast<ArrayValue *>(result);
+        EXPECT_EQ(chunk->tag(), PrimitiveTag::f64);
+        std::memcpy(out.data() + first, chunk->data(), chunk->nbytes());
+        chunks += 1;
+    });
+
+    EXPECT_TRUE(ok);
+    EXPECT_EQ(chunks, (n + 511) / 512);
+    for(std::size_t i = 0; i < n; ++i)
+        ASSERT_EQ(out[i], price[i] * qty[i] + 1) << i;
+}
+
+TEST(ColumnSource, Bind) {
+    BuilderContext ctx;
+    Builder builder(&ctx);
+
+    builder.make_placeholder("*");
+    builder.make_placeholder("sum");
+    builder.make_placeholder("x");
+
+    ColumnFiles files;
+    ColumnSource source;
+    String path = files.write("x.f64", Array<f64>{1, 2, 3, 4, 5});
+    ASSERT_TRUE(source.add("x", path, PrimitiveTag::f64));
+
+    // bound without a copy
+    Context env;
+    source.bind(env);
+    ArrayValue *column = static_cast<ArrayValue *>(env[Symbol("x")]);
+    EXPECT_FALSE(column->owns_data());
+    EXPECT_EQ(column->size(), 5u);
+
+    Expression *total = builder.make<FunctionCall>(builder.get_ctx_ref("sum"),
+                                                   Array<Expression *>{builder.get_ctx_ref("x")});
+    ArrayEval eval(env);
+    EXPECT_EQ(eval.run(total)->as<f64>(), 15.0);
+
+    // f64 columns feed BatchEval directly
+    Expression *square =
+        builder.make_binary_call("*", builder.get_ctx_ref("x"), builder.get_ctx_ref("x"));
+    Columns columns = source.columns();
+    EXPECT_EQ(columns[Symbol("x")], column->values<f64>());
+    EXPECT_EQ(batch_eval(Context(), columns, square, 5), (Array<double>{1, 4, 9, 16, 25}));
+}
+
+TEST(ColumnSource, Errors) {
+    ColumnFiles files;
+    String a = files.write("a.i32", Array<i32>{1, 2, 3});
+    String b = files.write("b.i32", Array<i32>{1, 2});
+
+    ColumnSource source;
+    EXPECT_FALSE(source.add("a", files.path("missing.i32"), PrimitiveTag::i32));
+    EXPECT_FALSE(source.add("a", a, PrimitiveTag::f64)); // 12 bytes
+    EXPECT_TRUE(source.add("a", a, PrimitiveTag::i32));
+    EXPECT_FALSE(source.add("b", b, PrimitiveTag::i32)); // 2 rows instead of 3
+    EXPECT_FALSE(source.add("a", a, PrimitiveTag::i32)); // a is already mapped
+    EXPECT_EQ(source.size(), 1u);
+}
+
+TEST(ColumnSource, Empty) {
+    BuilderContext ctx;
+    Builder builder(&ctx);
+    builder.make_placeholder("+");
+    builder.make_placeholder("x");
+    builder.make_placeholder("y");
+
+    ColumnFiles files;
+    ColumnSource source;
+    ASSERT_TRUE(source.add("x", files.write("x.f64", Array<f64>()), PrimitiveTag::f64));
+    ASSERT_TRUE(source.add("y", files.write("y.i32", Array<i32>()), PrimitiveTag::i32));
+    EXPECT_EQ(source.rows(), 0u);
+
+    Context env;
+    source.bind(env);
+    EXPECT_EQ(static_cast<ArrayValue *>(env[Symbol("x")])->size(), 0u);
+
+    // no chunk to evaluate
+    Expression *sum =
+        builder.make_binary_call("+", builder.get_ctx_ref("x"), builder.get_ctx_ref("y"));
+    std::size_t chunks = 0;
+    EXPECT_TRUE(source.stream(Context(), sum, [&](std::size_t, Value *) { chunks += 1; }));
+    EXPECT_EQ(chunks, 0u);
+
+    // the other columns must be empty too
+    EXPECT_FALSE(source.add("z", files.write("z.i32", Array<i32>{1}), PrimitiveTag::i32));
+}
@@ -0,0 +1,132 @@
+#pragma once
+#include "AST/TreeOps/EGraph.h"
+#include "AST/TreeOps/EvalExpression.h"
+#include <gtest/gtest.h>
+
+using namespace kiwi;
+
+struct EGraphFixture {
+    BuilderContext ctx;
+    Builder builder{&ctx};
+
+    EGraphFixture() {
+        for(char const *op : {"+", "-", "*", "/", "ln", "exp", "sqrt"})
+            builder.make_placeholder(op);
+        for(char const *name : {"a", "b", "c", "d"})
+            builder.make_placeholder(name);
+    }
+
+    Expression *ref(char const *name) { return builder.get_ctx_ref(name); }
+    Expression *bin(char const *op, Expression *a, Expression *b) {
+        return builder.make_binary_call(op, a, b);
+    }
+
+    // same value as the input for a few bindings
+    void check(Expression *expected, Expression *result) {
+        for(double seed : {0.5, 1.25, 3.0}) {
+            PrimitiveValue a(seed), b(seed * 2 + 1), c(seed - 4), d(7.5);
+            Context env;
+            env[Symbol("a")] = &a;
+            env[Symbol("b")] = &b;
+            env[Symbol("c")] = &c;
+            env[Symbol("d")] = &d;
+            EXPECT_NEAR(full_eval(env, result), full_eval(env, expected), 1e-9);
+        }
+    }
+};
+
+TEST(EGraph, Factoring) {
+    EGraphFixture f;
+
+    // a * b + a * c => a * (b + c)
+    Expression *expr = f.bin("+", f.bin("*", f.ref("a"), f.ref("b")),
+                             f.bin("*", f.ref("a"), f.ref("c")));
+
+    EGraph graph;
+    EClassId root = graph.add(expr);
+    EXPECT_EQ(graph.cost(root), 3);
+
+    SaturationReport report = graph.saturate();
+    EXPECT_EQ(report.reason, StopReason::saturated);
+    EXPECT_EQ(graph.cost(root), 2);
+
+    Expression *result = graph.extract(f.builder, root);
+    ASSERT_EQ(result->tag, NodeTag::binary_call);
+    EXPECT_EQ(static_cast<BinaryCall *>(result)->op, BinaryOp::mul);
+    f.check(expr, result);
+}
+
+TEST(EGraph, IdentitiesAndConstants) {
+    EGraphFixture f;
+
+    // ln(exp(a)) * (2 + 1 - 3) + (b - b) + c / 4 => c * 0.25
+    auto v = [&](double value) { return f.builder.make_value(value); };
+
+    Expression *ln = f.builder.make_unary_call("ln", f.builder.make_unary_call("exp", f.ref("a")));
+
+    Expression *zero = f.bin("-", f.bin("+", v(2), v(1)), v(3));
+    Expression *lhs  = f.bin("+", f.bin("*", ln, zero), f.bin("-", f.ref("b"), f.ref("b")));
+    Expression *expr = f.bin("+", lhs, f.bin("/", f.ref("c"), v(4)));
+
+    Expression *result = egraph_simplify(f.builder, expr);
+    ASSERT_EQ(result->tag, NodeTag::binary_call);
+    EXPECT_EQ(static_cast<BinaryCall *>(result)->op, BinaryOp::mul);
+    f.check(expr, result);
+}
+
+TEST(EGraph, PartialIdentities) {
+    EGraphFixture f;
+    auto v = [&](double value) { return f.builder.make_value(value); };
+
+    // sqrt(a) * sqrt(a) is NaN for a < 0, it is not a
+    Expression *sqrt = f.builder.make_unary_call("sqrt", f.ref("a"));
+    Expression *expr = f.bin("*", sqrt, sqrt);
+
+    Expression *result = egraph_simplify(f.builder, expr);
+    ASSERT_EQ(result->tag, NodeTag::binary_call);
+    EXPECT_EQ(static_cast<BinaryCall *>(result)->op, BinaryOp::mul);
+
+    // 1 / 2^-1074 is inf, the division is kept
+    expr   = f.bin("/", f.ref("a"), v(std::ldexp(1.0, -1074)));
+    result = egraph_simplify(f.builder, expr);
+    ASSERT_EQ(result->tag, NodeTag::binary_call);
+    EXPECT_EQ(static_cast<BinaryCall *>(result)->op, BinaryOp::div);
+
+    // 2^-1022 is exact
+    expr   = f.bin("/", f.ref("a"), v(std::ldexp(1.0, -1022)));
+    result = egraph_simplify(f.builder, expr);
+    ASSERT_EQ(result->tag, NodeTag::binary_call);
+    EXPECT_EQ(static_cast<BinaryCall *>(result)->op, BinaryOp::mul);
+}
+
+TEST(EGraph, CostModelsAndLimits) {
+    EGraphFixture f;
+
+    // ((a + b) + c) + d, balanced by the depth model
+    Expression *chain = f.bin("+", f.bin("+", f.bin("+", f.ref("a"), f.ref("b")), f.ref("c")),
+                              f.ref("d"));
+
+    EGraph graph;
+    EClassId root = graph.add(chain);
+    EXPECT_EQ(graph.cost(root, CostModel::depth), 3);
+    graph.saturate();
+    EXPECT_EQ(graph.cost(root, CostModel::depth), 2);
+    f.check(chain, graph.extract(f.builder, root, CostModel::depth));
+
+    // a long sum explodes under reassociation, the budget stops it
+    Expression *sum = f.ref("a");
+    for(int i = 0; i < 12; ++i) {
+        Expression *term = f.bin("*", f.ref(i % 2 ? "b" : "c"), f.builder.make_value(double(i)));
+        sum              = f.bin("+", sum, term);
+    }
+
+    SaturationLimits limits;
+    limits.max_nodes = 500;
+
+    EGraph bounded;
+    EClassId big            = bounded.add(sum);
+    SaturationReport report = bounded.saturate(limits);
+    EXPECT_NE(report.reason, StopReason::saturated);
+    EXPECT_LT(report.nodes, 1000u);
+    f.check(sum, bounded.extract(f.builder, big));
+}
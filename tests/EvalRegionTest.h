@@ -0,0 +1,98 @@
+#pragma once
+#include "AST/EvalRegion.h"
+#include "AST/TreeOps/EvalExpression.h"
+#include "VMTest.h"
+#include <gtest/gtest.h>
+
+using namespace kiwi;
+
+TEST(EvalRegion, ReleasedPerScope) {
+    EvalRegion region(4096);
+
+    u64 reserved = 0;
+    for(int request = 0; request < 100; ++request) {
+        EvalRegion::Scope scope(region);
+        EXPECT_EQ(EvalRegion::current(), &region);
+
+        for(int i = 0; i < 500; ++i)
+            region.make<PrimitiveValue>(double(i));
+
+        // the memory of the first request is reused
+        if(request == 0)
+            reserved = region.stats().reserved;
+        EXPECT_EQ(region.stats().reserved, reserved);
+    }
+
+    EXPECT_EQ(EvalRegion::current(), nullptr);
+    EXPECT_EQ(region.stats().bytes, 0u);
+}
+
+TEST(EvalRegion, NestedScopes) {
+    EvalRegion region;
+    EvalRegion::Scope outer(region);
+
+    PrimitiveValue *a = region.make<PrimitiveValue>(1.0);
+    u64 bytes         = region.stats().bytes;
+    {
+        EvalRegion::Scope inner(region);
+        region.make<PrimitiveValue>(2.0);
+        EXPECT_GT(region.stats().bytes, bytes);
+    }
+
+    EXPECT_EQ(region.stats().bytes, bytes);
+    EXPECT_EQ(a->as<f64>(), 1.0);
+}
+
+TEST(EvalRegion, Promote) {
+    BuilderContext module;
+    EvalRegion region;
+
+    // Point = struct(x: i32, tag: Struct, y: f64)
+    Struct *def = module.arena().make<Struct>();
+    def->add_attribute("x", get_primitive_type<i32>());
+    def->add_attribute("tag", module.arena().make<Struct>());
+    def->add_attribute("y", get_primitive_type<f64>());
+
+    Value *result = nullptr;
+    {
+        EvalRegion::Scope scope(region);
+
+        StructValue *p = region.make<StructValue>()->set_type(def);
+        p->set(0, 3)->set(2, 2.5)->set_value(1, region.make<PrimitiveValue>(u8(7)));
+
+        result = region.promote(p, module.arena());
+        EXPECT_FALSE(region.owns(result));
+        EXPECT_TRUE(module.arena().owns(result));
+    }
+
+    StructValue *p = static_cast<StructValue *>(result);
+    EXPECT_EQ(p->get<i32>(0), 3);
+    EXPECT_EQ(p->get<f64>(2), 2.5);
+
+    Value *tag = p->get_boxed(1);
+    EXPECT_TRUE(module.arena().owns(tag));
+    EXPECT_EQ(static_cast<PrimitiveValue *>(tag)->tag(), PrimitiveTag::u8);
+    EXPECT_EQ(tag->as<i64>(), 7);
+}
+
+TEST(EvalRegion, FunctionArguments) {
+    BuilderContext ctx;
+    Builder builder(&ctx);
+
+    Context env;
+    env[Symbol("fib")] = make_fib(builder);
+    Expression *call   = builder.make<FunctionCall>(builder.get_ctx_ref("fib"),
+                                                  Array<Expression *>{builder.make_value(15.0)});
+
+    EvalRegion region;
+    double expected = full_eval(env, call);
+    {
+        EvalRegion::Scope scope(region);
+        EXPECT_EQ(full_eval(env, call), expected);
+        EXPECT_GT(region.stats().allocations, 0u);
+    }
+
+    // arguments live as long as their call
+    EXPECT_EQ(region.stats().blocks, 1u);
+    EXPECT_EQ(region.stats().bytes, 0u);
+}
@@ -0,0 +1,85 @@
+#pragma once
+#include "AST/FlatAST.h"
+#include "AST/TreeOps.h"
+#include "AST/TreeOps/EvalExpression.h"
+#include <gtest/gtest.h>
+
+using namespace kiwi;
+
+inline String print_expr(Expression *expr) {
+    std::stringstream ss;
+    PrintExpression().visit_expression(expr, ss, 0);
+    return ss.str();
+}
+
+TEST(FlatAST, RoundTrip) {
+    BuilderContext ctx;
+    Builder builder(&ctx);
+
+    builder.make_placeholder("+");
+    builder.make_placeholder("ln");
+    Expression *x    = builder.make_placeholder("x");
+    Expression *sum  = builder.make_binary_call("+", x, builder.make_value(2.0));
+    Expression *expr = builder.make_unary_call("ln", builder.make_binary_call("+", sum, sum));
+
+    FlatTree tree = flatten(expr);
+
+    // the shared (+ x 2.0) subtree is stored once:
+    // x, 2.0, 3 calls and their 3 operator references
+    EXPECT_EQ(tree.size(), 8u);
+    EXPECT_EQ(tree.tag(tree.root), NodeTag::unary_call);
+
+    // post-order: children come before their parent
+    for(NodeIndex i = 0; i < tree.size(); ++i) {
+        for(u32 k = 0; k < tree.args_size(i); ++k) {
+            NodeIndex c = tree.child(i, k);
+            EXPECT_TRUE(c == null_node || c < i);
+        }
+    }
+
+    Expression *copy = unflatten(tree, builder);
+    EXPECT_NE(copy, expr);
+    EXPECT_EQ(print_expr(copy), print_expr(expr));
+}
+
+TEST(FlatAST, LinearEval) {
+    BuilderContext ctx;
+    Builder builder(&ctx);
+
+    for(char const *op : {"+", "*", "-", "sqrt"})
+        builder.make_placeholder(op);
+    builder.make_placeholder("x");
+
+    auto x = [&]() { return builder.get_ctx_ref("x"); };
+    auto v = [&](double value) { return builder.make_value(value); };
+
+    // sqrt(s * s) - (x match | 1 => s | 2 => -x | _ => 0) with s = x * x + 1
+    Expression *s = builder.make_binary_call("+", builder.make_binary_call("*", x(), x()), v(1));
+
+    Match *match  = builder.make<Match>();
+    match->target = x();
+    match->branches.emplace_back(v(1), s);
+    match->branches.emplace_back(v(2), builder.make_unary_call("-", x()));
+    match->default_branch = v(0);
+
+    Block *block = builder.make_block();
+    block->statements.push_back(v(3));
+    block->statements.push_back(builder.make_binary_call(
+        "-", builder.make_unary_call("sqrt", builder.make_binary_call("*", s, s)), match));
+
+    FlatTree tree = flatten(block);
+
+    Context env;
+    FlatEval eval(env);
+    for(double value : {0.5, 1.0, 2.0, 3.0}) {
+        env[Symbol("x")] = builder.make_value(value);
+        EXPECT_DOUBLE_EQ(eval.run(tree), full_eval(env, block)) << value;
+        EXPECT_TRUE(eval.ok());
+    }
+
+    // functions are not evaluated
+    Expression *call = builder.make<FunctionCall>(builder.get_ctx_ref("+"), Array<Expression *>{});
+    FlatTree calls   = flatten(call);
+    eval.run(calls);
+    EXPECT_FALSE(eval.ok());
+}
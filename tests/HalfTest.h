@@ -0,0 +1,121 @@
+#pragma once
+#include "AST/Builder.h"
+#include "AST/Half.h"
+#include "AST/TreeOps/TypedEval.h"
+#include <cmath>
+#include <gtest/gtest.h>
+
+using namespace kiwi;
+
+TEST(Half, Rounding) {
+    EXPECT_EQ(f16(1.0f).bits, 0x3c00);
+    EXPECT_EQ(f16(-2.0f).bits, 0xc000);
+    EXPECT_EQ(f16(65504.0f).bits, 0x7bff);
+    EXPECT_EQ(f16(65520.0f).bits, 0x7c00); // rounds to inf
+    EXPECT_EQ(f16(std::ldexp(1.f, -24)).bits, 0x0001);
+    EXPECT_EQ(f16(std::ldexp(1.f, -25)).bits, 0x0000); // tie to even
+
+    // 1 + 2^-11 is halfway between 1 and the next f16, ties to even
+    EXPECT_EQ(f16(1.f + std::ldexp(1.f, -11)).bits, 0x3c00);
+    EXPECT_EQ(f16(1.f + 3 * std::ldexp(1.f, -11)).bits, 0x3c02);
+
+    EXPECT_TRUE(std::isnan(f32(f16(NAN))));
+    EXPECT_TRUE(std::isinf(f32(f16(INFINITY))));
+
+    EXPECT_EQ(bf16(1.0f).bits, 0x3f80);
+    EXPECT_EQ(f32(bf16(3.140625f)), 3.140625f);
+    EXPECT_EQ(bf16(1.f + std::ldexp(1.f, -8)).bits, 0x3f80);
+    EXPECT_TRUE(std::isnan(f32(bf16(NAN))));
+
+    // every finite f16 survives the round trip
+    for(u32 h = 0; h < 0x10000; ++h) {
+        if((h & 0x7c00) == 0x7c00)
+            continue;
+        ASSERT_EQ(f16(f32(f16::from_bits(u16(h)))).bits, h);
+    }
+}
+
+TEST(Half, Primitive) {
+    PrimitiveValue a(f16(1.5f)), b(bf16(2.0f));
+
+    EXPECT_EQ(a.tag(), PrimitiveTag::f16);
+    EXPECT_EQ(b.tag(), PrimitiveTag::bf16);
+    EXPECT_EQ(a.as<f64>(), 1.5);
+    EXPECT_EQ(get_primitive_size(PrimitiveTag::f16), 2u);
+    EXPECT_EQ(get_primitive_tag(Symbol("bf16")), PrimitiveTag::bf16);
+    EXPECT_TRUE(is_floating_primitive(PrimitiveTag::bf16));
+
+    EXPECT_EQ(promote_primitive(PrimitiveTag::f16, PrimitiveTag::i64), PrimitiveTag::f16);
+    EXPECT_EQ(promote_primitive(PrimitiveTag::f16, PrimitiveTag::f32), PrimitiveTag::f32);
+    EXPECT_EQ(promote_primitive(PrimitiveTag::f16, PrimitiveTag::bf16), PrimitiveTag::f32);
+
+    // the kernels compute in f32 and round once
+    f16 lhs(2048.0f), rhs(1.0f), out;
+    binary_kernel(BinaryOp::add, PrimitiveTag::f16)(&out, &lhs, &rhs);
+    EXPECT_EQ(f32(out), 2048.0f);
+
+    f16 sq;
+    unary_kernel(UnaryOp::sqrt, PrimitiveTag::f16)(&sq, &lhs);
+    EXPECT_EQ(sq.bits, f16(std::sqrt(2048.0f)).bits);
+}
+
+TEST(Half, TypedEval) {
+    BuilderContext ctx;
+    Builder builder(&ctx);
+
+    builder.make_placeholder("*");
+    builder.make_placeholder("a");
+    builder.make_placeholder("b");
+
+    PrimitiveValue a(f16(0.1f)), b(bf16(3.0f));
+    Context env;
+    env[Symbol("a")] = &a;
+
+    // the literal takes the type of a
+    Expression *expr =
+        builder.make_binary_call("*", builder.get_ctx_ref("a"), builder.make_value(3.0));
+    TypedValue r = typed_eval(env, expr);
+    EXPECT_EQ(r.tag, PrimitiveTag::f16);
+    EXPECT_EQ(r.as<f16>().bits, f16(f32(f16(0.1f)) * 3.0f).bits);
+
+    env[Symbol("b")] = &b;
+    expr = builder.make_binary_call("*", builder.get_ctx_ref("a"), builder.get_ctx_ref("b"));
+    r    = typed_eval(env, expr);
+    EXPECT_EQ(r.tag, PrimitiveTag::f32);
+    EXPECT_EQ(r.as<f32>(), f32(f16(0.1f)) * 3.0f);
+}
+
+TEST(Half, BulkConversion) {
+    // not a multiple of the vector width, the tail is converted too
+    std::size_t n = 67;
+    Array<f32> values(n), back(n);
+    Array<f16> half(n);
+    Array<bf16> brain(n);
+
+    for(std::size_t i = 0; i < n; ++i)
+        values[i] = (f32(i) - 30.f) * 0.37f + std::ldexp(1.f, -20) * f32(i);
+    values[5] = NAN;
+    values[6] = 1e6f;
+
+    f32_to_f16(half.data(), values.data(), n);
+    f32_to_bf16(brain.data(), values.data(), n);
+
+    for(std::size_t i = 0; i < n; ++i) {
+        EXPECT_EQ(half[i].bits, f16(values[i]).bits) << i << " " << half_conversion_isa();
+        EXPECT_EQ(brain[i].bits, bf16(values[i]).bits) << i << " " << half_conversion_isa();
+    }
+
+    f16_to_f32(back.data(), half.data(), n);
+    for(std::size_t i = 0; i < n; ++i) {
+        if(i != 5) {
+            EXPECT_EQ(back[i], f32(half[i])) << i;
+        }
+    }
+
+    bf16_to_f32(back.data(), brain.data(), n);
+    for(std::size_t i = 0; i < n; ++i) {
+        if(i != 5) {
+            EXPECT_EQ(back[i], f32(brain[i])) << i;
+        }
+    }
+}
@@ -0,0 +1,139 @@
+#pragma once
+#include "AST/TreeOps/EvalExpression.h"
+#include "AST/TreeOps/IncrementalEval.h"
+#include <gtest/gtest.h>
+
+using namespace kiwi;
+
+TEST(IncrementalEval, RecomputesDirtyPath) {
+    BuilderContext ctx;
+    Builder builder(&ctx);
+
+    builder.make_placeholder("+");
+    builder.make_placeholder("*");
+    builder.make_placeholder("a");
+    builder.make_placeholder("b");
+    builder.make_placeholder("c");
+
+    auto ref = [&](char const *name) { return builder.get_ctx_ref(name); };
+
+    // (a * b) + (c * 2)
+    Expression *expr = builder.make_binary_call(
+        "+", builder.make_binary_call("*", ref("a"), ref("b")),
+        builder.make_binary_call("*", ref("c"), builder.make_value(2.0)));
+
+    Context env;
+    env[Symbol("a")] = builder.make_value(2.0);
+    env[Symbol("b")] = builder.make_value(3.0);
+    env[Symbol("c")] = builder.make_value(4.0);
+
+    IncrementalEval eval(env);
+    EXPECT_DOUBLE_EQ(eval.eval(expr), 14);
+    std::size_t first = eval.recompute_count();
+
+    // nothing changed
+    eval.reset_stats();
+    EXPECT_DOUBLE_EQ(eval.eval(expr), 14);
+    EXPECT_EQ(eval.recompute_count(), 0);
+
+    // root, c * 2 and c
+    eval.reset_stats();
+    eval.set(Symbol("c"), builder.make_value(10.0));
+    EXPECT_DOUBLE_EQ(eval.eval(expr), 26);
+    EXPECT_EQ(eval.recompute_count(), 3);
+    EXPECT_LT(eval.recompute_count(), first);
+    EXPECT_DOUBLE_EQ(eval.eval(expr), full_eval(eval.context(), expr));
+
+    // value modified in place
+    PrimitiveValue a(5.0);
+    eval.set(Symbol("a"), &a);
+    EXPECT_DOUBLE_EQ(eval.eval(expr), 35);
+
+    eval.reset_stats();
+    a.set_value(1.0);
+    eval.invalidate(Symbol("a"));
+    EXPECT_DOUBLE_EQ(eval.eval(expr), 23);
+    EXPECT_EQ(eval.recompute_count(), 3);
+}
+
+TEST(IncrementalEval, FunctionDependencies) {
+    BuilderContext ctx;
+    Builder builder(&ctx);
+
+    builder.make_placeholder("+");
+    builder.make_placeholder("*");
+    builder.make_placeholder("x");
+    builder.make_placeholder("k");
+
+    // def scale(v) = v * k; scale(x) + x
+    FunctionBuilder fb = builder.make_function("scale");
+    fb.add_arg("v", get_primitive_type<f64>());
+    fb.add_body(builder.make_binary_call("*", builder.get_ctx_ref("v"), builder.get_ctx_ref("k")));
+    Function *scale = fb.build();
+
+    Expression *call =
+        builder.make<FunctionCall>(builder.get_ctx_ref("scale"),
+                                   Array<Expression *>{builder.get_ctx_ref("x")});
+    Expression *expr = builder.make_binary_call("+", call, builder.get_ctx_ref("x"));
+
+    Context env;
+    env[Symbol("scale")] = scale;
+    env[Symbol("x")]     = builder.make_value(3.0);
+    env[Symbol("k")]     = builder.make_value(2.0);
+
+    IncrementalEval eval(env);
+    EXPECT_DOUBLE_EQ(eval.eval(expr), 9);
+
+    // k is only read by the body of scale
+    eval.set(Symbol("k"), builder.make_value(10.0));
+    EXPECT_DOUBLE_EQ(eval.eval(expr), 33);
+    EXPECT_DOUBLE_EQ(eval.eval(expr), full_eval(eval.context(), expr));
+}
+
+TEST(IncrementalEval, TransitiveDependencies) {
+    BuilderContext ctx;
+    Builder builder(&ctx);
+
+    builder.make_placeholder("*");
+    builder.make_placeholder("+");
+    builder.make_placeholder("m");
+    builder.make_placeholder("k");
+
+    // def scale(v) = v * k; k = m * 1
+    FunctionBuilder fb = builder.make_function("scale");
+    fb.add_arg("v", get_primitive_type<f64>());
+    fb.add_body(builder.make_binary_call("*", builder.get_ctx_ref("v"), builder.get_ctx_ref("k")));
+    Function *scale = fb.build();
+
+    // def shift(v) = v + k
+    FunctionBuilder gb = builder.make_function("shift");
+    gb.add_arg("v", get_primitive_type<f64>());
+    gb.add_body(builder.make_binary_call("+", builder.get_ctx_ref("v"), builder.get_ctx_ref("k")));
+    Function *shift = gb.build();
+
+    Expression *call = builder.make<FunctionCall>(builder.get_ctx_ref("scale"),
+                                                  Array<Expression *>{builder.make_value(3.0)});
+
+    Context env;
+    env[Symbol("scale")] = scale;
+    env[Symbol("k")]     = builder.make_binary_call("*", builder.get_ctx_ref("m"),
+                                                    builder.make_value(1.0));
+    env[Symbol("m")]     = builder.make_value(2.0);
+
+    IncrementalEval eval(env);
+    EXPECT_DOUBLE_EQ(eval.eval(call), 6);
+
+    // m is read through the binding of k, inside the body of scale
+    eval.set(Symbol("m"), builder.make_value(10.0));
+    EXPECT_DOUBLE_EQ(eval.eval(call), 30);
+    EXPECT_DOUBLE_EQ(eval.eval(call), full_eval(eval.context(), call));
+
+    // rebinding k drops its previous result
+    eval.set(Symbol("k"), builder.make_value(4.0));
+    EXPECT_DOUBLE_EQ(eval.eval(call), 12);
+
+    // the callee is rebound
+    eval.set(Symbol("scale"), shift);
+    EXPECT_DOUBLE_EQ(eval.eval(call), 7);
+    EXPECT_DOUBLE_EQ(eval.eval(call), full_eval(eval.context(), call));
+}
@@ -0,0 +1,108 @@
+#pragma once
+#ifdef KIWI_USE_LLVM_IR
+#include "JIT/NativeJIT.h"
+#include <gtest/gtest.h>
+
+using namespace kiwi;
+
+TEST(NativeJIT, Signatures) {
+    BuilderContext ctx;
+    Builder builder(&ctx);
+
+    builder.make_placeholder("+");
+    builder.make_placeholder("-");
+    builder.make_placeholder("*");
+    builder.make_placeholder("/");
+
+    // def fib(n) = n match | 0 => 0 | 1 => 1 | _ => fib(n - 1) + fib(n - 2)
+    FunctionBuilder fb = builder.make_function("fib");
+    fb.add_arg("n", nullptr);
+
+    auto fib_sub = [&](double offset) {
+        Expression *arg =
+            builder.make_binary_call("-", builder.get_ctx_ref("n"), builder.make_value(offset));
+        return builder.make<FunctionCall>(builder.get_ctx_ref("fib"), Array<Expression *>{arg});
+    };
+
+    Match *match  = builder.make<Match>();
+    match->target = builder.get_ctx_ref("n");
+    match->branches.emplace_back(builder.make_value(0.0), builder.make_value(0.0));
+    match->branches.emplace_back(builder.make_value(1.0), builder.make_value(1.0));
+    match->default_branch = builder.make_binary_call("+", fib_sub(1), fib_sub(2));
+    fb.add_body(match);
+    Function *fib = fb.build();
+
+    // def half(x: i32) = x / 2
+    FunctionBuilder hb = builder.make_function("half");
+    hb.add_arg("x", get_primitive_type<i32>());
+    hb.add_body(builder.make_binary_call("/", builder.get_ctx_ref("x"), builder.make_value(2)));
+    Function *half = hb.build();
+
+    Context env;
+    env[Symbol("fib")] = fib;
+
+    NativeJIT jit(env);
+    ASSERT_TRUE(jit.is_valid());
+
+    auto fib_f64 = jit.compile_as<f64, f64>(fib);
+    ASSERT_NE(fib_f64, nullptr);
+    EXPECT_EQ(fib_f64(20), 6765);
+
+    // same function, another signature
+    auto fib_i64 = jit.compile_as<i64, i64>(fib);
+    ASSERT_NE(fib_i64, nullptr);
+    EXPECT_EQ(fib_i64(20), 6765);
+
+    EXPECT_EQ((jit.compile_as<f64, f64>(fib)), fib_f64);
+    EXPECT_EQ(jit.size(), 2u);
+
+    // declared types are used when the signature is not given
+    auto half_i32 = reinterpret_cast<f64 (*)(i32)>(jit.compile(half));
+    ASSERT_NE(half_i32, nullptr);
+    EXPECT_EQ(half_i32(7), 3);
+
+    // def flip(x) = x / -1, min / -1 wraps instead of trapping
+    FunctionBuilder mb = builder.make_function("flip");
+    mb.add_arg("x", nullptr);
+    mb.add_body(builder.make_binary_call("/", builder.get_ctx_ref("x"), builder.make_value(-1)));
+    auto flip = jit.compile_as<i64, i64>(mb.build());
+    ASSERT_NE(flip, nullptr);
+    EXPECT_EQ(flip(5), -5);
+    EXPECT_EQ(flip(std::numeric_limits<i64>::min()), std::numeric_limits<i64>::min());
+}
+
+TEST(NativeJIT, HalfSignatures) {
+    BuilderContext ctx;
+    Builder builder(&ctx);
+
+    builder.make_placeholder("+");
+    builder.make_placeholder("*");
+
+    // def twice(x) = x + x * 1
+    FunctionBuilder fb = builder.make_function("twice");
+    fb.add_arg("x", nullptr);
+    fb.add_body(builder.make_binary_call(
+        "+", builder.get_ctx_ref("x"),
+        builder.make_binary_call("*", builder.get_ctx_ref("x"), builder.make_value(1.0f))));
+    Function *twice = fb.build();
+
+    Context env;
+    NativeJIT jit(env);
+    ASSERT_TRUE(jit.is_valid());
+
+    // 16 bit floats are passed as their bits
+    auto twice_f16 = jit.compile_as<f16, f16>(twice);
+    ASSERT_NE(twice_f16, nullptr);
+    EXPECT_EQ(f32(twice_f16(f16(1.5f))), 3.0f);
+    EXPECT_EQ(twice_f16(f16(0.1f)).bits, f16(f32(f16(0.1f)) * 2).bits);
+
+    auto twice_bf16 = jit.compile_as<bf16, bf16>(twice);
+    ASSERT_NE(twice_bf16, nullptr);
+    EXPECT_EQ(f32(twice_bf16(bf16(1.5f))), 3.0f);
+    EXPECT_EQ(twice_bf16(bf16(0.1f)).bits, bf16(f32(bf16(0.1f)) * 2).bits);
+
+    auto widened = jit.compile_as<f32, bf16>(twice);
+    ASSERT_NE(widened, nullptr);
+    EXPECT_EQ(widened(bf16(-2.5f)), -5.0f);
+}
+#endif
@@ -0,0 +1,217 @@
+#pragma once
+#include "AST/TreeOps/EvalExpression.h"
+#include "AST/TreeOps/MatchCompiler.h"
+#include "VM/Compiler.h"
+#include "VM/VirtualMachine.h"
+#include <gtest/gtest.h>
+
+using namespace kiwi;
+
+// x match | p0 => p0 * 2 | p1 => p1 * 2 ... | _ => -1
+inline Match *make_switch(Builder &builder, Array<double> const &patterns) {
+    Match *match  = builder.make<Match>();
+    match->target = builder.get_ctx_ref("x");
+    for(double p : patterns)
+        match->branches.emplace_back(builder.make_value(p), builder.make_value(p * 2));
+    match->default_branch = builder.make_value(-1.0);
+    return match;
+}
+
+TEST(MatchCompiler, JumpTable) {
+    BuilderContext ctx;
+    Builder builder(&ctx);
+    builder.make_placeholder("x");
+
+    Array<double> patterns;
+    for(int i = 0; i < 300; ++i)
+        patterns.push_back(i + 10);
+    patterns.push_back(12); // shadowed by the first 12
+
+    Match *match = make_switch(builder, patterns);
+    MatchCompiler().compile(match);
+
+    ASSERT_NE(match->plan, nullptr);
+    EXPECT_EQ(match->plan->strategy, MatchStrategy::jump_table);
+    EXPECT_EQ(match->plan->info.unreachable, Array<u32>{300});
+    EXPECT_TRUE(match->plan->info.exhaustive);
+
+    PrimitiveValue x(0.0);
+    Context env;
+    env[Symbol("x")] = &x;
+
+    for(double v : {9.0, 10.0, 12.0, 150.0, 309.0, 310.0, 12.5, -3.0}) {
+        x.set_value(v);
+        EXPECT_EQ(full_eval(env, match), v >= 10 && v < 310 && v == int(v) ? v * 2 : -1);
+    }
+}
+
+TEST(MatchCompiler, BinarySearch) {
+    BuilderContext ctx;
+    Builder builder(&ctx);
+    builder.make_placeholder("x");
+
+    Match *match = make_switch(builder, {1e6, 2.5, -7, 1000, 1, 2.5});
+    MatchCompiler().compile(match);
+
+    EXPECT_EQ(match->plan->strategy, MatchStrategy::binary_search);
+    EXPECT_EQ(match->plan->info.unreachable, Array<u32>{5});
+
+    PrimitiveValue x(0.0);
+    Context env;
+    env[Symbol("x")] = &x;
+
+    for(double v : {1e6, 2.5, -7.0, 1000.0, 1.0, 3.0, 0.0}) {
+        x.set_value(v);
+        bool found = v == 1e6 || v == 2.5 || v == -7 || v == 1000 || v == 1;
+        EXPECT_EQ(full_eval(env, match), found ? v * 2 : -1);
+    }
+}
+
+TEST(MatchCompiler, UnionTag) {
+    BuilderContext ctx;
+    Builder builder(&ctx);
+    builder.make_placeholder("foi");
+
+    // FloatOrInt = union(f: f64, i: i64, u: u8)
+    Union *def = builder.make<Union>();
+    def->add_attribute("f", get_primitive_type<f64>());
+    def->add_attribute("i", get_primitive_type<i64>());
+    def->add_attribute("u", get_primitive_type<u8>());
+    def->seal();
+
+    auto variant = [&](int32 index) {
+        UnionValue *v = builder.make<UnionValue>()->set_type(def);
+        if(index >= 0)
+            v->set(index, 0.0);
+        return v;
+    };
+
+    // foi match | FloatOrInt(f = _) => 1 | FloatOrInt(i = _) => 2 | None => 3
+    Match *match  = builder.make<Match>();
+    match->target = builder.get_ctx_ref("foi");
+    match->branches.emplace_back(variant(0), builder.make_value(1.0));
+    match->branches.emplace_back(variant(1), builder.make_value(2.0));
+    match->branches.emplace_back(variant(-1), builder.make_value(3.0));
+
+    MatchCompiler().compile(match);
+    MatchInfo const &info = match->plan->info;
+    EXPECT_EQ(match->plan->strategy, MatchStrategy::union_tag);
+    EXPECT_FALSE(info.exhaustive);
+    EXPECT_FALSE(info.missing_none);
+    ASSERT_EQ(info.missing.size(), 1u);
+    EXPECT_EQ(info.missing[0], Symbol("u"));
+
+    Context env;
+    for(int32 index : {0, 1, -1, 2}) {
+        UnionValue *foi    = variant(index);
+        env[Symbol("foi")] = foi;
+        EXPECT_EQ(full_eval(env, match), index == 2 ? 0 : index == -1 ? 3 : index + 1);
+    }
+}
+
+TEST(MatchCompiler, UnionTagFallback) {
+    BuilderContext ctx;
+    Builder builder(&ctx);
+    builder.make_placeholder("u");
+
+    // FloatOrInt = union(f: f64, i: i64)
+    Union *def = builder.make<Union>();
+    def->add_attribute("f", get_primitive_type<f64>());
+    def->add_attribute("i", get_primitive_type<i64>());
+    def->seal();
+
+    auto variant = [&](int32 index) {
+        UnionValue *v = builder.make<UnionValue>()->set_type(def);
+        v->set(index, 0.0);
+        return v;
+    };
+
+    // target match | FloatOrInt(f = _) => 1 | FloatOrInt(i = _) => 2 | _ => 7
+    auto make_match = [&](Expression *target) {
+        Match *match  = builder.make<Match>();
+        match->target = target;
+        match->branches.emplace_back(variant(0), builder.make_value(1.0));
+        match->branches.emplace_back(variant(1), builder.make_value(2.0));
+        match->default_branch = builder.make_value(7.0);
+        MatchCompiler().compile(match);
+        EXPECT_EQ(match->plan->strategy, MatchStrategy::union_tag);
+        return match;
+    };
+
+    // def f(x) = x match ..., a primitive argument is never a union, whatever its value
+    FunctionBuilder fb = builder.make_function("f");
+    fb.add_arg("x", get_primitive_type<f64>());
+    fb.add_body(make_match(builder.get_ctx_ref("x")));
+    Function *f = fb.build();
+
+    // def g() = u match ..., with u bound to a union constant
+    FunctionBuilder gb = builder.make_function("g");
+    gb.add_body(make_match(builder.get_ctx_ref("u")));
+    Function *g = gb.build();
+
+    Context env;
+    env[Symbol("f")] = f;
+    env[Symbol("u")] = variant(1);
+
+    Expression *call = builder.make<FunctionCall>(builder.get_ctx_ref("f"),
+                                                  Array<Expression *>{builder.make_value(0.0)});
+    EXPECT_EQ(full_eval(env, call), 7);
+
+    VirtualMachine vm;
+    Program pf = BytecodeCompiler(env).compile(f, "f");
+    EXPECT_EQ(vm.run(pf, {0.0}), 7);
+    EXPECT_EQ(vm.run(pf, {1.0}), 7);
+
+    Program pg = BytecodeCompiler(env).compile(g, "g");
+    EXPECT_EQ(vm.run(pg), 2);
+}
+
+TEST(MatchCompiler, Bytecode) {
+    BuilderContext ctx;
+    Builder builder(&ctx);
+    builder.make_placeholder("x");
+
+    Match *match = make_switch(builder, {3, 4, 5, 6, 8});
+
+    FunctionBuilder fb = builder.make_function("f");
+    fb.add_arg("x", get_primitive_type<f64>());
+    fb.add_body(match);
+    Function *f = fb.build();
+
+    Context env;
+    Program program = BytecodeCompiler(env).compile(f, "f");
+
+    std::stringstream ss;
+    disassemble(ss, program);
+    EXPECT_NE(ss.str().find("jump_table"), String::npos);
+    EXPECT_EQ(ss.str().find("jump_ne"), String::npos);
+
+    VirtualMachine vm;
+    for(double v : {2.0, 3.0, 5.0, 7.0, 8.0, 8.5})
+        EXPECT_EQ(vm.run(program, {v}), v >= 3 && v <= 8 && v != 7 && v == int(v) ? v * 2 : -1);
+}
+
+TEST(MatchCompiler, BytecodeTooBig) {
+    BuilderContext ctx;
+    Builder builder(&ctx);
+    builder.make_placeholder("+");
+    builder.make_placeholder("x");
+
+    // the branches after the first one start past the 16 bit jump targets
+    Block *block     = builder.make_block();
+    Expression *body = builder.make_binary_call("+", builder.get_ctx_ref("x"),
+                                                builder.get_ctx_ref("x"));
+    block->statements.assign(70000, body);
+
+    Match *match = make_switch(builder, {3, 4, 5, 6, 8});
+    std::get<1>(match->branches[0]) = block;
+    MatchCompiler().compile(match);
+    ASSERT_TRUE(match->plan->is_lookup());
+
+    FunctionBuilder fb = builder.make_function("f");
+    fb.add_arg("x", get_primitive_type<f64>());
+    fb.add_body(match);
+
+    Context env;
+    EXPECT_TRUE(BytecodeCompiler(env).compile(fb.build(), "f").empty());
+}
@@ -0,0 +1,103 @@
+#pragma once
+#include "AST/TreeOps/EvalExpression.h"
+#include "AST/TreeOps/ParallelEval.h"
+#include "VMTest.h"
+#include <gtest/gtest.h>
+
+using namespace kiwi;
+
+struct ParallelEvalFixture {
+    BuilderContext ctx;
+    Builder builder{&ctx};
+    Context env;
+
+    ParallelEvalFixture() { env[Symbol("fib")] = make_fib(builder); }
+
+    Expression *fib(double n) {
+        return builder.make<FunctionCall>(builder.get_ctx_ref("fib"),
+                                          Array<Expression *>{builder.make_value(n)});
+    }
+
+    // fib(12) + fib(13)
+    Expression *sum() { return builder.make_binary_call("+", fib(12), fib(13)); }
+};
+
+TEST(ParallelEval, MatchesFullEval) {
+    ParallelEvalFixture f;
+    WorkStealingPool pool(4);
+
+    Expression *expr = f.sum();
+    EXPECT_EQ(parallel_eval(f.env, pool, expr, 1000), full_eval(f.env, expr));
+    EXPECT_EQ(parallel_eval(f.env, pool, expr, 1000), 377);
+    EXPECT_GT(pool.stats().spawned, 0u);
+}
+
+TEST(ParallelEval, CheapTreesStaySerial) {
+    ParallelEvalFixture f;
+    WorkStealingPool pool(4);
+
+    Expression *expr = f.sum();
+    EXPECT_EQ(parallel_eval(f.env, pool, expr, 1e12), 377);
+    EXPECT_EQ(pool.stats().spawned, 0u);
+}
+
+TEST(ParallelEval, BoundedForks) {
+    ParallelEvalFixture f;
+    WorkStealingPool pool(4);
+
+    // every recursive call looks heavy, the fork depth bounds the tasks
+    Expression *expr = f.fib(20);
+    EXPECT_EQ(parallel_eval(f.env, pool, expr, 1000), 6765);
+    EXPECT_GT(pool.stats().spawned, 0u);
+    EXPECT_LT(pool.stats().spawned, 64u);
+}
+
+TEST(WorkStealingPool, Exceptions) {
+    WorkStealingPool pool(2);
+    std::atomic<int> done{0};
+
+    WorkStealingPool::Group group;
+    for(int i = 0; i < 8; ++i) {
+        pool.spawn(group, [&done, i]() {
+            if(i % 3 == 0)
+                throw i;
+            done += 1;
+        });
+    }
+
+    bool thrown = false;
+    try {
+        pool.wait(group);
+    } catch(int) {
+        thrown = true;
+    }
+    EXPECT_TRUE(thrown);
+    EXPECT_EQ(done, 5);
+
+    // the workers survived
+    WorkStealingPool::Group next;
+    for(int i = 0; i < 8; ++i)
+        pool.spawn(next, [&done]() { done += 1; });
+    pool.wait(next);
+    EXPECT_EQ(done, 13);
+}
+
+TEST(ParallelEval, Profile) {
+    ParallelEvalFixture f;
+    WorkStealingPool pool(2);
+    EvalCost cost(f.env);
+
+    EXPECT_LT(cost.profile("fib"), 0);
+
+    ParallelEval eval(f.env, pool, cost, 1e12);
+    eval.profiling = true;
+
+    Expression *expr = f.fib(10);
+    cost.estimate(expr);
+    EXPECT_EQ(eval.visit_expression(expr), 55);
+    EXPECT_GE(cost.profile("fib"), 0);
+
+    // estimates now use the measured time
+    cost.clear();
+    EXPECT_GE(cost.estimate(expr), cost.profile("fib"));
+}
@@ -0,0 +1,172 @@
+#pragma once
+#include "AST/TreeOps/EvalExpression.h"
+#include "AST/TreeOps/PartialEvalExpression.h"
+#include <gtest/gtest.h>
+
+using namespace kiwi;
+
+TEST(PartialEval, Passes) {
+    BuilderContext ctx;
+    Builder builder(&ctx);
+
+    for(char const *op : {"+", "-", "*", "/"})
+        builder.make_placeholder(op);
+    builder.make_placeholder("x");
+    builder.make_placeholder("y");
+
+    auto x = builder.get_ctx_ref("x");
+    auto y = builder.get_ctx_ref("y");
+    auto v = [&](double value) { return builder.make_value(value); };
+
+    Context env;
+
+    // x * 1 + 0 => x
+    Expression *x_one    = builder.make_binary_call("*", x, v(1));
+    Expression *identity = builder.make_binary_call("+", x_one, v(0));
+    EXPECT_EQ(optimize(builder, env, identity), x);
+
+    // (2 + 3) * y => 5 * y
+    Expression *sum    = builder.make_binary_call("+", v(2), v(3));
+    Expression *folded = optimize(builder, env, builder.make_binary_call("*", sum, y));
+    ASSERT_EQ(folded->tag, NodeTag::binary_call);
+    EXPECT_EQ(static_cast<Value *>(static_cast<BinaryCall *>(folded)->lhs)->as<f64>(), 5);
+
+    // x / 4 => x * 0.25
+    Expression *reduced = optimize(builder, env, builder.make_binary_call("/", x, v(4)));
+    ASSERT_EQ(reduced->tag, NodeTag::binary_call);
+    EXPECT_EQ(static_cast<BinaryCall *>(reduced)->op, BinaryOp::mul);
+
+    // (1 + 1) match | 1 => x | 2 => y | _ => 0 => y
+    Match *match  = builder.make<Match>();
+    match->target = builder.make_binary_call("+", v(1), v(1));
+    match->branches.emplace_back(v(1), x);
+    match->branches.emplace_back(v(2), y);
+    match->default_branch = v(0);
+    EXPECT_EQ(optimize(builder, env, match), y);
+}
+
+TEST(PartialEval, TypedFolding) {
+    BuilderContext ctx;
+    Builder builder(&ctx, true);
+
+    for(char const *op : {"+", "/", "sqrt"})
+        builder.make_placeholder(op);
+    builder.make_placeholder("x");
+
+    auto x = builder.get_ctx_ref("x");
+    Context env;
+
+    auto folded = [&](Expression *expr) {
+        Expression *result = optimize(builder, env, expr);
+        EXPECT_EQ(result->tag, NodeTag::value);
+        return static_cast<PrimitiveValue *>(result);
+    };
+
+    // 7 / 2 => 3 on integers
+    PrimitiveValue *quotient = folded(
+        builder.make_binary_call("/", builder.make_value(i32(7)), builder.make_value(i32(2))));
+    EXPECT_EQ(quotient->tag(), PrimitiveTag::i32);
+    EXPECT_EQ(quotient->as<f64>(), 3);
+
+    // sqrt(16) is computed in f64
+    PrimitiveValue *root = folded(builder.make_unary_call("sqrt", builder.make_value(i64(16))));
+    EXPECT_EQ(root->tag(), PrimitiveTag::f64);
+    EXPECT_EQ(root->as<f64>(), 4);
+
+    // x / 2 truncates on integers, 1 / 2^-1074 overflows: both stay divisions
+    Value *tiny = builder.make_value(std::ldexp(1.0, -1074));
+    for(Expression *divisor : {builder.make_value(i32(2)), tiny}) {
+        Expression *div = builder.make_binary_call("/", x, divisor);
+        EXPECT_EQ(optimize(builder, env, div), div);
+    }
+
+    // rebuilt nodes are hash-consed: x + (1 + 1) => x + 2
+    Expression *sum = builder.make_binary_call(
+        "+", x, builder.make_binary_call("+", builder.make_value(1.0), builder.make_value(1.0)));
+    Expression *expected = builder.make_binary_call("+", x, builder.make_value(2.0));
+    EXPECT_EQ(optimize(builder, env, sum), expected);
+}
+
+TEST(PartialEval, DeadBranchKeepsOrder) {
+    BuilderContext ctx;
+    Builder builder(&ctx);
+
+    builder.make_placeholder("y");
+    auto v = [&](double value) { return builder.make_value(value); };
+
+    // match 1 | y => 10 | 1 => 20 | 2 => 30 | _ => 0
+    // y is unknown, it is still tested before the branch that matches
+    Match *match  = builder.make<Match>();
+    match->target = v(1);
+    match->branches.emplace_back(builder.get_ctx_ref("y"), v(10));
+    match->branches.emplace_back(v(1), v(20));
+    match->branches.emplace_back(v(2), v(30));
+    match->default_branch = v(0);
+
+    Context env;
+    Expression *result = optimize(builder, env, match);
+    ASSERT_EQ(result->tag, NodeTag::match);
+
+    Match *reduced = static_cast<Match *>(result);
+    EXPECT_EQ(reduced->branches.size(), 1u);
+    EXPECT_EQ(static_cast<Value *>(reduced->default_branch)->as<f64>(), 20);
+
+    for(double y : {1.0, 5.0}) {
+        PrimitiveValue vy(y);
+        env[Symbol("y")] = &vy;
+        EXPECT_EQ(full_eval(env, result), full_eval(env, match)) << y;
+    }
+}
+
+TEST(PartialEval, InliningFixpoint) {
+    BuilderContext ctx;
+    Builder builder(&ctx);
+
+    builder.make_placeholder("+");
+    builder.make_placeholder("*");
+    builder.make_placeholder("x");
+    builder.make_placeholder("k");
+
+    // def sq(v) = v * v
+    FunctionBuilder fb = builder.make_function("sq");
+    fb.add_arg("v", get_primitive_type<f64>());
+    fb.add_body(builder.make_binary_call("*", builder.get_ctx_ref("v"), builder.get_ctx_ref("v")));
+    Function *sq = fb.build();
+
+    auto call = [&](Expression *arg) {
+        return builder.make<FunctionCall>(builder.get_ctx_ref("sq"), Array<Expression *>{arg});
+    };
+
+    Context env;
+    env[Symbol("sq")] = sq;
+    env[Symbol("k")]  = builder.make_value(3.0);
+
+    // sq(k) + sq(x + 1) * 1 => 9 + sq(x + 1)
+    Expression *x1 =
+        builder.make_binary_call("+", builder.get_ctx_ref("x"), builder.make_value(1.0));
+    Expression *expr = builder.make_binary_call(
+        "+", call(builder.get_ctx_ref("k")),
+        builder.make_binary_call("*", call(x1), builder.make_value(1.0)));
+
+    Optimizer optimizer(builder, env);
+    Expression *result = optimizer.run(expr);
+
+    ASSERT_EQ(result->tag, NodeTag::binary_call);
+    BinaryCall *add = static_cast<BinaryCall *>(result);
+    ASSERT_EQ(add->lhs->tag, NodeTag::value);
+    EXPECT_EQ(static_cast<Value *>(add->lhs)->as<f64>(), 9);
+
+    // the argument is not a leaf and is used twice, the call stays
+    EXPECT_EQ(add->rhs->tag, NodeTag::function_call);
+
+    // the last iteration did not change anything
+    EXPECT_GE(optimizer.iterations(), 2u);
+    std::size_t total = 0;
+    for(PassStats const &stat : optimizer.stats())
+        total += stat.rewrites;
+    EXPECT_GE(total, 4u);
+
+    PrimitiveValue vx(2.0);
+    env[Symbol("x")] = &vx;
+    EXPECT_DOUBLE_EQ(full_eval(env, result), full_eval(env, expr));
+}
@@ -0,0 +1,127 @@
+#pragma once
+#include "AST/TreeOps/ArrayEval.h"
+#include "AST/TreeOps/BatchEval.h"
+#include "AST/TreeOps/EvalExpression.h"
+#include "AST/TreeOps/ParallelEval.h"
+#include "AST/TreeOps/StackEval.h"
+#include "VMTest.h"
+#include <gtest/gtest.h>
+
+using namespace kiwi;
+
+TEST(StackEval, MatchesFullEval) {
+    BuilderContext ctx;
+    Builder builder(&ctx);
+
+    Function *fib = make_fib(builder);
+    builder.make_placeholder("*");
+    builder.make_placeholder("sqrt");
+
+    Context env;
+    env[Symbol("fib")] = fib;
+    env[Symbol("n")]   = builder.make_value(15.0);
+
+    // sqrt(fib(n)) * n
+    Expression *call = builder.make<FunctionCall>(builder.get_ctx_ref("fib"),
+                                                  Array<Expression *>{builder.get_ctx_ref("n")});
+    Expression *expr = builder.make_binary_call(
+        "*", builder.make_unary_call("sqrt", call), builder.get_ctx_ref("n"));
+
+    StackEval eval(env);
+    EXPECT_EQ(eval.run(call), 610);
+    EXPECT_DOUBLE_EQ(eval.run(expr), full_eval(env, expr));
+    EXPECT_TRUE(eval.ok());
+}
+
+TEST(StackEval, RecursiveBindings) {
+    BuilderContext ctx;
+    Builder builder(&ctx);
+
+    builder.make_placeholder("+");
+    builder.make_placeholder("a");
+    builder.make_placeholder("b");
+    builder.make_placeholder("n");
+    builder.make_placeholder("m");
+
+    Expression *a = builder.get_ctx_ref("a");
+    Expression *n = builder.get_ctx_ref("n");
+    Expression *m = builder.get_ctx_ref("m");
+
+    // m is an alias of n
+    Context env;
+    env[Symbol("n")] = builder.make_value(3.0);
+    env[Symbol("m")] = n;
+
+    Columns columns;
+    StackEval eval(env);
+    WorkStealingPool pool(2);
+
+    EXPECT_EQ(full_eval(env, m), 3);
+    EXPECT_EQ(static_cast<PrimitiveValue *>(ArrayEval(env).run(m))->as<f64>(), 3);
+    EXPECT_EQ(BatchEval(env, columns).run(m, 1)[0], 3);
+    EXPECT_EQ(eval.run(m), 3);
+    EXPECT_EQ(VirtualMachine().run(compile_bytecode(env, m)), 3);
+    EXPECT_EQ(parallel_eval(env, pool, m), 3);
+
+    // n = n, a = b + 1, b = a: resolution stops instead of recursing forever
+    env[Symbol("n")] = n;
+    env[Symbol("a")] =
+        builder.make_binary_call("+", builder.get_ctx_ref("b"), builder.make_value(1.0));
+    env[Symbol("b")] = a;
+
+    EXPECT_EQ(full_eval(env, n), 0);
+    EXPECT_EQ(BatchEval(env, columns).run(n, 1)[0], 0);
+
+    for(Expression *expr : {n, a}) {
+        full_eval(env, expr);
+        BatchEval(env, columns).run(expr, 1);
+        parallel_eval(env, pool, expr);
+        EXPECT_EQ(ArrayEval(env).run(expr), nullptr);
+
+        EXPECT_EQ(eval.run(expr), 0);
+        EXPECT_FALSE(eval.ok());
+
+        EXPECT_TRUE(compile_bytecode(env, expr).chunks.empty());
+    }
+}
+
+TEST(StackEval, DeepRecursion) {
+    BuilderContext ctx;
+    Builder builder(&ctx);
+
+    builder.make_placeholder("+");
+    builder.make_placeholder("-");
+
+    // def sum(n) = n match | 0 => 0 | _ => n + sum(n - 1)
+    FunctionBuilder fb = builder.make_function("sum");
+    fb.add_arg("n", get_primitive_type<f64>());
+
+    Match *match  = builder.make<Match>();
+    match->target = builder.get_ctx_ref("n");
+    match->branches.emplace_back(builder.make_value(0.0), builder.make_value(0.0));
+    match->default_branch = builder.make_binary_call(
+        "+", builder.get_ctx_ref("n"),
+        builder.make<FunctionCall>(
+            builder.get_ctx_ref("sum"),
+            Array<Expression *>{builder.make_binary_call("-", builder.get_ctx_ref("n"),
+                                                         builder.make_value(1.0))}));
+    fb.add_body(match);
+    Function *sum = fb.build();
+
+    Context env;
+    env[Symbol("sum")] = sum;
+    env[Symbol("n")]   = builder.make_value(100000.0);
+
+    Expression *call = builder.make<FunctionCall>(builder.get_ctx_ref("sum"),
+                                                  Array<Expression *>{builder.get_ctx_ref("n")});
+
+    // far deeper than the native stack would allow with FullEval
+    StackEval eval(env, 1 << 20, 1 << 18);
+    EXPECT_EQ(eval.run(call), 100000.0 * 100001.0 / 2);
+    EXPECT_TRUE(eval.ok());
+
+    // bounded by the frames, not by the thread stack
+    StackEval small(env, 1 << 20, 1000);
+    EXPECT_EQ(small.run(call), 0);
+    EXPECT_FALSE(small.ok());
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include "AST/Builder.h"
+#include <gtest/gtest.h>
+
+#include <thread>
+
+using namespace kiwi;
+
+TEST(StringDatabase, Intern) {
+    StringDatabase &db = StringDatabase::instance();
+
+    SymbolId a = db.intern("interned_a");
+    SymbolId b = db.intern("interned_b");
+
+    EXPECT_NE(a, b);
+    EXPECT_EQ(a, db.intern(String("interned_a")));
+    EXPECT_EQ(db.get(a), "interned_a");
+    EXPECT_TRUE(db.contains("interned_b"));
+
+    EXPECT_TRUE(Symbol().empty());
+    EXPECT_EQ(Symbol(""), Symbol());
+    EXPECT_EQ(Symbol("interned_a").id(), a);
+}
+
+TEST(StringDatabase, ThreadSafe) {
+    Array<Array<SymbolId>> ids(4);
+    Array<std::thread> threads;
+
+    for(std::size_t t = 0; t < ids.size(); ++t) {
+        threads.emplace_back([t, &ids]() {
+            for(int i = 0; i < 2000; ++i)
+                ids[t].push_back(Symbol("thread_sym_" + std::to_string(i)).id());
+        });
+    }
+    for(auto &thread : threads)
+        thread.join();
+
+    for(std::size_t t = 1; t < ids.size(); ++t)
+        EXPECT_EQ(ids[0], ids[t]);
+
+    EXPECT_EQ(Symbol::from_id(ids[0][42]).str(), "thread_sym_42");
+}
+
+TEST(StringDatabase, AttributeLookup) {
+    Struct def;
+    def.add_attribute("x", nullptr);
+    def.add_attribute("y", nullptr);
+
+    EXPECT_EQ(def.get_attribute_index("y"), 1);
+    EXPECT_EQ(def.get_attribute_index("z"), -1);
+}
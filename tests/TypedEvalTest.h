@@ -0,0 +1,131 @@
+#pragma once
+#include "AST/TreeOps/EvalExpression.h"
+#include "AST/TreeOps/TypedEval.h"
+#include "VMTest.h"
+#include <gtest/gtest.h>
+
+using namespace kiwi;
+
+TEST(TypedEval, IntegerSemantics) {
+    BuilderContext ctx;
+    Builder builder(&ctx);
+
+    builder.make_placeholder("/");
+
+    // def half(n) = n / 2
+    FunctionBuilder fb = builder.make_function("half");
+    fb.add_arg("n", get_primitive_type<f64>());
+    fb.add_body(builder.make_binary_call("/", builder.get_ctx_ref("n"), builder.make_value(2.0)));
+
+    Context env;
+    env[Symbol("half")] = fb.build();
+
+    TypedEval eval(env);
+    TypedValue r = eval.call("half", {make_typed(i64(7))});
+    EXPECT_EQ(r.tag, PrimitiveTag::i64);
+    EXPECT_EQ(r.as<i64>(), 3);
+
+    r = eval.call("half", {make_typed(7.0)});
+    EXPECT_EQ(r.tag, PrimitiveTag::f64);
+    EXPECT_EQ(r.as<f64>(), 3.5);
+
+    // one specialization per argument types
+    eval.call("half", {make_typed(i64(9))});
+    EXPECT_EQ(eval.specializations(), 2u);
+    EXPECT_TRUE(eval.ok());
+
+    // min / -1 wraps instead of trapping
+    i64 min = std::numeric_limits<i64>::min();
+    r = typed_eval(env, builder.make_binary_call("/", builder.make_value(min),
+                                                 builder.make_value(i64(-1))));
+    EXPECT_EQ(r.as<i64>(), min);
+    EXPECT_EQ(apply_operator(BinaryOp::div, i32(-7), i32(-1)), 7);
+    EXPECT_EQ(apply_operator(BinaryOp::div, std::numeric_limits<i8>::min(), i8(-1)),
+              std::numeric_limits<i8>::min());
+}
+
+TEST(TypedEval, Promotion) {
+    BuilderContext ctx;
+    Builder builder(&ctx);
+
+    builder.make_placeholder("+");
+    builder.make_placeholder("a");
+    builder.make_placeholder("b");
+
+    PrimitiveValue a(u8(200)), b(u8(100)), c(2.5f);
+    Context env;
+    env[Symbol("a")] = &a;
+    env[Symbol("b")] = &b;
+
+    Expression *sum = builder.make_binary_call("+", builder.get_ctx_ref("a"),
+                                               builder.get_ctx_ref("b"));
+
+    // u8 arithmetic wraps
+    TypedValue r = typed_eval(env, sum);
+    EXPECT_EQ(r.tag, PrimitiveTag::u8);
+    EXPECT_EQ(r.as<u64>(), 44u);
+
+    // u8 + f32 is f32
+    env[Symbol("b")] = &c;
+    r                = typed_eval(env, sum);
+    EXPECT_EQ(r.tag, PrimitiveTag::f32);
+    EXPECT_EQ(r.as<f32>(), 202.5f);
+}
+
+TEST(TypedEval, RecursiveSpecialization) {
+    BuilderContext ctx;
+    Builder builder(&ctx);
+
+    Function *fib = make_fib(builder);
+    Context env;
+    env[Symbol("fib")] = fib;
+
+    TypedEval eval(env);
+    TypedValue r = eval.call("fib", {make_typed(i64(20))});
+    EXPECT_TRUE(eval.ok());
+    EXPECT_EQ(r.tag, PrimitiveTag::f64); // the base cases are f64 literals
+    EXPECT_EQ(r.as<f64>(), 6765);
+
+    // n - 1 stays i64, fib(i64) only calls itself
+    EXPECT_EQ(eval.specializations(), 1u);
+
+    Expression *call = builder.make<FunctionCall>(builder.get_ctx_ref("fib"),
+                                                  Array<Expression *>{builder.make_value(15.0)});
+    EXPECT_EQ(eval.run(call).as<f64>(), full_eval(env, call));
+    EXPECT_EQ(eval.specializations(), 2u);
+}
+
+TEST(TypedEval, Rebinding) {
+    BuilderContext ctx;
+    Builder builder(&ctx);
+
+    builder.make_placeholder("*");
+    builder.make_placeholder("k");
+
+    // def scale(v) = v * k
+    FunctionBuilder fb = builder.make_function("scale");
+    fb.add_arg("v", get_primitive_type<f64>());
+    fb.add_body(builder.make_binary_call("*", builder.get_ctx_ref("v"), builder.get_ctx_ref("k")));
+
+    Context env;
+    env[Symbol("scale")] = fb.build();
+
+    TypedEval eval(env);
+    {
+        PrimitiveValue k(2.0);
+        env[Symbol("k")] = &k;
+        EXPECT_EQ(eval.call("scale", {make_typed(3.0)}).as<f64>(), 6);
+    }
+
+    // the cached specialization reads the new binding, the old one is gone
+    PrimitiveValue k(10.0);
+    env[Symbol("k")] = &k;
+    EXPECT_EQ(eval.call("scale", {make_typed(3.0)}).as<f64>(), 30);
+    EXPECT_EQ(eval.specializations(), 1u);
+    EXPECT_TRUE(eval.ok());
+
+    // a name that is no longer a value needs a clear()
+    env[Symbol("k")] = builder.get_ctx_ref("v");
+    eval.call("scale", {make_typed(3.0)});
+    EXPECT_FALSE(eval.ok());
+}
@@ -0,0 +1,129 @@
+#pragma once
+#include "AST/TreeOps/EvalExpression.h"
+#include "VM/Compiler.h"
+#include "VM/VirtualMachine.h"
+#include <gtest/gtest.h>
+
+#include <sstream>
+
+using namespace kiwi;
+
+// def fib(n) = n match | 0 => 0 | 1 => 1 | _ => fib(n - 1) + fib(n - 2)
+inline Function *make_fib(Builder &builder) {
+    builder.make_placeholder("+");
+    builder.make_placeholder("-");
+
+    FunctionBuilder fb = builder.make_function("fib");
+    fb.add_arg("n", get_primitive_type<f64>());
+
+    auto call = [&](double offset) {
+        Expression *arg =
+            builder.make_binary_call("-", builder.get_ctx_ref("n"), builder.make_value(offset));
+        return builder.make<FunctionCall>(builder.get_ctx_ref("fib"), Array<Expression *>{arg});
+    };
+
+    Match *match  = builder.make<Match>();
+    match->target = builder.get_ctx_ref("n");
+    match->branches.emplace_back(builder.make_value(0.0), builder.make_value(0.0));
+    match->branches.emplace_back(builder.make_value(1.0), builder.make_value(1.0));
+    match->default_branch = builder.make_binary_call("+", call(1), call(2));
+
+    fb.add_body(match);
+    return fb.build();
+}
+
+TEST(VM, Expression) {
+    BuilderContext ctx;
+    Builder builder(&ctx);
+
+    builder.make_placeholder("+");
+    builder.make_placeholder("*");
+    builder.make_placeholder("sqrt");
+    builder.make_placeholder("x");
+
+    // sqrt(x * x + 2) * -x
+    Expression *expr = builder.make_binary_call(
+        "*",
+        builder.make_unary_call(
+            "sqrt", builder.make_binary_call(
+                        "+", builder.make_binary_call("*", builder.get_ctx_ref("x"),
+                                                      builder.get_ctx_ref("x")),
+                        builder.make_value(2.0))),
+        builder.make_unary_call("-", builder.get_ctx_ref("x")));
+
+    Context env;
+    env[Symbol("x")] = builder.make_value(3.0);
+
+    Program program = compile_bytecode(env, expr);
+    ASSERT_EQ(program.chunks.size(), 1u);
+
+    VirtualMachine vm;
+    EXPECT_DOUBLE_EQ(vm.run(program), std::sqrt(11.0) * -3.0);
+}
+
+TEST(VM, RecursiveCalls) {
+    BuilderContext ctx;
+    Builder builder(&ctx);
+    Function *fib = make_fib(builder);
+
+    Context env;
+    env[Symbol("fib")] = fib;
+
+    Program program = BytecodeCompiler(env).compile(fib, "fib");
+    ASSERT_EQ(program.chunks.size(), 1u);
+    EXPECT_EQ(program.chunks[0].arg_count, 1);
+
+    VirtualMachine vm;
+    EXPECT_EQ(vm.run(program, {15}), 610);
+    EXPECT_EQ(vm.run(program, {1}), 1);
+
+    // same result as the tree walker
+    env[Symbol("n")] = builder.make_value(10.0);
+    Expression *call = builder.make<FunctionCall>(builder.get_ctx_ref("fib"),
+                                                  Array<Expression *>{builder.get_ctx_ref("n")});
+    EXPECT_EQ(vm.run(compile_bytecode(env, call)), full_eval(env, call));
+
+    std::stringstream ss;
+    disassemble(ss, program);
+    EXPECT_NE(ss.str().find("call"), String::npos);
+    EXPECT_NE(ss.str().find("jump_table"), String::npos); // constant patterns
+}
+
+TEST(VM, TooBig) {
+    BuilderContext ctx;
+    Builder builder(&ctx);
+
+    // more constants than a load_const can address
+    Block *block = builder.make_block();
+    for(int i = 0; i < 70000; ++i)
+        block->statements.push_back(builder.make_value(f64(i)));
+
+    Context env;
+    EXPECT_TRUE(compile_bytecode(env, block).empty());
+
+    block->statements.resize(1000);
+    Program program = compile_bytecode(env, block);
+    ASSERT_FALSE(program.empty());
+
+    VirtualMachine vm;
+    EXPECT_EQ(vm.run(program), 999);
+
+    // as many arguments as an operand can address, no register is left for the result
+    Function *wide = builder.make<Function>();
+    wide->body     = builder.make_value(1.0);
+    Array<Expression *> args;
+    for(int i = 0; i < 65536; ++i) {
+        wide->args.emplace_back(Symbol("arg_" + std::to_string(i)), nullptr);
+        args.push_back(builder.make_value(f64(i)));
+    }
+    env[Symbol("wide")] = wide;
+
+    builder.make_placeholder("wide");
+    Expression *call = builder.make<FunctionCall>(builder.get_ctx_ref("wide"), args);
+    EXPECT_TRUE(compile_bytecode(env, call).empty());
+
+    wide->args.pop_back();
+    args.pop_back();
+    call = builder.make<FunctionCall>(builder.get_ctx_ref("wide"), args);
+    EXPECT_TRUE(compile_bytecode(env, call).empty());
+}
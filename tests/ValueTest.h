@@ -5,6 +5,7 @@
 
 #include "AST/Expression.h"
 #include "AST/KExpression.h"
+#include "AST/StructArray.h"
 
 //#define KIWI_DEBUG
 #include "../src/Debug.h"
@@ -28,7 +29,12 @@ TEST(Value, StructType) {
 
     auto v = new StructValue();
     v->set_type(def);
+    v->set_value(0, arr[0])->set_value(1, arr[1]);
     v->dump(std::cout) << std::endl;
+
+    EXPECT_EQ(v->get<i64>(0), 2);
+    EXPECT_EQ(v->get<f64>(1), 2.0);
+    EXPECT_EQ(v->as<f64>(0), 2.0);
 }
 
 TEST(Value, UnionType) {
@@ -40,9 +46,9 @@ TEST(Value, UnionType) {
     // UnionType *stype = new UnionType(def);
     auto v = new UnionValue();
     v->set_type(def);
-    v->index = 0;
-    v->value = new PrimitiveValue(2);
+    v->set_value(0, new PrimitiveValue(2));
     v->dump(std::cout) << std::endl;
+    EXPECT_EQ(v->get<i64>(), 2);
 }
 
 TEST(Value, UnionTypeNone) {
@@ -54,7 +60,133 @@ TEST(Value, UnionTypeNone) {
     // UnionType *stype = new UnionType(def);
     auto v = new UnionValue();
     v->set_type(def);
-    v->index = 0;
-    v->value = new PrimitiveValue(2);
     v->dump(std::cout) << std::endl;
+    EXPECT_EQ(v->get<i64>(), 0);
+}
+
+TEST(Value, StructLayout) {
+    Struct def;
+    def.add_attribute("a", get_primitive_type<u8>());
+    def.add_attribute("b", get_primitive_type<f64>());
+    def.add_attribute("c", get_primitive_type<i32>());
+    def.add_attribute("d", new Struct());
+    def.seal();
+
+    RecordLayout const &layout = def.layout;
+    EXPECT_EQ(layout.field(0).offset, 0u);
+    EXPECT_EQ(layout.field(1).offset, 8u);
+    EXPECT_EQ(layout.field(2).offset, 16u);
+    EXPECT_EQ(layout.field(3).offset, 24u);
+    EXPECT_TRUE(layout.field(3).is_boxed());
+    EXPECT_EQ(layout.size, 32u);
+    EXPECT_EQ(layout.alignment, 8u);
+
+    EXPECT_EQ(def.get_attribute_index("c"), 2);
+    EXPECT_EQ(def.get_attribute_index("z"), -1);
+
+    Struct wide;
+    for(int i = 0; i < 50; ++i)
+        wide.add_attribute("field_" + std::to_string(i), get_primitive_type<f32>());
+    wide.seal();
+
+    for(int i = 0; i < 50; ++i)
+        EXPECT_EQ(wide.get_attribute_index("field_" + std::to_string(i)), i);
+    EXPECT_EQ(wide.layout.size, 200u);
+}
+
+TEST(Value, UnionLayout) {
+    Union def;
+    def.add_attribute("x", get_primitive_type<i16>());
+    def.add_attribute("y", get_primitive_type<f64>());
+    def.seal();
+
+    EXPECT_EQ(def.layout.field(0).offset, 0u);
+    EXPECT_EQ(def.layout.field(1).offset, 0u);
+    EXPECT_EQ(def.layout.size, 8u);
+    EXPECT_EQ(def.get_attribute_index("y"), 1);
+}
+
+TEST(Value, StructArray) {
+    Struct def;
+    def.add_attribute("id", get_primitive_type<i32>());
+    def.add_attribute("x", get_primitive_type<f64>());
+    def.seal();
+
+    StructValue row;
+    row.set_type(&def);
+
+    StructArray rows(&def);
+    for(int i = 0; i < 100; ++i) {
+        row.set(0, i)->set(1, i * 0.5);
+        rows.push_back(row);
+    }
+
+    EXPECT_EQ(rows.size(), 100u);
+    EXPECT_EQ(rows.column<f32>(1), nullptr);
+
+    f64 const *x = rows.column<f64>(1);
+    ASSERT_NE(x, nullptr);
+    EXPECT_EQ(reinterpret_cast<std::uintptr_t>(x) % StructArray::alignment, 0u);
+
+    f64 sum = 0;
+    for(std::size_t i = 0; i < rows.size(); ++i)
+        sum += x[i];
+    EXPECT_EQ(sum, 2475.0);
+
+    rows.load(42, row);
+    EXPECT_EQ(row.get<i32>(0), 42);
+    EXPECT_EQ(rows.get<i64>(42, 1), 21);
+}
+
+TEST(Value, InvalidAccess) {
+    Struct inner;
+    Struct def;
+    def.add_attribute("a", get_primitive_type<i32>());
+    def.add_attribute("b", &inner);
+    def.seal();
+
+    StructValue v;
+    v.set_type(&def);
+    v.set(0, 7);
+
+    // out of range fields are logged and ignored
+    v.set(5, 1.0);
+    EXPECT_EQ(v.get<i32>(5), 0);
+    EXPECT_EQ(v.get_boxed(5), nullptr);
+    EXPECT_EQ(v.as<i32>(5), 0);
+
+    // a primitive cannot go in a boxed field nor a struct in a packed one
+    v.set(1, 2.0);
+    EXPECT_EQ(v.get_boxed(1), nullptr);
+
+    StructValue other;
+    other.set_type(&def);
+    v.set_value(0, &other);
+    EXPECT_EQ(v.get<i32>(0), 7);
+
+    // rows are only copied between values of the array type
+    Struct wrong;
+    wrong.add_attribute("a", get_primitive_type<f64>());
+    wrong.seal();
+
+    StructValue w;
+    w.set_type(&wrong);
+    w.set(0, 3.5);
+
+    StructArray rows(&def, 1);
+    rows.store(0, w);
+    EXPECT_EQ(rows.get<i32>(0, 0), 0);
+    rows.load(0, w);
+    EXPECT_EQ(w.get<f64>(0), 3.5);
+
+    Union un;
+    un.add_attribute("x", get_primitive_type<i16>());
+    un.seal();
+
+    UnionValue u;
+    u.set_type(&un);
+    u.set(0, 4);
+    u.set(3, 1);
+    EXPECT_EQ(u.index, 0);
+    EXPECT_EQ(u.get<i16>(), 4);
 }
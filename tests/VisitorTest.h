@@ -0,0 +1,86 @@
+#pragma once
+#include "AST/TreeOps/EvalExpression.h"
+#include <gtest/gtest.h>
+
+using namespace kiwi;
+
+// Only counts values, every other node is unhandled
+struct CountValues : public StaticExpressionVisitor<CountValues, int> {
+    int value(Value *) { return 1; }
+
+    int binary_call(BinaryCall *call) {
+        return visit_expression(call->lhs) + visit_expression(call->rhs);
+    }
+
+    int unhandled_expression(Expression *) { return 0; }
+    int nullptr_expression() { return 0; }
+};
+
+TEST(Visitor, StaticDispatch) {
+    BuilderContext ctx;
+    Builder builder(&ctx);
+
+    builder.make_placeholder("+");
+    Expression *x    = builder.make_placeholder("x");
+    Expression *expr = builder.make_binary_call(
+        "+", builder.make_value(1.0), builder.make_binary_call("+", x, builder.make_value(2.0)));
+
+    EXPECT_EQ(CountValues().visit_expression(expr), 2);
+    EXPECT_EQ(CountValues().visit_expression(nullptr), 0);
+}
+
+TEST(Visitor, FullEval) {
+    BuilderContext ctx;
+    Builder builder(&ctx);
+
+    builder.make_placeholder("+");
+    builder.make_placeholder("*");
+    builder.make_placeholder("x");
+
+    // def sq_plus(y) = y * y + x
+    FunctionBuilder fb = builder.make_function("sq_plus");
+    fb.add_arg("y", get_primitive_type<f64>());
+    Expression *y = builder.get_ctx_ref("y");
+    fb.add_body(builder.make_binary_call("+", builder.make_binary_call("*", y, y),
+                                         builder.get_ctx_ref("x")));
+    Function *fun = fb.build();
+
+    Context env;
+    env[Symbol("x")]       = builder.make_value(1.5);
+    env[Symbol("sq_plus")] = fun;
+
+    Expression *call = builder.make<FunctionCall>(
+        builder.get_ctx_ref("sq_plus"), Array<Expression *>{builder.make_value(3)});
+
+    EXPECT_EQ(full_eval(env, call), 10.5);
+}
+
+TEST(Visitor, OperatorRegistry) {
+    BuilderContext ctx;
+    Builder builder(&ctx);
+
+    builder.make_placeholder("+");
+    Expression *x = builder.make_placeholder("x");
+
+    // resolved when the call is built
+    EXPECT_EQ(static_cast<BinaryCall *>(builder.make_binary_call("+", x, x))->op, BinaryOp::add);
+    EXPECT_EQ(get_binary_op("*"), BinaryOp::mul);
+    EXPECT_EQ(get_unary_op("sqrt"), UnaryOp::sqrt);
+    EXPECT_EQ(get_binary_op("max"), BinaryOp::none);
+
+    EXPECT_DOUBLE_EQ(binary_operator(BinaryOp::sub)(5, 3), 2);
+    EXPECT_EQ(binary_operator(BinaryOp::none), nullptr);
+
+    // typed kernels
+    i32 a = 7, b = 2, r = 0;
+    binary_kernel(BinaryOp::div, PrimitiveTag::i32)(&r, &a, &b);
+    EXPECT_EQ(r, 3);
+
+    f32 c = 4, s = 0;
+    unary_kernel(UnaryOp::sqrt, PrimitiveTag::f32)(&s, &c);
+    EXPECT_FLOAT_EQ(s, 2);
+
+    EXPECT_EQ(unary_kernel(UnaryOp::sqrt, PrimitiveTag::u8), nullptr);
+    EXPECT_EQ(unary_kernel(UnaryOp::neg, PrimitiveTag::u32), nullptr);
+    EXPECT_NE(unary_kernel(UnaryOp::neg, PrimitiveTag::i64), nullptr);
+}
@@ -5,6 +5,25 @@
 #include "ParserTest.h"
 
 #include "BuilderContextTest.h"
+#include "ArenaTest.h"
+#include "StringDatabaseTest.h"
+#include "FlatASTTest.h"
+#include "BinaryConversionTest.h"
+#include "VisitorTest.h"
+#include "VMTest.h"
+#include "BatchEvalTest.h"
+#include "IncrementalEvalTest.h"
+#include "StackEvalTest.h"
+#include "PartialEvalTest.h"
+#include "EGraphTest.h"
+#include "ParallelEvalTest.h"
+#include "TypedEvalTest.h"
+#include "MatchCompilerTest.h"
+#include "EvalRegionTest.h"
+#include "HalfTest.h"
+#include "ArrayEvalTest.h"
+#include "ColumnSourceTest.h"
+#include "JITTest.h"
 
 int main(int argc, char **argv) {
     testing::InitGoogleTest(&argc, argv);